@@ -0,0 +1,117 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// OTHER
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "GLState.h"
+#include "IBLBaker.h"
+#include "BRDFLUTData.h"
+
+// Split sum BRDF scale and bias to F0, N.V along x and roughness along y. It doesn't depend on the
+// environment, so instead of integrating 512x512 texels at startup the engine ships it baked:
+// BRDFLUTData.h holds a 64x64 RG8 table, written by 3DEngine.exe --bake brdf from IBLBaker::bakeBRDF.
+// The BRDF_APPROX shader permutation skips the texture for Karis' analytic fit (approximate below).
+// Errors and fragment cost of both: 3DEngine.exe --benchmark brdf
+namespace BRDFLUT
+{
+	static const char* const DATA_FILE = "src/BRDFLUTData.h";
+	// Samples per texel of the table, the startup bake used 1024
+	static const uint32_t BAKE_SAMPLES = 4096;
+
+	// Upload the shipped table. Unsigned normalised, both channels lie in [0, 1]
+	inline GLuint createTexture()
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		GLState::get().bindTexture(0, GL_TEXTURE_2D, texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG8, SIZE, SIZE);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SIZE, SIZE, GL_RG, GL_UNSIGNED_BYTE, DATA);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return texture;
+	}
+
+	// Bilinear lookup of an RG float table of size x size with clamp to edge, as the GPU filters it
+	inline void sample(const float* table, int size, float nDotV, float roughness, float* out)
+	{
+		float x = std::min(std::max(nDotV * size - 0.5f, 0.0f), (float)(size - 1));
+		float y = std::min(std::max(roughness * size - 0.5f, 0.0f), (float)(size - 1));
+		int x0 = (int)x, y0 = (int)y;
+		int x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+		float fx = x - x0, fy = y - y0;
+		for (int c = 0; c < 2; c++)
+		{
+			float top = table[(y0 * size + x0) * 2 + c] * (1.0f - fx) + table[(y0 * size + x1) * 2 + c] * fx;
+			float bottom = table[(y1 * size + x0) * 2 + c] * (1.0f - fx) + table[(y1 * size + x1) * 2 + c] * fx;
+			out[c] = top * (1.0f - fy) + bottom * fy;
+		}
+	}
+
+	// The shipped table as floats
+	inline std::vector<float> getTable()
+	{
+		std::vector<float> table(SIZE * SIZE * 2);
+		for (size_t i = 0; i < table.size(); i++)
+		{
+			table[i] = DATA[i] / 255.0f;
+		}
+		return table;
+	}
+
+	// Karis' fit to the split sum (Physically Based Shading on Mobile), the maths of envBRDFApprox in
+	// FragmentCorePBR. Fitted to a Smith G with k = alpha / 2, so it drifts from the table at high roughness
+	inline void approximate(float nDotV, float roughness, float* out)
+	{
+		const float c0[4] = { -1.0f, -0.0275f, -0.572f, 0.022f };
+		const float c1[4] = { 1.0f, 0.0425f, 1.04f, -0.04f };
+		float r[4];
+		for (int i = 0; i < 4; i++)
+		{
+			r[i] = roughness * c0[i] + c1[i];
+		}
+		float a004 = std::min(r[0] * r[0], std::exp2(-9.28f * nDotV)) * r[0] + r[1];
+		out[0] = -1.04f * a004 + r[2];
+		out[1] = 1.04f * a004 + r[3];
+	}
+
+	// --bake brdf: integrate the table on the CPU, quantise it and write it out as BRDFLUTData.h
+	inline int bake()
+	{
+		double start = IBLBaker::getTimeMs();
+		std::vector<float> table;
+		IBLBaker::bakeBRDF(SIZE, &ThreadPool::get(), table, BAKE_SAMPLES);
+		std::ofstream outFile(DATA_FILE);
+		if (!outFile)
+		{
+			std::cout << "ERROR: Could not write " << DATA_FILE << std::endl;
+			return 1;
+		}
+		outFile << "#pragma once\n\n"
+			<< "// Generated by 3DEngine.exe --bake brdf, see BRDFLUT.h. Split sum scale and bias to F0 as RG8 unorm,\n"
+			<< "// N.V along x and roughness along y, " << BAKE_SAMPLES << " GGX samples a texel\n"
+			<< "namespace BRDFLUT\n{\n"
+			<< "\tstatic const int SIZE = " << SIZE << ";\n"
+			<< "\tstatic constexpr unsigned char DATA[SIZE * SIZE * 2] =\n\t{";
+		for (size_t i = 0; i < table.size(); i++)
+		{
+			int value = (int)std::lround(std::min(std::max(table[i], 0.0f), 1.0f) * 255.0f);
+			outFile << (i % 32 == 0 ? "\n\t\t" : " ") << value << (i + 1 < table.size() ? "," : "");
+		}
+		outFile << "\n\t};\n}\n";
+		std::cout << "BRDF LUT " << SIZE << "x" << SIZE << " baked in " << IBLBaker::getTimeMs() - start << " ms, written to " << DATA_FILE << std::endl;
+		return 0;
+	}
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+// Generated by 3DEngine.exe --bake brdf, see BRDFLUT.h. Split sum scale and bias to F0 as RG8 unorm,
+// N.V along x and roughness along y, 4096 GGX samples a texel
+namespace BRDFLUT
+{
+	static const int SIZE = 64;
+	static constexpr unsigned char DATA[SIZE * SIZE * 2] =
+	{
+		10, 243, 28, 226, 46, 209, 62, 192, 78, 177, 92, 163, 106, 149, 118, 137, 130, 125, 141, 114, 151, 104, 160, 95, 169, 86, 177, 78, 184, 71, 191, 64,
+		198, 57, 203, 52, 209, 46, 214, 41, 218, 37, 222, 33, 226, 29, 229, 26, 232, 23, 235, 20, 237, 18, 240, 15, 242, 13, 243, 12, 245, 10, 246, 9,
+		248, 7, 249, 6, 250, 5, 251, 4, 251, 4, 252, 3, 252, 3, 253, 2, 253, 2, 254, 1, 254, 1, 254, 1, 254, 1, 254, 1, 255, 0, 255, 0,
+		255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0,
+		9, 228, 28, 221, 45, 206, 62, 191, 77, 176, 92, 162, 105, 149, 118, 136, 129, 125, 140, 114, 150, 104, 160, 94, 169, 86, 177, 78, 184, 70, 191, 64,
+		197, 57, 203, 52, 208, 46, 213, 41, 218, 37, 222, 33, 226, 29, 229, 26, 232, 23, 235, 20, 237, 18, 239, 15, 241, 13, 243, 12, 245, 10, 246, 9,
+		248, 7, 249, 6, 250, 5, 250, 4, 251, 4, 252, 3, 252, 3, 253, 2, 253, 2, 254, 1, 254, 1, 254, 1, 254, 1, 254, 1, 255, 0, 255, 0,
+		255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0,
+		9, 202, 27, 212, 45, 201, 61, 187, 76, 173, 91, 160, 104, 147, 117, 135, 129, 124, 140, 113, 150, 103, 159, 94, 168, 85, 176, 78, 183, 70, 190, 63,
+		197, 57, 203, 51, 208, 46, 213, 41, 217, 37, 221, 33, 225, 29, 229, 26, 232, 23, 234, 20, 237, 18, 239, 15, 241, 13, 243, 12, 245, 10, 246, 9,
+		247, 7, 248, 6, 249, 5, 250, 4, 251, 4, 252, 3, 252, 3, 253, 2, 253, 2, 253, 1, 254, 1, 254, 1, 254, 1, 254, 1, 254, 0, 255, 0,
+		255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0,
+		10, 174, 26, 199, 44, 193, 60, 182, 75, 170, 90, 157, 103, 145, 116, 134, 128, 123, 138, 112, 149, 102, 158, 93, 167, 85, 175, 77, 183, 70, 189, 63,
+		196, 57, 202, 51, 207, 46, 212, 41, 217, 37, 221, 33, 225, 29, 228, 26, 231, 23, 234, 20, 236, 18, 239, 15, 241, 13, 243, 12, 244, 10, 246, 9,
+		247, 7, 248, 6, 249, 5, 250, 4, 251, 4, 251, 3, 252, 3, 252, 2, 253, 2, 253, 1, 254, 1, 254, 1, 254, 1, 254, 1, 254, 0, 254, 0,
+		255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0,
+		12, 153, 26, 182, 43, 183, 59, 175, 74, 165, 88, 154, 102, 142, 114, 131, 126, 121, 137, 111, 147, 101, 157, 92, 166, 84, 174, 76, 181, 69, 188, 63,
+		195, 57, 201, 51, 206, 46, 211, 41, 216, 37, 220, 33, 224, 29, 227, 26, 230, 23, 233, 20, 236, 18, 238, 15, 240, 13, 242, 12, 244, 10, 245, 9,
+		246, 7, 248, 6, 249, 5, 250, 4, 250, 4, 251, 3, 252, 3, 252, 2, 253, 2, 253, 1, 253, 1, 254, 1, 254, 1, 254, 1, 254, 0, 254, 0,
+		254, 0, 254, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0,
+		17, 142, 27, 165, 42, 171, 58, 167, 72, 159, 87, 149, 100, 139, 113, 128, 124, 118, 135, 109, 146, 100, 155, 91, 164, 83, 172, 76, 180, 69, 187, 62,
+		193, 56, 199, 51, 205, 45, 210, 41, 215, 36, 219, 32, 223, 29, 226, 26, 229, 23, 232, 20, 235, 17, 237, 15, 239, 13, 241, 12, 243, 10, 244, 9,
+		246, 7, 247, 6, 248, 5, 249, 4, 250, 4, 251, 3, 251, 3, 252, 2, 252, 2, 253, 1, 253, 1, 253, 1, 253, 1, 254, 1, 254, 0, 254, 0,
+		254, 0, 254, 0, 254, 0, 254, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0,
+		22, 135, 29, 150, 42, 158, 57, 157, 71, 151, 85, 143, 98, 134, 111, 125, 123, 116, 134, 107, 144, 98, 153, 90, 162, 82, 171, 75, 178, 68, 185, 61,
+		192, 56, 198, 50, 203, 45, 209, 40, 213, 36, 218, 32, 221, 29, 225, 25, 228, 22, 231, 20, 234, 17, 236, 15, 238, 13, 240, 12, 242, 10, 244, 9,
+		245, 7, 246, 6, 247, 5, 248, 4, 249, 4, 250, 3, 251, 3, 251, 2, 252, 2, 252, 1, 253, 1, 253, 1, 253, 1, 253, 1, 254, 0, 254, 0,
+		254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0,
+		29, 131, 32, 137, 43, 145, 57, 146, 70, 143, 84, 136, 97, 129, 109, 121, 121, 112, 132, 104, 142, 96, 152, 88, 160, 80, 169, 73, 176, 67, 184, 61,
+		190, 55, 196, 49, 202, 45, 207, 40, 212, 36, 216, 32, 220, 28, 224, 25, 227, 22, 230, 20, 233, 17, 235, 15, 237, 13, 239, 11, 241, 10, 243, 9,
+		244, 7, 245, 6, 247, 5, 248, 4, 249, 4, 249, 3, 250, 3, 251, 2, 251, 2, 252, 1, 252, 1, 252, 1, 253, 1, 253, 1, 253, 0, 253, 0,
+		254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0,
+		36, 127, 36, 127, 45, 133, 57, 136, 70, 134, 83, 129, 96, 123, 108, 116, 119, 108, 130, 100, 140, 93, 149, 85, 158, 78, 167, 72, 174, 65, 181, 59,
+		188, 54, 194, 49, 200, 44, 205, 40, 210, 35, 214, 32, 218, 28, 222, 25, 225, 22, 228, 20, 231, 17, 234, 15, 236, 13, 238, 11, 240, 10, 242, 9,
+		243, 7, 244, 6, 246, 5, 247, 4, 248, 4, 249, 3, 249, 3, 250, 2, 251, 2, 251, 1, 251, 1, 252, 1, 252, 1, 253, 1, 253, 0, 253, 0,
+		253, 0, 253, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 255, 0, 255, 0, 255, 0, 255, 0, 255, 0,
+		44, 124, 42, 118, 48, 123, 59, 125, 70, 125, 82, 121, 94, 116, 106, 110, 117, 103, 128, 97, 138, 90, 147, 83, 156, 76, 164, 70, 172, 64, 179, 58,
+		186, 53, 192, 48, 198, 43, 203, 39, 208, 35, 212, 31, 217, 28, 220, 25, 224, 22, 227, 19, 230, 17, 232, 15, 235, 13, 237, 11, 239, 10, 240, 9,
+		242, 7, 243, 6, 245, 5, 246, 4, 247, 4, 248, 3, 248, 3, 249, 2, 250, 2, 250, 1, 251, 1, 251, 1, 252, 1, 252, 1, 252, 0, 253, 0,
+		253, 0, 253, 0, 253, 0, 253, 0, 253, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 255, 0, 255, 0, 255, 0,
+		52, 120, 47, 112, 52, 114, 61, 116, 71, 116, 83, 113, 94, 109, 105, 104, 116, 99, 126, 92, 136, 86, 145, 80, 154, 74, 162, 68, 170, 62, 177, 57,
+		184, 52, 190, 47, 196, 42, 201, 38, 206, 34, 210, 31, 215, 28, 218, 25, 222, 22, 225, 19, 228, 17, 231, 15, 233, 13, 235, 11, 237, 10, 239, 9,
+		241, 7, 242, 6, 243, 5, 245, 5, 246, 4, 247, 3, 248, 3, 248, 2, 249, 2, 250, 1, 250, 1, 251, 1, 251, 1, 251, 1, 252, 0, 252, 0,
+		252, 0, 252, 0, 253, 0, 253, 0, 253, 0, 253, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 255, 0, 255, 0,
+		61, 115, 54, 106, 57, 106, 64, 107, 73, 107, 83, 105, 94, 102, 104, 98, 114, 93, 124, 88, 134, 82, 143, 77, 152, 71, 160, 66, 168, 60, 175, 55,
+		181, 50, 188, 46, 193, 42, 199, 38, 204, 34, 208, 30, 212, 27, 216, 24, 220, 22, 223, 19, 226, 17, 229, 15, 231, 13, 234, 11, 236, 10, 238, 9,
+		239, 7, 241, 6, 242, 5, 243, 5, 245, 4, 246, 3, 246, 3, 247, 2, 248, 2, 249, 1, 249, 1, 250, 1, 250, 1, 251, 1, 251, 0, 251, 0,
+		252, 0, 252, 0, 252, 0, 253, 0, 253, 0, 253, 0, 253, 0, 253, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 255, 0, 255, 0,
+		69, 111, 61, 101, 62, 99, 68, 99, 75, 99, 84, 98, 94, 95, 104, 92, 114, 88, 123, 83, 132, 78, 141, 73, 150, 68, 158, 63, 165, 58, 172, 53,
+		179, 49, 185, 45, 191, 40, 196, 37, 201, 33, 206, 30, 210, 27, 214, 24, 218, 21, 221, 19, 224, 17, 227, 15, 230, 13, 232, 11, 234, 10, 236, 8,
+		238, 7, 239, 6, 241, 5, 242, 5, 243, 4, 244, 3, 245, 3, 246, 2, 247, 2, 248, 1, 248, 1, 249, 1, 249, 1, 250, 1, 250, 0, 251, 0,
+		251, 0, 251, 0, 252, 0, 252, 0, 252, 0, 253, 0, 253, 0, 253, 0, 253, 0, 253, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0,
+		77, 106, 68, 96, 68, 93, 72, 93, 78, 92, 86, 91, 95, 89, 104, 86, 113, 82, 122, 78, 131, 74, 139, 70, 148, 65, 155, 60, 163, 56, 170, 51,
+		176, 47, 183, 43, 188, 39, 194, 36, 199, 32, 203, 29, 208, 26, 212, 23, 216, 21, 219, 19, 222, 16, 225, 15, 228, 13, 230, 11, 232, 10, 234, 8,
+		236, 7, 238, 6, 239, 5, 241, 5, 242, 4, 243, 3, 244, 3, 245, 2, 246, 2, 247, 2, 247, 1, 248, 1, 249, 1, 249, 1, 250, 0, 250, 0,
+		250, 0, 251, 0, 251, 0, 252, 0, 252, 0, 252, 0, 252, 0, 253, 0, 253, 0, 253, 0, 253, 0, 254, 0, 254, 0, 254, 0, 254, 0, 254, 0,
+		85, 101, 75, 91, 74, 88, 77, 87, 82, 86, 89, 84, 96, 83, 105, 80, 113, 77, 121, 74, 130, 70, 138, 66, 146, 62, 153, 58, 161, 53, 168, 49,
+		174, 45, 180, 42, 186, 38, 191, 35, 196, 31, 201, 28, 205, 26, 209, 23, 213, 20, 217, 18, 220, 16, 223, 14, 225, 13, 228, 11, 230, 10, 232, 8,
+		234, 7, 236, 6, 238, 5, 239, 5, 240, 4, 242, 3, 243, 3, 244, 2, 245, 2, 245, 2, 246, 1, 247, 1, 248, 1, 248, 1, 249, 1, 249, 0,
+		250, 0, 250, 0, 250, 0, 251, 0, 251, 0, 252, 0, 252, 0, 252, 0, 252, 0, 253, 0, 253, 0, 253, 0, 253, 0, 254, 0, 254, 0, 254, 0,
+		93, 96, 82, 87, 80, 83, 82, 81, 86, 80, 92, 78, 98, 77, 106, 75, 113, 72, 121, 69, 129, 66, 137, 62, 144, 58, 152, 55, 159, 51, 165, 47,
+		172, 43, 178, 40, 183, 37, 189, 33, 194, 30, 198, 28, 203, 25, 207, 22, 211, 20, 214, 18, 217, 16, 220, 14, 223, 12, 226, 11, 228, 10, 230, 8,
+		232, 7, 234, 6, 236, 5, 237, 5, 239, 4, 240, 3, 241, 3, 242, 2, 243, 2, 244, 2, 245, 1, 246, 1, 246, 1, 247, 1, 248, 1, 248, 0,
+		249, 0, 249, 0, 250, 0, 250, 0, 250, 0, 251, 0, 251, 0, 251, 0, 252, 0, 252, 0, 252, 0, 253, 0, 253, 0, 253, 0, 253, 0, 254, 0,
+		101, 91, 89, 82, 86, 78, 87, 76, 90, 75, 95, 73, 101, 71, 107, 69, 114, 67, 121, 64, 129, 61, 136, 58, 143, 55, 150, 52, 157, 48, 163, 45,
+		169, 41, 175, 38, 181, 35, 186, 32, 191, 29, 196, 27, 200, 24, 204, 22, 208, 20, 212, 17, 215, 16, 218, 14, 221, 12, 223, 11, 226, 9, 228, 8,
+		230, 7, 232, 6, 234, 5, 235, 5, 237, 4, 238, 3, 240, 3, 241, 2, 242, 2, 243, 2, 244, 1, 244, 1, 245, 1, 246, 1, 247, 1, 247, 0,
+		248, 0, 248, 0, 249, 0, 249, 0, 249, 0, 250, 0, 250, 0, 251, 0, 251, 0, 251, 0, 252, 0, 252, 0, 252, 0, 253, 0, 253, 0, 253, 0,
+		108, 86, 96, 78, 92, 74, 92, 71, 95, 70, 98, 68, 103, 66, 109, 65, 115, 62, 122, 60, 129, 57, 135, 55, 142, 52, 149, 49, 155, 45, 161, 42,
+		167, 39, 173, 36, 178, 34, 184, 31, 188, 28, 193, 26, 197, 23, 202, 21, 205, 19, 209, 17, 212, 15, 215, 14, 218, 12, 221, 11, 223, 9, 226, 8,
+		228, 7, 230, 6, 232, 5, 233, 5, 235, 4, 236, 3, 238, 3, 239, 2, 240, 2, 241, 2, 242, 1, 243, 1, 244, 1, 244, 1, 245, 1, 246, 0,
+		246, 0, 247, 0, 247, 0, 248, 0, 248, 0, 249, 0, 249, 0, 250, 0, 250, 0, 251, 0, 251, 0, 251, 0, 252, 0, 252, 0, 252, 0, 253, 0,
+		115, 81, 103, 74, 99, 70, 98, 67, 99, 65, 102, 64, 106, 62, 111, 60, 117, 58, 123, 56, 129, 53, 135, 51, 141, 48, 148, 46, 154, 43, 160, 40,
+		165, 37, 171, 35, 176, 32, 181, 29, 186, 27, 190, 25, 195, 22, 199, 20, 203, 18, 206, 17, 210, 15, 213, 13, 216, 12, 218, 10, 221, 9, 223, 8,
+		225, 7, 228, 6, 229, 5, 231, 5, 233, 4, 234, 3, 236, 3, 237, 2, 238, 2, 239, 2, 240, 1, 241, 1, 242, 1, 243, 1, 243, 1, 244, 0,
+		245, 0, 246, 0, 246, 0, 247, 0, 247, 0, 248, 0, 248, 0, 249, 0, 249, 0, 250, 0, 250, 0, 251, 0, 251, 0, 251, 0, 252, 0, 252, 0,
+		121, 77, 110, 70, 105, 66, 103, 63, 104, 61, 106, 59, 110, 58, 114, 56, 119, 54, 124, 52, 130, 50, 135, 48, 141, 45, 147, 43, 153, 40, 158, 38,
+		164, 35, 169, 33, 174, 30, 179, 28, 183, 26, 188, 24, 192, 22, 196, 20, 200, 18, 203, 16, 207, 14, 210, 13, 213, 11, 216, 10, 218, 9, 221, 8,
+		223, 7, 225, 6, 227, 5, 229, 5, 230, 4, 232, 3, 233, 3, 235, 2, 236, 2, 237, 2, 238, 1, 239, 1, 240, 1, 241, 1, 242, 1, 243, 1,
+		244, 0, 244, 0, 245, 0, 246, 0, 246, 0, 247, 0, 247, 0, 248, 0, 248, 0, 249, 0, 249, 0, 250, 0, 250, 0, 251, 0, 251, 0, 251, 0,
+		127, 72, 116, 66, 111, 62, 109, 59, 109, 57, 110, 56, 113, 54, 117, 52, 121, 50, 126, 48, 131, 46, 136, 44, 141, 42, 146, 40, 152, 38, 157, 35,
+		162, 33, 167, 31, 172, 29, 177, 27, 181, 24, 185, 22, 190, 21, 193, 19, 197, 17, 201, 15, 204, 14, 207, 12, 210, 11, 213, 10, 215, 9, 218, 8,
+		220, 7, 222, 6, 224, 5, 226, 5, 228, 4, 229, 3, 231, 3, 232, 2, 234, 2, 235, 2, 236, 1, 237, 1, 238, 1, 239, 1, 240, 1, 241, 1,
+		242, 0, 243, 0, 243, 0, 244, 0, 245, 0, 245, 0, 246, 0, 247, 0, 247, 0, 248, 0, 248, 0, 249, 0, 249, 0, 250, 0, 250, 0, 251, 0,
+		133, 68, 122, 62, 117, 59, 114, 56, 114, 54, 115, 52, 117, 50, 120, 49, 123, 47, 127, 45, 132, 43, 136, 41, 141, 39, 146, 37, 151, 35, 156, 33,
+		161, 31, 165, 29, 170, 27, 175, 25, 179, 23, 183, 21, 187, 20, 191, 18, 194, 16, 198, 15, 201, 13, 204, 12, 207, 11, 210, 10, 212, 9, 215, 8,
+		217, 7, 219, 6, 221, 5, 223, 5, 225, 4, 227, 3, 228, 3, 230, 2, 231, 2, 233, 2, 234, 1, 235, 1, 236, 1, 237, 1, 238, 1, 239, 1,
+		240, 0, 241, 0, 242, 0, 243, 0, 243, 0, 244, 0, 245, 0, 245, 0, 246, 0, 246, 0, 247, 0, 248, 0, 248, 0, 249, 0, 249, 0, 250, 0,
+		139, 64, 128, 59, 122, 55, 119, 53, 118, 50, 119, 49, 120, 47, 123, 45, 126, 44, 129, 42, 133, 40, 137, 38, 142, 37, 146, 35, 151, 33, 155, 31,
+		160, 29, 164, 27, 168, 25, 173, 24, 177, 22, 181, 20, 184, 19, 188, 17, 192, 16, 195, 14, 198, 13, 201, 12, 204, 10, 207, 9, 209, 8, 212, 7,
+		214, 7, 216, 6, 219, 5, 221, 4, 222, 4, 224, 3, 226, 3, 228, 2, 229, 2, 230, 2, 232, 1, 233, 1, 234, 1, 235, 1, 236, 1, 237, 1,
+		238, 0, 239, 0, 240, 0, 241, 0, 242, 0, 242, 0, 243, 0, 244, 0, 244, 0, 245, 0, 246, 0, 246, 0, 247, 0, 247, 0, 248, 0, 248, 0,
+		144, 60, 133, 55, 127, 52, 124, 49, 123, 47, 123, 46, 124, 44, 126, 42, 128, 41, 131, 39, 135, 37, 139, 36, 142, 34, 146, 32, 150, 31, 155, 29,
+		159, 27, 163, 26, 167, 24, 171, 22, 175, 21, 178, 19, 182, 18, 186, 16, 189, 15, 192, 14, 195, 12, 198, 11, 201, 10, 204, 9, 206, 8, 209, 7,
+		211, 6, 214, 6, 216, 5, 218, 4, 220, 4, 222, 3, 223, 3, 225, 2, 226, 2, 228, 2, 229, 2, 230, 1, 232, 1, 233, 1, 234, 1, 235, 1,
+		236, 0, 237, 0, 238, 0, 239, 0, 240, 0, 240, 0, 241, 0, 242, 0, 243, 0, 243, 0, 244, 0, 245, 0, 245, 0, 246, 0, 247, 0, 247, 0,
+		148, 56, 138, 52, 132, 49, 129, 46, 127, 44, 127, 43, 128, 41, 129, 39, 131, 38, 134, 36, 137, 35, 140, 33, 143, 32, 147, 30, 150, 29, 154, 27,
+		158, 25, 162, 24, 165, 22, 169, 21, 173, 19, 176, 18, 180, 17, 183, 15, 186, 14, 189, 13, 192, 12, 195, 11, 198, 10, 201, 9, 204, 8, 206, 7,
+		209, 6, 211, 6, 213, 5, 215, 4, 217, 4, 219, 3, 221, 3, 222, 2, 224, 2, 225, 2, 227, 2, 228, 1, 229, 1, 230, 1, 232, 1, 233, 1,
+		234, 0, 235, 0, 236, 0, 237, 0, 238, 0, 238, 0, 239, 0, 240, 0, 241, 0, 242, 0, 242, 0, 243, 0, 244, 0, 244, 0, 245, 0, 246, 0,
+		153, 52, 143, 49, 137, 46, 134, 44, 132, 42, 131, 40, 131, 38, 132, 37, 134, 35, 136, 34, 138, 32, 141, 31, 144, 30, 147, 28, 151, 27, 154, 25,
+		157, 24, 161, 22, 164, 21, 168, 20, 171, 18, 174, 17, 178, 16, 181, 14, 184, 13, 187, 12, 190, 11, 193, 10, 196, 9, 198, 8, 201, 7, 203, 7,
+		206, 6, 208, 5, 210, 5, 212, 4, 214, 4, 216, 3, 217, 3, 219, 2, 221, 2, 222, 2, 224, 2, 225, 1, 227, 1, 228, 1, 229, 1, 230, 1,
+		231, 1, 232, 0, 233, 0, 234, 0, 235, 0, 236, 0, 237, 0, 238, 0, 239, 0, 240, 0, 240, 0, 241, 0, 242, 0, 243, 0, 243, 0, 244, 0,
+		157, 49, 148, 46, 142, 43, 138, 41, 136, 39, 135, 37, 135, 36, 135, 34, 136, 33, 138, 32, 140, 30, 143, 29, 145, 28, 148, 26, 151, 25, 154, 24,
+		157, 22, 160, 21, 163, 20, 166, 18, 169, 17, 172, 16, 175, 15, 178, 14, 182, 13, 185, 12, 187, 11, 190, 10, 193, 9, 196, 8, 198, 7, 200, 6,
+		203, 6, 205, 5, 207, 5, 209, 4, 211, 4, 213, 3, 215, 3, 216, 2, 218, 2, 219, 2, 221, 2, 222, 1, 224, 1, 225, 1, 226, 1, 228, 1,
+		229, 1, 230, 0, 231, 0, 232, 0, 233, 0, 234, 0, 235, 0, 236, 0, 237, 0, 238, 0, 238, 0, 239, 0, 240, 0, 241, 0, 241, 0, 242, 0,
+		160, 46, 152, 43, 146, 41, 142, 39, 140, 37, 138, 35, 138, 34, 138, 32, 139, 31, 140, 29, 142, 28, 144, 27, 146, 26, 149, 24, 151, 23, 154, 22,
+		157, 21, 159, 19, 162, 18, 165, 17, 168, 16, 171, 15, 174, 14, 177, 13, 180, 12, 182, 11, 185, 10, 188, 9, 190, 8, 193, 8, 195, 7, 197, 6,
+		200, 6, 202, 5, 204, 4, 206, 4, 208, 3, 210, 3, 211, 3, 213, 2, 215, 2, 216, 2, 218, 2, 219, 1, 221, 1, 222, 1, 223, 1, 225, 1,
+		226, 1, 227, 0, 228, 0, 229, 0, 230, 0, 231, 0, 232, 0, 233, 0, 234, 0, 235, 0, 236, 0, 237, 0, 238, 0, 238, 0, 239, 0, 240, 0,
+		164, 43, 155, 40, 150, 38, 146, 36, 143, 34, 142, 33, 141, 31, 141, 30, 142, 29, 143, 28, 144, 26, 145, 25, 147, 24, 149, 23, 152, 22, 154, 20,
+		156, 19, 159, 18, 161, 17, 164, 16, 167, 15, 169, 14, 172, 13, 175, 12, 178, 11, 180, 10, 183, 9, 185, 9, 188, 8, 190, 7, 192, 7, 194, 6,
+		197, 5, 199, 5, 201, 4, 203, 4, 205, 3, 207, 3, 208, 3, 210, 2, 212, 2, 213, 2, 215, 2, 216, 1, 218, 1, 219, 1, 221, 1, 222, 1,
+		223, 1, 224, 0, 225, 0, 227, 0, 228, 0, 229, 0, 230, 0, 231, 0, 232, 0, 233, 0, 234, 0, 234, 0, 235, 0, 236, 0, 237, 0, 238, 0,
+		167, 40, 159, 38, 153, 36, 149, 34, 147, 32, 145, 31, 144, 29, 144, 28, 144, 27, 145, 26, 146, 25, 147, 23, 148, 22, 150, 21, 152, 20, 154, 19,
+		156, 18, 158, 17, 161, 16, 163, 15, 166, 14, 168, 13, 171, 12, 173, 11, 176, 10, 178, 10, 180, 9, 183, 8, 185, 8, 187, 7, 189, 6, 192, 6,
+		194, 5, 196, 5, 198, 4, 200, 4, 202, 3, 203, 3, 205, 3, 207, 2, 209, 2, 210, 2, 212, 1, 213, 1, 215, 1, 216, 1, 217, 1, 219, 1,
+		220, 1, 221, 0, 222, 0, 224, 0, 225, 0, 226, 0, 227, 0, 228, 0, 229, 0, 230, 0, 231, 0, 232, 0, 233, 0, 233, 0, 234, 0, 235, 0,
+		169, 38, 162, 35, 156, 34, 153, 32, 150, 30, 148, 29, 147, 28, 146, 26, 146, 25, 147, 24, 147, 23, 148, 22, 150, 21, 151, 20, 152, 19, 154, 18,
+		156, 17, 158, 16, 160, 15, 162, 14, 165, 13, 167, 12, 169, 11, 172, 11, 174, 10, 176, 9, 178, 8, 180, 8, 183, 7, 185, 6, 187, 6, 189, 5,
+		191, 5, 193, 4, 195, 4, 197, 4, 198, 3, 200, 3, 202, 2, 204, 2, 205, 2, 207, 2, 209, 1, 210, 1, 211, 1, 213, 1, 214, 1, 215, 1,
+		217, 1, 218, 0, 219, 0, 220, 0, 222, 0, 223, 0, 224, 0, 225, 0, 226, 0, 227, 0, 228, 0, 229, 0, 230, 0, 231, 0, 232, 0, 232, 0,
+		172, 35, 165, 33, 159, 31, 156, 30, 153, 28, 151, 27, 149, 26, 149, 25, 148, 24, 148, 22, 149, 21, 150, 20, 151, 19, 152, 18, 153, 17, 154, 17,
+		156, 16, 158, 15, 160, 14, 162, 13, 164, 12, 166, 11, 168, 11, 170, 10, 172, 9, 174, 9, 176, 8, 178, 7, 180, 7, 182, 6, 184, 6, 186, 5,
+		188, 5, 190, 4, 192, 4, 194, 3, 195, 3, 197, 3, 199, 2, 200, 2, 202, 2, 204, 2, 205, 1, 207, 1, 208, 1, 209, 1, 211, 1, 212, 1,
+		213, 1, 215, 0, 216, 0, 217, 0, 218, 0, 219, 0, 220, 0, 222, 0, 223, 0, 224, 0, 225, 0, 226, 0, 227, 0, 228, 0, 229, 0, 229, 0,
+		174, 33, 167, 31, 162, 29, 158, 28, 155, 27, 153, 25, 152, 24, 151, 23, 150, 22, 150, 21, 150, 20, 151, 19, 152, 18, 152, 17, 153, 16, 155, 15,
+		156, 15, 158, 14, 159, 13, 161, 12, 163, 11, 165, 11, 167, 10, 168, 9, 170, 9, 172, 8, 174, 7, 176, 7, 178, 6, 180, 6, 182, 5, 183, 5,
+		185, 4, 187, 4, 189, 4, 191, 3, 192, 3, 194, 3, 196, 2, 197, 2, 199, 2, 200, 2, 202, 1, 203, 1, 205, 1, 206, 1, 207, 1, 209, 1,
+		210, 1, 211, 0, 212, 0, 214, 0, 215, 0, 216, 0, 217, 0, 218, 0, 219, 0, 220, 0, 221, 0, 222, 0, 223, 0, 224, 0, 225, 0, 226, 0,
+		176, 31, 169, 29, 164, 28, 161, 26, 158, 25, 156, 24, 154, 23, 153, 22, 152, 21, 152, 20, 152, 19, 152, 18, 152, 17, 153, 16, 154, 15, 155, 14,
+		156, 14, 158, 13, 159, 12, 161, 11, 162, 11, 164, 10, 165, 9, 167, 9, 169, 8, 171, 8, 172, 7, 174, 6, 176, 6, 177, 5, 179, 5, 181, 5,
+		183, 4, 184, 4, 186, 3, 188, 3, 189, 3, 191, 2, 192, 2, 194, 2, 195, 2, 197, 2, 198, 1, 200, 1, 201, 1, 202, 1, 204, 1, 205, 1,
+		206, 1, 208, 0, 209, 0, 210, 0, 211, 0, 212, 0, 213, 0, 215, 0, 216, 0, 217, 0, 218, 0, 219, 0, 220, 0, 221, 0, 222, 0, 223, 0,
+		177, 29, 171, 27, 167, 26, 163, 25, 160, 23, 158, 22, 156, 21, 155, 20, 154, 19, 153, 18, 153, 17, 153, 17, 153, 16, 154, 15, 154, 14, 155, 13,
+		156, 13, 158, 12, 159, 11, 160, 11, 161, 10, 163, 9, 164, 9, 166, 8, 167, 8, 169, 7, 170, 7, 172, 6, 174, 6, 175, 5, 177, 5, 178, 4,
+		180, 4, 182, 4, 183, 3, 185, 3, 186, 3, 188, 2, 189, 2, 191, 2, 192, 2, 193, 1, 195, 1, 196, 1, 198, 1, 199, 1, 200, 1, 201, 1,
+		203, 1, 204, 0, 205, 0, 206, 0, 207, 0, 209, 0, 210, 0, 211, 0, 212, 0, 213, 0, 214, 0, 215, 0, 216, 0, 217, 0, 218, 0, 219, 0,
+		179, 27, 173, 26, 168, 24, 165, 23, 162, 22, 160, 21, 158, 20, 156, 19, 155, 18, 155, 17, 154, 16, 154, 15, 154, 15, 154, 14, 155, 13, 156, 13,
+		157, 12, 157, 11, 158, 11, 159, 10, 161, 9, 162, 9, 163, 8, 164, 8, 166, 7, 167, 7, 169, 6, 170, 6, 172, 5, 173, 5, 174, 4, 176, 4,
+		177, 4, 179, 3, 180, 3, 182, 3, 183, 3, 184, 2, 186, 2, 187, 2, 189, 2, 190, 1, 191, 1, 193, 1, 194, 1, 195, 1, 196, 1, 198, 1,
+		199, 1, 200, 0, 201, 0, 202, 0, 204, 0, 205, 0, 206, 0, 207, 0, 208, 0, 209, 0, 210, 0, 211, 0, 212, 0, 213, 0, 214, 0, 215, 0,
+		180, 25, 174, 24, 170, 23, 166, 22, 164, 21, 161, 20, 159, 19, 158, 18, 157, 17, 156, 16, 155, 15, 155, 14, 155, 14, 155, 13, 155, 12, 156, 12,
+		157, 11, 157, 10, 158, 10, 159, 9, 160, 9, 161, 8, 162, 8, 163, 7, 164, 7, 166, 6, 167, 6, 168, 5, 170, 5, 171, 5, 172, 4, 173, 4,
+		175, 4, 176, 3, 177, 3, 179, 3, 180, 2, 181, 2, 183, 2, 184, 2, 185, 2, 187, 1, 188, 1, 189, 1, 190, 1, 192, 1, 193, 1, 194, 1,
+		195, 1, 196, 0, 197, 0, 199, 0, 200, 0, 201, 0, 202, 0, 203, 0, 204, 0, 205, 0, 206, 0, 207, 0, 208, 0, 209, 0, 210, 0, 211, 0,
+		181, 24, 175, 23, 171, 21, 168, 20, 165, 19, 163, 18, 161, 17, 159, 17, 158, 16, 157, 15, 156, 14, 156, 14, 155, 13, 156, 12, 156, 12, 156, 11,
+		157, 10, 157, 10, 158, 9, 158, 9, 159, 8, 160, 8, 161, 7, 162, 7, 163, 6, 164, 6, 165, 5, 166, 5, 167, 5, 169, 4, 170, 4, 171, 4,
+		172, 3, 173, 3, 175, 3, 176, 3, 177, 2, 178, 2, 180, 2, 181, 2, 182, 1, 183, 1, 184, 1, 185, 1, 187, 1, 188, 1, 189, 1, 190, 1,
+		191, 1, 192, 0, 193, 0, 195, 0, 196, 0, 197, 0, 198, 0, 199, 0, 200, 0, 201, 0, 202, 0, 203, 0, 204, 0, 205, 0, 206, 0, 207, 0,
+		181, 22, 176, 21, 172, 20, 169, 19, 166, 18, 164, 17, 162, 16, 160, 16, 159, 15, 158, 14, 157, 13, 156, 13, 156, 12, 156, 11, 156, 11, 156, 10,
+		156, 10, 157, 9, 157, 9, 158, 8, 158, 8, 159, 7, 160, 7, 161, 6, 162, 6, 163, 5, 164, 5, 164, 5, 165, 4, 167, 4, 168, 4, 169, 3,
+		170, 3, 171, 3, 172, 3, 173, 2, 174, 2, 175, 2, 176, 2, 177, 2, 179, 1, 180, 1, 181, 1, 182, 1, 183, 1, 184, 1, 185, 1, 186, 1,
+		187, 1, 188, 0, 189, 0, 190, 0, 191, 0, 193, 0, 194, 0, 195, 0, 195, 0, 196, 0, 197, 0, 198, 0, 199, 0, 200, 0, 201, 0, 202, 0,
+		182, 21, 177, 20, 173, 19, 170, 18, 167, 17, 165, 16, 163, 15, 161, 15, 160, 14, 158, 13, 157, 12, 157, 12, 156, 11, 156, 11, 156, 10, 156, 10,
+		156, 9, 156, 8, 157, 8, 157, 8, 158, 7, 158, 7, 159, 6, 160, 6, 160, 5, 161, 5, 162, 5, 163, 4, 163, 4, 164, 4, 165, 3, 166, 3,
+		167, 3, 168, 3, 169, 2, 170, 2, 171, 2, 172, 2, 173, 2, 174, 2, 175, 1, 176, 1, 177, 1, 178, 1, 179, 1, 180, 1, 181, 1, 182, 1,
+		183, 0, 184, 0, 185, 0, 186, 0, 187, 0, 188, 0, 189, 0, 190, 0, 191, 0, 192, 0, 193, 0, 194, 0, 195, 0, 196, 0, 197, 0, 198, 0,
+		182, 20, 178, 19, 174, 18, 171, 17, 168, 16, 166, 15, 163, 14, 162, 14, 160, 13, 159, 12, 158, 12, 157, 11, 157, 11, 156, 10, 156, 9, 156, 9,
+		156, 8, 156, 8, 156, 7, 156, 7, 157, 7, 157, 6, 158, 6, 158, 5, 159, 5, 159, 5, 160, 4, 161, 4, 161, 4, 162, 4, 163, 3, 164, 3,
+		165, 3, 166, 3, 167, 2, 167, 2, 168, 2, 169, 2, 170, 2, 171, 1, 172, 1, 173, 1, 174, 1, 175, 1, 176, 1, 176, 1, 177, 1, 178, 1,
+		179, 0, 180, 0, 181, 0, 182, 0, 183, 0, 184, 0, 185, 0, 186, 0, 187, 0, 187, 0, 188, 0, 189, 0, 190, 0, 191, 0, 192, 0, 193, 0,
+		182, 18, 178, 17, 174, 17, 171, 16, 168, 15, 166, 14, 164, 13, 162, 13, 161, 12, 159, 12, 158, 11, 158, 10, 157, 10, 156, 9, 156, 9, 156, 8,
+		156, 8, 156, 7, 156, 7, 156, 7, 156, 6, 156, 6, 157, 5, 157, 5, 157, 5, 158, 4, 158, 4, 159, 4, 160, 4, 160, 3, 161, 3, 162, 3,
+		162, 3, 163, 2, 164, 2, 164, 2, 165, 2, 166, 2, 167, 1, 168, 1, 168, 1, 169, 1, 170, 1, 171, 1, 172, 1, 173, 1, 173, 1, 174, 1,
+		175, 0, 176, 0, 177, 0, 178, 0, 179, 0, 179, 0, 180, 0, 181, 0, 182, 0, 183, 0, 184, 0, 184, 0, 185, 0, 186, 0, 187, 0, 188, 0,
+		182, 17, 178, 16, 175, 16, 172, 15, 169, 14, 166, 13, 164, 13, 162, 12, 161, 11, 160, 11, 159, 10, 158, 10, 157, 9, 156, 9, 156, 8, 155, 8,
+		155, 7, 155, 7, 155, 7, 155, 6, 155, 6, 155, 5, 155, 5, 156, 5, 156, 4, 156, 4, 157, 4, 157, 4, 158, 3, 158, 3, 159, 3, 159, 3,
+		160, 2, 160, 2, 161, 2, 162, 2, 162, 2, 163, 2, 164, 1, 164, 1, 165, 1, 166, 1, 167, 1, 167, 1, 168, 1, 169, 1, 170, 1, 170, 1,
+		171, 0, 172, 0, 173, 0, 173, 0, 174, 0, 175, 0, 176, 0, 177, 0, 177, 0, 178, 0, 179, 0, 180, 0, 180, 0, 181, 0, 182, 0, 183, 0,
+		182, 16, 178, 15, 175, 15, 172, 14, 169, 13, 167, 12, 165, 12, 163, 11, 161, 11, 160, 10, 159, 10, 158, 9, 157, 9, 156, 8, 155, 8, 155, 7,
+		155, 7, 154, 6, 154, 6, 154, 6, 154, 5, 154, 5, 154, 5, 154, 4, 154, 4, 155, 4, 155, 4, 155, 3, 156, 3, 156, 3, 156, 3, 157, 2,
+		157, 2, 158, 2, 158, 2, 159, 2, 159, 2, 160, 1, 161, 1, 161, 1, 162, 1, 162, 1, 163, 1, 164, 1, 164, 1, 165, 1, 166, 1, 166, 0,
+		167, 0, 168, 0, 168, 0, 169, 0, 170, 0, 170, 0, 171, 0, 172, 0, 173, 0, 173, 0, 174, 0, 175, 0, 175, 0, 176, 0, 177, 0, 178, 0,
+		181, 15, 178, 14, 174, 14, 172, 13, 169, 12, 167, 12, 164, 11, 163, 11, 161, 10, 160, 10, 159, 9, 157, 9, 157, 8, 156, 8, 155, 7, 154, 7,
+		154, 6, 154, 6, 153, 6, 153, 5, 153, 5, 153, 5, 153, 4, 153, 4, 153, 4, 153, 4, 153, 3, 153, 3, 154, 3, 154, 3, 154, 3, 154, 2,
+		155, 2, 155, 2, 156, 2, 156, 2, 157, 2, 157, 1, 157, 1, 158, 1, 158, 1, 159, 1, 159, 1, 160, 1, 161, 1, 161, 1, 162, 1, 162, 0,
+		163, 0, 164, 0, 164, 0, 165, 0, 165, 0, 166, 0, 167, 0, 167, 0, 168, 0, 168, 0, 169, 0, 170, 0, 170, 0, 171, 0, 172, 0, 172, 0,
+		180, 14, 177, 14, 174, 13, 171, 12, 169, 12, 166, 11, 164, 10, 162, 10, 161, 9, 159, 9, 158, 8, 157, 8, 156, 8, 155, 7, 154, 7, 154, 6,
+		153, 6, 153, 6, 152, 5, 152, 5, 152, 5, 152, 4, 151, 4, 151, 4, 151, 4, 151, 3, 151, 3, 152, 3, 152, 3, 152, 3, 152, 2, 152, 2,
+		152, 2, 153, 2, 153, 2, 153, 2, 154, 1, 154, 1, 154, 1, 155, 1, 155, 1, 156, 1, 156, 1, 156, 1, 157, 1, 157, 1, 158, 1, 158, 0,
+		159, 0, 159, 0, 160, 0, 160, 0, 161, 0, 161, 0, 162, 0, 163, 0, 163, 0, 164, 0, 164, 0, 165, 0, 165, 0, 166, 0, 167, 0, 167, 0,
+		180, 13, 177, 13, 174, 12, 171, 11, 168, 11, 166, 10, 164, 10, 162, 9, 161, 9, 159, 8, 158, 8, 157, 8, 156, 7, 155, 7, 154, 6, 153, 6,
+		152, 6, 152, 5, 151, 5, 151, 5, 151, 4, 150, 4, 150, 4, 150, 4, 150, 3, 150, 3, 150, 3, 150, 3, 150, 3, 150, 2, 150, 2, 150, 2,
+		150, 2, 150, 2, 150, 2, 150, 1, 151, 1, 151, 1, 151, 1, 151, 1, 152, 1, 152, 1, 152, 1, 153, 1, 153, 1, 154, 1, 154, 0, 154, 0,
+		155, 0, 155, 0, 156, 0, 156, 0, 156, 0, 157, 0, 157, 0, 158, 0, 158, 0, 159, 0, 159, 0, 160, 0, 160, 0, 161, 0, 161, 0, 162, 0,
+		179, 13, 176, 12, 173, 11, 170, 11, 168, 10, 166, 10, 163, 9, 162, 9, 160, 8, 159, 8, 157, 7, 156, 7, 155, 7, 154, 6, 153, 6, 152, 6,
+		151, 5, 151, 5, 150, 5, 150, 4, 149, 4, 149, 4, 149, 4, 148, 3, 148, 3, 148, 3, 148, 3, 147, 3, 147, 2, 147, 2, 147, 2, 147, 2,
+		147, 2, 147, 2, 148, 1, 148, 1, 148, 1, 148, 1, 148, 1, 148, 1, 148, 1, 149, 1, 149, 1, 149, 1, 149, 1, 150, 1, 150, 0, 150, 0,
+		151, 0, 151, 0, 151, 0, 152, 0, 152, 0, 152, 0, 153, 0, 153, 0, 153, 0, 154, 0, 154, 0, 155, 0, 155, 0, 156, 0, 156, 0, 156, 0,
+		178, 12, 175, 11, 172, 11, 170, 10, 167, 10, 165, 9, 163, 9, 161, 8, 159, 8, 158, 7, 157, 7, 155, 7, 154, 6, 153, 6, 152, 6, 151, 5,
+		150, 5, 150, 5, 149, 4, 148, 4, 148, 4, 147, 4, 147, 3, 147, 3, 146, 3, 146, 3, 146, 3, 145, 2, 145, 2, 145, 2, 145, 2, 145, 2,
+		145, 2, 145, 2, 145, 1, 145, 1, 145, 1, 145, 1, 145, 1, 145, 1, 145, 1, 145, 1, 145, 1, 146, 1, 146, 1, 146, 0, 146, 0, 146, 0,
+		147, 0, 147, 0, 147, 0, 147, 0, 148, 0, 148, 0, 148, 0, 148, 0, 149, 0, 149, 0, 149, 0, 150, 0, 150, 0, 150, 0, 151, 0, 151, 0,
+		177, 11, 174, 11, 171, 10, 169, 10, 166, 9, 164, 9, 162, 8, 160, 8, 159, 7, 157, 7, 156, 7, 154, 6, 153, 6, 152, 6, 151, 5, 150, 5,
+		149, 5, 148, 4, 148, 4, 147, 4, 146, 4, 146, 3, 145, 3, 145, 3, 144, 3, 144, 3, 144, 2, 143, 2, 143, 2, 143, 2, 143, 2, 142, 2,
+		142, 2, 142, 1, 142, 1, 142, 1, 142, 1, 142, 1, 142, 1, 142, 1, 142, 1, 142, 1, 142, 1, 142, 1, 142, 1, 142, 0, 142, 0, 142, 0,
+		142, 0, 143, 0, 143, 0, 143, 0, 143, 0, 143, 0, 144, 0, 144, 0, 144, 0, 144, 0, 144, 0, 145, 0, 145, 0, 145, 0, 145, 0, 146, 0,
+		175, 11, 173, 10, 170, 9, 168, 9, 165, 9, 163, 8, 161, 8, 159, 7, 158, 7, 156, 7, 155, 6, 153, 6, 152, 5, 151, 5, 150, 5, 149, 5,
+		148, 4, 147, 4, 146, 4, 146, 4, 145, 3, 144, 3, 144, 3, 143, 3, 143, 3, 142, 2, 142, 2, 141, 2, 141, 2, 141, 2, 140, 2, 140, 2,
+		140, 1, 140, 1, 139, 1, 139, 1, 139, 1, 139, 1, 139, 1, 139, 1, 139, 1, 139, 1, 138, 1, 138, 1, 138, 0, 138, 0, 138, 0, 138, 0,
+		139, 0, 139, 0, 139, 0, 139, 0, 139, 0, 139, 0, 139, 0, 139, 0, 139, 0, 139, 0, 140, 0, 140, 0, 140, 0, 140, 0, 140, 0, 140, 0,
+		174, 10, 171, 9, 169, 9, 167, 8, 164, 8, 162, 8, 160, 7, 158, 7, 157, 6, 155, 6, 154, 6, 152, 5, 151, 5, 150, 5, 149, 5, 148, 4,
+		147, 4, 146, 4, 145, 4, 144, 3, 143, 3, 143, 3, 142, 3, 141, 3, 141, 2, 140, 2, 140, 2, 139, 2, 139, 2, 138, 2, 138, 2, 137, 1,
+		137, 1, 137, 1, 137, 1, 136, 1, 136, 1, 136, 1, 136, 1, 135, 1, 135, 1, 135, 1, 135, 1, 135, 1, 135, 0, 135, 0, 135, 0, 135, 0,
+		135, 0, 134, 0, 134, 0, 134, 0, 134, 0, 134, 0, 135, 0, 135, 0, 135, 0, 135, 0, 135, 0, 135, 0, 135, 0, 135, 0, 135, 0, 135, 0,
+		173, 9, 170, 9, 168, 8, 165, 8, 163, 8, 161, 7, 159, 7, 157, 6, 156, 6, 154, 6, 152, 5, 151, 5, 150, 5, 149, 5, 147, 4, 146, 4,
+		145, 4, 144, 4, 143, 3, 142, 3, 142, 3, 141, 3, 140, 3, 139, 2, 139, 2, 138, 2, 137, 2, 137, 2, 136, 2, 136, 2, 135, 1, 135, 1,
+		135, 1, 134, 1, 134, 1, 133, 1, 133, 1, 133, 1, 133, 1, 132, 1, 132, 1, 132, 1, 132, 1, 131, 0, 131, 0, 131, 0, 131, 0, 131, 0,
+		131, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0, 130, 0,
+		171, 9, 169, 8, 166, 8, 164, 8, 162, 7, 160, 7, 158, 6, 156, 6, 154, 6, 153, 5, 151, 5, 150, 5, 148, 5, 147, 4, 146, 4, 145, 4,
+		144, 4, 143, 3, 142, 3, 141, 3, 140, 3, 139, 3, 138, 2, 137, 2, 137, 2, 136, 2, 135, 2, 135, 2, 134, 2, 133, 2, 133, 1, 132, 1,
+		132, 1, 131, 1, 131, 1, 131, 1, 130, 1, 130, 1, 129, 1, 129, 1, 129, 1, 128, 1, 128, 0, 128, 0, 128, 0, 127, 0, 127, 0, 127, 0,
+		127, 0, 126, 0, 126, 0, 126, 0, 126, 0, 126, 0, 126, 0, 126, 0, 125, 0, 125, 0, 125, 0, 125, 0, 125, 0, 125, 0, 125, 0, 125, 0,
+		169, 8, 167, 8, 165, 7, 162, 7, 160, 7, 158, 6, 156, 6, 155, 6, 153, 5, 151, 5, 150, 5, 148, 5, 147, 4, 146, 4, 144, 4, 143, 4,
+		142, 3, 141, 3, 140, 3, 139, 3, 138, 3, 137, 2, 136, 2, 135, 2, 135, 2, 134, 2, 133, 2, 132, 2, 132, 2, 131, 1, 130, 1, 130, 1,
+		129, 1, 129, 1, 128, 1, 128, 1, 127, 1, 127, 1, 126, 1, 126, 1, 125, 1, 125, 1, 125, 0, 124, 0, 124, 0, 124, 0, 123, 0, 123, 0,
+		123, 0, 123, 0, 122, 0, 122, 0, 122, 0, 122, 0, 121, 0, 121, 0, 121, 0, 121, 0, 121, 0, 120, 0, 120, 0, 120, 0, 120, 0, 120, 0,
+		168, 8, 165, 7, 163, 7, 161, 7, 159, 6, 157, 6, 155, 6, 153, 5, 151, 5, 150, 5, 148, 5, 147, 4, 145, 4, 144, 4, 143, 4, 141, 3,
+		140, 3, 139, 3, 138, 3, 137, 3, 136, 2, 135, 2, 134, 2, 133, 2, 132, 2, 131, 2, 131, 2, 130, 2, 129, 1, 128, 1, 128, 1, 127, 1,
+		127, 1, 126, 1, 125, 1, 125, 1, 124, 1, 124, 1, 123, 1, 123, 1, 122, 1, 122, 0, 121, 0, 121, 0, 120, 0, 120, 0, 120, 0, 119, 0,
+		119, 0, 119, 0, 118, 0, 118, 0, 118, 0, 117, 0, 117, 0, 117, 0, 117, 0, 116, 0, 116, 0, 116, 0, 116, 0, 115, 0, 115, 0, 115, 0,
+		166, 7, 164, 7, 161, 7, 159, 6, 157, 6, 155, 6, 153, 5, 151, 5, 150, 5, 148, 4, 147, 4, 145, 4, 144, 4, 142, 4, 141, 3, 140, 3,
+		138, 3, 137, 3, 136, 3, 135, 2, 134, 2, 133, 2, 132, 2, 131, 2, 130, 2, 129, 2, 128, 2, 128, 1, 127, 1, 126, 1, 125, 1, 124, 1,
+		124, 1, 123, 1, 122, 1, 122, 1, 121, 1, 121, 1, 120, 1, 120, 1, 119, 0, 118, 0, 118, 0, 117, 0, 117, 0, 117, 0, 116, 0, 116, 0,
+		115, 0, 115, 0, 114, 0, 114, 0, 114, 0, 113, 0, 113, 0, 113, 0, 112, 0, 112, 0, 112, 0, 111, 0, 111, 0, 111, 0, 111, 0, 110, 0,
+		164, 7, 162, 7, 160, 6, 157, 6, 155, 6, 153, 5, 152, 5, 150, 5, 148, 4, 146, 4, 145, 4, 143, 4, 142, 4, 140, 3, 139, 3, 138, 3,
+		137, 3, 135, 3, 134, 2, 133, 2, 132, 2, 131, 2, 130, 2, 129, 2, 128, 2, 127, 2, 126, 1, 125, 1, 124, 1, 123, 1, 123, 1, 122, 1,
+		121, 1, 120, 1, 120, 1, 119, 1, 118, 1, 118, 1, 117, 1, 116, 1, 116, 0, 115, 0, 115, 0, 114, 0, 114, 0, 113, 0, 112, 0, 112, 0,
+		112, 0, 111, 0, 111, 0, 110, 0, 110, 0, 109, 0, 109, 0, 108, 0, 108, 0, 108, 0, 107, 0, 107, 0, 107, 0, 106, 0, 106, 0, 106, 0,
+		162, 7, 160, 6, 158, 6, 156, 6, 154, 5, 152, 5, 150, 5, 148, 4, 146, 4, 145, 4, 143, 4, 141, 4, 140, 3, 139, 3, 137, 3, 136, 3,
+		135, 3, 133, 2, 132, 2, 131, 2, 130, 2, 129, 2, 128, 2, 127, 2, 126, 2, 125, 1, 124, 1, 123, 1, 122, 1, 121, 1, 120, 1, 119, 1,
+		118, 1, 118, 1, 117, 1, 116, 1, 115, 1, 115, 1, 114, 1, 113, 0, 113, 0, 112, 0, 111, 0, 111, 0, 110, 0, 110, 0, 109, 0, 108, 0,
+		108, 0, 107, 0, 107, 0, 106, 0, 106, 0, 105, 0, 105, 0, 104, 0, 104, 0, 104, 0, 103, 0, 103, 0, 102, 0, 102, 0, 101, 0, 101, 0,
+		160, 6, 158, 6, 156, 6, 154, 5, 152, 5, 150, 5, 148, 4, 146, 4, 144, 4, 143, 4, 141, 4, 140, 3, 138, 3, 137, 3, 135, 3, 134, 3,
+		133, 2, 131, 2, 130, 2, 129, 2, 128, 2, 126, 2, 125, 2, 124, 2, 123, 1, 122, 1, 121, 1, 120, 1, 119, 1, 118, 1, 117, 1, 116, 1,
+		116, 1, 115, 1, 114, 1, 113, 1, 112, 1, 112, 1, 111, 0, 110, 0, 109, 0, 109, 0, 108, 0, 107, 0, 107, 0, 106, 0, 105, 0, 105, 0,
+		104, 0, 104, 0, 103, 0, 103, 0, 102, 0, 101, 0, 101, 0, 100, 0, 100, 0, 99, 0, 99, 0, 98, 0, 98, 0, 98, 0, 97, 0, 97, 0,
+		158, 6, 156, 6, 154, 5, 152, 5, 150, 5, 148, 4, 146, 4, 144, 4, 142, 4, 141, 4, 139, 3, 138, 3, 136, 3, 135, 3, 133, 3, 132, 2,
+		130, 2, 129, 2, 128, 2, 127, 2, 125, 2, 124, 2, 123, 2, 122, 1, 121, 1, 120, 1, 119, 1, 118, 1, 117, 1, 116, 1, 115, 1, 114, 1,
+		113, 1, 112, 1, 111, 1, 110, 1, 109, 1, 109, 1, 108, 0, 107, 0, 106, 0, 106, 0, 105, 0, 104, 0, 103, 0, 103, 0, 102, 0, 101, 0,
+		101, 0, 100, 0, 99, 0, 99, 0, 98, 0, 98, 0, 97, 0, 97, 0, 96, 0, 95, 0, 95, 0, 94, 0, 94, 0, 93, 0, 93, 0, 92, 0,
+		156, 6, 154, 5, 152, 5, 150, 5, 148, 4, 146, 4, 144, 4, 142, 4, 140, 4, 139, 3, 137, 3, 136, 3, 134, 3, 132, 3, 131, 2, 130, 2,
+		128, 2, 127, 2, 126, 2, 124, 2, 123, 2, 122, 2, 121, 1, 119, 1, 118, 1, 117, 1, 116, 1, 115, 1, 114, 1, 113, 1, 112, 1, 111, 1,
+		110, 1, 109, 1, 108, 1, 107, 1, 106, 1, 106, 0, 105, 0, 104, 0, 103, 0, 102, 0, 102, 0, 101, 0, 100, 0, 99, 0, 99, 0, 98, 0,
+		97, 0, 97, 0, 96, 0, 95, 0, 95, 0, 94, 0, 93, 0, 93, 0, 92, 0, 92, 0, 91, 0, 90, 0, 90, 0, 89, 0, 89, 0, 88, 0,
+		154, 5, 152, 5, 150, 5, 148, 4, 146, 4, 144, 4, 142, 4, 140, 4, 138, 3, 137, 3, 135, 3, 133, 3, 132, 3, 130, 2, 129, 2, 127, 2,
+		126, 2, 125, 2, 123, 2, 122, 2, 121, 2, 119, 1, 118, 1, 117, 1, 116, 1, 115, 1, 114, 1, 112, 1, 111, 1, 110, 1, 109, 1, 108, 1,
+		107, 1, 106, 1, 105, 1, 104, 1, 104, 0, 103, 0, 102, 0, 101, 0, 100, 0, 99, 0, 98, 0, 98, 0, 97, 0, 96, 0, 95, 0, 95, 0,
+		94, 0, 93, 0, 92, 0, 92, 0, 91, 0, 90, 0, 90, 0, 89, 0, 88, 0, 88, 0, 87, 0, 87, 0, 86, 0, 85, 0, 85, 0, 84, 0,
+		151, 5, 149, 5, 147, 4, 145, 4, 143, 4, 142, 4, 140, 4, 138, 3, 136, 3, 135, 3, 133, 3, 131, 3, 130, 2, 128, 2, 127, 2, 125, 2,
+		124, 2, 122, 2, 121, 2, 120, 2, 118, 1, 117, 1, 116, 1, 115, 1, 113, 1, 112, 1, 111, 1, 110, 1, 109, 1, 108, 1, 107, 1, 106, 1,
+		105, 1, 104, 1, 103, 1, 102, 0, 101, 0, 100, 0, 99, 0, 98, 0, 97, 0, 96, 0, 95, 0, 95, 0, 94, 0, 93, 0, 92, 0, 91, 0,
+		91, 0, 90, 0, 89, 0, 88, 0, 88, 0, 87, 0, 86, 0, 86, 0, 85, 0, 84, 0, 84, 0, 83, 0, 82, 0, 82, 0, 81, 0, 80, 0
+	};
+}
@@ -0,0 +1,1878 @@
+#pragma once
+
+// OTHER
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <fstream>
+
+// GLEW
+#include <glew.h>
+
+// GLFW
+#include <glfw3.h>
+
+// MTB
+#include <glm.hpp>
+#include <gtc\matrix_transform.hpp>
+
+// SOIL2
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+#include "ShaderBake.h"
+#include "TextureCompressor.h"
+#include "TextureBake.h"
+#include "MipGenerator.h"
+#include "VirtualTexture.h"
+#include "TextureStreamer.h"
+#include "MaterialTable.h"
+#include "MeshBatch.h"
+#include "IBLBaker.h"
+#include "SHIrradiance.h"
+#include "IBLRebaker.h"
+#include "HDRFile.h"
+#include "Primitives.h"
+#include "Light.h"
+
+// Standalone measurements, run with: 3DEngine.exe --benchmark <name>
+// Each benchmark prints a small table and returns non zero if a correctness check failed.
+namespace Benchmark
+{
+	// Best of a few runs in milliseconds, the first run also warms the caches
+	inline double timeMs(const std::function<void()>& func, int runs = 5)
+	{
+		double best = 1e30;
+		for (int i = 0; i < runs; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			func();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = ms < best ? ms : best;
+		}
+		return best;
+	}
+
+	// Hidden window with the same context the engine asks for, for benchmarks that need GL
+	inline GLFWwindow* createContext()
+	{
+		if (glfwInit() == GLFW_FALSE)
+		{
+			std::cout << "ERROR: glfwInit failed" << std::endl;
+			return nullptr;
+		}
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		GLFWwindow* window = glfwCreateWindow(64, 64, "Benchmark", NULL, NULL);
+		if (!window)
+		{
+			std::cout << "ERROR: Could not create benchmark context" << std::endl;
+			glfwTerminate();
+			return nullptr;
+		}
+		glfwMakeContextCurrent(window);
+		glewExperimental = GL_TRUE;
+		if (glewInit() != GLEW_OK)
+		{
+			std::cout << "ERROR: glewInit failed" << std::endl;
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			return nullptr;
+		}
+		return window;
+	}
+
+	inline void destroyContext(GLFWwindow* window)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+
+	// Build time of every engine program from GLSL and from the baked SPIR-V.
+	// Drivers cache compiled programs, so only the first run after a driver or shader change is cold
+	inline int shaderCompile()
+	{
+		GLFWwindow* window = createContext();
+		if (!window)
+		{
+			return 1;
+		}
+		std::cout << "GL_ARB_gl_spirv " << (GLEW_ARB_gl_spirv ? "supported" : "not supported, SPIR-V column falls back to GLSL") << std::endl;
+		std::cout << std::left << std::setw(34) << "program (fragment)" << std::right << std::setw(12) << "GLSL ms"
+			<< std::setw(12) << "SPIR-V ms" << std::setw(10) << "loaded" << std::endl;
+		double totalGlsl = 0.0;
+		double totalSpirv = 0.0;
+		for (auto& i : ShaderBake::getPrograms())
+		{
+			Shader::setSpirvEnabled(false);
+			Shader* glsl = new Shader(i.vertexFile, i.fragmentFile);
+			Shader::setSpirvEnabled(true);
+			Shader* spirv = new Shader(i.vertexFile, i.fragmentFile);
+			std::cout << std::left << std::setw(34) << i.fragmentFile << std::right << std::fixed << std::setprecision(2)
+				<< std::setw(12) << glsl->getCompileMs() << std::setw(12) << spirv->getCompileMs()
+				<< std::setw(10) << (spirv->isSpirv() ? "SPIR-V" : "GLSL") << std::endl;
+			totalGlsl += glsl->getCompileMs();
+			totalSpirv += spirv->getCompileMs();
+			delete glsl;
+			delete spirv;
+		}
+		std::cout << std::left << std::setw(34) << "total" << std::right << std::setw(12) << totalGlsl << std::setw(12) << totalSpirv << std::endl;
+		destroyContext(window);
+		return 0;
+	}
+
+	// Sort cost and state changes of the render queue for growing draw counts
+	inline int renderQueue()
+	{
+		const size_t counts[] = { 10000, 100000, 1000000 };
+		const unsigned programs = 8;
+		const unsigned materials = 256;
+		int failed = 0;
+		ThreadPool& pool = ThreadPool::get();
+
+		std::cout << "Render queue sort, " << pool.getThreadCount() << " worker threads" << std::endl;
+		std::cout << std::setw(10) << "draws" << std::setw(14) << "serial ms" << std::setw(14) << "parallel ms"
+			<< std::setw(20) << "changes unsorted" << std::setw(18) << "changes sorted" << std::endl;
+
+		for (size_t count : counts)
+		{
+			// Random programs, materials and depths in submission order, like a scene walked object by object
+			std::mt19937 rng(1234);
+			std::vector<uint64_t> keys(count);
+			for (auto& i : keys)
+			{
+				i = RenderQueue::makeKey(PASS_OPAQUE, rng() % programs, rng() % materials, rng() & 0xFFFFFF);
+			}
+
+			RenderQueue queue;
+			auto fill = [&]()
+			{
+				queue.begin(glm::mat4(1.0f), glm::mat4(1.0f), glm::vec3(0.0f), 1.0f);
+				for (auto& i : keys)
+				{
+					queue.submitKey(i, { nullptr, nullptr, nullptr });
+				}
+			};
+
+			fill();
+			unsigned programChanges, materialChanges;
+			queue.countStateChanges(programChanges, materialChanges);
+			unsigned unsortedChanges = programChanges + materialChanges;
+
+			// Filling is timed on its own and taken off so only the sort is reported
+			double fillMs = timeMs(fill);
+			queue.setParallelThreshold((size_t)-1);
+			double serialMs = timeMs([&]() { fill(); queue.sort(pool); }) - fillMs;
+			queue.setParallelThreshold(0);
+			double parallelMs = timeMs([&]() { fill(); queue.sort(pool); }) - fillMs;
+
+			if (!queue.isSorted())
+			{
+				std::cout << "ERROR: render queue is not sorted for " << count << " draws" << std::endl;
+				failed = 1;
+			}
+			queue.countStateChanges(programChanges, materialChanges);
+			unsigned sortedChanges = programChanges + materialChanges;
+
+			std::cout << std::setw(10) << count << std::setw(14) << std::fixed << std::setprecision(3) << serialMs
+				<< std::setw(14) << parallelMs << std::setw(20) << unsortedChanges << std::setw(18) << sortedChanges << std::endl;
+		}
+		return failed;
+	}
+
+	// Peak signal to noise ratio over the first channels of two RGBA8 images
+	inline double psnr(const std::vector<unsigned char>& a, const unsigned char* b, size_t pixels, int channels)
+	{
+		double error = 0.0;
+		for (size_t i = 0; i < pixels; i++)
+		{
+			for (int c = 0; c < channels; c++)
+			{
+				double d = (double)a[i * 4 + c] - b[i * 4 + c];
+				error += d * d;
+			}
+		}
+		double mse = error / ((double)pixels * channels);
+		return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+	}
+
+	// Quality and speed of the block compressor on the material textures
+	inline int textureCompress()
+	{
+		struct Input
+		{
+			const char* fileName;
+			int format;
+			int channels;
+		};
+		const Input inputs[] =
+		{
+			{ "Assets/albedo.png", FORMAT_BC7 | FORMAT_SRGB, 3 },
+			{ "Assets/normal.png", FORMAT_BC5, 2 },
+			{ "Assets/rough.png", FORMAT_BC4, 1 },
+			{ "Assets/metal.png", FORMAT_BC4, 1 }
+		};
+		ThreadPool& pool = ThreadPool::get();
+		std::cout << "Block compression, full mip chain, " << pool.getThreadCount() + 1 << " threads in parallel" << std::endl;
+		std::cout << std::left << std::setw(20) << "texture" << std::right << std::setw(8) << "format" << std::setw(12) << "size"
+			<< std::setw(12) << "serial ms" << std::setw(14) << "parallel ms" << std::setw(10) << "MPix/s" << std::setw(10) << "PSNR dB"
+			<< std::setw(12) << "VRAM MB" << std::setw(12) << "RGBA8 MB" << std::endl;
+		int failed = 0;
+		for (auto& i : inputs)
+		{
+			int width, height;
+			unsigned char* rgba = SOIL_load_image(i.fileName, &width, &height, NULL, SOIL_LOAD_RGBA);
+			if (!rgba)
+			{
+				std::cout << "ERROR: Failed to load texture" << i.fileName << std::endl;
+				failed = 1;
+				continue;
+			}
+			CompressedImage image;
+			double serialMs = timeMs([&]() { image = TextureCompressor::compress(rgba, width, height, i.format, nullptr); }, 1);
+			double parallelMs = timeMs([&]() { image = TextureCompressor::compress(rgba, width, height, i.format, &pool); }, 3);
+			std::vector<unsigned char> decoded = TextureCompressor::decompress(image);
+			double quality = psnr(decoded, rgba, (size_t)width * height, i.channels);
+			const double mb = 1.0 / (1024.0 * 1024.0);
+			std::cout << std::left << std::setw(20) << i.fileName << std::right << std::setw(8) << TextureCompressor::getFormatName(i.format)
+				<< std::setw(12) << (std::to_string(width) + "x" + std::to_string(height)) << std::fixed << std::setprecision(1)
+				<< std::setw(12) << serialMs << std::setw(14) << parallelMs << std::setw(10) << (width * (double)height * 4.0 / 3.0) / (parallelMs * 1000.0)
+				<< std::setw(10) << std::setprecision(2) << quality << std::setw(12) << std::setprecision(1) << image.data.size() * mb
+				<< std::setw(12) << (double)width * height * 4 * 4 / 3 * mb << std::endl;
+			SOIL_free_image_data(rgba);
+		}
+
+		// Occlusion/roughness/metallic packed into one BC7 texture instead of a BC4 texture each
+		std::vector<std::string> sources = TextureBake::findORMSources("Assets");
+		std::vector<unsigned char> orm;
+		int width, height;
+		if (TextureBake::packORM(sources, orm, width, height))
+		{
+			CompressedImage image;
+			double parallelMs = timeMs([&]() { image = TextureCompressor::compress(orm.data(), width, height, FORMAT_BC7, &pool, MIP_CONTENT_LINEAR); }, 1);
+			std::vector<unsigned char> decoded = TextureCompressor::decompress(image);
+			int maps = 0;
+			for (auto& i : sources)
+			{
+				maps += i.empty() ? 0 : 1;
+			}
+			const double mb = 1.0 / (1024.0 * 1024.0);
+			std::cout << std::left << std::setw(20) << "orm (packed)" << std::right << std::setw(8) << "BC7" << std::setw(12)
+				<< (std::to_string(width) + "x" + std::to_string(height)) << std::fixed << std::setprecision(1) << std::setw(12) << "-"
+				<< std::setw(14) << parallelMs << std::setw(10) << (width * (double)height * 4.0 / 3.0) / (parallelMs * 1000.0)
+				<< std::setw(10) << std::setprecision(2) << psnr(decoded, orm.data(), (size_t)width * height, 3) << std::setw(12) << std::setprecision(1)
+				<< image.data.size() * mb << std::setw(12) << (double)width * height * 4 * 4 / 3 * mb << std::endl;
+			std::cout << "Packed ORM: " << maps << " samplers and fetches per fragment become 1, " << std::setprecision(1)
+				<< maps * image.data.size() / 2 * mb << " MB of BC4 become " << image.data.size() * mb << " MB of BC7" << std::endl;
+		}
+		return failed;
+	}
+
+	// CPU side time to get each material texture ready for upload: decoding and compressing the PNG
+	// against mapping and reading the baked KTX2 and DDS files. Cold is the first read in this process,
+	// warm the best of the later ones. The containers were just written and are likely still in the
+	// OS file cache, the startup times the engine prints with and without baked files show a true cold start
+	inline int textureLoad()
+	{
+		std::vector<std::string> files = TextureFile::listFiles("Assets", ".png");
+		std::cout << "Texture load, CPU work before upload" << std::endl;
+		std::cout << std::left << std::setw(20) << "texture" << std::right << std::setw(8) << "format" << std::setw(12) << "PNG cold"
+			<< std::setw(12) << "PNG warm" << std::setw(12) << "KTX2 cold" << std::setw(12) << "KTX2 warm" << std::setw(12) << "DDS warm"
+			<< std::setw(10) << "speedup" << std::endl;
+		int failed = 0;
+		double pngTotal = 0.0, ktxTotal = 0.0;
+		for (auto& i : files)
+		{
+			std::string source = "Assets/" + i;
+			int format = TextureBake::guessFormat(i);
+			CompressedImage image;
+			auto loadPng = [&]()
+			{
+				int width, height;
+				unsigned char* rgba = SOIL_load_image(source.c_str(), &width, &height, NULL, SOIL_LOAD_RGBA);
+				if (rgba)
+				{
+					image = TextureCompressor::compress(rgba, width, height, format);
+				}
+				SOIL_free_image_data(rgba);
+			};
+			double pngCold = timeMs(loadPng, 1);
+			double pngWarm = timeMs(loadPng, 2);
+			if (image.levels.empty())
+			{
+				std::cout << "ERROR: Failed to load texture" << source << std::endl;
+				failed = 1;
+				continue;
+			}
+
+			// Baked files written fresh so both containers hold exactly this image
+			std::string base = "Assets/" + i.substr(0, i.size() - 4);
+			std::string ktxFile = base + ".benchmark.ktx2", ddsFile = base + ".benchmark.dds";
+			TextureFile::writeKTX2(ktxFile, image);
+			TextureFile::writeDDS(ddsFile, image);
+			auto loadBaked = [&](const std::string& fileName)
+			{
+				MappedFile file(fileName);
+				int readFormat;
+				std::vector<CompressedLevel> levels;
+				bool valid = TextureFile::read(file, readFormat, levels) && readFormat == image.format && levels.size() == image.levels.size();
+				// Same work as the loader: every level is read once
+				for (size_t l = 0; valid && l < levels.size(); l++)
+				{
+					valid = std::memcmp(file.getData() + levels[l].offset, image.data.data() + image.levels[l].offset, levels[l].size) == 0;
+				}
+				if (!valid)
+				{
+					std::cout << "ERROR: " << fileName << " does not match the image it was written from" << std::endl;
+					failed = 1;
+				}
+			};
+			double ktxCold = timeMs([&]() { loadBaked(ktxFile); }, 1);
+			double ktxWarm = timeMs([&]() { loadBaked(ktxFile); }, 3);
+			double ddsWarm = timeMs([&]() { loadBaked(ddsFile); }, 3);
+			std::remove(ktxFile.c_str());
+			std::remove(ddsFile.c_str());
+			pngTotal += pngCold;
+			ktxTotal += ktxCold;
+			std::cout << std::left << std::setw(20) << i << std::right << std::setw(8) << TextureCompressor::getFormatName(format)
+				<< std::fixed << std::setprecision(1) << std::setw(12) << pngCold << std::setw(12) << pngWarm << std::setw(12) << ktxCold
+				<< std::setw(12) << ktxWarm << std::setw(12) << ddsWarm << std::setw(9) << pngCold / std::max(ktxCold, 0.001) << "x" << std::endl;
+		}
+		std::cout << "Total cold: PNG " << std::fixed << std::setprecision(1) << pngTotal << " ms, KTX2 " << ktxTotal << " ms" << std::endl;
+		return failed;
+	}
+
+	// Mean linear light value of the colour channels of an sRGB image
+	inline double meanLinear(const unsigned char* rgba, size_t pixels)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < pixels; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				sum += MipGenerator::srgbToLinear(rgba[i * 4 + c] / 255.0f);
+			}
+		}
+		return sum / (pixels * 3.0);
+	}
+
+	// CPU mip chain generation for the 4K albedo and normal map and an 8K albedo tiled from the 4K one
+	inline int mipGeneration()
+	{
+		int width, height;
+		unsigned char* albedo = SOIL_load_image("Assets/albedo.png", &width, &height, NULL, SOIL_LOAD_RGBA);
+		int normalWidth, normalHeight;
+		unsigned char* normal = SOIL_load_image("Assets/normal.png", &normalWidth, &normalHeight, NULL, SOIL_LOAD_RGBA);
+		if (!albedo || !normal)
+		{
+			std::cout << "ERROR: Failed to load Assets/albedo.png and Assets/normal.png" << std::endl;
+			SOIL_free_image_data(albedo);
+			SOIL_free_image_data(normal);
+			return 1;
+		}
+		std::vector<unsigned char> large((size_t)width * height * 16);
+		for (int y = 0; y < height * 2; y++)
+		{
+			for (int x = 0; x < 2; x++)
+			{
+				std::memcpy(&large[((size_t)y * width * 2 + (size_t)x * width) * 4], albedo + (size_t)(y % height) * width * 4, (size_t)width * 4);
+			}
+		}
+
+		struct Input
+		{
+			const char* name;
+			const unsigned char* rgba;
+			int width;
+			int height;
+			int content;
+		};
+		const Input inputs[] =
+		{
+			{ "albedo (sRGB)", albedo, width, height, MIP_CONTENT_SRGB },
+			{ "normal", normal, normalWidth, normalHeight, MIP_CONTENT_NORMAL },
+			{ "albedo 8K (sRGB)", large.data(), width * 2, height * 2, MIP_CONTENT_SRGB }
+		};
+		ThreadPool& pool = ThreadPool::get();
+#if defined(ENGINE_AVX2)
+		const char* kernels = "AVX2";
+#elif defined(ENGINE_SSE2)
+		const char* kernels = "SSE2";
+#else
+		const char* kernels = "scalar";
+#endif
+		std::cout << "Mip chain generation, " << kernels << " kernels, " << pool.getThreadCount() + 1 << " threads in parallel" << std::endl;
+		std::cout << std::left << std::setw(20) << "texture" << std::right << std::setw(12) << "size" << std::setw(10) << "filter"
+			<< std::setw(12) << "serial ms" << std::setw(14) << "parallel ms" << std::setw(10) << "MPix/s" << std::endl;
+		for (auto& i : inputs)
+		{
+			for (int filter : { MIP_FILTER_BOX, MIP_FILTER_KAISER, MIP_FILTER_LANCZOS })
+			{
+				double serialMs = timeMs([&]() { MipGenerator::generate(i.rgba, i.width, i.height, i.content, filter, nullptr); }, 1);
+				double parallelMs = timeMs([&]() { MipGenerator::generate(i.rgba, i.width, i.height, i.content, filter, &pool); }, 2);
+				std::cout << std::left << std::setw(20) << i.name << std::right << std::setw(12) << (std::to_string(i.width) + "x" + std::to_string(i.height))
+					<< std::setw(10) << MipGenerator::getFilterName(filter) << std::fixed << std::setprecision(1) << std::setw(12) << serialMs
+					<< std::setw(14) << parallelMs << std::setw(10) << (i.width * (double)i.height) / (parallelMs * 1000.0) << std::endl;
+			}
+		}
+
+		// The 1x1 level should keep the average brightness, which only holds when filtering in linear light
+		int failed = 0;
+		double reference = meanLinear(albedo, (size_t)width * height);
+		std::cout << "Albedo mean linear value " << std::setprecision(4) << reference << ", 1x1 level:" << std::endl;
+		for (int content : { MIP_CONTENT_LINEAR, MIP_CONTENT_SRGB })
+		{
+			std::vector<MipLevel> levels = MipGenerator::generate(albedo, width, height, content, MIP_FILTER_KAISER, &pool);
+			double mean = meanLinear(levels.back().rgba.data(), 1);
+			double error = 100.0 * (mean - reference) / reference;
+			std::cout << "  " << std::left << std::setw(28) << (content == MIP_CONTENT_SRGB ? "filtered in linear light" : "filtered in gamma space")
+				<< std::right << std::setprecision(4) << mean << " (" << std::showpos << std::setprecision(1) << error << std::noshowpos << "%)" << std::endl;
+			if (content == MIP_CONTENT_SRGB && std::fabs(error) > 2.0)
+			{
+				std::cout << "ERROR: Linear light mip chain changed the average brightness" << std::endl;
+				failed = 1;
+			}
+		}
+		SOIL_free_image_data(albedo);
+		SOIL_free_image_data(normal);
+		return failed;
+	}
+
+	// Virtual texture streaming run headless: the feedback buffer the GPU pass would write is
+	// emulated on the CPU for a camera flying low over a ground plane covered by the texture
+	inline int virtualTexture()
+	{
+		// Layers baked fresh from the albedo and normal map
+		std::vector<std::string> files = { "Assets/albedo.benchmark.vtex", "Assets/normal.benchmark.vtex" };
+		const char* sources[] = { "Assets/albedo.png", "Assets/normal.png" };
+		for (int i = 0; i < 2; i++)
+		{
+			int width, height;
+			unsigned char* rgba = SOIL_load_image(sources[i], &width, &height, NULL, SOIL_LOAD_RGBA);
+			if (!rgba)
+			{
+				std::cout << "ERROR: Failed to load " << sources[i] << std::endl;
+				return 1;
+			}
+			int format = TextureBake::guessFormat(sources[i]);
+			double ms = timeMs([&]() { TiledTextureFile::write(files[i], rgba, width, height, format); }, 1);
+			SOIL_free_image_data(rgba);
+			std::cout << "Baked " << files[i] << " (" << TextureCompressor::getFormatName(format) << ", " << width << "x" << height << ") in "
+				<< std::fixed << std::setprecision(0) << ms << " ms" << std::endl;
+		}
+
+		int failed = 0;
+		{
+			const size_t budget = 8 * 1024 * 1024;
+			VirtualTexture texture(files, budget, false);
+			if (!texture.isValid())
+			{
+				std::remove(files[0].c_str());
+				std::remove(files[1].c_str());
+				return 1;
+			}
+			// 1280x720 screen with a 90 degree field of view, the texture repeats every 4 units
+			const int screenWidth = 1280, screenHeight = 720;
+			const int width = screenWidth / VirtualTexture::FEEDBACK_DIVISOR, height = screenHeight / VirtualTexture::FEEDBACK_DIVISOR;
+			const float tanHalfFov = 1.0f, aspect = (float)screenWidth / screenHeight, repeat = 4.0f;
+			// Texture coordinates where the ray through a screen position hits the ground, false for sky
+			auto hitGround = [&](const glm::vec3& eye, const glm::mat3& basis, float sx, float sy, glm::vec2& uv)
+			{
+				glm::vec3 direction = basis * glm::vec3((2.0f * sx / screenWidth - 1.0f) * tanHalfFov * aspect, (1.0f - 2.0f * sy / screenHeight) * tanHalfFov, -1.0f);
+				if (direction.y > -1e-4f)
+				{
+					return false;
+				}
+				glm::vec3 hit = eye + direction * (-eye.y / direction.y);
+				uv = glm::vec2(hit.x, hit.z) / repeat;
+				return true;
+			};
+
+			// Fly forwards for 8 seconds while turning, then hover for 2 so the streaming can catch up
+			const int frames = 600, moving = 480;
+			std::vector<uint32_t> feedback((size_t)width * height);
+			std::vector<uint32_t> wanted;
+			double hitSum = 0.0, nearSum = 0.0, feedbackMs = 0.0, updateMs = 0.0;
+			double finalHit = 0.0;
+			auto frameStart = std::chrono::steady_clock::now();
+			for (int frame = 0; frame < frames; frame++)
+			{
+				float t = std::min(frame, moving) / 60.0f;
+				glm::vec3 eye(t * 3.0f, 1.5f, -t * 1.5f);
+				float yaw = 0.4f * std::sin(t * 0.7f), pitch = -0.35f;
+				glm::mat3 basis = glm::mat3(glm::rotate(glm::mat4(1.0f), yaw, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::rotate(glm::mat4(1.0f), pitch, glm::vec3(1.0f, 0.0f, 0.0f)));
+
+				// Each feedback texel samples the centre of its block of screen pixels, derivatives are one screen pixel
+				for (int y = 0; y < height; y++)
+				{
+					for (int x = 0; x < width; x++)
+					{
+						float sx = (x + 0.5f) * VirtualTexture::FEEDBACK_DIVISOR, sy = (y + 0.5f) * VirtualTexture::FEEDBACK_DIVISOR;
+						glm::vec2 uv, right, down;
+						bool ground = hitGround(eye, basis, sx, sy, uv) && hitGround(eye, basis, sx + 1.0f, sy, right) && hitGround(eye, basis, sx, sy + 1.0f, down);
+						feedback[(size_t)y * width + x] = ground ? texture.getPage(uv, right - uv, down - uv) : VirtualTexture::NO_PAGE;
+					}
+				}
+
+				// What the shaders would draw this frame, the page asked for or a coarser parent
+				unsigned hits = 0, near = 0, ground = 0;
+				for (uint32_t page : feedback)
+				{
+					if (page != VirtualTexture::NO_PAGE)
+					{
+						int served = texture.getServedLevel(page);
+						hits += served == VirtualTexture::getPageLevel(page) ? 1 : 0;
+						near += served <= VirtualTexture::getPageLevel(page) + 1 ? 1 : 0;
+						ground++;
+					}
+				}
+				double hitRate = ground ? (double)hits / ground : 1.0;
+				hitSum += hitRate;
+				nearSum += ground ? (double)near / ground : 1.0;
+				finalHit = hitRate;
+
+				feedbackMs += timeMs([&]() { texture.processFeedback(feedback.data(), feedback.size()); }, 1);
+				updateMs += timeMs([&]() { texture.update(); }, 1);
+				// Paced at 60 frames a second, so the streaming thread gets the time it would in the engine
+				frameStart += std::chrono::microseconds(16667);
+				std::this_thread::sleep_until(frameStart);
+			}
+
+			const VirtualTexture::Stats& stats = texture.getStats();
+			const double mb = 1.0 / (1024.0 * 1024.0);
+			std::cout << "Virtual texture, " << texture.getSize() << "x" << texture.getSize() << ", " << texture.getLevelCount() << " levels, "
+				<< texture.getSlotCount() << " page slots, feedback " << width << "x" << height << ", " << frames << " frames at 60 Hz" << std::endl;
+			std::cout << std::fixed << std::setprecision(1);
+			std::cout << "  video memory        " << texture.getResidentBytes() * mb << " MB resident vs " << texture.getFullResidencyBytes() * mb << " MB fully resident" << std::endl;
+			std::cout << "  pages               " << stats.streamed << " streamed, " << stats.evicted << " evicted, " << stats.dropped << " dropped, " << texture.getResidentCount() << " resident" << std::endl;
+			std::cout << "  texels at wanted level  " << 100.0 * hitSum / frames << "% average, " << 100.0 * nearSum / frames << "% within one level, " << 100.0 * finalHit << "% after hovering" << std::endl;
+			std::cout << std::setprecision(3) << "  render thread       " << feedbackMs / frames << " ms feedback + " << updateMs / frames << " ms update per frame" << std::endl;
+			std::cout << std::setprecision(1) << "  streaming thread    " << stats.streamMs << " ms total, " << stats.streamMs * 1000.0 / std::max(stats.streamed, 1u) << " us per page" << std::endl;
+			if (finalHit < 0.99)
+			{
+				std::cout << "ERROR: Streaming did not catch up with a still camera" << std::endl;
+				failed = 1;
+			}
+		}
+		std::remove(files[0].c_str());
+		std::remove(files[1].c_str());
+		return failed;
+	}
+
+	// Mip streaming in a test scene: a corridor of 16 wall quads, 4 units wide, each with its own
+	// albedo and normal map streamed from KTX2 under a 128 MB budget. The camera walks down the
+	// corridor for 8 seconds and stands still for 3, resident memory is compared with loading mip 0
+	inline int textureStreaming()
+	{
+		std::vector<std::string> files = { "Assets/albedo.benchmark.ktx2", "Assets/normal.benchmark.ktx2" };
+		const char* sources[] = { "Assets/albedo.png", "Assets/normal.png" };
+		for (int i = 0; i < 2; i++)
+		{
+			int width, height;
+			unsigned char* rgba = SOIL_load_image(sources[i], &width, &height, NULL, SOIL_LOAD_RGBA);
+			if (!rgba)
+			{
+				std::cout << "ERROR: Failed to load " << sources[i] << std::endl;
+				return 1;
+			}
+			TextureFile::writeKTX2(files[i], TextureCompressor::compress(rgba, width, height, TextureBake::guessFormat(sources[i])));
+			SOIL_free_image_data(rgba);
+		}
+		GLFWwindow* window = createContext();
+		if (!window)
+		{
+			std::remove(files[0].c_str());
+			std::remove(files[1].c_str());
+			return 1;
+		}
+
+		int failed = 0;
+		{
+			const size_t budget = 128 * 1024 * 1024;
+			const int walls = 16;
+			TextureStreamer streamer(budget);
+			Quad quad;
+			std::vector<Mesh*> meshes;
+			std::vector<RenderMaterial> materials;
+			for (int i = 0; i < walls; i++)
+			{
+				// Facing down the corridor, alternately on the left and the right
+				glm::vec3 position(i % 2 ? 3.0f : -3.0f, 0.0f, -6.0f * i);
+				meshes.push_back(new Mesh(&quad, position, glm::vec3(0.0f, i % 2 ? -90.0f : 90.0f, 0.0f), glm::vec3(4.0f)));
+				meshes.back()->setOrigin(position);
+				RenderMaterial material = { nullptr, { streamer.load(files[0]), streamer.load(files[1]) }, 2 };
+				if (!material.textures[0] || !material.textures[1])
+				{
+					failed = 1;
+					break;
+				}
+				materials.push_back(material);
+			}
+
+			// 1280x720 with a 90 degree field of view, paced at 60 frames a second like the engine
+			const int frames = 660, moving = 480;
+			size_t peakBytes = 0;
+			double residentSum = 0.0, updateMs = 0.0;
+			auto frameStart = std::chrono::steady_clock::now();
+			for (int frame = 0; frame < frames && !failed; frame++)
+			{
+				float t = std::min(frame, moving) / (float)moving;
+				streamer.beginFrame(glm::vec3(0.0f, 0.0f, 4.0f - t * 6.0f * walls * 0.5f), 90.0f, 720);
+				for (int i = 0; i < walls; i++)
+				{
+					streamer.request(materials[i], *meshes[i]);
+				}
+				updateMs += timeMs([&]() { streamer.update(); }, 1);
+				peakBytes = std::max(peakBytes, streamer.getResidentBytes());
+				residentSum += streamer.getResidentBytes();
+				frameStart += std::chrono::microseconds(16667);
+				std::this_thread::sleep_until(frameStart);
+			}
+
+			if (!failed)
+			{
+				const TextureStreamer::Stats& stats = streamer.getStats();
+				const double mb = 1.0 / (1024.0 * 1024.0);
+				std::cout << "Texture streaming, " << streamer.getTextureCount() << " textures on " << walls << " walls, tail of "
+					<< TextureStreamer::TAIL_SIZE << "x" << TextureStreamer::TAIL_SIZE << " and smaller, " << frames << " frames at 60 Hz" << std::endl;
+				std::cout << std::fixed << std::setprecision(1);
+				std::cout << "  video memory        " << streamer.getResidentBytes() * mb << " MB resident vs " << streamer.getFullResidencyBytes() * mb
+					<< " MB fully resident, " << budget * mb << " MB budget" << std::endl;
+				std::cout << "  while walking       " << residentSum / frames * mb << " MB average, " << peakBytes * mb << " MB peak" << std::endl;
+				std::cout << "  levels              " << stats.promoted << " promoted, " << stats.demoted << " demoted, "
+					<< streamer.getTextureCount() - streamer.getMissingCount() << "/" << streamer.getTextureCount() << " textures at their level after standing still" << std::endl;
+				std::cout << "  per wall, standing  ";
+				for (int i = 0; i < walls; i++)
+				{
+					std::cout << streamer.getResidentLevel(materials[i].textures[0]) << (i + 1 < walls ? " " : "\n");
+				}
+				std::cout << std::setprecision(3) << "  render thread       " << updateMs / frames << " ms update per frame" << std::endl;
+				std::cout << std::setprecision(1) << "  workers             " << stats.loadMs << " ms total, " << stats.loadMs / std::max(stats.promoted, 1u) << " ms per level" << std::endl;
+				if (streamer.getMissingCount() > 0 && streamer.getWantedBytes() <= budget)
+				{
+					std::cout << "ERROR: Streaming did not catch up with a still camera" << std::endl;
+					failed = 1;
+				}
+			}
+			for (auto* i : meshes)
+			{
+				delete i;
+			}
+		}
+		destroyContext(window);
+		std::remove(files[0].c_str());
+		std::remove(files[1].c_str());
+		return failed;
+	}
+
+	// Per draw texture binds against the material table: a 40x25 wall of quads, each with a material
+	// of its own (albedo and ORM textures of a single colour, a shared flat normal map). The queue binds
+	// three textures and sets the material uniforms before every draw, the table draws everything with
+	// one glMultiDrawElementsIndirect, through bindless handles when the driver has them and texture
+	// arrays otherwise. Every path renders into the same framebuffer and the images must match
+	inline int materials()
+	{
+		GLFWwindow* window = createContext();
+		if (!window)
+		{
+			return 1;
+		}
+
+		int failed = 0;
+		{
+			const int columns = 40, rows = 25, count = columns * rows;
+			const int size = 256;
+			std::mt19937 random(7);
+			std::uniform_int_distribution<int> distribution(0, 255);
+			auto channel = [&]() { return (unsigned char)distribution(random); };
+			Quad quad;
+			std::vector<Mesh*> meshes;
+			std::vector<Texture*> textures;
+			std::vector<Material*> materials;
+			std::vector<RenderMaterial> renderMaterials(count);
+			Texture* normal = new Texture((unsigned char)128, (unsigned char)128, (unsigned char)255);
+			for (int i = 0; i < count; i++)
+			{
+				glm::vec3 position((i % columns - columns * 0.5f + 0.5f) * 2.0f, (i / columns - rows * 0.5f + 0.5f) * 2.0f, 0.0f);
+				meshes.push_back(new Mesh(&quad, position, glm::vec3(0.0f), glm::vec3(1.0f)));
+				meshes.back()->setOrigin(position);
+				textures.push_back(new Texture(channel(), channel(), channel()));
+				textures.push_back(new Texture((unsigned char)255, channel(), channel()));
+				materials.push_back(new Material(glm::vec3(0.0f), 0, 1, 2));
+				renderMaterials[i] = { materials.back(), { textures[i * 2], textures[i * 2 + 1], normal }, 3 };
+			}
+
+			// Same uniforms for every program, the camera sees the whole wall
+			glm::vec3 cameraPos(0.0f, 0.0f, 48.0f);
+			glm::mat4 view = glm::lookAt(cameraPos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+			PointLight light(glm::vec3(0.0f, 0.0f, 10.0f), 400.0f);
+			auto setUniforms = [&](Shader* shader)
+			{
+				shader->use();
+				shader->setMat4fv(view, "ViewMatrix");
+				shader->setMat4fv(projection, "ProjectionMatrix");
+				shader->setVec3f(cameraPos, "cameraPos");
+				light.sendToShader(*shader);
+			};
+
+			GLuint colour, depth, framebuffer;
+			glGenTextures(1, &colour);
+			GLState::get().bindTexture(0, GL_TEXTURE_2D, colour);
+			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, size, size);
+			glGenRenderbuffers(1, &depth);
+			glBindRenderbuffer(GL_RENDERBUFFER, depth);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+			glGenFramebuffers(1, &framebuffer);
+			GLState::get().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour, 0);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+			GLState::get().setViewport(0, 0, size, size);
+			GLState::get().setDepthTest(true);
+
+			std::cout << "Materials, " << count << " quads with unique materials, GL_ARB_bindless_texture "
+				<< (GLEW_ARB_bindless_texture ? "supported" : "not supported") << std::endl;
+			std::cout << std::left << std::setw(28) << "path" << std::right << std::setw(12) << "draw calls" << std::setw(14) << "CPU ms"
+				<< std::setw(14) << "frame ms" << std::setw(14) << "texture MB" << std::endl;
+			std::vector<unsigned char> reference((size_t)size * size * 4), image(reference.size());
+
+			// Time submission on its own and with glFinish for the whole frame, then read the image back
+			auto measure = [&](const char* name, unsigned calls, double textureMB, const std::function<void()>& frame)
+			{
+				double cpuMs = timeMs([&]() { glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); frame(); }, 20);
+				glFinish();
+				double frameMs = timeMs([&]() { glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); frame(); glFinish(); }, 20);
+				glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+				std::cout << std::left << std::setw(28) << name << std::right << std::setw(12) << calls << std::fixed << std::setprecision(3)
+					<< std::setw(14) << cpuMs << std::setw(14) << frameMs << std::setprecision(2) << std::setw(14) << textureMB << std::endl;
+			};
+
+			const ShaderBake::ProgramFiles& orm = ShaderBake::getPermutations()[ShaderBake::PERMUTATION_PBR_ORM];
+			Shader* queueShader = new Shader(orm.vertexFile, orm.fragmentFile, "", orm.defines);
+			setUniforms(queueShader);
+			RenderQueue queue;
+			measure("render queue, binds per draw", count, 0.0, [&]()
+			{
+				queue.begin(view, projection, cameraPos, 100.0f);
+				for (int i = 0; i < count; i++)
+				{
+					queue.submit(PASS_OPAQUE, queueShader, &renderMaterials[i], meshes[i]);
+				}
+				queue.sort();
+				queue.execute();
+			});
+			reference = image;
+			delete queueShader;
+
+			const ShaderBake::ProgramFiles& table = ShaderBake::getPermutations()[ShaderBake::PERMUTATION_PBR_TABLE];
+			for (bool allowBindless : { true, false })
+			{
+				if (allowBindless && !GLEW_ARB_bindless_texture)
+				{
+					continue;
+				}
+				MaterialTable materialTable(allowBindless);
+				MeshBatch batch;
+				std::string defines = std::string(table.defines) + (materialTable.isBindless() ? " BINDLESS_TEXTURES" : "");
+				Shader* tableShader = new Shader(table.vertexFile, table.fragmentFile, "", defines.c_str());
+				setUniforms(tableShader);
+				auto frame = [&]()
+				{
+					batch.begin();
+					for (int i = 0; i < count; i++)
+					{
+						batch.add(meshes[i], materialTable.add(&renderMaterials[i]));
+					}
+					materialTable.bind(*tableShader);
+					batch.draw(tableShader);
+				};
+				// Build the arrays or make the handles resident before timing
+				frame();
+				measure(materialTable.isBindless() ? "material table, bindless" : "material table, arrays", 1,
+					materialTable.getArrayBytes() / (1024.0 * 1024.0), frame);
+				size_t differing = 0;
+				for (size_t i = 0; i < image.size(); i++)
+				{
+					differing += std::abs(image[i] - reference[i]) > 2 ? 1 : 0;
+				}
+				if (differing > 0)
+				{
+					std::cout << "ERROR: " << differing << " channels differ from the render queue image" << std::endl;
+					failed = 1;
+				}
+				delete tableShader;
+			}
+
+			GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteRenderbuffers(1, &depth);
+			GLState::get().forgetTexture(colour);
+			glDeleteTextures(1, &colour);
+			for (auto* i : meshes)
+			{
+				delete i;
+			}
+			for (auto* i : materials)
+			{
+				delete i;
+			}
+			for (auto* i : textures)
+			{
+				delete i;
+			}
+			delete normal;
+		}
+		destroyContext(window);
+		return failed;
+	}
+
+	// Hash of every value of a bake, equal hashes mean bit identical maps
+	inline uint64_t hashBake(const IBLBaker::Result& result)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (auto* cube : { &result.environment, &result.irradiance, &result.prefilter })
+		{
+			for (auto& level : cube->levels)
+			{
+				hash = IBLCache::hashBytes(hash, level.data(), level.size() * sizeof(float));
+			}
+		}
+		return hash;
+	}
+
+	// Procedural sky with a small bright sun, and a little per texel noise as photographed HDRs have
+	inline IBLBaker::Image makeSky(int width, int height, bool sun = true)
+	{
+		IBLBaker::Image image;
+		image.width = width;
+		image.height = height;
+		image.rgb.resize((size_t)width * height * 3);
+		for (int y = 0; y < height; y++)
+		{
+			float elevation = ((y + 0.5f) / height - 0.5f) * IBLBaker::PI;
+			for (int x = 0; x < width; x++)
+			{
+				float azimuth = ((x + 0.5f) / width) * 2.0f * IBLBaker::PI;
+				float sunlight = sun ? std::exp(-((elevation - 0.6f) * (elevation - 0.6f) + (azimuth - 2.0f) * (azimuth - 2.0f)) * 800.0f) * 5000.0f : 0.0f;
+				uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u);
+				hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+				float noise = 1.0f + 0.02f * ((hash >> 16) / 65535.0f - 0.5f);
+				float* texel = &image.rgb[((size_t)y * width + x) * 3];
+				texel[0] = ((elevation > 0.0f ? 0.3f + 0.5f * elevation : 0.2f) + sunlight) * noise;
+				texel[1] = ((elevation > 0.0f ? 0.5f + 0.4f * elevation : 0.15f) + sunlight) * noise;
+				texel[2] = ((elevation > 0.0f ? 0.9f : 0.1f) + sunlight * 0.9f) * noise;
+			}
+		}
+		return image;
+	}
+
+	// Assets/environment.hdr when there is one and the procedural sky otherwise
+	inline IBLBaker::Image loadEnvironment()
+	{
+		IBLBaker::Image image;
+		std::ifstream file("Assets/environment.hdr");
+		if (!file.good() || !IBLBaker::loadHDR("Assets/environment.hdr", image, &ThreadPool::get()))
+		{
+			image = makeSky(2048, 1024);
+		}
+		return image;
+	}
+
+	// CPU IBL bake at the engine's map sizes on 1, 2, 4 ... threads
+	inline int iblBake()
+	{
+		IBLBaker::Image image = loadEnvironment();
+		IBLCache::Settings settings;
+		unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+		std::cout << "CPU IBL bake of a " << image.width << "x" << image.height << " HDR, " << IBLBaker::getKernelName() << " kernels, up to " << hardware << " threads" << std::endl;
+		std::cout << std::right << std::setw(8) << "threads" << std::setw(13) << "environment" << std::setw(12) << "irradiance" << std::setw(11) << "prefilter"
+			<< std::setw(10) << "total ms" << std::setw(14) << "MTexel/s" << std::setw(9) << "speedup" << std::endl;
+
+		// Output texels of every map, each costs a few to a thousand samples
+		double texels = 0.0;
+		for (auto& i : IBLCache::getMapFiles(settings))
+		{
+			for (int level = 0; level < i.levels; level++)
+			{
+				double size = std::max(1, i.size >> level);
+				texels += size * size * (i.cube ? 6 : 1);
+			}
+		}
+		int failed = 0;
+		uint64_t reference = 0;
+		double serialMs = 0.0;
+		for (unsigned threads = 1; ; threads = std::min(threads * 2, hardware))
+		{
+			ThreadPool* pool = threads > 1 ? new ThreadPool(threads - 1) : nullptr;
+			IBLBaker::Result result = IBLBaker::bake(image, settings, pool);
+			delete pool;
+			double totalMs = result.environmentMs + result.irradianceMs + result.prefilterMs;
+			serialMs = threads == 1 ? totalMs : serialMs;
+			std::cout << std::fixed << std::setprecision(1) << std::setw(8) << threads << std::setw(13) << result.environmentMs << std::setw(12) << result.irradianceMs
+				<< std::setw(11) << result.prefilterMs << std::setw(10) << totalMs << std::setw(14) << texels / (totalMs * 1000.0)
+				<< std::setw(8) << serialMs / totalMs << "x" << std::endl;
+
+			// Every row is worked out by one thread in a fixed order, so the maps must not change with the thread count
+			uint64_t hash = hashBake(result);
+			if (threads == 1)
+			{
+				reference = hash;
+			}
+			else if (hash != reference)
+			{
+				std::cout << "ERROR: Bake on " << threads << " threads differs from the single threaded bake" << std::endl;
+				failed = 1;
+			}
+			if (threads == hardware)
+			{
+				break;
+			}
+		}
+		return failed;
+	}
+
+	// Brute force irradiance / pi of a size x size map: every texel of one environment level, weighted by
+	// its solid angle and the cosine. Exact but for the detail that level has lost
+	inline IBLBaker::CubeMap convolveIrradiance(const IBLBaker::CubeMap& environment, int level, int size, ThreadPool* pool)
+	{
+		// Direction and solid angle weighted radiance of every source texel
+		int levelSize = environment.getLevelSize(level);
+		std::vector<float> sources;
+		for (int face = 0; face < 6; face++)
+		{
+			for (int y = 0; y < levelSize; y++)
+			{
+				for (int x = 0; x < levelSize; x++)
+				{
+					float d[3];
+					IBLBaker::getTexelDirection(face, x, y, levelSize, d);
+					float weight = IBLBaker::getTexelSolidAngle(x, y, levelSize) / IBLBaker::PI;
+					const float* texel = &environment.levels[level][(((size_t)face * levelSize + y) * levelSize + x) * 3];
+					sources.insert(sources.end(), { d[0], d[1], d[2], texel[0] * weight, texel[1] * weight, texel[2] * weight });
+				}
+			}
+		}
+		IBLBaker::CubeMap irradiance;
+		IBLBaker::allocate(irradiance, size, 1);
+		IBLBaker::forEachRow(irradiance, 0, 1, pool, [&](int, int face, int y)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				float n[3];
+				IBLBaker::getTexelDirection(face, x, y, size, n);
+				double sum[3] = {};
+				for (size_t i = 0; i < sources.size(); i += 6)
+				{
+					float cosine = n[0] * sources[i] + n[1] * sources[i + 1] + n[2] * sources[i + 2];
+					if (cosine > 0.0f)
+					{
+						for (int c = 0; c < 3; c++)
+						{
+							sum[c] += cosine * sources[i + 3 + c];
+						}
+					}
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					irradiance.levels[0][(((size_t)face * size + y) * size + x) * 3 + c] = (float)sum[c];
+				}
+			}
+		});
+		return irradiance;
+	}
+
+	// IBL quality tiers: CPU bake time, GPU memory and cache size of each tier's maps, and their error
+	// against a reference with ultra's sizes and twice its samples. Maps are compared along the texel
+	// directions of a 64x64 cube, the irradiance map and every prefilter level at its roughness. Uses the
+	// sky without its sun: where a tiny sun lands on a texel would swamp the differences between tiers
+	inline int iblQuality()
+	{
+		IBLBaker::Image image = makeSky(2048, 1024, false);
+		ThreadPool& pool = ThreadPool::get();
+		IBLCache::Settings referenceSettings = IBLCache::getSettings(IBLCache::QUALITY_ULTRA);
+		referenceSettings.irradianceSamples *= 2;
+		referenceSettings.prefilterSamples *= 2;
+		IBLBaker::Result reference = IBLBaker::bake(image, referenceSettings, &pool);
+		std::cout << "IBL quality tiers for a " << image.width << "x" << image.height << " HDR, " << pool.getThreadCount() + 1 << " threads. Reference: "
+			<< referenceSettings.irradianceSamples << " irradiance and " << referenceSettings.prefilterSamples << " prefilter samples, " << std::fixed << std::setprecision(0)
+			<< reference.environmentMs + reference.irradianceMs + reference.prefilterMs << " ms" << std::endl;
+		std::cout << std::left << std::setw(8) << "tier" << std::right << std::setw(13) << "environment" << std::setw(12) << "irradiance" << std::setw(11) << "prefilter"
+			<< std::setw(10) << "bake ms" << std::setw(9) << "GPU MB" << std::setw(10) << "cache MB" << std::setw(14) << "irradiance %" << std::setw(13) << "prefilter %" << std::endl;
+
+		const int directionSize = 64;
+		auto sampleAll = [&](const IBLBaker::CubeMap& cube, float lod)
+		{
+			std::vector<float> values((size_t)directionSize * directionSize * 6 * 3);
+			for (int face = 0; face < 6; face++)
+			{
+				for (int y = 0; y < directionSize; y++)
+				{
+					for (int x = 0; x < directionSize; x++)
+					{
+						float d[3];
+						IBLBaker::getTexelDirection(face, x, y, directionSize, d);
+						IBLBaker::sampleCube(cube, d, lod, &values[(((size_t)face * directionSize + y) * directionSize + x) * 3]);
+					}
+				}
+			}
+			return values;
+		};
+
+		int failed = 0;
+		double lastError = 0.0;
+		for (int i = 0; i < IBLCache::QUALITY_COUNT; i++)
+		{
+			IBLCache::quality_enum quality = (IBLCache::quality_enum)i;
+			IBLCache::Settings settings = IBLCache::getSettings(quality);
+			IBLBaker::Result result = IBLBaker::bake(image, settings, &pool);
+			size_t cacheBytes = 0;
+			for (auto& map : IBLCache::getMapFiles(settings))
+			{
+				for (int level = 0; level < map.levels; level++)
+				{
+					cacheBytes += IBLCache::getLevelBytes(map, level);
+				}
+			}
+			double irradianceRMS, prefilterRMS = 0.0, largest;
+			IBLBaker::getRelativeError(sampleAll(result.irradiance, 0.0f), sampleAll(reference.irradiance, 0.0f), irradianceRMS, largest);
+			// Mean over the levels, each level is the same roughness on every tier
+			for (int level = 0; level < settings.prefilterLevels; level++)
+			{
+				double rms;
+				IBLBaker::getRelativeError(sampleAll(result.prefilter, (float)level), sampleAll(reference.prefilter, (float)level), rms, largest);
+				prefilterRMS += rms / settings.prefilterLevels;
+			}
+			std::cout << std::left << std::setw(8) << IBLCache::getQualityName(quality) << std::right << std::setw(13) << settings.environmentSize
+				<< std::setw(12) << (std::to_string(settings.irradianceSize) + "/" + std::to_string(settings.irradianceSamples))
+				<< std::setw(11) << (std::to_string(settings.prefilterSize) + "/" + std::to_string(settings.prefilterSamples)) << std::fixed << std::setprecision(1)
+				<< std::setw(10) << result.environmentMs + result.irradianceMs + result.prefilterMs << std::setprecision(2)
+				<< std::setw(9) << IBLCache::getMemoryBytes(settings) / (1024.0 * 1024.0) << std::setw(10) << cacheBytes / (1024.0 * 1024.0)
+				<< std::setw(14) << irradianceRMS * 100.0 << std::setw(13) << prefilterRMS * 100.0 << std::endl;
+			// Each tier is bigger or takes more samples than the one below, so it must be closer to the reference
+			double error = irradianceRMS + prefilterRMS;
+			if (i > 0 && error > lastError)
+			{
+				std::cout << "ERROR: The " << IBLCache::getQualityName(quality) << " tier is further from the reference than the tier below" << std::endl;
+				failed = 1;
+			}
+			lastError = error;
+		}
+		std::cout << "Sizes are per face, with the samples per texel after the slash" << std::endl;
+		return failed;
+	}
+
+	// Irradiance map bake with the fixed step hemisphere loop against cosine importance sampling with
+	// mip filtered lookups at 16 to 4096 samples: time and error against a brute force convolution. Finds
+	// the sample count at which importance sampling matches the loop's error and how much cheaper it is
+	// there, and runs the convergence test. Done for Assets/environment.hdr or the sky with its sun, and
+	// for the sky without one
+	inline int irradianceBake()
+	{
+		IBLCache::Settings settings;
+		ThreadPool& pool = ThreadPool::get();
+		int size = settings.irradianceSize;
+		std::cout << "Irradiance map, " << size << "x" << size << " faces, " << pool.getThreadCount() + 1 << " threads, " << IBLBaker::getKernelName() << " kernels" << std::endl;
+		std::vector<IBLBaker::Sample> loop = IBLBaker::buildUniformIrradianceSamples();
+
+		int failed = 0;
+		for (bool sun : { true, false })
+		{
+			IBLBaker::Image image = sun ? loadEnvironment() : makeSky(2048, 1024, false);
+			IBLBaker::CubeMap environment;
+			IBLBaker::bakeEnvironment(image, settings.environmentSize, &pool, environment);
+
+			// The 128x128 level still resolves the sun of the procedural sky
+			const int referenceLevel = 2;
+			IBLBaker::CubeMap reference;
+			double referenceMs = timeMs([&]() { reference = convolveIrradiance(environment, referenceLevel, size, &pool); }, 1);
+			std::cout << std::endl << (sun ? "Environment" : "Sky without the sun") << ", " << image.width << "x" << image.height << ". Reference: every texel of the "
+				<< environment.getLevelSize(referenceLevel) << "x" << environment.getLevelSize(referenceLevel) << " level, " << std::fixed << std::setprecision(0) << referenceMs << " ms" << std::endl;
+			std::cout << std::left << std::setw(36) << "bake" << std::right << std::setw(10) << "samples" << std::setw(10) << "ms" << std::setw(9) << "RMS %"
+				<< std::setw(9) << "max %" << std::setw(10) << "cheaper" << std::endl;
+
+			IBLBaker::CubeMap irradiance;
+			double rms, largest;
+			auto row = [&](const char* name, size_t samples, double ms, double loopMs)
+			{
+				IBLBaker::getRelativeError(irradiance.levels[0], reference.levels[0], rms, largest);
+				std::cout << std::left << std::setw(36) << name << std::right << std::setw(10) << samples << std::fixed << std::setprecision(1) << std::setw(10) << ms
+					<< std::setprecision(2) << std::setw(9) << rms * 100.0 << std::setw(9) << largest * 100.0 << std::setprecision(1) << std::setw(9) << loopMs / ms << "x" << std::endl;
+			};
+
+			double loopMs = timeMs([&]() { IBLBaker::bakeIrradiance(environment, size, loop, IBLBaker::PI / (float)loop.size(), &pool, irradiance); }, 1);
+			row("fixed step loop, level 0", loop.size(), loopMs, loopMs);
+			double loopRMS = rms;
+
+			// Without the mip lookups the samples alias over the level 0 texels
+			std::vector<IBLBaker::Sample> unfiltered = IBLBaker::buildIrradianceSamples(settings.irradianceSamples, settings.environmentSize);
+			for (auto& i : unfiltered)
+			{
+				i.lod = 0.0f;
+			}
+			double ms = timeMs([&]() { IBLBaker::bakeIrradiance(environment, size, unfiltered, 1.0f / unfiltered.size(), &pool, irradiance); }, 1);
+			row("importance sampled, level 0", unfiltered.size(), ms, loopMs);
+
+			uint32_t equalCount = 0;
+			double equalMs = 0.0, settingsRMS = 0.0;
+			for (uint32_t count = 16; count <= 4096; count *= 2)
+			{
+				ms = timeMs([&]() { IBLBaker::bakeIrradiance(environment, size, count, &pool, irradiance); }, count < 1024 ? 3 : 1);
+				row("importance sampled, mip filtered", count, ms, loopMs);
+				if (!equalCount && rms <= loopRMS)
+				{
+					equalCount = count;
+					equalMs = ms;
+				}
+				settingsRMS = count == (uint32_t)settings.irradianceSamples ? rms : settingsRMS;
+			}
+
+			const double tolerance = 0.005;
+			uint32_t converged = IBLBaker::findIrradianceSampleCount(environment, size, tolerance, &pool);
+			std::cout << "Converged at " << converged << " samples: doubling them changes the map by less than " << tolerance * 100.0 << "% RMS" << std::endl;
+			if (equalCount)
+			{
+				std::cout << "Error of the fixed step loop reached at " << equalCount << " samples, " << loopMs / equalMs << "x cheaper" << std::endl;
+			}
+			else
+			{
+				// Cosine sampling doesn't know where a small, very bright light is, only enough samples to land on it help
+				std::cout << "Error of the fixed step loop not reached by 4096 samples" << std::endl;
+			}
+			if (!sun && settingsRMS > loopRMS)
+			{
+				std::cout << "ERROR: The engine's " << settings.irradianceSamples << " samples are less accurate than the fixed step loop" << std::endl;
+				failed = 1;
+			}
+		}
+		return failed;
+	}
+
+	// Spherical harmonics irradiance against the irradiance map convolution: bake time of both on the
+	// CPU, error of SH9 over every texel of the 32x32 map, and the GPU cost per pixel of evaluating SH
+	// versus fetching from the map in the PBR shader
+	inline int shIrradiance()
+	{
+		IBLBaker::Image image = loadEnvironment();
+		IBLCache::Settings settings;
+		ThreadPool& pool = ThreadPool::get();
+		IBLBaker::CubeMap environment, irradiance;
+		IBLBaker::bakeEnvironment(image, settings.environmentSize, &pool, environment);
+		const float* faces = environment.levels[0].data();
+		int size = settings.environmentSize;
+
+		std::cout << "SH9 irradiance of a " << image.width << "x" << image.height << " HDR, " << pool.getThreadCount() + 1 << " threads" << std::endl;
+		std::cout << std::left << std::setw(44) << "bake" << std::right << std::setw(12) << "serial ms" << std::setw(14) << "parallel ms" << std::endl;
+		auto row = [&](const char* name, double serialMs, double parallelMs)
+		{
+			std::cout << std::left << std::setw(44) << name << std::right << std::fixed << std::setprecision(2) << std::setw(12) << serialMs << std::setw(14) << parallelMs << std::endl;
+		};
+		row(("irradiance map convolution, " + std::to_string(settings.irradianceSize) + "x" + std::to_string(settings.irradianceSize)).c_str(),
+			timeMs([&]() { IBLBaker::bakeIrradiance(environment, settings.irradianceSize, (uint32_t)settings.irradianceSamples, nullptr, irradiance); }, 1),
+			timeMs([&]() { IBLBaker::bakeIrradiance(environment, settings.irradianceSize, (uint32_t)settings.irradianceSamples, &pool, irradiance); }, 1));
+		SHIrradiance::Coefficients cube, equirect;
+		row(("SH9 projection of the cube map, " + std::to_string(size) + "x" + std::to_string(size)).c_str(),
+			timeMs([&]() { cube = SHIrradiance::projectCube(faces, size, nullptr); }),
+			timeMs([&]() { cube = SHIrradiance::projectCube(faces, size, &pool); }));
+		row(("SH9 projection of the HDR, " + std::to_string(image.width) + "x" + std::to_string(image.height)).c_str(),
+			timeMs([&]() { equirect = SHIrradiance::projectEquirect(image, nullptr); }),
+			timeMs([&]() { equirect = SHIrradiance::projectEquirect(image, &pool); }));
+
+		// Error over every texel of the map, relative to the mean irradiance
+		int failed = 0;
+		std::cout << std::left << std::setw(44) << "error against the convolution" << std::right << std::setw(12) << "RMS %" << std::setw(14) << "max %" << std::endl;
+		for (auto* coefficients : { &cube, &equirect })
+		{
+			int mapSize = settings.irradianceSize;
+			double sumSquares = 0.0, maxError = 0.0, sum = 0.0;
+			size_t count = (size_t)mapSize * mapSize * 6 * 3;
+			for (int face = 0; face < 6; face++)
+			{
+				for (int y = 0; y < mapSize; y++)
+				{
+					for (int x = 0; x < mapSize; x++)
+					{
+						float d[3], value[3];
+						IBLBaker::getTexelDirection(face, x, y, mapSize, d);
+						SHIrradiance::evaluate(*coefficients, d, value);
+						const float* reference = &irradiance.levels[0][(((size_t)face * mapSize + y) * mapSize + x) * 3];
+						for (int c = 0; c < 3; c++)
+						{
+							double error = std::fabs(value[c] - reference[c]);
+							sumSquares += error * error;
+							maxError = std::max(maxError, error);
+							sum += reference[c];
+						}
+					}
+				}
+			}
+			double mean = sum / count;
+			double rms = 100.0 * std::sqrt(sumSquares / count) / mean;
+			row(coefficients == &cube ? "SH9 from the cube map" : "SH9 from the HDR", rms, 100.0 * maxError / mean);
+		}
+		// How far SH9 is from the convolution depends on the lighting, a small bright sun rings. Both
+		// projections see the same environment though, so they must agree
+		for (int i = 0; i < 9; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				if (std::fabs(cube.c[i][c] - equirect.c[i][c]) > 0.01f * std::fabs(cube.c[0][c]))
+				{
+					std::cout << "ERROR: SH9 of the cube map and of the HDR differ in coefficient " << i << std::endl;
+					failed = 1;
+				}
+			}
+		}
+
+		GLFWwindow* window = createContext();
+		if (!window)
+		{
+			return 1;
+		}
+		{
+			// Full screen quads over a 1024x1024 target with a normal map, so normals differ per pixel
+			const int targetSize = 1024, layers = 16;
+			Quad quad;
+			Mesh mesh(&quad, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(2.0f, 2.0f, 1.0f));
+			Texture albedo((unsigned char)200, (unsigned char)200, (unsigned char)200);
+			Texture orm((unsigned char)255, (unsigned char)200, (unsigned char)0);
+			Texture normal("Assets/normal.png");
+			Material material(glm::vec3(0.0f), 0, 1, 2);
+			PointLight light(glm::vec3(0.0f, 0.0f, 2.0f), 1.0f);
+
+			// The map and SH from the same environment
+			GLuint irradianceMap;
+			glGenTextures(1, &irradianceMap);
+			GLState::get().bindTexture(8, GL_TEXTURE_CUBE_MAP, irradianceMap);
+			int mapSize = settings.irradianceSize;
+			for (int face = 0; face < 6; face++)
+			{
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB16F, mapSize, mapSize, 0, GL_RGB, GL_FLOAT, &irradiance.levels[0][(size_t)face * mapSize * mapSize * 3]);
+			}
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			GLuint shBuffer = SHIrradiance::createBuffer(cube);
+
+			GLuint colour, framebuffer;
+			glGenTextures(1, &colour);
+			GLState::get().bindTexture(0, GL_TEXTURE_2D, colour);
+			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, targetSize, targetSize);
+			glGenFramebuffers(1, &framebuffer);
+			GLState::get().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour, 0);
+			GLState::get().setViewport(0, 0, targetSize, targetSize);
+			GLState::get().setDepthTest(false);
+			albedo.bind(0);
+			orm.bind(1);
+			normal.bind(2);
+
+			std::cout << "PBR shader, " << layers << " full screen layers of " << targetSize << "x" << targetSize << std::endl;
+			std::cout << std::left << std::setw(44) << "diffuse IBL" << std::right << std::setw(12) << "frame ms" << std::setw(14) << "ns/pixel" << std::endl;
+			const ShaderBake::ProgramFiles& orms = ShaderBake::getPermutations()[ShaderBake::PERMUTATION_PBR_ORM];
+			const ShaderBake::ProgramFiles& sh = ShaderBake::getPermutations()[ShaderBake::PERMUTATION_PBR_SH];
+			for (const ShaderBake::ProgramFiles* files : { &orms, &sh })
+			{
+				Shader shader(files->vertexFile, files->fragmentFile, "", files->defines);
+				shader.use();
+				shader.setMat4fv(glm::mat4(1.0f), "ViewMatrix");
+				shader.setMat4fv(glm::mat4(1.0f), "ProjectionMatrix");
+				shader.setVec3f(glm::vec3(0.0f, 0.0f, 1.0f), "cameraPos");
+				shader.set1i(8, "irradianceMap");
+				material.sendToShader(shader);
+				light.sendToShader(shader);
+				auto frame = [&]()
+				{
+					for (int i = 0; i < layers; i++)
+					{
+						mesh.render(&shader);
+					}
+					glFinish();
+				};
+				frame();
+				double frameMs = timeMs(frame, 20);
+				row(files == &sh ? "SH9, 9 multiply adds" : "irradiance map fetch", frameMs, frameMs * 1e6 / ((double)targetSize * targetSize * layers));
+			}
+
+			GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+			glDeleteFramebuffers(1, &framebuffer);
+			GLState::get().forgetTexture(colour);
+			glDeleteTextures(1, &colour);
+			GLState::get().forgetTexture(irradianceMap);
+			glDeleteTextures(1, &irradianceMap);
+			glDeleteBuffers(1, &shBuffer);
+		}
+		destroyContext(window);
+		return failed;
+	}
+
+	// Split sum BRDF: the 512x512 RG16F LUT the engine used to integrate at startup, the shipped 64x64 RG8
+	// table and Karis' analytic fit, each against a 16384 sample reference. Then the GPU cost per pixel
+	// of the LUT fetch and of the fit in the PBR shader. Also checks BRDFLUTData.h is up to date
+	inline int brdf()
+	{
+		ThreadPool& pool = ThreadPool::get();
+		const int referenceSize = 128, startupSize = 512;
+		std::vector<float> reference, startup, generated;
+		double referenceMs = timeMs([&]() { IBLBaker::bakeBRDF(referenceSize, &pool, reference, 16384); }, 1);
+		double startupMs = timeMs([&]() { IBLBaker::bakeBRDF(startupSize, &pool, startup, 1024); }, 1);
+		// As stored in RG16F
+		for (auto& i : startup)
+		{
+			i = halfToFloat(floatToHalf(i));
+		}
+		std::vector<float> shipped = BRDFLUT::getTable();
+
+		int failed = 0;
+		double generateMs = timeMs([&]() { IBLBaker::bakeBRDF(BRDFLUT::SIZE, &pool, generated, BRDFLUT::BAKE_SAMPLES); }, 1);
+		for (size_t i = 0; i < generated.size(); i++)
+		{
+			if (std::lround(std::min(std::max(generated[i], 0.0f), 1.0f) * 255.0f) != BRDFLUT::DATA[i])
+			{
+				std::cout << "ERROR: " << BRDFLUT::DATA_FILE << " doesn't match the bake, run 3DEngine.exe --bake brdf" << std::endl;
+				failed = 1;
+				break;
+			}
+		}
+
+		std::cout << "Split sum BRDF against a " << referenceSize << "x" << referenceSize << " reference of 16384 samples a texel (" << std::fixed << std::setprecision(0)
+			<< referenceMs << " ms), " << pool.getThreadCount() + 1 << " threads" << std::endl;
+		std::cout << std::left << std::setw(36) << "BRDF" << std::right << std::setw(12) << "startup ms" << std::setw(10) << "KB"
+			<< std::setw(10) << "RMS" << std::setw(10) << "max" << std::endl;
+		auto compare = [&](const char* name, double ms, double kilobytes, const std::function<void(float, float, float*)>& lookup)
+		{
+			double sumSquares = 0.0, maxError = 0.0;
+			for (int y = 0; y < referenceSize; y++)
+			{
+				for (int x = 0; x < referenceSize; x++)
+				{
+					float value[2];
+					lookup((x + 0.5f) / referenceSize, (y + 0.5f) / referenceSize, value);
+					for (int c = 0; c < 2; c++)
+					{
+						double error = std::fabs(value[c] - reference[((size_t)y * referenceSize + x) * 2 + c]);
+						sumSquares += error * error;
+						maxError = std::max(maxError, error);
+					}
+				}
+			}
+			double rms = std::sqrt(sumSquares / (referenceSize * referenceSize * 2));
+			std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(1) << std::setw(12) << ms
+				<< std::setw(10) << kilobytes << std::setprecision(4) << std::setw(10) << rms << std::setw(10) << maxError << std::endl;
+			return rms;
+		};
+		compare("512x512 RG16F, 1024 samples", startupMs, startupSize * startupSize * 4 / 1024.0,
+			[&](float nDotV, float roughness, float* out) { BRDFLUT::sample(startup.data(), startupSize, nDotV, roughness, out); });
+		double shippedRms = compare("64x64 RG8 shipped", 0.0, BRDFLUT::SIZE * BRDFLUT::SIZE * 2 / 1024.0,
+			[&](float nDotV, float roughness, float* out) { BRDFLUT::sample(shipped.data(), BRDFLUT::SIZE, nDotV, roughness, out); });
+		compare("Karis analytic fit", 0.0, 0.0, BRDFLUT::approximate);
+		std::cout << "Bake of the shipped table: " << std::setprecision(1) << generateMs << " ms" << std::endl;
+		// Bilinear filtering of the table should stay well inside what 8 bits can show
+		if (shippedRms > 0.005)
+		{
+			std::cout << "ERROR: The shipped table is further from the reference than expected" << std::endl;
+			failed = 1;
+		}
+
+		GLFWwindow* window = createContext();
+		if (!window)
+		{
+			return 1;
+		}
+		{
+			// Full screen quads over a 1024x1024 target with a normal map, so N.V differs per pixel
+			const int targetSize = 1024, layers = 16;
+			Quad quad;
+			Mesh mesh(&quad, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(2.0f, 2.0f, 1.0f));
+			Texture albedo((unsigned char)200, (unsigned char)200, (unsigned char)200);
+			Texture orm((unsigned char)255, (unsigned char)128, (unsigned char)255);
+			Texture normal("Assets/normal.png");
+			Material material(glm::vec3(0.0f), 0, 1, 2);
+			PointLight light(glm::vec3(0.0f, 0.0f, 2.0f), 1.0f);
+			SHIrradiance::Coefficients coefficients = {};
+			GLuint shBuffer = SHIrradiance::createBuffer(coefficients);
+
+			GLuint startupLUT, shippedLUT = BRDFLUT::createTexture();
+			glGenTextures(1, &startupLUT);
+			GLState::get().bindTexture(0, GL_TEXTURE_2D, startupLUT);
+			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, startupSize, startupSize);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, startupSize, startupSize, GL_RG, GL_FLOAT, startup.data());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			GLuint colour, framebuffer;
+			glGenTextures(1, &colour);
+			GLState::get().bindTexture(0, GL_TEXTURE_2D, colour);
+			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, targetSize, targetSize);
+			glGenFramebuffers(1, &framebuffer);
+			GLState::get().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour, 0);
+			GLState::get().setViewport(0, 0, targetSize, targetSize);
+			GLState::get().setDepthTest(false);
+			albedo.bind(0);
+			orm.bind(1);
+			normal.bind(2);
+
+			std::cout << "PBR shader, " << layers << " full screen layers of " << targetSize << "x" << targetSize << std::endl;
+			std::cout << std::left << std::setw(36) << "BRDF" << std::right << std::setw(12) << "frame ms" << std::setw(10) << "ns/pixel" << std::endl;
+			const ShaderBake::ProgramFiles& lut = ShaderBake::getPermutations()[ShaderBake::PERMUTATION_PBR_PROBES];
+			const ShaderBake::ProgramFiles& approx = ShaderBake::getPermutations()[ShaderBake::PERMUTATION_PBR_BRDF_APPROX];
+			struct Variant
+			{
+				const char* name;
+				const ShaderBake::ProgramFiles* files;
+				GLuint texture;
+			};
+			for (const Variant& variant : { Variant{ "512x512 RG16F fetch", &lut, startupLUT }, Variant{ "64x64 RG8 fetch", &lut, shippedLUT }, Variant{ "Karis analytic fit", &approx, 0u } })
+			{
+				Shader shader(variant.files->vertexFile, variant.files->fragmentFile, "", variant.files->defines);
+				shader.use();
+				shader.setMat4fv(glm::mat4(1.0f), "ViewMatrix");
+				shader.setMat4fv(glm::mat4(1.0f), "ProjectionMatrix");
+				shader.setVec3f(glm::vec3(0.0f, 0.0f, 1.0f), "cameraPos");
+				if (variant.texture)
+				{
+					GLState::get().bindTexture(5, GL_TEXTURE_2D, variant.texture);
+					shader.set1i(5, "brdfLUT");
+				}
+				material.sendToShader(shader);
+				light.sendToShader(shader);
+				auto frame = [&]()
+				{
+					for (int i = 0; i < layers; i++)
+					{
+						mesh.render(&shader);
+					}
+					glFinish();
+				};
+				frame();
+				double frameMs = timeMs(frame, 20);
+				std::cout << std::left << std::setw(36) << variant.name << std::right << std::fixed << std::setprecision(2) << std::setw(12) << frameMs
+					<< std::setw(10) << frameMs * 1e6 / ((double)targetSize * targetSize * layers) << std::endl;
+			}
+
+			GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+			glDeleteFramebuffers(1, &framebuffer);
+			GLState::get().forgetTexture(colour);
+			glDeleteTextures(1, &colour);
+			for (GLuint i : { startupLUT, shippedLUT })
+			{
+				GLState::get().forgetTexture(i);
+				glDeleteTextures(1, &i);
+			}
+			glDeleteBuffers(1, &shBuffer);
+		}
+		destroyContext(window);
+		return failed;
+	}
+
+	// Radiance HDR decode with stb_image against HDRFile: serial and on the thread pool, to floats and
+	// to half floats, and in bands of rows the way initIBL uploads it. Uses Assets/environment.hdr, or
+	// writes the procedural sky as an 8192x4096 RLE file when there is none
+	inline int hdrLoad()
+	{
+		std::string fileName = "Assets/environment.hdr";
+		bool written = false;
+		if (!std::ifstream(fileName).good())
+		{
+			fileName = "hdrload_benchmark.hdr";
+			IBLBaker::Image sky = makeSky(8192, 4096);
+			written = stbi_write_hdr(fileName.c_str(), sky.width, sky.height, 3, sky.rgb.data()) != 0;
+			if (!written)
+			{
+				std::cout << "ERROR: Could not write " << fileName << std::endl;
+				return 1;
+			}
+		}
+
+		int failed = 0;
+		{
+			ThreadPool& pool = ThreadPool::get();
+			MappedFile mapped(fileName);
+			double fileMB = mapped.getSize() / (1024.0 * 1024.0);
+			HDRFile reference(fileName);
+			if (!reference.isValid())
+			{
+				std::cout << "ERROR: HDRFile could not read " << fileName << std::endl;
+				return 1;
+			}
+			int width = reference.getWidth(), height = reference.getHeight();
+			size_t values = (size_t)width * height * 3;
+#if defined(ENGINE_F16C)
+			const char* halfs = "F16C";
+#else
+			const char* halfs = "scalar";
+#endif
+			std::cout << "HDR decode of " << fileName << ", " << width << "x" << height << ", " << std::fixed << std::setprecision(1) << fileMB << " MB, "
+				<< pool.getThreadCount() + 1 << " threads, " << halfs << " half conversion" << std::endl;
+			std::cout << std::left << std::setw(40) << "decoder" << std::right << std::setw(10) << "ms" << std::setw(10) << "MB/s"
+				<< std::setw(10) << "MPix/s" << std::setw(14) << "output MB" << std::endl;
+			auto row = [&](const char* name, double ms, double outputBytes)
+			{
+				std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << ms
+					<< std::setw(10) << fileMB / (ms / 1000.0) << std::setw(10) << (width * (double)height) / (ms * 1000.0)
+					<< std::setw(14) << outputBytes / (1024.0 * 1024.0) << std::endl;
+			};
+
+			float* stb = nullptr;
+			row("stb_image stbi_loadf", timeMs([&]()
+			{
+				int w, h, components;
+				stbi_image_free(stb);
+				stb = stbi_loadf(fileName.c_str(), &w, &h, &components, 3);
+			}, 2), values * 4.0);
+			row("HDRFile scanline index", timeMs([&]() { HDRFile file(fileName); }, 3), 0.0);
+			std::vector<float> floats(values);
+			row("HDRFile floats, 1 thread", timeMs([&]() { HDRFile file(fileName); file.readRows(0, height, floats.data()); }, 2), values * 4.0);
+			row("HDRFile floats, thread pool", timeMs([&]() { HDRFile file(fileName); file.readRows(0, height, floats.data(), &pool); }, 3), values * 4.0);
+			std::vector<uint16_t> halfData(values);
+			row("HDRFile halfs, thread pool", timeMs([&]() { HDRFile file(fileName); file.readRows(0, height, halfData.data(), &pool); }, 3), values * 2.0);
+			const int bandRows = 256;
+			std::vector<uint16_t> band((size_t)width * bandRows * 3);
+			row("HDRFile halfs, bands of 256 rows", timeMs([&]()
+			{
+				HDRFile file(fileName);
+				for (int y = 0; y < height; y += bandRows)
+				{
+					file.readRows(y, std::min(bandRows, height - y), band.data(), &pool);
+				}
+			}, 3), band.size() * 2.0);
+
+			// stb_image keeps the top row first, HDRFile gives the bottom row first like GL
+			size_t rowSize = (size_t)width * 3;
+			size_t floatMismatches = 0, halfMismatches = 0;
+			for (int y = 0; stb && y < height; y++)
+			{
+				const float* expected = stb + (size_t)(height - 1 - y) * rowSize;
+				floatMismatches += std::memcmp(expected, &floats[(size_t)y * rowSize], rowSize * sizeof(float)) != 0 ? 1 : 0;
+				for (size_t i = 0; i < rowSize; i++)
+				{
+					halfMismatches += floatToHalf(expected[i]) != halfData[(size_t)y * rowSize + i] ? 1 : 0;
+				}
+			}
+			if (!stb || floatMismatches > 0 || halfMismatches > 0)
+			{
+				std::cout << "ERROR: HDRFile differs from stb_image in " << floatMismatches << " rows of floats and " << halfMismatches << " half floats" << std::endl;
+				failed = 1;
+			}
+			stbi_image_free(stb);
+		}
+		if (written)
+		{
+			std::remove(fileName.c_str());
+		}
+		return failed;
+	}
+
+	// The conversion as CubeMapFS and glGenerateMipmap did it on the GPU: one bilinear lookup at each
+	// level 0 texel centre and 2x2 box mips
+	inline void bakePointEnvironment(const IBLBaker::Image& image, int size, ThreadPool* pool, IBLBaker::CubeMap& cube)
+	{
+		int levels = IBLBaker::getLevelCount(size);
+		IBLBaker::allocate(cube, size, levels);
+		IBLBaker::forEachRow(cube, 0, 1, pool, [&](int, int face, int y)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				float d[3];
+				IBLBaker::getTexelDirection(face, x, y, size, d);
+				IBLBaker::sampleEquirect(image, d, &cube.levels[0][(((size_t)face * size + y) * size + x) * 3]);
+			}
+		});
+		for (int level = 1; level < levels; level++)
+		{
+			int parentSize = cube.getLevelSize(level - 1);
+			IBLBaker::forEachRow(cube, level, 1, pool, [&](int, int face, int y)
+			{
+				int levelSize = cube.getLevelSize(level);
+				for (int x = 0; x < levelSize; x++)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						float sum = 0.0f;
+						for (int j = 0; j < 2; j++)
+						{
+							for (int i = 0; i < 2; i++)
+							{
+								int px = std::min(parentSize - 1, x * 2 + i), py = std::min(parentSize - 1, y * 2 + j);
+								sum += cube.levels[level - 1][(((size_t)face * parentSize + py) * parentSize + px) * 3 + c];
+							}
+						}
+						cube.levels[level][(((size_t)face * levelSize + y) * levelSize + x) * 3 + c] = sum * 0.25f;
+					}
+				}
+			});
+		}
+	}
+
+	// Equirectangular to cube map on the CPU from 2048 and 8192 wide skies: the old point sampled level 0
+	// with box mips against IBLBaker::bakeEnvironment's supersampling and solid angle weighted mips, from
+	// floats and from half floats. Times the engine's map size serial and on the pool. Errors are RMS
+	// relative to references supersampled 32x32 per texel: level 0 of a 256 map, and its level 3 against
+	// a reference built at 32 directly
+	inline int cubeMap()
+	{
+		ThreadPool& pool = ThreadPool::get();
+		IBLCache::Settings settings;
+		const int errorSize = 256, errorLevel = 3, referenceSupersampling = 32;
+		std::cout << "Equirectangular to cube map, " << settings.environmentSize << " faces with " << IBLBaker::getLevelCount(settings.environmentSize) << " levels, "
+			<< pool.getThreadCount() + 1 << " threads, " << IBLBaker::getKernelName() << " kernels" << std::endl;
+		std::cout << std::left << std::setw(12) << "source" << std::setw(26) << "method" << std::right << std::setw(11) << "serial ms" << std::setw(9) << "pool ms"
+			<< std::setw(9) << "speedup" << std::setw(14) << "level 0 RMS %" << std::setw(14) << "level 3 RMS %" << std::endl;
+
+		typedef void (*Bake)(const IBLBaker::Image&, int, ThreadPool*, IBLBaker::CubeMap&);
+		Bake point = bakePointEnvironment;
+		Bake supersampled = [](const IBLBaker::Image& image, int size, ThreadPool* pool, IBLBaker::CubeMap& cube) { IBLBaker::bakeEnvironment(image, size, pool, cube); };
+		int failed = 0;
+		for (int width : { 2048, 8192 })
+		{
+			IBLBaker::Image sky = makeSky(width, width / 2);
+			IBLBaker::Image halfSky;
+			halfSky.width = sky.width;
+			halfSky.height = sky.height;
+			halfSky.halfs.resize(sky.rgb.size());
+			floatsToHalfs(sky.rgb.data(), halfSky.halfs.data(), sky.rgb.size());
+			IBLBaker::CubeMap reference, referenceLevel;
+			IBLBaker::bakeEnvironment(sky, errorSize, &pool, reference, referenceSupersampling);
+			IBLBaker::bakeEnvironment(sky, errorSize >> errorLevel, &pool, referenceLevel, referenceSupersampling);
+
+			int n = IBLBaker::getSupersampling(sky, settings.environmentSize);
+			std::string supersampledName = "supersampled " + std::to_string(n) + "x" + std::to_string(n);
+			struct Method
+			{
+				std::string name;
+				Bake bake;
+				const IBLBaker::Image* image;
+			};
+			const Method methods[] = { { "point, box mips", point, &sky }, { supersampledName, supersampled, &sky }, { supersampledName + ", halfs", supersampled, &halfSky } };
+			double errors[3][2];
+			for (int i = 0; i < 3; i++)
+			{
+				const Method& method = methods[i];
+				IBLBaker::CubeMap cube;
+				double serialMs = timeMs([&]() { method.bake(*method.image, settings.environmentSize, nullptr, cube); }, 1);
+				double poolMs = timeMs([&]() { method.bake(*method.image, settings.environmentSize, &pool, cube); }, 3);
+				method.bake(*method.image, errorSize, &pool, cube);
+				double largest;
+				IBLBaker::getRelativeError(cube.levels[0], reference.levels[0], errors[i][0], largest);
+				IBLBaker::getRelativeError(cube.levels[errorLevel], referenceLevel.levels[0], errors[i][1], largest);
+				std::cout << std::left << std::setw(12) << (std::to_string(sky.width) + "x" + std::to_string(sky.height)) << std::setw(26) << method.name << std::right
+					<< std::fixed << std::setprecision(1) << std::setw(11) << serialMs << std::setw(9) << poolMs << std::setw(8) << serialMs / poolMs << "x"
+					<< std::setprecision(3) << std::setw(14) << errors[i][0] * 100.0 << std::setw(14) << errors[i][1] * 100.0 << std::endl;
+			}
+			// Filtering over the whole texel must beat a lookup at its centre at both levels, from either source
+			for (int i = 1; i < 3; i++)
+			{
+				if (errors[i][0] >= errors[0][0] || errors[i][1] >= errors[0][1])
+				{
+					std::cout << "ERROR: " << methods[i].name << " is no closer to the reference than point sampling for the " << sky.width << " wide sky" << std::endl;
+					failed = 1;
+				}
+			}
+		}
+		return failed;
+	}
+
+	// Runtime environment switch with IBLRebaker at several per frame budgets, and with no budget, which
+	// is the stall of baking it all in one frame. Every frame waits for the GPU, so frame times include
+	// the GPU work. Uses Assets/environment.hdr, or writes the procedural sky as a 4096x2048 file
+	inline int iblRebake()
+	{
+		std::string fileName = "Assets/environment.hdr";
+		bool written = false;
+		if (!std::ifstream(fileName).good())
+		{
+			fileName = "iblrebake_benchmark.hdr";
+			IBLBaker::Image sky = makeSky(4096, 2048);
+			written = stbi_write_hdr(fileName.c_str(), sky.width, sky.height, 3, sky.rgb.data()) != 0;
+			if (!written)
+			{
+				std::cout << "ERROR: Could not write " << fileName << std::endl;
+				return 1;
+			}
+		}
+		GLFWwindow* window = createContext();
+		if (!window)
+		{
+			return 1;
+		}
+		int failed = 0;
+		{
+			const std::vector<ShaderBake::ProgramFiles>& programs = ShaderBake::getPrograms();
+			// Irradiance and Prefiltered Map
+			Shader irradiance(programs[2].vertexFile, programs[2].fragmentFile);
+			Shader prefilter(programs[3].vertexFile, programs[3].fragmentFile);
+
+			// Unit cube around the origin, culling is off so the winding doesn't matter
+			std::vector<float> vertices;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (float side : { -1.0f, 1.0f })
+				{
+					const float corners[6][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { 1, 1 }, { -1, 1 }, { -1, -1 } };
+					for (auto& corner : corners)
+					{
+						float p[3];
+						p[axis] = side;
+						p[(axis + 1) % 3] = corner[0];
+						p[(axis + 2) % 3] = corner[1];
+						vertices.insert(vertices.end(), p, p + 3);
+					}
+				}
+			}
+			GLuint cubeVAO, cubeVBO;
+			glGenVertexArrays(1, &cubeVAO);
+			glGenBuffers(1, &cubeVBO);
+			GLState::get().bindVertexArray(cubeVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+			GLState::get().setCullFace(false);
+			GLState::get().setDepthTest(false);
+
+			IBLCache::Settings settings;
+			IBLRebaker rebaker(&irradiance, &prefilter, settings, true, [&]()
+			{
+				GLState::get().bindVertexArray(cubeVAO);
+				glDrawArrays(GL_TRIANGLES, 0, 36);
+			});
+			std::cout << "Environment switch to " << fileName << ", " << ThreadPool::get().getThreadCount() + 1 << " threads" << std::endl;
+			std::cout << std::left << std::setw(24) << "budget" << std::right << std::setw(10) << "jobs" << std::setw(10) << "frames" << std::setw(12) << "decode ms"
+				<< std::setw(12) << "total ms" << std::setw(14) << "longest ms" << std::setw(12) << "mean ms" << std::endl;
+			// The first run also warms up the shaders and the measured rates
+			for (double budgetMs : { 4.0, 1.0, 2.0, 4.0, 8.0, 1e9 })
+			{
+				double start = IBLBaker::getTimeMs(), longestMs = 0.0, jobsMs = 0.0;
+				rebaker.start(fileName);
+				bool ready = false;
+				while (rebaker.isBusy() && !ready)
+				{
+					double frameStart = IBLBaker::getTimeMs();
+					ready = rebaker.update(budgetMs);
+					glFinish();
+					double frameMs = IBLBaker::getTimeMs() - frameStart;
+					// Frames before the decode finishes run no jobs
+					if (rebaker.getStats().jobCount > 0)
+					{
+						longestMs = std::max(longestMs, frameMs);
+						jobsMs += frameMs;
+					}
+				}
+				if (!ready)
+				{
+					std::cout << "ERROR: Could not rebake from " << fileName << std::endl;
+					failed = 1;
+					break;
+				}
+				IBLRebaker::Stats stats = rebaker.getStats();
+				IBLCache::Maps maps;
+				SHIrradiance::Coefficients coefficients;
+				rebaker.take(maps, coefficients);
+				for (GLuint texture : { maps.environment, maps.irradiance, maps.prefilter })
+				{
+					GLState::get().forgetTexture(texture);
+					glDeleteTextures(1, &texture);
+				}
+				std::string name = budgetMs > 1e6 ? "none (one frame)" : std::to_string((int)budgetMs) + " ms";
+				std::cout << std::left << std::setw(24) << name << std::right << std::setw(10) << stats.jobCount << std::setw(10) << stats.frames << std::fixed << std::setprecision(1)
+					<< std::setw(12) << stats.decodeMs << std::setw(12) << IBLBaker::getTimeMs() - start << std::setprecision(2) << std::setw(14) << longestMs
+					<< std::setw(12) << jobsMs / std::max(1u, stats.frames) << std::endl;
+			}
+			GLState::get().forgetVertexArray(cubeVAO);
+			glDeleteVertexArrays(1, &cubeVAO);
+			glDeleteBuffers(1, &cubeVBO);
+		}
+		destroyContext(window);
+		if (written)
+		{
+			std::remove(fileName.c_str());
+		}
+		return failed;
+	}
+
+	// Run a benchmark by name, returns the process exit code
+	inline int run(const std::string& name)
+	{
+		if (name == "renderqueue")
+		{
+			return renderQueue();
+		}
+		if (name == "shadercompile")
+		{
+			return shaderCompile();
+		}
+		if (name == "texturecompress")
+		{
+			return textureCompress();
+		}
+		if (name == "mipgen")
+		{
+			return mipGeneration();
+		}
+		if (name == "textureload")
+		{
+			return textureLoad();
+		}
+		if (name == "virtualtexture")
+		{
+			return virtualTexture();
+		}
+		if (name == "texturestreaming")
+		{
+			return textureStreaming();
+		}
+		if (name == "materials")
+		{
+			return materials();
+		}
+		if (name == "iblbake")
+		{
+			return iblBake();
+		}
+		if (name == "irradiance")
+		{
+			return irradianceBake();
+		}
+		if (name == "shirradiance")
+		{
+			return shIrradiance();
+		}
+		if (name == "iblrebake")
+		{
+			return iblRebake();
+		}
+		if (name == "hdrload")
+		{
+			return hdrLoad();
+		}
+		if (name == "brdf")
+		{
+			return brdf();
+		}
+		if (name == "iblquality")
+		{
+			return iblQuality();
+		}
+		if (name == "cubemap")
+		{
+			return cubeMap();
+		}
+		std::cout << "ERROR: Unknown benchmark: " << name << std::endl;
+		std::cout << "Available: renderqueue, shadercompile, texturecompress, mipgen, textureload, virtualtexture, texturestreaming, materials, iblbake, irradiance, shirradiance, hdrload, iblrebake, brdf, iblquality, cubemap" << std::endl;
+		return 1;
+	}
+}
@@ -5,6 +5,9 @@ in vec3 position;
 
 uniform samplerCube environmentMap;
 uniform float roughness;
+// GGX samples per texel and the size of environmentMap level 0
+uniform int sampleCount;
+uniform float environmentSize;
 
 const float PI = 3.14159265359;
 
@@ -63,7 +66,7 @@ void main()
 	vec3 N = normalize(position);
 	vec3 V = N;
 	// Samples in hemisphere around normal
-	const uint SAMPLE_COUNT = 1024u;
+	uint SAMPLE_COUNT = uint(sampleCount);
 	float totalWeight = 0.0f;
 	vec3 prefilteredColor = vec3(0.0f);
 
@@ -83,8 +86,7 @@ void main()
 			float VdotH = max(dot(V, H), 0.0f);
 			float pdf = D * NdotH / (4.0f * VdotH) + 0.0001f;
 
-			float resolution = 512.0f; // source cubemap resolution
-			float saTexel = 4.0f * PI / (6.0f * resolution * resolution);
+			float saTexel = 4.0f * PI / (6.0f * environmentSize * environmentSize);
 			float saSample = 1.0f / (float(SAMPLE_COUNT) * pdf + 0.0001);
 
 			float mipLevel = roughness == 0.0f ? 0.0f : 0.5f * log2(saSample / saTexel);
@@ -53,21 +53,28 @@ void APIENTRY glDebugOutput(GLenum source,
 // Window size
 void framebuffer_resize_callback(GLFWwindow* window, int fbW, int fbH)
 {
-	glViewport(0, 0, fbW, fbH);
+	GLState::get().setViewport(0, 0, fbW, fbH);
 };
 
 // Enums for easy tracking of multiple shaders, texture, materials etc...
-enum shader_enum{SHADER_CORE_PROGRAM = 0, SHADER_CORE_BLINN, SHADER_EQUIRECTANGULAR_TO_CUBEMAP, SHADER_IRRADIANCE, SHADER_REFLECTION, SHADER_BRDFLUT, SHADER_SKYBOX};
-enum texture_enum{TEX_CURRENT_A_PBR = 0, TEX_CURRENT_M_PBR, TEX_CURRENT_R_PBR, TEX_CURRENT_N_PBR};
+enum shader_enum{SHADER_CORE_PROGRAM = 0, SHADER_CORE_BLINN, SHADER_IRRADIANCE, SHADER_REFLECTION, SHADER_SKYBOX};
+enum texture_enum{TEX_CURRENT_A_PBR = 0, TEX_CURRENT_M_PBR, TEX_CURRENT_R_PBR, TEX_CURRENT_N_PBR, TEX_CURRENT_ORM_PBR};
 enum material_enum {MATERIAL_1 = 0};
 enum mesh_enum {MESH_QUAD = 0};
 
 class Engine
 {
 public:
-	Engine(const char* title, const int width, const int height, bool resizable)
-		: windowWidth(width), windowHeight(height), camera(glm::vec3(0.0f, 1.0f, 4.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f))
+	Engine(const char* title, const int width, const int height, bool resizable, bool asyncTextures = true, bool shIrradiance = true, bool brdfApprox = false,
+		IBLCache::quality_enum iblQuality = IBLCache::QUALITY_HIGH)
+		: windowWidth(width), windowHeight(height), camera(glm::vec3(0.0f, 1.0f, 4.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f)), textureCache(textureLoader)
 	{
+		this->startTime = std::chrono::steady_clock::now();
+		this->textureLoader.setAsync(asyncTextures);
+		this->shIrradiance = shIrradiance;
+		this->brdfApprox = brdfApprox;
+		this->iblQuality = iblQuality;
+		this->iblSettings = IBLCache::getSettings(iblQuality);
 		this->window = nullptr;
 		this->frameBufferWidth = this->windowWidth;
 		this->frameBufferHeight = this->windowHeight;
@@ -120,7 +127,13 @@ public:
 
 		// Initialise necessary data for rendering
 		this->initMatrices();
+		// The packed texture and the virtual texture pick the PBR shader permutation, so they are looked for first
+		this->ormTexture = TextureBake::findBakedORM("Assets");
+		this->initVirtualTexture();
+		this->initTextureStreamer();
 		this->initShaders();
+		this->initMaterialTable();
+		this->initShaderWatcher();
 		this->initTextures();
 		this->initIBL("Assets/environment.hdr");
 		this->initMaterials();
@@ -135,6 +148,28 @@ public:
 
 	~Engine()
 	{
+		// Stop watching shader files and loading textures
+		this->shaderWatcher.stop();
+		this->textureLoader.stop();
+		delete this->virtualTexture;
+		delete this->textureStreamer;
+		delete this->materialTable;
+		delete this->meshBatch;
+		delete this->tableShader;
+		delete this->feedbackShader;
+		delete this->iblRebaker;
+		delete this->reflectionProbes;
+		delete this->probeShader;
+		delete this->probeSkyboxShader;
+		if (this->shBuffer)
+		{
+			glDeleteBuffers(1, &this->shBuffer);
+		}
+		if (this->brdfLUT)
+		{
+			glDeleteTextures(1, &this->brdfLUT);
+		}
+		glDeleteQueries(2, this->sceneQueries);
 		// Destroy GLFW window
 		glfwDestroyWindow(this->window);
 		glfwTerminate();
@@ -143,10 +178,7 @@ public:
 		{
 			delete this->shaders[i];
 		}
-		for (size_t i = 0; i < this->textures.size(); i++)
-		{
-			delete this->textures[i];
-		}
+		this->textures.clear();
 		for (size_t i = 0; i < this->materials.size(); i++)
 		{
 			delete this->materials[i];
@@ -250,6 +282,47 @@ public:
 	{
 		this->updateDt();
 		this->updateInput();
+		// Swap in any shaders edited on disk
+		this->shaderWatcher.update();
+		// Bake a newly set environment a few jobs at a time, its maps replace the current ones once all are done
+		if (this->iblRebaker->isBusy())
+		{
+			bool ready = this->iblRebaker->update(this->iblRebakeBudgetMs);
+			GLState::get().setViewport(0, 0, this->frameBufferWidth, this->frameBufferHeight);
+			if (ready)
+			{
+				this->swapIBL();
+			}
+		}
+		// One face of a reflection probe captured or prefiltered per frame
+		if (this->reflectionProbes->isCapturing())
+		{
+			this->reflectionProbes->update();
+			GLState::get().setViewport(0, 0, this->frameBufferWidth, this->frameBufferHeight);
+		}
+		// Upload textures that finished decoding
+		if (!this->textureLoader.isIdle())
+		{
+			this->textureLoader.update();
+			if (this->textureLoader.isIdle())
+			{
+				std::cout << "Startup to all textures loaded: " << this->getMsSinceStart() << " ms" << std::endl;
+				// Probes captured so far saw the placeholder textures
+				this->reflectionProbes->recaptureAll();
+			}
+		}
+	}
+	// Light the scene from another HDR. It is decoded in the background and baked over the next frames
+	// within iblRebakeBudgetMs each, the current lighting stays until the new maps are complete
+	void setEnvironment(const std::string& fileName)
+	{
+		this->iblRebaker->start(fileName);
+	}
+	// Place a reflection probe capturing the scene from position, lighting draws that overlap the box.
+	// Returns its index, -1 when no more fit
+	int addReflectionProbe(const glm::vec3& position, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		return this->reflectionProbes->add(position, boxMin, boxMax);
 	}
 	// Render to screen
 	void render()
@@ -259,22 +332,73 @@ public:
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
 
+		// Read the scene time from two frames ago, its result is ready by now
+		if (this->sceneQueryFrame >= 2)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(this->sceneQueries[this->sceneQueryFrame & 1], GL_QUERY_RESULT, &elapsed);
+			this->sceneGpuMs = elapsed / 1000000.0;
+		}
+		glBeginQuery(GL_TIME_ELAPSED, this->sceneQueries[this->sceneQueryFrame & 1]);
+
 		// Clear GL
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
 		// Update uniforms
 		this->updateUniforms();
-		// Render models
+		// Find the virtual texture pages this view needs with a small pass, read back a frame later,
+		// then place the pages streamed in since the last frame
+		if (this->virtualTexture)
+		{
+			this->virtualTexture->beginFeedback(this->frameBufferWidth, this->frameBufferHeight);
+			this->feedbackQueue.begin(this->viewMatrix, this->projectionMatrix, this->camera.getPosition(), this->farPlane);
+			for (auto& i : this->models)
+			{
+				i->submit(this->feedbackQueue, this->feedbackShader);
+			}
+			this->feedbackQueue.sort();
+			this->feedbackQueue.execute();
+			this->virtualTexture->endFeedback(this->frameBufferWidth, this->frameBufferHeight);
+			this->virtualTexture->update();
+			this->virtualTexture->bindPageTable(VIRTUAL_PAGE_TABLE_UNIT);
+		}
+		// Ask for the mip levels each model needs from this view, then upload the ones that arrived
+		if (this->textureStreamer)
+		{
+			this->textureStreamer->beginFrame(this->camera.getPosition(), this->fov, this->frameBufferHeight);
+			for (auto& i : this->models)
+			{
+				i->stream(*this->textureStreamer);
+			}
+			this->textureStreamer->update();
+		}
+		// Queue visible meshes of every model, sort by state and depth then draw. Models whose
+		// materials are in the material table are all drawn by one multi draw instead
+		bool batched = this->materialTable && this->useMaterialTable && this->textureLoader.isIdle();
+		this->renderQueue.begin(this->viewMatrix, this->projectionMatrix, this->camera.getPosition(), this->farPlane);
+		this->meshBatch->begin();
 		for (auto& i : this->models)
 		{
-			//i->render(this->shaders[SHADER_CORE_PROGRAM]);
-			i->renderPBR(this->shaders[SHADER_CORE_PROGRAM]);
+			i->selectProbes(*this->reflectionProbes);
+			if (!batched || !i->submit(*this->meshBatch, *this->materialTable))
+			{
+				i->submit(this->renderQueue, this->shaders[SHADER_CORE_PROGRAM]);
+			}
 		}
-		
+		this->renderQueue.sort();
+		this->renderQueue.execute();
+		if (this->meshBatch->getDrawCount() > 0)
+		{
+			this->materialTable->bind(*this->tableShader);
+			this->meshBatch->draw(this->tableShader);
+		}
+
 		// Render Skybox
 		shaders[SHADER_SKYBOX]->use();
 		renderCube();
+		glEndQuery(GL_TIME_ELAPSED);
+		this->sceneQueryFrame++;
 
 		// Render GUI
 		renderGUI();
@@ -282,12 +406,28 @@ public:
 		/* Swap front and back buffers */
 		glfwSwapBuffers(window);
 		//glFlush();
+		if (!this->firstFrameRendered)
+		{
+			std::cout << "Startup to first frame: " << this->getMsSinceStart() << " ms (" << (this->textureLoader.isIdle() ? "textures loaded" : "textures still loading") << ")" << std::endl;
+			this->firstFrameRendered = true;
+		}
 
-		// Set default GL state
-		glBindVertexArray(0);
-		glUseProgram(0);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		// Close the GL state and uniform write statistics for this frame
+		GLState::get().newFrame();
+		for (auto* i : this->shaders)
+		{
+			i->getReflection().newFrame();
+		}
+		// Validate the PBR program against what was written during the first frame
+		if (!this->shadersValidated)
+		{
+			std::string report = this->shaders[SHADER_CORE_PROGRAM]->getReflection().validate(this->getReservedTextureUnits());
+			if (!report.empty())
+			{
+				std::cout << "Shader validation (" << this->shaders[SHADER_CORE_PROGRAM]->getFragmentFile() << "):" << std::endl << report;
+			}
+			this->shadersValidated = true;
+		}
 	}
 
 	// Renders the GUI
@@ -319,6 +459,55 @@ public:
 			ImGui::ColorEdit3("Colour", (float*)&lightColour);
 			ImGui::SliderFloat("Intensity", &Intensity, 0.0f, 50.0f);
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+			const GLState::Counters& glCalls = GLState::get().getLastFrameCounters();
+			ImGui::Text("GL state calls per frame: %u issued, %u elided", glCalls.issued, glCalls.elided);
+			const RenderQueue::Stats& queueStats = this->renderQueue.getStats();
+			ImGui::Text("Draws: %u submitted, %u culled, %u drawn", queueStats.submitted, queueStats.culled, queueStats.drawn);
+			ImGui::Text("Program changes: %u, material changes: %u", queueStats.programChanges, queueStats.materialChanges);
+			ImGui::Text("Queue sort %.3f ms, execute %.3f ms", queueStats.sortMs, queueStats.executeMs);
+			if (this->materialTable)
+			{
+				ImGui::Checkbox("Material table and multi draw", &this->useMaterialTable);
+				this->materialTable->renderGUI();
+				ImGui::Text("Multi draw: %u draws in 1 call", (unsigned)this->meshBatch->getDrawCount());
+			}
+			ImGui::Text("IBL %.1f ms at startup, %s", this->iblMs, this->iblFromCache ? "loaded from cache" : "environment built on the CPU, convolved on the GPU");
+			ImGui::Text("IBL quality %s: environment %d, prefilter %d at %d samples, irradiance %d at %d samples", IBLCache::getQualityName(this->iblQuality),
+				this->iblSettings.environmentSize, this->iblSettings.prefilterSize, this->iblSettings.prefilterSamples, this->iblSettings.irradianceSize, this->iblSettings.irradianceSamples);
+			static char environmentFile[260] = "Assets/environment.hdr";
+			ImGui::InputText("HDR", environmentFile, sizeof(environmentFile));
+			if (ImGui::Button("Switch environment"))
+			{
+				this->setEnvironment(environmentFile);
+			}
+			ImGui::SliderFloat("Rebake budget ms/frame", &this->iblRebakeBudgetMs, 0.25f, 16.0f);
+			const IBLRebaker::Stats& rebake = this->iblRebaker->getStats();
+			if (this->iblRebaker->isBusy())
+			{
+				ImGui::Text("Rebaking %s: %u/%u jobs, %.2f ms last frame", this->iblRebaker->getFileName().c_str(), rebake.jobsDone, rebake.jobCount, rebake.lastFrameMs);
+			}
+			else if (rebake.frames > 0)
+			{
+				ImGui::Text("Rebaked in %.0f ms over %u frames, longest %.2f ms", rebake.totalMs, rebake.frames, rebake.longestFrameMs);
+			}
+			if (this->shIrradiance)
+			{
+				ImGui::Text("Diffuse IBL: SH9, projected in %.1f ms", this->shMs);
+			}
+			else
+			{
+				ImGui::Text("Diffuse IBL: irradiance cube map");
+			}
+			static float probeExtent = 2.0f;
+			ImGui::SliderFloat("Probe box half size", &probeExtent, 0.5f, 20.0f);
+			if (ImGui::Button("Add reflection probe at camera"))
+			{
+				glm::vec3 position = this->camera.getPosition();
+				this->addReflectionProbe(position, position - glm::vec3(probeExtent), position + glm::vec3(probeExtent));
+			}
+			ImGui::Text("Scene GPU %.3f ms, gamma in %s", this->sceneGpuMs, this->srgbFramebuffer ? "texture and framebuffer hardware" : "shaders");
+			const TextureLoader::Stats& textureStats = this->textureLoader.getStats();
+			ImGui::Text("Textures: %u/%u loaded, decode %.1f ms (all threads), upload %.1f ms", textureStats.uploaded, textureStats.requested, textureStats.decodeMs, textureStats.uploadMs);
 			ImGui::End();
 
 			// CAMERA SETTINGS WINDOW
@@ -388,9 +577,67 @@ public:
 			this->camera.setMoveSpeed(movementSpeed);
 			this->camera.setSens(sensitivity);
 		}
-		// Render GUI
+		// Shader reload status
+		this->shaderWatcher.renderGUI();
+		// Texture cache hits and memory
+		this->textureCache.renderGUI();
+		if (this->virtualTexture)
+		{
+			this->virtualTexture->renderGUI();
+		}
+		if (this->textureStreamer)
+		{
+			this->textureStreamer->renderGUI();
+		}
+		this->reflectionProbes->renderGUI();
+		// Reflected interface and validation report of one program
+		{
+			ImGui::Begin("Shader Validation");
+			if (this->validationNames.size() != this->shaders.size())
+			{
+				this->validationNames.clear();
+				for (auto* i : this->shaders)
+				{
+					this->validationNames.push_back(i->getFragmentFile());
+				}
+			}
+			bool validate = ImGui::Combo("Program", &this->validationShader, [](void* data, int index, const char** text)
+			{
+				*text = (*(std::vector<std::string>*)data)[index].c_str();
+				return true;
+			}, &this->validationNames, (int)this->validationNames.size());
+			validate |= ImGui::Button("Validate");
+			Shader* shader = this->shaders[this->validationShader];
+			// A reload links a new program
+			validate |= shader->getID() != this->validationProgram;
+			ShaderReflection& reflection = shader->getReflection();
+			if (ImGui::CollapsingHeader("Uniforms"))
+			{
+				for (auto& i : reflection.getUniforms())
+				{
+					ImGui::Text("%3d  %-16s %s", i.location, ShaderReflection::getTypeName(i.type), i.name.c_str());
+				}
+			}
+			if (ImGui::CollapsingHeader("Attributes"))
+			{
+				for (auto& i : reflection.getAttributes())
+				{
+					ImGui::Text("%3d  %-16s %s", i.location, ShaderReflection::getTypeName(i.type), i.name.c_str());
+				}
+			}
+			if (validate)
+			{
+				this->validationProgram = shader->getID();
+				this->validationReport = reflection.validate(this->validationShader == SHADER_CORE_PROGRAM ? this->getReservedTextureUnits() : std::map<GLint, std::string>());
+			}
+			ImGui::TextWrapped("%s", this->validationReport.empty() ? "No problems found" : this->validationReport.c_str());
+			ImGui::End();
+		}
+		// Render GUI, its colours are already sRGB so they are written unchanged
 		ImGui::Render();
+		GLState::get().setFramebufferSRGB(false);
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		GLState::get().setFramebufferSRGB(this->srgbFramebuffer);
 	}
 
 private:
@@ -435,45 +682,73 @@ private:
 	
 	//Shaders
 	std::vector<Shader*> shaders;
+	ShaderWatcher shaderWatcher;
+	bool shadersValidated = false;
+	// Shader Validation window, the report is rebuilt on a reload, a new selection or Validate
+	int validationShader = SHADER_CORE_PROGRAM;
+	GLuint validationProgram = 0;
+	std::string validationReport;
+	std::vector<std::string> validationNames;
 	//Textures
-	std::vector<Texture*> textures;
+	TextureLoader textureLoader;
+	TextureCache textureCache;
+	std::vector<TextureHandle> textures;
+	// Baked occlusion/roughness/metallic texture, when empty the separate maps are used
+	std::string ormTexture;
+	// Albedo, ORM and normal map streamed a page at a time, when baked, and the pass that finds the pages
+	VirtualTexture* virtualTexture = nullptr;
+	Shader* feedbackShader = nullptr;
+	RenderQueue feedbackQueue;
+	static const GLint VIRTUAL_PAGE_TABLE_UNIT = 9;
+	// Without a virtual texture, baked albedo, ORM and normal maps stream their mip levels by distance
+	TextureStreamer* textureStreamer = nullptr;
+	std::vector<Texture*> streamedTextures;
+	// Once every texture is loaded, models go through the material table and are drawn in one multi draw
+	MaterialTable* materialTable = nullptr;
+	MeshBatch* meshBatch = nullptr;
+	Shader* tableShader = nullptr;
+	bool useMaterialTable = true;
+	// Back buffer encodes linear colour to sRGB on write
+	bool srgbFramebuffer = false;
+	// GPU time of the scene pass, queries alternate so the result read is a frame old and never stalls
+	GLuint sceneQueries[2] = { 0, 0 };
+	unsigned sceneQueryFrame = 0;
+	double sceneGpuMs = 0.0;
+	// IBL quality tier, the map sizes and sample counts it sets and how long initIBL took, with or without the cache
+	IBLCache::quality_enum iblQuality = IBLCache::QUALITY_HIGH;
+	IBLCache::Settings iblSettings;
+	double iblMs = 0.0;
+	bool iblFromCache = false;
+	// The maps in use, and the environment being baked to replace them with at most this much work a frame
+	IBLCache::Maps iblMaps;
+	IBLRebaker* iblRebaker = nullptr;
+	float iblRebakeBudgetMs = 2.0f;
+	// Diffuse IBL from spherical harmonics instead of the irradiance map, and how long their projection took
+	bool shIrradiance = true;
+	GLuint shBuffer = 0;
+	double shMs = 0.0;
+	// Split sum BRDF from Karis' fit in the shaders instead of the shipped LUT
+	bool brdfApprox = false;
+	GLuint brdfLUT = 0;
+
+	ReflectionProbes* reflectionProbes = nullptr;
+	// PBR and skybox programs drawing probe captures, without tonemapping
+	Shader* probeShader = nullptr;
+	Shader* probeSkyboxShader = nullptr;
+	RenderQueue probeQueue;
+	static const GLint REFLECTION_PROBE_UNIT = 10;
+	// Startup timing
+	std::chrono::steady_clock::time_point startTime;
+	bool firstFrameRendered = false;
 	//Materials
 	std::vector<Material*> materials;
 	//Models
 	std::vector<Model*> models;
+	RenderQueue renderQueue;
 	//Lights
 	std::vector<PointLight*> pointLights;
 
 
-	// Function for rendering BRDFLUT
-	unsigned int quadVAO = 0;
-	unsigned int quadVBO;
-	void renderQuad()
-	{
-		if (quadVAO == 0)
-		{
-			float quadVertices[] = {
-				// positions        // texture Coords
-				-1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-				-1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-				 1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-				 1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-			};
-			// setup plane VAO
-			glGenVertexArrays(1, &quadVAO);
-			glGenBuffers(1, &quadVBO);
-			glBindVertexArray(quadVAO);
-			glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-		}
-		glBindVertexArray(quadVAO);
-		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-		glBindVertexArray(0);
-	}
 	// Function for rendering to Cubemap
 	unsigned int cubeVAO = 0;
 	unsigned int cubeVBO = 0;
@@ -531,7 +806,7 @@ private:
 			glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
 			glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 			// link vertex attributes
-			glBindVertexArray(cubeVAO);
+			GLState::get().bindVertexArray(cubeVAO);
 			glEnableVertexAttribArray(0);
 			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
 			glEnableVertexAttribArray(1);
@@ -539,14 +814,13 @@ private:
 			glEnableVertexAttribArray(2);
 			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			glBindVertexArray(0);
+			GLState::get().bindVertexArray(0);
 		}
 		// render Cube
-		glFrontFace(GL_CW);
-		glBindVertexArray(cubeVAO);
+		GLState::get().frontFace(GL_CW);
+		GLState::get().bindVertexArray(cubeVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glBindVertexArray(0);
-		glFrontFace(GL_CCW);
+		GLState::get().frontFace(GL_CCW);
 	}
 
 	void initGLFW()
@@ -594,6 +868,7 @@ private:
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
 		glfwWindowHint(GLFW_RESIZABLE, resizable);
 		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
+		glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
 
 		this->window = glfwCreateWindow(this->windowWidth, this->windowHeight, title, NULL, NULL);
 
@@ -612,17 +887,29 @@ private:
 
 	void initOpenGLOptions()
 	{
-		glEnable(GL_DEPTH_TEST); // for use of Z coordinate etc..
-		glDepthFunc(GL_LEQUAL); // for skybox to render properly
+		GLState::get().setDepthTest(true); // for use of Z coordinate etc..
+		GLState::get().depthFunc(GL_LEQUAL); // for skybox to render properly
 		glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS); // seamless cubemap sampling for lower mip levels in prefilter map
-		glEnable(GL_CULL_FACE); // for culling unecessary faces
-		glCullFace(GL_BACK); // triangles facing away from camera
-		glFrontFace(GL_CCW); // counter clockwise = forwards face
-		glEnable(GL_BLEND); // for colour blending
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // Fix for wierd blending issue interpreting BRDFLUT r.g channels as alpha 1
+		GLState::get().setCullFace(true); // for culling unecessary faces
+		GLState::get().cullFaceMode(GL_BACK); // triangles facing away from camera
+		GLState::get().frontFace(GL_CCW); // counter clockwise = forwards face
+		GLState::get().setBlend(true); // for colour blending
+		GLState::get().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); // default fill polygon with colour
 
+		// Shaders output linear colour and the blend unit encodes it to sRGB on write. Without an
+		// sRGB capable back buffer the shaders are built with LINEAR_FRAMEBUFFER and encode it themselves
+		GLint encoding = GL_LINEAR;
+		glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding);
+		this->srgbFramebuffer = encoding == GL_SRGB;
+		if (!this->srgbFramebuffer)
+		{
+			std::cout << "Default framebuffer is not sRGB capable, gamma is applied in the shaders" << std::endl;
+		}
+		GLState::get().setFramebufferSRGB(this->srgbFramebuffer);
+		glGenQueries(2, this->sceneQueries);
+
 		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 
 	}
@@ -640,106 +927,352 @@ private:
 
 	void initShaders()
 	{
-		this->shaders.push_back(new Shader("src\\VertexCorePBR.glsl", "src\\FragmentCorePBR.glsl")); // PBR
-		this->shaders.push_back(new Shader("src\\VertexCore.glsl", "src\\FragmentCore.glsl"));	// BlinnPhong
-		this->shaders.push_back(new Shader("src\\CubeMapVS.glsl", "src\\CubeMapFS.glsl"));	// EquirectangularToCubemap (IBL stuff)
-		this->shaders.push_back(new Shader("src\\CubeMapVS.glsl", "src\\IrradianceConvolutionFS.glsl")); // Irradiance (IBL stuff)
-		this->shaders.push_back(new Shader("src\\CubeMapVS.glsl", "src\\CubeMapPrefilterFS.glsl")); // Prefiltered Map (IBL stuff)
-		this->shaders.push_back(new Shader("src\\brdfLUTVS.glsl", "src\\brdfLUTFS.glsl")); // brdfLUT shaders (IBL STUFF)
-		this->shaders.push_back(new Shader("src\\skyboxVS.glsl", "src\\skyboxFS.glsl")); // Skybox (optional)
+		// Baked SPIR-V is used where it is present and up to date, otherwise the GLSL is compiled
+		const std::vector<ShaderBake::ProgramFiles>& programs = ShaderBake::getPrograms();
+		for (size_t i = 0; i < programs.size(); i++)
+		{
+			const ShaderBake::ProgramFiles* files = &programs[i];
+			if (i == SHADER_CORE_PROGRAM && this->virtualTexture)
+			{
+				files = &ShaderBake::getPermutations()[ShaderBake::PERMUTATION_PBR_VIRTUAL];
+			}
+			else if (i == SHADER_CORE_PROGRAM && !this->ormTexture.empty())
+			{
+				files = &ShaderBake::getPermutations()[ShaderBake::PERMUTATION_PBR_ORM];
+			}
+			std::string defines = files->defines;
+			if (this->shIrradiance && i == SHADER_CORE_PROGRAM)
+			{
+				defines += defines.empty() ? "SH_IRRADIANCE" : " SH_IRRADIANCE";
+			}
+			// Reflection probes are captured in HDR, so their programs skip the tonemapping and gamma
+			if (i == SHADER_CORE_PROGRAM || i == SHADER_SKYBOX)
+			{
+				std::string captureDefines = defines.empty() ? "PROBE_CAPTURE" : defines + " PROBE_CAPTURE";
+				if (this->brdfApprox && i == SHADER_CORE_PROGRAM)
+				{
+					captureDefines += " BRDF_APPROX";
+				}
+				Shader* capture = new Shader(files->vertexFile, files->fragmentFile, "", captureDefines.c_str());
+				(i == SHADER_CORE_PROGRAM ? this->probeShader : this->probeSkyboxShader) = capture;
+			}
+			if (i == SHADER_CORE_PROGRAM)
+			{
+				defines += defines.empty() ? "REFLECTION_PROBES" : " REFLECTION_PROBES";
+				if (this->brdfApprox)
+				{
+					defines += " BRDF_APPROX";
+				}
+			}
+			if (!this->srgbFramebuffer && (i == SHADER_CORE_PROGRAM || i == SHADER_SKYBOX))
+			{
+				defines += defines.empty() ? "LINEAR_FRAMEBUFFER" : " LINEAR_FRAMEBUFFER";
+			}
+			this->shaders.push_back(new Shader(files->vertexFile, files->fragmentFile, "", defines.c_str()));
+		}
+		if (this->virtualTexture)
+		{
+			const ShaderBake::ProgramFiles& feedback = ShaderBake::getPermutations()[ShaderBake::PERMUTATION_VIRTUAL_FEEDBACK];
+			this->feedbackShader = new Shader(feedback.vertexFile, feedback.fragmentFile, "", feedback.defines);
+		}
 	}
 
-	void initIBL(const char* fileName)
+	// Material table and the PBR permutation that reads it. Streamed and virtual textures change
+	// while they are drawn, so they keep binding their textures per draw
+	void initMaterialTable()
 	{
-		// Set up Frame buffer
-		unsigned int cubeFBO;
-		unsigned int cubeRBO;
-		glGenFramebuffers(1, &cubeFBO);
-		glGenRenderbuffers(1, &cubeRBO);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
-		glBindRenderbuffer(GL_RENDERBUFFER, cubeRBO);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, cubeRBO);
-
-		int width, height, nrComponents;
+		this->meshBatch = new MeshBatch();
+		if (this->virtualTexture || this->textureStreamer)
+		{
+			return;
+		}
+		this->materialTable = new MaterialTable();
+		std::string defines = this->ormTexture.empty() ? "MATERIAL_TABLE" : ShaderBake::getPermutations()[ShaderBake::PERMUTATION_PBR_TABLE].defines;
+		if (this->materialTable->isBindless())
+		{
+			defines += " BINDLESS_TEXTURES";
+		}
+		if (this->shIrradiance)
+		{
+			defines += " SH_IRRADIANCE";
+		}
+		defines += " REFLECTION_PROBES";
+		if (this->brdfApprox)
+		{
+			defines += " BRDF_APPROX";
+		}
+		if (!this->srgbFramebuffer)
+		{
+			defines += " LINEAR_FRAMEBUFFER";
+		}
+		const ShaderBake::ProgramFiles& files = ShaderBake::getPermutations()[ShaderBake::PERMUTATION_PBR_TABLE];
+		this->tableShader = new Shader(files.vertexFile, files.fragmentFile, "", defines.c_str());
+	}
+	// PBR programs sharing the camera, light and IBL uniforms
+	std::vector<Shader*> getPBRShaders() const
+	{
+		std::vector<Shader*> shaders = { this->shaders[SHADER_CORE_PROGRAM], this->probeShader };
+		if (this->tableShader)
+		{
+			shaders.push_back(this->tableShader);
+		}
+		return shaders;
+	}
 
-		// Load HDR image from file
-		stbi_set_flip_vertically_on_load(true);
-		float* image = stbi_loadf(fileName, &width, &height, &nrComponents, 0);
+	// Use the virtual texture when its layers have been baked with --bake virtual
+	void initVirtualTexture()
+	{
+		std::vector<std::string> layers = TextureBake::findBakedVirtual("Assets");
+		if (layers.empty())
+		{
+			return;
+		}
+		this->virtualTexture = new VirtualTexture(layers);
+		if (!this->virtualTexture->isValid())
+		{
+			delete this->virtualTexture;
+			this->virtualTexture = nullptr;
+		}
+	}
+	// Stream the material textures when all of them are baked with their mip chains
+	void initTextureStreamer()
+	{
+		if (this->virtualTexture || this->ormTexture.empty() || TextureFile::findBaked("Assets/albedo.png").empty() || TextureFile::findBaked("Assets/normal.png").empty())
+		{
+			return;
+		}
+		this->textureStreamer = new TextureStreamer();
+		for (const std::string& i : { std::string("Assets/albedo.png"), this->ormTexture, std::string("Assets/normal.png") })
+		{
+			Texture* texture = this->textureStreamer->load(i);
+			if (!texture)
+			{
+				delete this->textureStreamer;
+				this->textureStreamer = nullptr;
+				this->streamedTextures.clear();
+				return;
+			}
+			this->streamedTextures.push_back(texture);
+		}
+	}
+	// Recompile shaders in the background when their source files are saved
+	void initShaderWatcher()
+	{
+		for (auto* i : this->shaders)
+		{
+			this->shaderWatcher.watch(i);
+		}
+		if (this->feedbackShader)
+		{
+			this->shaderWatcher.watch(this->feedbackShader);
+		}
+		if (this->tableShader)
+		{
+			this->shaderWatcher.watch(this->tableShader);
+		}
+		this->shaderWatcher.watch(this->probeShader);
+		this->shaderWatcher.watch(this->probeSkyboxShader);
+		this->shaderWatcher.start();
+	}
 
-		unsigned int hdrTexture;
-		if (image)
+	// Upload the IBL maps cached for this HDR, or bake them and cache them for the next launch. The environment
+	// cube is built on the CPU, the irradiance and prefilter passes run on the GPU
+	void initIBL(const char* fileName)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::string key = IBLCache::getKey(fileName, this->iblSettings, IBLCache::getShaderFiles());
+		IBLCache::Maps maps;
+		IBLBaker::CubeMap environment;
+		this->iblFromCache = IBLCache::load(fileName, key, this->iblSettings, maps);
+		double saveMs = 0.0;
+		if (!this->iblFromCache)
 		{
-			glGenTextures(1, &hdrTexture);
-			glBindTexture(GL_TEXTURE_2D, hdrTexture);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, image);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			stbi_image_free(image);
+			this->bakeIBL(fileName, maps, environment);
+			auto saveStart = std::chrono::steady_clock::now();
+			IBLCache::save(fileName, key, this->iblSettings, maps);
+			saveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - saveStart).count();
+		}
+		glFinish();
+		this->iblMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (this->iblFromCache)
+		{
+			std::cout << "IBL: " << this->iblMs << " ms, loaded from cache" << std::endl;
 		}
 		else
 		{
-			std::cout << "ERROR: Failed to load texture" << fileName << std::endl;
+			std::cout << "IBL: " << this->iblMs << " ms, environment built on the CPU and convolved on the GPU (" << saveMs << " ms of it writing the cache)" << std::endl;
 		}
 
-		// Create Cubemap texture
-		unsigned int envCubeMap;
-		glGenTextures(1, &envCubeMap);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubeMap);
-		for (unsigned int i = 0; i < 6; ++i)
+		/////////////////////////////////////////////////
+		// BIND AND SET UNIFORMS FOR PBR SHADER /////////
+		/////////////////////////////////////////////////
+		
+		// Bind and set irradiancemap uniform
+		this->shaders[SHADER_CORE_PROGRAM]->use();
+		GLState::get().bindTexture(8, GL_TEXTURE_CUBE_MAP, maps.irradiance);
+		// Bind and set prefiltermap uniform
+		GLState::get().bindTexture(6, GL_TEXTURE_CUBE_MAP, maps.prefilter);
+		// The BRDF LUT doesn't depend on the environment, it ships with the engine
+		if (!this->brdfApprox)
 		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
+			this->brdfLUT = BRDFLUT::createTexture();
+			GLState::get().bindTexture(5, GL_TEXTURE_2D, this->brdfLUT);
+		}
+		for (Shader* i : this->getPBRShaders())
+		{
+			i->set1iUI(8, "irradianceMap");
+			i->set1iUI(6, "prefilterMap");
+			if (!this->brdfApprox)
+			{
+				i->set1iUI(5, "brdfLUT");
+			}
 		}
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		// Projection and view matrix for cubemap faces
-		glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-		glm::mat4 captureViews[] =
-		{
-		   glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		   glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		   glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-		   glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-		   glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		   glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
-		};
-
-		// Render HDR to Cubemap
-		this->shaders[SHADER_EQUIRECTANGULAR_TO_CUBEMAP]->use();
-		this->shaders[SHADER_EQUIRECTANGULAR_TO_CUBEMAP]->set1i(0, "equirectangularMap");
-		this->shaders[SHADER_EQUIRECTANGULAR_TO_CUBEMAP]->setMat4fv(captureProjection, "projection");
-		this->shaders[SHADER_EQUIRECTANGULAR_TO_CUBEMAP]->use();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, hdrTexture);
-		glViewport(0, 0, 512, 512);
-		glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
-		for (unsigned int i = 0; i < 6; ++i)
+		//Bind texture and set uniform for skybox shader
+		this->shaders[SHADER_SKYBOX]->use();
+		GLState::get().bindTexture(7, GL_TEXTURE_CUBE_MAP, maps.environment);
+		this->shaders[SHADER_SKYBOX]->set1iUI(7, "environmentMap");
+		this->probeSkyboxShader->set1iUI(7, "environmentMap");
+
+		if (this->shIrradiance)
 		{
-			this->shaders[SHADER_EQUIRECTANGULAR_TO_CUBEMAP]->setMat4fv(captureViews[i], "view");
-			this->shaders[SHADER_EQUIRECTANGULAR_TO_CUBEMAP]->use();
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubeMap, 0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			renderCube(); // renders a 1x1x1 cube
+			this->initSHIrradiance(maps.environment, environment);
+		}
+		this->iblMaps = maps;
+		this->iblRebaker = new IBLRebaker(this->shaders[SHADER_IRRADIANCE], this->shaders[SHADER_REFLECTION], this->iblSettings, this->shIrradiance, [this]() { this->renderCube(); });
+		this->initReflectionProbes();
+	}
+	// Probes are prefiltered like the global prefilter map and bound next to it
+	void initReflectionProbes()
+	{
+		this->reflectionProbes = new ReflectionProbes(this->shaders[SHADER_REFLECTION], this->iblSettings, REFLECTION_PROBE_UNIT, this->nearPlane, this->farPlane,
+			[this](const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position) { this->renderProbeScene(view, projection, position); },
+			[this]() { this->renderCube(); });
+		this->shaders[SHADER_CORE_PROGRAM]->set1iUI(REFLECTION_PROBE_UNIT, "probeMaps");
+		if (this->tableShader)
+		{
+			this->tableShader->set1iUI(REFLECTION_PROBE_UNIT, "probeMaps");
+		}
+	}
+	// One face of a probe capture: the models and the skybox seen from the probe, in HDR. The camera
+	// uniforms are set again for the frame by updateUniforms
+	void renderProbeScene(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position)
+	{
+		this->probeShader->setMat4fv(view, "ViewMatrix");
+		this->probeShader->setMat4fv(projection, "ProjectionMatrix");
+		this->probeShader->setVec3f(position, "cameraPos");
+		this->probeQueue.begin(view, projection, position, this->farPlane);
+		for (auto& i : this->models)
+		{
+			i->submit(this->probeQueue, this->probeShader);
 		}
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		this->probeQueue.sort();
+		this->probeQueue.execute();
+		this->probeSkyboxShader->setMat4fv(view, "view");
+		this->probeSkyboxShader->setMat4fv(projection, "projection");
+		this->probeSkyboxShader->use();
+		this->renderCube();
+	}
+	// Put the maps of a finished rebake in place of the current ones, all between two frames
+	void swapIBL()
+	{
+		IBLCache::Maps maps = this->iblMaps;
+		SHIrradiance::Coefficients coefficients;
+		this->iblRebaker->take(maps, coefficients);
+		GLState::get().bindTexture(8, GL_TEXTURE_CUBE_MAP, maps.irradiance);
+		GLState::get().bindTexture(6, GL_TEXTURE_CUBE_MAP, maps.prefilter);
+		GLState::get().bindTexture(7, GL_TEXTURE_CUBE_MAP, maps.environment);
+		for (GLuint old : { this->iblMaps.environment, this->iblMaps.irradiance, this->iblMaps.prefilter })
+		{
+			GLState::get().forgetTexture(old);
+			glDeleteTextures(1, &old);
+		}
+		if (this->shBuffer)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, this->shBuffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(coefficients), &coefficients);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+		this->iblMaps = maps;
+		// The sky in the probes is the old one
+		this->reflectionProbes->recaptureAll();
+	}
+	// Project the environment map onto spherical harmonics on the thread pool. A baked map is still on
+	// the CPU in baked, one loaded from the cache is read back
+	void initSHIrradiance(GLuint environment, const IBLBaker::CubeMap& baked)
+	{
+		auto start = std::chrono::steady_clock::now();
+		int size = this->iblSettings.environmentSize;
+		std::vector<float> faces;
+		if (baked.levels.empty())
+		{
+			faces.resize((size_t)size * size * 6 * 3);
+			GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, environment);
+			for (int face = 0; face < 6; face++)
+			{
+				glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB, GL_FLOAT, faces.data() + (size_t)face * size * size * 3);
+			}
+		}
+		double readMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		SHIrradiance::Coefficients coefficients = SHIrradiance::projectCube(baked.levels.empty() ? faces.data() : baked.levels[0].data(), size, &ThreadPool::get());
+		this->shBuffer = SHIrradiance::createBuffer(coefficients);
+		this->shMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "SH irradiance: " << this->shMs << " ms (" << readMs << " ms of it reading the environment map back)" << std::endl;
+	}
 
-		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubeMap);
-		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	// Equirectangular HDR to environment cube map, then the diffuse irradiance and specular prefilter from it.
+	// The environment map and its mips are built on the CPU and kept in environment for the SH projection
+	void bakeIBL(const char* fileName, IBLCache::Maps& maps, IBLBaker::CubeMap& environment)
+	{
+		const IBLCache::Settings& settings = this->iblSettings;
+		// Decode the HDR to half floats and resample it into the cube map on the thread pool, no HDR
+		// texture or capture draws. An HDR that won't load lights the scene black
+		auto hdrStart = std::chrono::steady_clock::now();
+		IBLBaker::Image image;
+		if (IBLBaker::loadHDR(fileName, image, &ThreadPool::get(), true))
+		{
+			double decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - hdrStart).count();
+			IBLBaker::bakeEnvironment(image, settings.environmentSize, &ThreadPool::get(), environment);
+			std::cout << "HDR " << image.width << "x" << image.height << " decoded in " << decodeMs << " ms, environment cube map built on the CPU in "
+				<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - hdrStart).count() - decodeMs << " ms" << std::endl;
+		}
+		else
+		{
+			IBLBaker::allocate(environment, settings.environmentSize, IBLBaker::getLevelCount(settings.environmentSize));
+		}
+		// At 16K the half floats are most of a gigabyte
+		image = IBLBaker::Image();
+
+		// Every level is uploaded, the irradiance and prefilter passes pick a source mip per sample from its pdf
+		std::vector<uint16_t> halfs;
+		IBLCache::MapFile environmentMap = { "environment", true, settings.environmentSize, (int)environment.levels.size() };
+		unsigned int envCubeMap = IBLCache::uploadMap(environmentMap, [&](int level)
+		{
+			halfs = IBLBaker::getHalfs(environment, level);
+			return (const void*)halfs.data();
+		});
+
+		// Set up Frame buffer
+		unsigned int cubeFBO;
+		unsigned int cubeRBO;
+		glGenFramebuffers(1, &cubeFBO);
+		glGenRenderbuffers(1, &cubeRBO);
+
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, cubeRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, settings.irradianceSize, settings.irradianceSize);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, cubeRBO);
+
+		// Projection and view matrix for cubemap faces
+		glm::mat4 captureProjection = IBLRebaker::getCaptureProjection();
 
 		// Create texture for convoluted map
 		unsigned int irradianceMap;
 		glGenTextures(1, &irradianceMap);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+		GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, irradianceMap);
 		for (unsigned int i = 0; i < 6; ++i)
 		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, settings.irradianceSize, settings.irradianceSize, 0, GL_RGB, GL_FLOAT, nullptr);
 		}
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -747,33 +1280,34 @@ private:
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
 
 		// Convolute to create irradiance cubemap
 		this->shaders[SHADER_IRRADIANCE]->set1i(0, "environmentMap");
+		this->shaders[SHADER_IRRADIANCE]->set1i(settings.irradianceSamples, "sampleCount");
+		this->shaders[SHADER_IRRADIANCE]->set1f((float)settings.environmentSize, "environmentSize");
 		this->shaders[SHADER_IRRADIANCE]->setMat4fv(captureProjection, "projection");
 		this->shaders[SHADER_IRRADIANCE]->use();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubeMap);
-		glViewport(0, 0, 32, 32);
-		glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
+		GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, envCubeMap);
+		GLState::get().setViewport(0, 0, settings.irradianceSize, settings.irradianceSize);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
 		for (unsigned int i = 0; i < 6; ++i)
 		{
-			this->shaders[SHADER_IRRADIANCE]->setMat4fv(captureViews[i], "view");
+			this->shaders[SHADER_IRRADIANCE]->setMat4fv(IBLRebaker::getCaptureView(i), "view");
 			this->shaders[SHADER_IRRADIANCE]->use();
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			renderCube();
 		}
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
 		
 		// Create texture for pre filtered cubemap, rescale capture FBO to pre filter scale
 		unsigned int prefilterMap;
 		glGenTextures(1, &prefilterMap);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+		GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, prefilterMap);
 		for (unsigned int i = 0; i < 6; ++i)
 		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, settings.prefilterSize, settings.prefilterSize, 0, GL_RGB, GL_FLOAT, nullptr);
 		}
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -783,27 +1317,28 @@ private:
 		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
 		this->shaders[SHADER_REFLECTION]->set1i(0, "environmentMap");
+		this->shaders[SHADER_REFLECTION]->set1i(settings.prefilterSamples, "sampleCount");
+		this->shaders[SHADER_REFLECTION]->set1f((float)settings.environmentSize, "environmentSize");
 		this->shaders[SHADER_REFLECTION]->setMat4fv(captureProjection, "projection");
 		this->shaders[SHADER_REFLECTION]->use();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubeMap);
-		glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
-		unsigned int maxMipLevels = 5;
+		GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, envCubeMap);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
+		unsigned int maxMipLevels = settings.prefilterLevels;
 		// For each each face of the cube map and each mip level render prefiltered cubemap
 		for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
 		{
-			unsigned int mipWidth = 128 * std::pow(0.5, mip);
-			unsigned int mipHeight = 128 * std::pow(0.5, mip);
+			unsigned int mipWidth = settings.prefilterSize >> mip;
+			unsigned int mipHeight = settings.prefilterSize >> mip;
 			glBindRenderbuffer(GL_RENDERBUFFER, cubeRBO);
 			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-			glViewport(0, 0, mipWidth, mipHeight);
+			GLState::get().setViewport(0, 0, mipWidth, mipHeight);
 
 			float roughness = (float)mip / (float)(maxMipLevels - 1);
 			this->shaders[SHADER_REFLECTION]->set1f(roughness, "roughness");
 			this->shaders[SHADER_REFLECTION]->use();
 			for (unsigned int i = 0; i < 6; ++i)
 			{
-				this->shaders[SHADER_REFLECTION]->setMat4fv(captureViews[i], "view");
+				this->shaders[SHADER_REFLECTION]->setMat4fv(IBLRebaker::getCaptureView(i), "view");
 				this->shaders[SHADER_REFLECTION]->use();
 				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
 				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -811,80 +1346,96 @@ private:
 			}
 		}
 
-		// Create BRDFLUT texture
-		unsigned int brdfLUTTexture;
-		glGenTextures(1, &brdfLUTTexture);
-		GLint swizzleMask[] = { GL_RED, GL_GREEN, GL_BLUE, GL_ONE };
-		glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
-		
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTextureParameteriv(brdfLUTTexture, GL_TEXTURE_SWIZZLE_RGBA, swizzleMask);
+		GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, envCubeMap);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
-		glBindRenderbuffer(GL_RENDERBUFFER, cubeRBO);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
-		// Render BRDFLUT texture
-		glViewport(0, 0, 512, 512);
-		this->shaders[SHADER_BRDFLUT]->use();
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glBlendFunc(GL_ONE, GL_ONE);
-		renderQuad();
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 		// Reset viewport
 		glfwGetFramebufferSize(this->window, &this->frameBufferWidth, &this->frameBufferHeight);
-		glViewport(0, 0, frameBufferWidth, frameBufferHeight);
+		GLState::get().setViewport(0, 0, frameBufferWidth, frameBufferHeight);
 
-		/////////////////////////////////////////////////
-		// BIND AND SET UNIFORMS FOR PBR SHADER /////////
-		/////////////////////////////////////////////////
-		
-		// Bind and set irradiancemap uniform
-		this->shaders[SHADER_CORE_PROGRAM]->use();
-		glActiveTexture(GL_TEXTURE8);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-		this->shaders[SHADER_CORE_PROGRAM]->set1iUI(8, "irradianceMap");
-		// Bind and set prefiltermap uniform
-		glActiveTexture(GL_TEXTURE6);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-		this->shaders[SHADER_CORE_PROGRAM]->set1iUI(6, "prefilterMap");
-
-		// Bind and set BRDFLUT uniform
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-		this->shaders[SHADER_CORE_PROGRAM]->set1iUI(5, "brdfLUT");
-
-		//Bind texture and set uniform for skybox shader
-		this->shaders[SHADER_SKYBOX]->use();
-		glActiveTexture(GL_TEXTURE7);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, envCubeMap);
-		this->shaders[SHADER_SKYBOX]->set1iUI(7, "environmentMap");
+		maps.environment = envCubeMap;
+		maps.irradiance = irradianceMap;
+		maps.prefilter = prefilterMap;
 	}
-	// Load textures
+	// Texture units the IBL maps are bound to in initIBL, material samplers must stay clear of these
+	std::map<GLint, std::string> getReservedTextureUnits() const
+	{
+		std::map<GLint, std::string> units;
+		if (!this->brdfApprox)
+		{
+			units[5] = "brdfLUT";
+		}
+		units[6] = "prefilterMap";
+		units[7] = "environmentMap";
+		units[8] = "irradianceMap";
+		units[REFLECTION_PROBE_UNIT] = "probeMaps";
+		if (this->virtualTexture)
+		{
+			units[VIRTUAL_PAGE_TABLE_UNIT] = "vtPageTable";
+		}
+		return units;
+	}
+	// Load textures, decoded and block compressed in the background with a neutral placeholder shown until each is ready
+	// With a baked ORM texture metalness and roughness come from it instead of their own maps
 	void initTextures()
 	{
-		this->textures.push_back(new Texture("Assets/albedo.png"));
-		this->textures.push_back(new Texture("Assets/metal.png"));
-		this->textures.push_back(new Texture("Assets/rough.png"));
-		this->textures.push_back(new Texture("Assets/normal.png"));
+		this->textures.resize(TEX_CURRENT_ORM_PBR + 1);
+		// The virtual texture and the texture streamer load their own textures
+		if (this->virtualTexture || this->textureStreamer)
+		{
+			return;
+		}
+		this->textures[TEX_CURRENT_A_PBR] = this->textureCache.get("Assets/albedo.png", FORMAT_BC7 | FORMAT_SRGB, 128, 128, 128);
+		if (this->ormTexture.empty())
+		{
+			this->textures[TEX_CURRENT_M_PBR] = this->textureCache.get("Assets/metal.png", FORMAT_BC4, 0, 0, 0);
+			this->textures[TEX_CURRENT_R_PBR] = this->textureCache.get("Assets/rough.png", FORMAT_BC4, 128, 128, 128);
+		}
+		else
+		{
+			this->textures[TEX_CURRENT_ORM_PBR] = this->textureCache.get(this->ormTexture.c_str(), FORMAT_BC7, 255, 128, 0);
+		}
+		this->textures[TEX_CURRENT_N_PBR] = this->textureCache.get("Assets/normal.png", FORMAT_BC5, 128, 128, 255);
+	}
+
+	double getMsSinceStart() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->startTime).count();
 	}
 	// Create a material
 	void initMaterials()
 	{
 		this->materials.clear();
-		this->materials.push_back(new Material(glm::vec3(0.03f), 0, 1, 2, 3));
+		if (this->ormTexture.empty() && !this->virtualTexture)
+		{
+			this->materials.push_back(new Material(glm::vec3(0.03f), 0, 1, 2, 3));
+		}
+		else
+		{
+			this->materials.push_back(new Material(glm::vec3(0.03f), 0, 1, 2));
+		}
 	}
 	// Load model with above material and textures
 	void initModel(const char *filePath)
 	{
-		this->models.push_back(new Model(glm::vec3(0.0f, 0.0f, 0.0f), this->materials[0], this->textures[TEX_CURRENT_A_PBR], this->textures[TEX_CURRENT_M_PBR], this->textures[TEX_CURRENT_R_PBR], this->textures[TEX_CURRENT_N_PBR], filePath));
+		if (this->virtualTexture)
+		{
+			this->models.push_back(new Model(glm::vec3(0.0f, 0.0f, 0.0f), this->materials[0], this->virtualTexture->getAtlas(0), this->virtualTexture->getAtlas(1), this->virtualTexture->getAtlas(2), filePath));
+		}
+		else if (this->textureStreamer)
+		{
+			this->models.push_back(new Model(glm::vec3(0.0f, 0.0f, 0.0f), this->materials[0], this->streamedTextures[0], this->streamedTextures[1], this->streamedTextures[2], filePath));
+		}
+		else if (this->materials[0]->hasPackedORM())
+		{
+			this->models.push_back(new Model(glm::vec3(0.0f, 0.0f, 0.0f), this->materials[0], this->textures[TEX_CURRENT_A_PBR], this->textures[TEX_CURRENT_ORM_PBR], this->textures[TEX_CURRENT_N_PBR], filePath));
+		}
+		else
+		{
+			this->models.push_back(new Model(glm::vec3(0.0f, 0.0f, 0.0f), this->materials[0], this->textures[TEX_CURRENT_A_PBR], this->textures[TEX_CURRENT_M_PBR], this->textures[TEX_CURRENT_R_PBR], this->textures[TEX_CURRENT_N_PBR], filePath));
+		}
 	}
 	// Create lights
 	void initLights()
@@ -900,11 +1451,21 @@ private:
 	// Set View matrix, projection matrix and light uniforms.
 	void initUniforms()
 	{
-		this->shaders[SHADER_CORE_PROGRAM]->setMat4fv(viewMatrix, "ViewMatrix");
-		this->shaders[SHADER_CORE_PROGRAM]->setMat4fv(projectionMatrix, "ProjectionMatrix");
-		for (PointLight* pl : this->pointLights)
+		for (Shader* i : this->getPBRShaders())
 		{
-			pl->sendToShader(*this->shaders[SHADER_CORE_PROGRAM]);
+			i->setMat4fv(viewMatrix, "ViewMatrix");
+			i->setMat4fv(projectionMatrix, "ProjectionMatrix");
+			for (PointLight* pl : this->pointLights)
+			{
+				pl->sendToShader(*i);
+			}
+		}
+		if (this->virtualTexture)
+		{
+			this->virtualTexture->setUniforms(*this->shaders[SHADER_CORE_PROGRAM], VIRTUAL_PAGE_TABLE_UNIT);
+			this->virtualTexture->setUniforms(*this->probeShader, VIRTUAL_PAGE_TABLE_UNIT);
+			this->virtualTexture->setUniforms(*this->feedbackShader, VIRTUAL_PAGE_TABLE_UNIT);
+			this->feedbackShader->set1f(VirtualTexture::getFeedbackLevelBias(), "vtLevelBias");
 		}
 	}
 	// Update above uniforms each frame
@@ -912,19 +1473,26 @@ private:
 	{
 		this->viewMatrix = this->camera.getViewMatix();;
 
-		this->shaders[SHADER_CORE_PROGRAM]->setMat4fv(this->viewMatrix, "ViewMatrix");
-		this->shaders[SHADER_CORE_PROGRAM]->setVec3f(this->camera.getPosition(), "cameraPos");
-		for (PointLight* pl : this->pointLights)
-		{
-			pl->sendToShader(*this->shaders[SHADER_CORE_PROGRAM]);
-		}
-
 		glfwGetFramebufferSize(this->window, &this->frameBufferWidth, &this->frameBufferHeight);
 		
 		projectionMatrix = glm::perspective(glm::radians(fov), static_cast<float>(frameBufferWidth) / frameBufferHeight, nearPlane, farPlane);
-		this->shaders[SHADER_CORE_PROGRAM]->setMat4fv(projectionMatrix, "ProjectionMatrix");
+		for (Shader* i : this->getPBRShaders())
+		{
+			i->setMat4fv(this->viewMatrix, "ViewMatrix");
+			i->setVec3f(this->camera.getPosition(), "cameraPos");
+			for (PointLight* pl : this->pointLights)
+			{
+				pl->sendToShader(*i);
+			}
+			i->setMat4fv(projectionMatrix, "ProjectionMatrix");
+		}
 		this->shaders[SHADER_SKYBOX]->setMat4fv(viewMatrix, "view");
 		this->shaders[SHADER_SKYBOX]->setMat4fv(projectionMatrix, "projection");
+		if (this->feedbackShader)
+		{
+			this->feedbackShader->setMat4fv(this->viewMatrix, "ViewMatrix");
+			this->feedbackShader->setMat4fv(this->projectionMatrix, "ProjectionMatrix");
+		}
 	}
 
 public:
@@ -1,4 +1,7 @@
 #version 440
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
 // PBR FRAGMENT SHADER
 out vec4 fs_color;
 
@@ -12,10 +15,13 @@ struct Material
 {
 	vec3 ambient;
 	sampler2D albedoTex;
+#ifdef ORM_TEXTURE
+	sampler2D ormTex; // Occlusion, roughness, metallic in r, g, b
+#else
 	sampler2D metalTex;
 	sampler2D roughTex;
+#endif
 	sampler2D normTex;
-	sampler2D aoTex;
 };
 
 struct PointLight
@@ -28,15 +34,138 @@ struct PointLight
 	float quadratic;
 };
 
+#ifdef MATERIAL_TABLE
+// Textures of every material in one buffer, indexed by the material of the draw, see MaterialTable.h.
+// Every invocation of a draw reads the same entry
+flat in uint vs_materialID;
+struct MaterialEntry
+{
+#ifdef BINDLESS_TEXTURES
+	// Resident texture handles
+	uvec2 albedoTex;
+	uvec2 ormTex;
+	uvec2 metalTex;
+	uvec2 roughTex;
+	uvec2 normTex;
+#else
+	// Layers in the texture arrays of the same name
+	uint albedoTex;
+	uint ormTex;
+	uint metalTex;
+	uint roughTex;
+	uint normTex;
+#endif
+};
+layout(std430, binding = 2) readonly buffer MaterialTable
+{
+	MaterialEntry materials[];
+};
+#ifndef BINDLESS_TEXTURES
+uniform sampler2DArray albedoTex;
+uniform sampler2DArray ormTex;
+uniform sampler2DArray metalTex;
+uniform sampler2DArray roughTex;
+uniform sampler2DArray normTex;
+#endif
+#else
 uniform Material material;
+#endif
 uniform PointLight pointLight;
 uniform vec3 cameraPos;
+#ifdef SH_IRRADIANCE
+// Irradiance as L2 spherical harmonics with the basis constants folded in, see SHIrradiance.h
+layout(std140, binding = 3) uniform SHIrradiance
+{
+	vec4 shCoefficients[9];
+};
+
+vec3 evaluateSH(vec3 n)
+{
+	vec3 result = shCoefficients[0].rgb;
+	result += shCoefficients[1].rgb * n.y + shCoefficients[2].rgb * n.z + shCoefficients[3].rgb * n.x;
+	result += shCoefficients[4].rgb * (n.x * n.y) + shCoefficients[5].rgb * (n.y * n.z) + shCoefficients[6].rgb * (3.0f * n.z * n.z - 1.0f);
+	result += shCoefficients[7].rgb * (n.x * n.z) + shCoefficients[8].rgb * (n.x * n.x - n.y * n.y);
+	return max(result, vec3(0.0f));
+}
+#else
 uniform samplerCube irradianceMap;
+#endif
 uniform samplerCube prefilterMap;
+#ifdef BRDF_APPROX
+// Karis' analytic fit to the split sum scale and bias to F0, instead of the LUT. See BRDFLUT.h
+vec2 envBRDFApprox(float NdotV, float roughness)
+{
+	const vec4 c0 = vec4(-1.0f, -0.0275f, -0.572f, 0.022f);
+	const vec4 c1 = vec4(1.0f, 0.0425f, 1.04f, -0.04f);
+	vec4 r = roughness * c0 + c1;
+	float a004 = min(r.x * r.x, exp2(-9.28f * NdotV)) * r.x + r.y;
+	return vec2(-1.04f, 1.04f) * a004 + r.zw;
+}
+#else
 uniform sampler2D brdfLUT;
+#endif
+#ifdef REFLECTION_PROBES
+// Local prefiltered cube maps, one layer per probe, see ReflectionProbes.h
+const int MAX_PROBES = 8;
+struct ReflectionProbe
+{
+	vec4 position;
+	vec4 boxMin;
+	vec4 boxMax;
+};
+layout(std140, binding = 4) uniform ReflectionProbes
+{
+	ReflectionProbe probes[MAX_PROBES];
+};
+uniform samplerCubeArray probeMaps;
+// Probes lighting the draw in x and y, their weights in z and w
+#ifdef MATERIAL_TABLE
+flat in vec4 vs_probeBlend;
+#else
+uniform vec4 probeBlend;
+#endif
+
+// Reflection off the probe's box rather than at infinity: R is traced from the fragment to the box
+// and the probe sampled towards where it hits, so nearby walls reflect in the right place
+vec3 sampleProbe(int index, vec3 R, float lod)
+{
+	vec3 toMax = (probes[index].boxMax.xyz - vs_position) / R;
+	vec3 toMin = (probes[index].boxMin.xyz - vs_position) / R;
+	vec3 exits = max(toMax, toMin);
+	float hit = max(min(exits.x, min(exits.y, exits.z)), 0.0f);
+	vec3 direction = vs_position + R * hit - probes[index].position.xyz;
+	return textureLod(probeMaps, vec4(direction, float(index)), lod).rgb;
+}
+#endif
 
 const float PI = 3.14159265359f;
 
+#ifdef VIRTUAL_TEXTURE
+// Material textures are atlases of the resident pages of a virtual texture, see VirtualTexture.h
+uniform usampler2D vtPageTable;
+uniform float vtPages; // Pages per side of level 0
+uniform float vtMaxLevel;
+uniform float vtAtlasSlots; // Pages per side of the atlases
+const float VT_PAGE_SIZE = 128.0f;
+const float VT_PAGE_BORDER = 4.0f;
+const float VT_TILE_SIZE = VT_PAGE_SIZE + 2.0f * VT_PAGE_BORDER;
+
+// Atlas coordinates of uv in the finest resident page at or above the level the derivatives ask for
+vec2 virtualAddress(vec2 uv)
+{
+	vec2 texels = uv * vtPages * VT_PAGE_SIZE;
+	vec2 dx = dFdx(texels);
+	vec2 dy = dFdy(texels);
+	int level = int(clamp(0.5f * log2(max(dot(dx, dx), dot(dy, dy))), 0.0f, vtMaxLevel));
+	vec2 wrapped = fract(uv);
+	int pages = max(int(vtPages) >> level, 1);
+	// Entry: atlas slot in r and g, level of the page it holds in b
+	uvec4 entry = texelFetch(vtPageTable, min(ivec2(wrapped * float(pages)), ivec2(pages - 1)), level);
+	vec2 inPage = fract(wrapped * (vtPages / exp2(float(entry.b))));
+	return (vec2(entry.rg) * VT_TILE_SIZE + VT_PAGE_BORDER + inPage * VT_PAGE_SIZE) / (vtAtlasSlots * VT_TILE_SIZE);
+}
+#endif
+
 float DistributionGGX(float NdotH, float roughness)
 {
 	float a = roughness * roughness;
@@ -64,29 +193,46 @@ vec3 FresnelSchlickRoughness(float HdotV, vec3 baseReflectivity, float roughness
 {
 	return baseReflectivity + (max(vec3(1.0f - roughness), baseReflectivity) - baseReflectivity) * pow(1.0f - HdotV, 5.0f);
 }
-// Custom power function due to some wierd shader compilation issue
-vec3 my_pow(vec3 vec, float expt) {
-	return vec3(pow(vec.x, expt), pow(vec.y, expt), pow(vec.z, expt));
-}
 
 void main()
 {
+#if defined(MATERIAL_TABLE) && defined(BINDLESS_TEXTURES)
+#define MATERIAL_SAMPLE(tex) texture(sampler2D(materials[vs_materialID].tex), vs_texcoord)
+#elif defined(MATERIAL_TABLE)
+#define MATERIAL_SAMPLE(tex) texture(tex, vec3(vs_texcoord, float(materials[vs_materialID].tex)))
+#elif defined(VIRTUAL_TEXTURE)
+	// One page table lookup serves every material texture, the atlases share their layout
+	vec2 vtCoord = virtualAddress(vs_texcoord);
+#define MATERIAL_SAMPLE(tex) textureLod(material.tex, vtCoord, 0.0f)
+#else
+#define MATERIAL_SAMPLE(tex) texture(material.tex, vs_texcoord)
+#endif
 	// Calculate normal, tangent, bitangent
 	vec3 normal = normalize(vs_normal);
 	vec3 tangent = normalize(vs_tangent);
 	tangent = normalize(tangent - dot(tangent, normal) * normal);
 	vec3 bitangent = cross(tangent, normal);
-	vec3 texNorm = texture(material.normTex, vs_texcoord).rgb;
-	texNorm = 2.0 * texNorm - vec3(1.0f);
+	// Normal maps are stored as two channels (BC5), z is rebuilt from the unit length
+	vec2 texNormXY = 2.0 * MATERIAL_SAMPLE(normTex).rg - vec2(1.0f);
+	vec3 texNorm = vec3(texNormXY, sqrt(max(1.0 - dot(texNormXY, texNormXY), 0.0)));
 	// Calculate final normal with respect to normal map
 	mat3 TBN = mat3(tangent, bitangent, normal);
 	vec3 finalNorm = TBN * texNorm;
 	finalNorm = normalize(finalNorm);
 	normal = finalNorm;
-	// Sample from texture maps, Converting albedo to linear space
-	vec3 albedo = my_pow(texture(material.albedoTex, vs_texcoord).rgb, 2.2);
-	float metallic = texture(material.metalTex, vs_texcoord).r;
-	float roughness = texture(material.roughTex, vs_texcoord).r;
+	// Sample from texture maps, albedo is an sRGB texture so it is already linear
+	vec3 albedo = MATERIAL_SAMPLE(albedoTex).rgb;
+#ifdef ORM_TEXTURE
+	// One fetch for all three
+	vec3 orm = MATERIAL_SAMPLE(ormTex).rgb;
+	float occlusion = orm.r;
+	float roughness = orm.g;
+	float metallic = orm.b;
+#else
+	float metallic = MATERIAL_SAMPLE(metalTex).r;
+	float roughness = MATERIAL_SAMPLE(roughTex).r;
+	float occlusion = 1.0f;
+#endif
 
 	vec3 N = normalize(normal);
 	vec3 V = normalize(cameraPos - vs_position);
@@ -124,20 +270,57 @@ void main()
 	// Get ambient light from irradiance map
 	vec3 F2 = FresnelSchlickRoughness(NdotV, baseReflectivity, roughness);
 	vec3 kD2 = (1.0f - F2) * (1.0f - metallic);
+#ifdef SH_IRRADIANCE
+	vec3 diffuse = evaluateSH(N) * albedo * kD2;
+#else
 	vec3 diffuse = texture(irradianceMap, N).rgb * albedo * kD2;
+#endif
 
 	// calculate specular light
 	// combine sample of prefiltered map and BRDF look up texture using the split sum approximation
 	const float MAX_REFLECTION_LOD = 4.0;
-	vec3 prefilteredColor = textureLod(prefilterMap, reflect(-V, N), roughness * MAX_REFLECTION_LOD).rgb;
+	vec3 R = reflect(-V, N);
+	float reflectionLod = roughness * MAX_REFLECTION_LOD;
+#ifdef REFLECTION_PROBES
+#ifdef MATERIAL_TABLE
+	vec4 blend = vs_probeBlend;
+#else
+	vec4 blend = probeBlend;
+#endif
+	// The same for the whole draw, so only draws inside a probe's box pay for it
+	float globalWeight = 1.0f - blend.z - blend.w;
+	vec3 prefilteredColor = vec3(0.0f);
+	if (globalWeight > 0.0f)
+	{
+		prefilteredColor = textureLod(prefilterMap, R, reflectionLod).rgb * globalWeight;
+	}
+	if (blend.z > 0.0f)
+	{
+		prefilteredColor += sampleProbe(int(blend.x), R, reflectionLod) * blend.z;
+	}
+	if (blend.w > 0.0f)
+	{
+		prefilteredColor += sampleProbe(int(blend.y), R, reflectionLod) * blend.w;
+	}
+#else
+	vec3 prefilteredColor = textureLod(prefilterMap, R, reflectionLod).rgb;
+#endif
+#ifdef BRDF_APPROX
+	vec2 brdf = envBRDFApprox(NdotV, roughness);
+#else
 	vec2 brdf = texture(brdfLUT, vec2(NdotV, roughness)).rg;
+#endif
 	vec3 specular2 = prefilteredColor * (F * brdf.r + brdf.g);
 
-	vec3 ambient = diffuse + specular2;
+	vec3 ambient = (diffuse + specular2) * occlusion;
 	vec3 colour = ambient + Lo;
-	// HDR tonemapping
+#ifndef PROBE_CAPTURE
+	// HDR tonemapping, reflection probes capture the radiance before it
 	colour = colour / (colour + vec3(1.0f));
-	// Gamma correction
+#endif
+#ifdef LINEAR_FRAMEBUFFER
+	// Gamma correction, otherwise the sRGB framebuffer encodes on write
 	colour = pow(colour, vec3(1.0f / 2.2f));
+#endif
 	fs_color = vec4(colour, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,321 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// OTHER
+#include <cstring>
+
+// Shadow copy of the GL state the engine touches. Every bind and state change goes through
+// here and is only forwarded to the driver when it actually changes something.
+class GLState
+{
+public:
+	// Per frame call counters
+	struct Counters
+	{
+		unsigned issued;
+		unsigned elided;
+	};
+
+	static const int MAX_TEXTURE_UNITS = 16;
+
+private:
+	// Texture targets tracked per unit
+	enum target_enum { TARGET_2D = 0, TARGET_CUBE, TARGET_2D_ARRAY, TARGET_CUBE_ARRAY, TARGET_COUNT };
+
+	// UNKNOWN forces the next call through, used when something outside the cache may have changed the state
+	static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	GLuint program;
+	GLuint vertexArray;
+	GLuint activeUnit;
+	GLuint textures[MAX_TEXTURE_UNITS][TARGET_COUNT];
+	GLuint drawFramebuffer;
+	GLuint readFramebuffer;
+	GLint viewport[4];
+	GLuint blend;
+	GLuint cullFace;
+	GLuint depthTest;
+	GLuint framebufferSRGB;
+	GLenum blendSrc;
+	GLenum blendDst;
+	GLenum cullMode;
+	GLenum frontFaceMode;
+	GLenum depthFunction;
+	GLuint depthWrite;
+
+	Counters current;
+	Counters lastFrame;
+
+	GLState()
+	{
+		this->current = { 0, 0 };
+		this->lastFrame = { 0, 0 };
+		this->invalidate();
+	}
+
+	// -1 for targets the engine doesn't use, their binds are never cached
+	static int getTargetIndex(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_TEXTURE_2D: return TARGET_2D;
+		case GL_TEXTURE_CUBE_MAP: return TARGET_CUBE;
+		case GL_TEXTURE_2D_ARRAY: return TARGET_2D_ARRAY;
+		case GL_TEXTURE_CUBE_MAP_ARRAY: return TARGET_CUBE_ARRAY;
+		default: return -1;
+		}
+	}
+
+	// Returns true if the cached value differs and has been updated, counting the call either way
+	template<typename T>
+	bool change(T& cached, T value)
+	{
+		if (cached == value)
+		{
+			this->current.elided++;
+			return false;
+		}
+		cached = value;
+		this->current.issued++;
+		return true;
+	}
+
+	void setCapability(GLuint& cached, GLenum cap, bool enabled)
+	{
+		if (this->change(cached, (GLuint)enabled))
+		{
+			if (enabled)
+			{
+				glEnable(cap);
+			}
+			else
+			{
+				glDisable(cap);
+			}
+		}
+	}
+
+	void setActiveUnit(GLuint unit)
+	{
+		if (this->change(this->activeUnit, unit))
+		{
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+	}
+
+public:
+	static GLState& get()
+	{
+		static GLState state;
+		return state;
+	}
+
+	// Forget everything, the next call of each kind goes to the driver
+	void invalidate()
+	{
+		this->program = UNKNOWN;
+		this->vertexArray = UNKNOWN;
+		this->activeUnit = UNKNOWN;
+		for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+		{
+			for (int t = 0; t < TARGET_COUNT; t++)
+			{
+				this->textures[i][t] = UNKNOWN;
+			}
+		}
+		this->drawFramebuffer = UNKNOWN;
+		this->readFramebuffer = UNKNOWN;
+		std::memset(this->viewport, 0xFF, sizeof(this->viewport));
+		this->blend = UNKNOWN;
+		this->cullFace = UNKNOWN;
+		this->depthTest = UNKNOWN;
+		this->framebufferSRGB = UNKNOWN;
+		this->blendSrc = UNKNOWN;
+		this->blendDst = UNKNOWN;
+		this->cullMode = UNKNOWN;
+		this->frontFaceMode = UNKNOWN;
+		this->depthFunction = UNKNOWN;
+		this->depthWrite = UNKNOWN;
+	}
+
+	void useProgram(GLuint id)
+	{
+		if (this->change(this->program, id))
+		{
+			glUseProgram(id);
+		}
+	}
+
+	void bindVertexArray(GLuint id)
+	{
+		if (this->change(this->vertexArray, id))
+		{
+			glBindVertexArray(id);
+		}
+	}
+
+	// Always selects the unit, even when the binding is cached, since callers bind to edit the
+	// texture and glTex* calls act on the active unit. Only the glBindTexture is skipped
+	void bindTexture(GLuint unit, GLenum target, GLuint id)
+	{
+		this->setActiveUnit(unit);
+		int index = getTargetIndex(target);
+		if (index == -1)
+		{
+			this->current.issued++;
+			glBindTexture(target, id);
+			return;
+		}
+		if (this->change(this->textures[unit][index], id))
+		{
+			glBindTexture(target, id);
+		}
+	}
+
+	void bindFramebuffer(GLenum target, GLuint id)
+	{
+		bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+		bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+		if ((!draw || this->drawFramebuffer == id) && (!read || this->readFramebuffer == id))
+		{
+			this->current.elided++;
+			return;
+		}
+		if (draw)
+		{
+			this->drawFramebuffer = id;
+		}
+		if (read)
+		{
+			this->readFramebuffer = id;
+		}
+		this->current.issued++;
+		glBindFramebuffer(target, id);
+	}
+
+	void setViewport(GLint x, GLint y, GLint width, GLint height)
+	{
+		if (this->viewport[0] == x && this->viewport[1] == y && this->viewport[2] == width && this->viewport[3] == height)
+		{
+			this->current.elided++;
+			return;
+		}
+		this->viewport[0] = x;
+		this->viewport[1] = y;
+		this->viewport[2] = width;
+		this->viewport[3] = height;
+		this->current.issued++;
+		glViewport(x, y, width, height);
+	}
+
+	void setBlend(bool enabled)
+	{
+		this->setCapability(this->blend, GL_BLEND, enabled);
+	}
+
+	void setCullFace(bool enabled)
+	{
+		this->setCapability(this->cullFace, GL_CULL_FACE, enabled);
+	}
+
+	void setDepthTest(bool enabled)
+	{
+		this->setCapability(this->depthTest, GL_DEPTH_TEST, enabled);
+	}
+
+	// Linear to sRGB encoding on writes to sRGB colour buffers, other buffers are unaffected
+	void setFramebufferSRGB(bool enabled)
+	{
+		this->setCapability(this->framebufferSRGB, GL_FRAMEBUFFER_SRGB, enabled);
+	}
+
+	void blendFunc(GLenum src, GLenum dst)
+	{
+		if (this->blendSrc == src && this->blendDst == dst)
+		{
+			this->current.elided++;
+			return;
+		}
+		this->blendSrc = src;
+		this->blendDst = dst;
+		this->current.issued++;
+		glBlendFunc(src, dst);
+	}
+
+	void cullFaceMode(GLenum mode)
+	{
+		if (this->change(this->cullMode, mode))
+		{
+			glCullFace(mode);
+		}
+	}
+
+	void frontFace(GLenum mode)
+	{
+		if (this->change(this->frontFaceMode, mode))
+		{
+			glFrontFace(mode);
+		}
+	}
+
+	void depthFunc(GLenum func)
+	{
+		if (this->change(this->depthFunction, func))
+		{
+			glDepthFunc(func);
+		}
+	}
+
+	void depthMask(bool enabled)
+	{
+		if (this->change(this->depthWrite, (GLuint)enabled))
+		{
+			glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+		}
+	}
+
+	// Objects about to be deleted, GL may hand the same name out again
+	void forgetProgram(GLuint id)
+	{
+		if (this->program == id)
+		{
+			this->program = UNKNOWN;
+		}
+	}
+
+	void forgetVertexArray(GLuint id)
+	{
+		if (this->vertexArray == id)
+		{
+			this->vertexArray = UNKNOWN;
+		}
+	}
+
+	void forgetTexture(GLuint id)
+	{
+		for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+		{
+			for (int t = 0; t < TARGET_COUNT; t++)
+			{
+				if (this->textures[i][t] == id)
+				{
+					this->textures[i][t] = UNKNOWN;
+				}
+			}
+		}
+	}
+
+	// Frame boundary, keeps the counters of the frame that just finished
+	void newFrame()
+	{
+		this->lastFrame = this->current;
+		this->current = { 0, 0 };
+	}
+
+	const Counters& getLastFrameCounters() const
+	{
+		return this->lastFrame;
+	}
+};
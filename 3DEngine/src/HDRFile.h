@@ -0,0 +1,340 @@
+#pragma once
+
+// OTHER
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+#include "SIMD.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+
+// Half float bits of a float, rounded to nearest even. Values past the half range clamp to its largest
+// finite value, as a sun too bright for RGB16F should not turn into infinity
+inline uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, 4);
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t exponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+	if (exponent == 0xFF)
+	{
+		return (uint16_t)(sign | (mantissa ? 0x7E00 : 0x7BFF));
+	}
+	int e = (int)exponent - 127 + 15;
+	if (e <= 0)
+	{
+		// Subnormal or zero
+		if (e < -10)
+		{
+			return (uint16_t)sign;
+		}
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - e);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		half += (rest > halfway || (rest == halfway && (half & 1))) ? 1 : 0;
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = e >= 31 ? 0x7C00 : ((uint32_t)e << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1FFF;
+	half += (e < 31 && (rest > 0x1000 || (rest == 0x1000 && (half & 1)))) ? 1 : 0;
+	return (uint16_t)(sign | std::min(half, 0x7BFFu));
+}
+
+// Float of half float bits. Normal halfs just move their exponent and mantissa into place, cheap enough
+// for the per texel fetches of the CPU cube map build
+inline float halfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	if (exponent == 0)
+	{
+		// Subnormal or zero
+		float value = mantissa * 5.96046448e-8f;
+		return sign ? -value : value;
+	}
+	uint32_t bits = sign | (exponent == 31 ? 0x7F800000 | (mantissa << 13) : ((exponent + 112) << 23) | (mantissa << 13));
+	float value;
+	std::memcpy(&value, &bits, 4);
+	return value;
+}
+
+// floatToHalf over an array, 8 values per instruction with F16C. Gives the same bits either way
+inline void floatsToHalfs(const float* in, uint16_t* out, size_t count)
+{
+	size_t i = 0;
+#if defined(ENGINE_F16C)
+	const __m256 largest = _mm256_set1_ps(65504.0f), smallest = _mm256_set1_ps(-65504.0f);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 values = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + i), smallest), largest);
+		_mm_storeu_si128((__m128i*)(out + i), _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = floatToHalf(in[i]);
+	}
+}
+
+// Radiance RGBE (.hdr) image read straight from a memory mapped file. Opening it parses the header
+// and skims the run lengths once to find where every scanline starts. Any band of rows can then be
+// decoded on its own and the rows of a band in parallel, to floats or directly to half floats for a
+// GL_RGB16F upload. A large HDR can so be streamed to the GPU a band at a time, without the whole
+// image ever sitting in memory as floats.
+// Reads the same files as stb_image (32-bit_rle_rgbe, -Y H +X W, flat or new style RLE scanlines)
+// and gives the same floats.
+class HDRFile
+{
+private:
+	MappedFile file;
+	int width;
+	int height;
+	// Offset of every scanline in the file, top row first as stored
+	std::vector<size_t> rowOffsets;
+	// Scanlines are stored as plain RGBE pixels rather than run length encoded
+	bool flat;
+
+	// Next header line, false past the end of the file
+	bool readLine(size_t& offset, std::string& line) const
+	{
+		const unsigned char* data = this->file.getData();
+		size_t size = this->file.getSize();
+		if (offset >= size)
+		{
+			return false;
+		}
+		const unsigned char* end = (const unsigned char*)std::memchr(data + offset, '\n', size - offset);
+		size_t lineEnd = end ? (size_t)(end - data) : size;
+		line.assign((const char*)data + offset, lineEnd - offset);
+		offset = lineEnd + 1;
+		return true;
+	}
+
+	bool readHeader(size_t& offset)
+	{
+		std::string line;
+		if (!this->readLine(offset, line) || (line != "#?RADIANCE" && line != "#?RGBE"))
+		{
+			return false;
+		}
+		bool rgbe = false;
+		while (this->readLine(offset, line) && !line.empty())
+		{
+			rgbe = rgbe || line == "FORMAT=32-bit_rle_rgbe";
+		}
+		if (!rgbe || !this->readLine(offset, line) || line.compare(0, 3, "-Y ") != 0)
+		{
+			return false;
+		}
+		char* token;
+		this->height = (int)std::strtol(line.c_str() + 3, &token, 10);
+		while (*token == ' ')
+		{
+			token++;
+		}
+		if (std::strncmp(token, "+X ", 3) != 0)
+		{
+			return false;
+		}
+		this->width = (int)std::strtol(token + 3, nullptr, 10);
+		return this->width > 0 && this->height > 0;
+	}
+
+	// Find every scanline by walking the run lengths without expanding them
+	bool indexRows(size_t offset)
+	{
+		const unsigned char* data = this->file.getData();
+		size_t size = this->file.getSize();
+		this->rowOffsets.resize(this->height);
+		// Like stb_image: narrow or very wide images and those whose first scanline isn't RLE are flat
+		this->flat = this->width < 8 || this->width >= 32768 || offset + 4 > size || data[offset] != 2 || data[offset + 1] != 2 || (data[offset + 2] & 0x80);
+		if (this->flat)
+		{
+			size_t rowBytes = (size_t)this->width * 4;
+			for (int y = 0; y < this->height; y++)
+			{
+				this->rowOffsets[y] = offset + (size_t)y * rowBytes;
+			}
+			return offset + rowBytes * this->height <= size;
+		}
+		for (int y = 0; y < this->height; y++)
+		{
+			if (offset + 4 > size || data[offset] != 2 || data[offset + 1] != 2 || ((data[offset + 2] << 8) | data[offset + 3]) != this->width)
+			{
+				return false;
+			}
+			this->rowOffsets[y] = offset;
+			offset += 4;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				for (int x = 0; x < this->width;)
+				{
+					if (offset >= size)
+					{
+						return false;
+					}
+					int count = data[offset];
+					// A run is a count past 128 and one value, a dump is a count and that many values
+					offset += count > 128 ? 2 : 1 + (size_t)count;
+					x += count > 128 ? count - 128 : count;
+					if (x > this->width)
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return offset <= size;
+	}
+
+	// Multiplier of the RGB bytes for each shared exponent, the same floats stb_image computes
+	static const float* getExponentScales()
+	{
+		struct Table
+		{
+			float scales[256];
+			Table()
+			{
+				this->scales[0] = 0.0f;
+				for (int e = 1; e < 256; e++)
+				{
+					this->scales[e] = (float)std::ldexp(1.0f, e - (128 + 8));
+				}
+			}
+		};
+		static const Table table;
+		return table.scales;
+	}
+
+	// Floats of one stored scanline, rgb interleaved
+	void decodeRow(int row, unsigned char* rgbe, float* out) const
+	{
+		const float* scales = getExponentScales();
+		const unsigned char* data = this->file.getData() + this->rowOffsets[row];
+		if (this->flat)
+		{
+			std::memcpy(rgbe, data, (size_t)this->width * 4);
+		}
+		else
+		{
+			// Channels are stored one after the other, interleave them while expanding the runs
+			data += 4;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				for (int x = 0; x < this->width;)
+				{
+					int count = *data++;
+					if (count > 128)
+					{
+						unsigned char value = *data++;
+						for (count -= 128; count > 0; count--)
+						{
+							rgbe[(x++) * 4 + channel] = value;
+						}
+					}
+					else
+					{
+						for (; count > 0; count--)
+						{
+							rgbe[(x++) * 4 + channel] = *data++;
+						}
+					}
+				}
+			}
+		}
+		for (int x = 0; x < this->width; x++)
+		{
+			float scale = scales[rgbe[x * 4 + 3]];
+			out[x * 3] = rgbe[x * 4] * scale;
+			out[x * 3 + 1] = rgbe[x * 4 + 1] * scale;
+			out[x * 3 + 2] = rgbe[x * 4 + 2] * scale;
+		}
+	}
+
+	// Rows [first, first + count) counted from the bottom, the way GL and initIBL want them
+	template <typename Output>
+	void decodeRows(int first, int count, ThreadPool* pool, const Output& output) const
+	{
+		auto run = [&](size_t begin, size_t end)
+		{
+			std::vector<unsigned char> rgbe((size_t)this->width * 4);
+			std::vector<float> floats((size_t)this->width * 3);
+			for (size_t i = begin; i < end; i++)
+			{
+				this->decodeRow(this->height - 1 - (first + (int)i), rgbe.data(), floats.data());
+				output(i, floats.data());
+			}
+		};
+		if (pool)
+		{
+			pool->parallelFor((size_t)count, 4, run);
+		}
+		else
+		{
+			run(0, (size_t)count);
+		}
+	}
+
+public:
+	HDRFile(const std::string& fileName)
+		: file(fileName)
+	{
+		this->width = 0;
+		this->height = 0;
+		this->flat = false;
+		size_t offset = 0;
+		if (!this->file.isOpen() || !this->readHeader(offset) || !this->indexRows(offset))
+		{
+			this->width = 0;
+			this->height = 0;
+			this->rowOffsets.clear();
+		}
+	}
+
+	HDRFile(const HDRFile&) = delete;
+	HDRFile& operator=(const HDRFile&) = delete;
+
+	bool isValid() const
+	{
+		return !this->rowOffsets.empty();
+	}
+
+	int getWidth() const
+	{
+		return this->width;
+	}
+
+	int getHeight() const
+	{
+		return this->height;
+	}
+
+	// Decode count rows from first, bottom row first, as RGB floats into out
+	void readRows(int first, int count, float* out, ThreadPool* pool = nullptr) const
+	{
+		size_t rowSize = (size_t)this->width * 3;
+		this->decodeRows(first, count, pool, [&](size_t row, const float* floats)
+		{
+			std::memcpy(out + row * rowSize, floats, rowSize * sizeof(float));
+		});
+	}
+
+	// Decode count rows from first, bottom row first, as RGB half floats into out
+	void readRows(int first, int count, uint16_t* out, ThreadPool* pool = nullptr) const
+	{
+		size_t rowSize = (size_t)this->width * 3;
+		this->decodeRows(first, count, pool, [&](size_t row, const float* floats)
+		{
+			floatsToHalfs(floats, out + row * rowSize, rowSize);
+		});
+	}
+};
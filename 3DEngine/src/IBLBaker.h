@@ -0,0 +1,1003 @@
+#pragma once
+
+// OTHER
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+
+#include "SIMD.h"
+#include "ThreadPool.h"
+#include "IBLCache.h"
+#include "HDRFile.h"
+
+// CPU side of the IBL bake. The environment cube map is built here for the engine too: Engine::bakeIBL
+// and IBLRebaker upload bakeEnvironment's maps, no GPU pass resamples the HDR. The rest is a reference
+// with the maths of IrradianceConvolutionFS and CubeMapPrefilterFS: cosine importance sampled
+// irradiance and GGX importance sampled prefilter with the source mip picked from each sample's pdf.
+// Also integrates the BRDF LUT that BRDFLUT ships.
+// Needs no GPU and gives the same bits on every run and thread count. Writes the IBL cache files, so
+// a build server can bake them with: 3DEngine.exe --bake ibl [file.hdr]
+// Everything a sample needs that doesn't depend on the texel (its tangent space direction, weight and
+// source mip) is computed once per map. The texel loops then run Lanes::COUNT texels at a time in SIMD
+// registers, with the cube map fetches done per lane, and rows of every face and mip are spread over
+// the thread pool.
+namespace IBLBaker
+{
+	// SIMD registers of floats: 8 per AVX2 register, 4 per SSE register, scalar otherwise
+
+#if defined(ENGINE_AVX2)
+	struct Lanes
+	{
+		static const int COUNT = 8;
+		__m256 v;
+		Lanes(__m256 v) : v(v) {}
+		explicit Lanes(float f) : v(_mm256_set1_ps(f)) {}
+		static Lanes load(const float* p) { return _mm256_loadu_ps(p); }
+		void store(float* p) const { _mm256_storeu_ps(p, this->v); }
+	};
+	inline Lanes operator+(Lanes a, Lanes b) { return _mm256_add_ps(a.v, b.v); }
+	inline Lanes operator-(Lanes a, Lanes b) { return _mm256_sub_ps(a.v, b.v); }
+	inline Lanes operator*(Lanes a, Lanes b) { return _mm256_mul_ps(a.v, b.v); }
+	inline Lanes operator/(Lanes a, Lanes b) { return _mm256_div_ps(a.v, b.v); }
+	inline Lanes maxLanes(Lanes a, Lanes b) { return _mm256_max_ps(a.v, b.v); }
+	inline Lanes minLanes(Lanes a, Lanes b) { return _mm256_min_ps(a.v, b.v); }
+	inline Lanes sqrtLanes(Lanes a) { return _mm256_sqrt_ps(a.v); }
+	inline Lanes absLanes(Lanes a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+	// 1 in lanes where a > 0, 0 elsewhere
+	inline Lanes positiveLanes(Lanes a) { return _mm256_and_ps(_mm256_cmp_ps(a.v, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_set1_ps(1.0f)); }
+	// Mask of the lanes where a > b for selectLanes, which takes a where it is set and b elsewhere
+	inline Lanes greaterLanes(Lanes a, Lanes b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+	inline Lanes selectLanes(Lanes mask, Lanes a, Lanes b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+#elif defined(ENGINE_SSE2)
+	struct Lanes
+	{
+		static const int COUNT = 4;
+		__m128 v;
+		Lanes(__m128 v) : v(v) {}
+		explicit Lanes(float f) : v(_mm_set1_ps(f)) {}
+		static Lanes load(const float* p) { return _mm_loadu_ps(p); }
+		void store(float* p) const { _mm_storeu_ps(p, this->v); }
+	};
+	inline Lanes operator+(Lanes a, Lanes b) { return _mm_add_ps(a.v, b.v); }
+	inline Lanes operator-(Lanes a, Lanes b) { return _mm_sub_ps(a.v, b.v); }
+	inline Lanes operator*(Lanes a, Lanes b) { return _mm_mul_ps(a.v, b.v); }
+	inline Lanes operator/(Lanes a, Lanes b) { return _mm_div_ps(a.v, b.v); }
+	inline Lanes maxLanes(Lanes a, Lanes b) { return _mm_max_ps(a.v, b.v); }
+	inline Lanes minLanes(Lanes a, Lanes b) { return _mm_min_ps(a.v, b.v); }
+	inline Lanes sqrtLanes(Lanes a) { return _mm_sqrt_ps(a.v); }
+	inline Lanes absLanes(Lanes a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+	inline Lanes positiveLanes(Lanes a) { return _mm_and_ps(_mm_cmpgt_ps(a.v, _mm_setzero_ps()), _mm_set1_ps(1.0f)); }
+	inline Lanes greaterLanes(Lanes a, Lanes b) { return _mm_cmpgt_ps(a.v, b.v); }
+	inline Lanes selectLanes(Lanes mask, Lanes a, Lanes b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+#else
+	struct Lanes
+	{
+		static const int COUNT = 1;
+		float v;
+		explicit Lanes(float f) : v(f) {}
+		static Lanes load(const float* p) { return Lanes(*p); }
+		void store(float* p) const { *p = this->v; }
+	};
+	inline Lanes operator+(Lanes a, Lanes b) { return Lanes(a.v + b.v); }
+	inline Lanes operator-(Lanes a, Lanes b) { return Lanes(a.v - b.v); }
+	inline Lanes operator*(Lanes a, Lanes b) { return Lanes(a.v * b.v); }
+	inline Lanes operator/(Lanes a, Lanes b) { return Lanes(a.v / b.v); }
+	inline Lanes maxLanes(Lanes a, Lanes b) { return Lanes(std::max(a.v, b.v)); }
+	inline Lanes minLanes(Lanes a, Lanes b) { return Lanes(std::min(a.v, b.v)); }
+	inline Lanes sqrtLanes(Lanes a) { return Lanes(std::sqrt(a.v)); }
+	inline Lanes absLanes(Lanes a) { return Lanes(std::fabs(a.v)); }
+	inline Lanes positiveLanes(Lanes a) { return Lanes(a.v > 0.0f ? 1.0f : 0.0f); }
+	inline Lanes greaterLanes(Lanes a, Lanes b) { return Lanes(a.v > b.v ? 1.0f : 0.0f); }
+	inline Lanes selectLanes(Lanes mask, Lanes a, Lanes b) { return mask.v != 0.0f ? a : b; }
+#endif
+
+	inline const char* getKernelName()
+	{
+#if defined(ENGINE_AVX2)
+		return "AVX2";
+#elif defined(ENGINE_SSE2)
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+
+	const float PI = 3.14159265359f;
+
+	// atan2 of every lane to about 1e-6 radians: a polynomial over the first octant, mirrored into the others
+	inline Lanes atan2Lanes(Lanes y, Lanes x)
+	{
+		Lanes ax = absLanes(x), ay = absLanes(y);
+		Lanes a = minLanes(ax, ay) / maxLanes(maxLanes(ax, ay), Lanes(1e-30f));
+		Lanes s = a * a;
+		Lanes r = (((((Lanes(-0.013480470f) * s + Lanes(0.057477314f)) * s - Lanes(0.121239071f)) * s + Lanes(0.195635925f)) * s - Lanes(0.332994597f)) * s + Lanes(0.999995630f)) * a;
+		r = selectLanes(greaterLanes(ay, ax), Lanes(0.5f * PI) - r, r);
+		r = selectLanes(greaterLanes(Lanes(0.0f), x), Lanes(PI) - r, r);
+		return selectLanes(greaterLanes(Lanes(0.0f), y), Lanes(0.0f) - r, r);
+	}
+
+	// Equirectangular RGB image, bottom row first like GL textures. Texels are floats in rgb, or half
+	// floats in halfs when rgb is empty: the engine decodes to halfs, so a 16K HDR takes 800 MB, not 1.6 GB
+	struct Image
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<float> rgb;
+		std::vector<uint16_t> halfs;
+	};
+
+	// RGB float cube map, each level holds its six faces one after the other in GL face order
+	struct CubeMap
+	{
+		int size = 0;
+		std::vector<std::vector<float>> levels;
+
+		int getLevelSize(int level) const
+		{
+			return std::max(1, this->size >> level);
+		}
+	};
+
+	// Everything bakeIBL makes, plus how long each part took
+	struct Result
+	{
+		CubeMap environment;
+		CubeMap irradiance;
+		CubeMap prefilter;
+		double environmentMs = 0.0;
+		double irradianceMs = 0.0;
+		double prefilterMs = 0.0;
+	};
+
+	inline double getTimeMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Load an HDR bottom row first, as floats or as half floats
+	inline bool loadHDR(const std::string& fileName, Image& image, ThreadPool* pool = nullptr, bool halfs = false)
+	{
+		HDRFile file(fileName);
+		if (!file.isValid())
+		{
+			std::cout << "ERROR: Failed to load texture" << fileName << std::endl;
+			return false;
+		}
+		image.width = file.getWidth();
+		image.height = file.getHeight();
+		if (halfs)
+		{
+			image.halfs.resize((size_t)image.width * image.height * 3);
+			file.readRows(0, image.height, image.halfs.data(), pool);
+		}
+		else
+		{
+			image.rgb.resize((size_t)image.width * image.height * 3);
+			file.readRows(0, image.height, image.rgb.data(), pool);
+		}
+		return true;
+	}
+
+	// Directions
+
+	// Direction through (s, t) in [-1, 1] on a face, as GL lays out cube map faces
+	inline void getFaceDirection(int face, float s, float t, float* d)
+	{
+		switch (face)
+		{
+		case 0: d[0] = 1.0f; d[1] = -t; d[2] = -s; break;
+		case 1: d[0] = -1.0f; d[1] = -t; d[2] = s; break;
+		case 2: d[0] = s; d[1] = 1.0f; d[2] = t; break;
+		case 3: d[0] = s; d[1] = -1.0f; d[2] = -t; break;
+		case 4: d[0] = s; d[1] = -t; d[2] = 1.0f; break;
+		default: d[0] = -s; d[1] = -t; d[2] = -1.0f; break;
+		}
+	}
+
+	inline void getFaceDirection(int face, Lanes s, Lanes t, Lanes& x, Lanes& y, Lanes& z)
+	{
+		Lanes one(1.0f), zero(0.0f);
+		switch (face)
+		{
+		case 0: x = one; y = zero - t; z = zero - s; break;
+		case 1: x = zero - one; y = zero - t; z = s; break;
+		case 2: x = s; y = one; z = t; break;
+		case 3: x = s; y = zero - one; z = zero - t; break;
+		case 4: x = s; y = zero - t; z = one; break;
+		default: x = zero - s; y = zero - t; z = zero - one; break;
+		}
+	}
+
+	// Face a direction points at and where on it, s and t in [0, 1]. The direction needn't be unit length
+	inline int getFace(const float* d, float& s, float& t)
+	{
+		float ax = std::fabs(d[0]), ay = std::fabs(d[1]), az = std::fabs(d[2]);
+		int face;
+		float sc, tc, ma;
+		if (ax >= ay && ax >= az)
+		{
+			face = d[0] > 0.0f ? 0 : 1;
+			sc = d[0] > 0.0f ? -d[2] : d[2];
+			tc = -d[1];
+			ma = ax;
+		}
+		else if (ay >= az)
+		{
+			face = d[1] > 0.0f ? 2 : 3;
+			sc = d[0];
+			tc = d[1] > 0.0f ? d[2] : -d[2];
+			ma = ay;
+		}
+		else
+		{
+			face = d[2] > 0.0f ? 4 : 5;
+			sc = d[2] > 0.0f ? d[0] : -d[0];
+			tc = -d[1];
+			ma = az;
+		}
+		s = 0.5f * (sc / ma + 1.0f);
+		t = 0.5f * (tc / ma + 1.0f);
+		return face;
+	}
+
+	// Unit direction through the centre of a texel
+	inline void getTexelDirection(int face, int x, int y, int size, float* d)
+	{
+		getFaceDirection(face, (x + 0.5f) / size * 2.0f - 1.0f, (y + 0.5f) / size * 2.0f - 1.0f, d);
+		float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		d[0] /= length;
+		d[1] /= length;
+		d[2] /= length;
+	}
+
+	// Solid angle of a cube face texel, from the area element integrated over the face. In doubles, as
+	// the texel is a small difference of large corner values
+	inline float getTexelSolidAngle(int x, int y, int size)
+	{
+		auto area = [](double u, double v) { return std::atan2(u * v, std::sqrt(u * u + v * v + 1.0)); };
+		double u0 = 2.0 * x / size - 1.0, u1 = 2.0 * (x + 1) / size - 1.0;
+		double v0 = 2.0 * y / size - 1.0, v1 = 2.0 * (y + 1) / size - 1.0;
+		return (float)(area(u0, v0) - area(u0, v1) - area(u1, v0) + area(u1, v1));
+	}
+
+	// Sampling
+
+	// Every half float as a float, 256 KB that stay in cache while the texels are looked up in it
+	inline const float* getHalfTable()
+	{
+		static const std::vector<float> table = []()
+		{
+			std::vector<float> values(65536);
+			for (uint32_t i = 0; i < 65536; i++)
+			{
+				values[i] = halfToFloat((uint16_t)i);
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+#if defined(ENGINE_SSE2)
+	// RGB texel in the first three floats of a register, half floats converted 4 at a time with F16C
+	inline __m128 loadTexel(const float* p)
+	{
+		return _mm_setr_ps(p[0], p[1], p[2], 0.0f);
+	}
+
+	inline __m128 loadTexel(const uint16_t* p)
+	{
+#if defined(ENGINE_F16C)
+		int32_t rg;
+		std::memcpy(&rg, p, 4);
+		return _mm_cvtph_ps(_mm_insert_epi16(_mm_cvtsi32_si128(rg), p[2], 2));
+#else
+		const float* table = getHalfTable();
+		return _mm_setr_ps(table[p[0]], table[p[1]], table[p[2]], 0.0f);
+#endif
+	}
+#endif
+
+	inline float toFloat(float value)
+	{
+		return value;
+	}
+
+	inline float toFloat(uint16_t value)
+	{
+		return getHalfTable()[value];
+	}
+
+	// Add weight times the bilinear lookup at texel coordinates (x, y) of an equirectangular image to
+	// sum, which has room for 4 floats. Wraps around in longitude and clamps at the poles
+	template <typename T>
+	inline void fetchEquirect(const T* texels, int width, int height, float x, float y, float weight, float* sum)
+	{
+		int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+		float fx = x - x0, fy = y - y0;
+		x0 = x0 < 0 ? x0 + width : (x0 >= width ? x0 - width : x0);
+		int x1 = x0 + 1 < width ? x0 + 1 : 0;
+		int y1 = std::max(0, std::min(height - 1, y0 + 1));
+		y0 = std::max(0, std::min(height - 1, y0));
+		const T* p00 = texels + ((size_t)y0 * width + x0) * 3;
+		const T* p10 = texels + ((size_t)y0 * width + x1) * 3;
+		const T* p01 = texels + ((size_t)y1 * width + x0) * 3;
+		const T* p11 = texels + ((size_t)y1 * width + x1) * 3;
+#if defined(ENGINE_SSE2)
+		__m128 t00 = loadTexel(p00), t10 = loadTexel(p10), t01 = loadTexel(p01), t11 = loadTexel(p11);
+		__m128 blendX = _mm_set1_ps(fx);
+		__m128 bottom = _mm_add_ps(t00, _mm_mul_ps(_mm_sub_ps(t10, t00), blendX));
+		__m128 top = _mm_add_ps(t01, _mm_mul_ps(_mm_sub_ps(t11, t01), blendX));
+		__m128 value = _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(top, bottom), _mm_set1_ps(fy)));
+		_mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum), _mm_mul_ps(value, _mm_set1_ps(weight))));
+#else
+		for (int c = 0; c < 3; c++)
+		{
+			sum[c] += ((toFloat(p00[c]) * (1.0f - fx) + toFloat(p10[c]) * fx) * (1.0f - fy) + (toFloat(p01[c]) * (1.0f - fx) + toFloat(p11[c]) * fx) * fy) * weight;
+		}
+#endif
+	}
+
+	// Bilinear lookup of the image along a direction: u from the longitude atan2(z, x), v from the latitude
+	inline void sampleEquirect(const Image& image, const float* d, float* out)
+	{
+		float u = std::atan2(d[2], d[0]) * (0.5f / PI) + 0.5f;
+		float v = std::asin(std::max(-1.0f, std::min(1.0f, d[1]))) / PI + 0.5f;
+		float x = u * image.width - 0.5f, y = v * image.height - 0.5f;
+		float sum[4] = {};
+		if (image.rgb.empty())
+		{
+			fetchEquirect(image.halfs.data(), image.width, image.height, x, y, 1.0f, sum);
+		}
+		else
+		{
+			fetchEquirect(image.rgb.data(), image.width, image.height, x, y, 1.0f, sum);
+		}
+		std::memcpy(out, sum, 3 * sizeof(float));
+	}
+
+	// Texel of a face level. One past an edge steps onto the neighbouring face, as seamless cube map filtering does
+	inline const float* getTexel(const float* level, int size, int face, int x, int y)
+	{
+		if (x < 0 || y < 0 || x >= size || y >= size)
+		{
+			float d[3], s, t;
+			getFaceDirection(face, (x + 0.5f) / size * 2.0f - 1.0f, (y + 0.5f) / size * 2.0f - 1.0f, d);
+			face = getFace(d, s, t);
+			x = std::max(0, std::min(size - 1, (int)(s * size)));
+			y = std::max(0, std::min(size - 1, (int)(t * size)));
+		}
+		return level + (((size_t)face * size + y) * size + x) * 3;
+	}
+
+	inline void sampleLevel(const CubeMap& cube, int level, int face, float s, float t, float* out)
+	{
+		int size = cube.getLevelSize(level);
+		const float* data = cube.levels[level].data();
+		float x = s * size - 0.5f, y = t * size - 0.5f;
+		int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+		float fx = x - x0, fy = y - y0;
+		const float* p00 = getTexel(data, size, face, x0, y0);
+		const float* p10 = getTexel(data, size, face, x0 + 1, y0);
+		const float* p01 = getTexel(data, size, face, x0, y0 + 1);
+		const float* p11 = getTexel(data, size, face, x0 + 1, y0 + 1);
+		for (int c = 0; c < 3; c++)
+		{
+			out[c] = (p00[c] * (1.0f - fx) + p10[c] * fx) * (1.0f - fy) + (p01[c] * (1.0f - fx) + p11[c] * fx) * fy;
+		}
+	}
+
+	// Trilinear lookup at lod, clamped to the levels there are
+	inline void sampleCube(const CubeMap& cube, const float* d, float lod, float* out)
+	{
+		float s, t;
+		int face = getFace(d, s, t);
+		lod = std::max(0.0f, std::min((float)cube.levels.size() - 1.0f, lod));
+		int level = (int)lod;
+		float blend = lod - level;
+		sampleLevel(cube, level, face, s, t, out);
+		if (blend > 0.0f)
+		{
+			float upper[3];
+			sampleLevel(cube, level + 1, face, s, t, upper);
+			for (int c = 0; c < 3; c++)
+			{
+				out[c] += (upper[c] - out[c]) * blend;
+			}
+		}
+	}
+
+	// Sample tables
+
+	inline float radicalInverse(uint32_t bits)
+	{
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+		bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+		bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+		return float(bits) * 2.3283064365386963e-10f;
+	}
+
+	// GGX half vector around +z for Hammersley point i of count
+	inline void importanceSampleGGX(uint32_t i, uint32_t count, float roughness, float* h)
+	{
+		float a = roughness * roughness;
+		float phi = 2.0f * PI * ((float)i / (float)count);
+		float xi = radicalInverse(i);
+		float cosTheta = std::sqrt((1.0f - xi) / (1.0f + (a * a - 1.0f) * xi));
+		float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+		h[0] = std::cos(phi) * sinTheta;
+		h[1] = std::sin(phi) * sinTheta;
+		h[2] = cosTheta;
+	}
+
+	// Tangent frame of the GGX shaders around a unit normal
+	inline void getGGXFrame(const float* n, float* tangent, float* bitangent)
+	{
+		float up[3] = { 0.0f, 0.0f, 1.0f };
+		if (std::fabs(n[2]) >= 0.999f)
+		{
+			up[0] = 1.0f;
+			up[2] = 0.0f;
+		}
+		tangent[0] = up[1] * n[2] - up[2] * n[1];
+		tangent[1] = up[2] * n[0] - up[0] * n[2];
+		tangent[2] = up[0] * n[1] - up[1] * n[0];
+		float length = std::sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+		for (int c = 0; c < 3; c++)
+		{
+			tangent[c] /= length;
+		}
+		bitangent[0] = n[1] * tangent[2] - n[2] * tangent[1];
+		bitangent[1] = n[2] * tangent[0] - n[0] * tangent[2];
+		bitangent[2] = n[0] * tangent[1] - n[1] * tangent[0];
+	}
+
+	// A sample direction in the texel's tangent frame, what it is weighted by and the source lod
+	struct Sample
+	{
+		float x, y, z;
+		float weight;
+		float lod;
+	};
+
+	// Cosine weighted hemisphere samples of IrradianceConvolutionFS. The pdf cos(theta) / pi cancels the
+	// cosine, so every sample weighs the same, and the source mip is picked from the pdf as the prefilter does
+	inline std::vector<Sample> buildIrradianceSamples(uint32_t count, int sourceSize)
+	{
+		std::vector<Sample> samples;
+		float saTexel = 4.0f * PI / (6.0f * sourceSize * sourceSize);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float phi = 2.0f * PI * ((float)i / (float)count);
+			float xi = radicalInverse(i);
+			float cosTheta = std::sqrt(1.0f - xi), sinTheta = std::sqrt(xi);
+			float saSample = PI / ((float)count * cosTheta);
+			samples.push_back({ sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta, 1.0f, 0.5f * std::log2(saSample / saTexel) });
+		}
+		return samples;
+	}
+
+	// The fixed step hemisphere loop the irradiance shader ran before, about 15,700 level 0 fetches a texel.
+	// Stepped in floats like it was so the count matches. Only the benchmark's baseline now
+	inline std::vector<Sample> buildUniformIrradianceSamples()
+	{
+		std::vector<Sample> samples;
+		const float sampleDelta = 0.025f;
+		for (float phi = 0.0f; phi < 2.0f * PI; phi += sampleDelta)
+		{
+			for (float theta = 0.0f; theta < 0.5f * PI; theta += sampleDelta)
+			{
+				samples.push_back({ std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta), std::cos(theta) * std::sin(theta), 0.0f });
+			}
+		}
+		return samples;
+	}
+
+	// Light directions of CubeMapPrefilterFS with V = N. Reflecting about H gives L = 2 (N.H) H - N, so
+	// N.L, the pdf and the source mip only depend on the sample and are worked out once here
+	inline std::vector<Sample> buildPrefilterSamples(float roughness, int sourceSize, uint32_t count)
+	{
+		std::vector<Sample> samples;
+		if (roughness == 0.0f)
+		{
+			// Every half vector is N, so is every light direction
+			samples.push_back({ 0.0f, 0.0f, 1.0f, 1.0f, 0.0f });
+			return samples;
+		}
+		float a = roughness * roughness;
+		float a2 = a * a;
+		float saTexel = 4.0f * PI / (6.0f * sourceSize * sourceSize);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float h[3];
+			importanceSampleGGX(i, count, roughness, h);
+			float nDotH = std::max(h[2], 0.0f);
+			float l[3] = { 2.0f * nDotH * h[0], 2.0f * nDotH * h[1], 2.0f * nDotH * h[2] - 1.0f };
+			float nDotL = std::max(l[2], 0.0f);
+			if (nDotL > 0.0f)
+			{
+				float denom = nDotH * nDotH * (a2 - 1.0f) + 1.0f;
+				float d = a2 / (PI * denom * denom);
+				// V.H equals N.H as V = N
+				float pdf = d * nDotH / (4.0f * nDotH) + 0.0001f;
+				float saSample = 1.0f / ((float)count * pdf + 0.0001f);
+				samples.push_back({ l[0], l[1], l[2], nDotL, 0.5f * std::log2(saSample / saTexel) });
+			}
+		}
+		return samples;
+	}
+
+	// Passes
+
+	// Integrate samples for a row of a face level, Lanes::COUNT texels at a time. frame fills each
+	// texel's unit normal and the two axes the tangent space x and y of the samples map to
+	template <typename Frame>
+	inline void integrateRow(const CubeMap& source, const std::vector<Sample>& samples, float scale, int face, int y, int size, const Frame& frame, float* out)
+	{
+		const int COUNT = Lanes::COUNT;
+		for (int x0 = 0; x0 < size; x0 += COUNT)
+		{
+			// Texels past the end of the row repeat the last one and are not written
+			float axes[9][COUNT];
+			for (int lane = 0; lane < COUNT; lane++)
+			{
+				float n[3], t[3], b[3];
+				getTexelDirection(face, std::min(x0 + lane, size - 1), y, size, n);
+				frame(n, t, b);
+				for (int c = 0; c < 3; c++)
+				{
+					axes[c][lane] = t[c];
+					axes[3 + c][lane] = b[c];
+					axes[6 + c][lane] = n[c];
+				}
+			}
+			Lanes tx = Lanes::load(axes[0]), ty = Lanes::load(axes[1]), tz = Lanes::load(axes[2]);
+			Lanes bx = Lanes::load(axes[3]), by = Lanes::load(axes[4]), bz = Lanes::load(axes[5]);
+			Lanes nx = Lanes::load(axes[6]), ny = Lanes::load(axes[7]), nz = Lanes::load(axes[8]);
+			float sum[COUNT][3] = {};
+			float directions[3][COUNT];
+			for (auto& s : samples)
+			{
+				Lanes sx(s.x), sy(s.y), sz(s.z);
+				(tx * sx + bx * sy + nx * sz).store(directions[0]);
+				(ty * sx + by * sy + ny * sz).store(directions[1]);
+				(tz * sx + bz * sy + nz * sz).store(directions[2]);
+				for (int lane = 0; lane < COUNT; lane++)
+				{
+					float d[3] = { directions[0][lane], directions[1][lane], directions[2][lane] }, colour[3];
+					sampleCube(source, d, s.lod, colour);
+					for (int c = 0; c < 3; c++)
+					{
+						sum[lane][c] += colour[c] * s.weight;
+					}
+				}
+			}
+			for (int lane = 0; lane < COUNT && x0 + lane < size; lane++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					out[((size_t)(x0 + lane)) * 3 + c] = sum[lane][c] * scale;
+				}
+			}
+		}
+	}
+
+	// Rows of every face of some levels of a cube map, spread over the pool. Rows cost very different
+	// amounts across levels, so each thread takes the next row left rather than a fixed share
+	inline void forEachRow(const CubeMap& cube, int firstLevel, int levelCount, ThreadPool* pool, const std::function<void(int level, int face, int y)>& func)
+	{
+		struct Row
+		{
+			int level, face, y;
+		};
+		std::vector<Row> rows;
+		for (int level = firstLevel; level < firstLevel + levelCount; level++)
+		{
+			for (int face = 0; face < 6; face++)
+			{
+				for (int y = 0; y < cube.getLevelSize(level); y++)
+				{
+					rows.push_back({ level, face, y });
+				}
+			}
+		}
+		std::atomic<size_t> next(0);
+		auto run = [&](size_t, size_t)
+		{
+			for (size_t i = next++; i < rows.size(); i = next++)
+			{
+				func(rows[i].level, rows[i].face, rows[i].y);
+			}
+		};
+		if (pool)
+		{
+			pool->parallelFor(pool->getThreadCount() + 1, 1, run);
+		}
+		else
+		{
+			run(0, 1);
+		}
+	}
+
+	inline void allocate(CubeMap& cube, int size, int levels)
+	{
+		cube.size = size;
+		cube.levels.resize(levels);
+		for (int i = 0; i < levels; i++)
+		{
+			cube.levels[i].assign((size_t)cube.getLevelSize(i) * cube.getLevelSize(i) * 6 * 3, 0.0f);
+		}
+	}
+
+	// Levels of a full mip chain down to 1x1
+	inline int getLevelCount(int size)
+	{
+		int levels = 1;
+		while ((size >> levels) > 0)
+		{
+			levels++;
+		}
+		return levels;
+	}
+
+	// A level as half floats, faces one after the other, for a GL_RGB16F upload or a cache file
+	inline std::vector<uint16_t> getHalfs(const CubeMap& cube, int level)
+	{
+		std::vector<uint16_t> halfs(cube.levels[level].size());
+		floatsToHalfs(cube.levels[level].data(), halfs.data(), halfs.size());
+		return halfs;
+	}
+
+	// Subsamples along each side of a level 0 texel: enough that their spacing is no wider than an image
+	// texel at the equator, where a face texel spans about 2 / size radians and an image texel 2 pi / width
+	static const int MAX_SUPERSAMPLING = 8;
+
+	inline int getSupersampling(const Image& image, int size)
+	{
+		float ratio = image.width / (PI * size);
+		return std::max(1, std::min(MAX_SUPERSAMPLING, (int)std::ceil(ratio - 0.01f)));
+	}
+
+	// One row of level 0: every texel the mean of n x n bilinear lookups spread over it, each weighted by
+	// the solid angle it stands for on the face, (1 + s^2 + t^2)^-3/2. Directions, weights and image
+	// coordinates are worked out Lanes::COUNT texels at a time, the fetches per lane
+	template <typename T>
+	inline void resampleRow(const T* texels, int width, int height, int face, int y, int size, int n, float* out)
+	{
+		const int COUNT = Lanes::COUNT;
+		float step = 2.0f / (size * n);
+		float first[COUNT], xs[COUNT], ys[COUNT], weights[COUNT];
+		for (int x0 = 0; x0 < size; x0 += COUNT)
+		{
+			for (int lane = 0; lane < COUNT; lane++)
+			{
+				first[lane] = ((x0 + lane) * n + 0.5f) * step - 1.0f;
+			}
+			Lanes s0 = Lanes::load(first);
+			float sums[COUNT][4] = {}, weightSums[COUNT] = {};
+			int lanes = std::min(COUNT, size - x0);
+			for (int j = 0; j < n; j++)
+			{
+				Lanes t(((y * n + j) + 0.5f) * step - 1.0f);
+				for (int i = 0; i < n; i++)
+				{
+					Lanes s = s0 + Lanes(i * step);
+					Lanes dx(0.0f), dy(0.0f), dz(0.0f);
+					getFaceDirection(face, s, t, dx, dy, dz);
+					Lanes q = s * s + t * t + Lanes(1.0f);
+					(Lanes(1.0f) / (q * sqrtLanes(q))).store(weights);
+					// Longitude and latitude, the direction needn't be unit length for either
+					Lanes u = atan2Lanes(dz, dx) * Lanes(0.5f / PI) + Lanes(0.5f);
+					Lanes v = atan2Lanes(dy, sqrtLanes(dx * dx + dz * dz)) * Lanes(1.0f / PI) + Lanes(0.5f);
+					(u * Lanes((float)width) - Lanes(0.5f)).store(xs);
+					(v * Lanes((float)height) - Lanes(0.5f)).store(ys);
+					for (int lane = 0; lane < lanes; lane++)
+					{
+						fetchEquirect(texels, width, height, xs[lane], ys[lane], weights[lane], sums[lane]);
+						weightSums[lane] += weights[lane];
+					}
+				}
+			}
+			for (int lane = 0; lane < lanes; lane++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					out[(x0 + lane) * 3 + c] = sums[lane][c] / weightSums[lane];
+				}
+			}
+		}
+	}
+
+	// Equirectangular image to a cube map with a full mip chain, on the pool or on the calling thread if
+	// it is null. Level 0 is supersampled n x n per texel (getSupersampling unless given), so an 8K-16K
+	// HDR is filtered down instead of point sampled. Every lower level averages its 2x2 parents weighted
+	// by their solid angle, texels towards a face's corners cover less of the sphere than a box filter
+	// gives them. This is the environment map the engine uploads and the prefilter reads its mips
+	inline void bakeEnvironment(const Image& image, int size, ThreadPool* pool, CubeMap& cube, int supersampling = 0)
+	{
+		int levels = getLevelCount(size);
+		allocate(cube, size, levels);
+		int n = supersampling > 0 ? supersampling : getSupersampling(image, size);
+		forEachRow(cube, 0, 1, pool, [&](int, int face, int y)
+		{
+			float* row = &cube.levels[0][((size_t)face * size + y) * size * 3];
+			if (image.rgb.empty())
+			{
+				resampleRow(image.halfs.data(), image.width, image.height, face, y, size, n, row);
+			}
+			else
+			{
+				resampleRow(image.rgb.data(), image.width, image.height, face, y, size, n, row);
+			}
+		});
+		for (int level = 1; level < levels; level++)
+		{
+			int parentSize = cube.getLevelSize(level - 1);
+			// Texel solid angles are the same on every face
+			std::vector<float> solidAngles((size_t)parentSize * parentSize);
+			for (int y = 0; y < parentSize; y++)
+			{
+				for (int x = 0; x < parentSize; x++)
+				{
+					solidAngles[(size_t)y * parentSize + x] = getTexelSolidAngle(x, y, parentSize);
+				}
+			}
+			forEachRow(cube, level, 1, pool, [&](int, int face, int y)
+			{
+				int levelSize = cube.getLevelSize(level);
+				const float* parent = cube.levels[level - 1].data();
+				for (int x = 0; x < levelSize; x++)
+				{
+					float sum[3] = {}, weightSum = 0.0f;
+					for (int j = 0; j < 2; j++)
+					{
+						for (int i = 0; i < 2; i++)
+						{
+							int px = std::min(parentSize - 1, x * 2 + i), py = std::min(parentSize - 1, y * 2 + j);
+							float weight = solidAngles[(size_t)py * parentSize + px];
+							const float* texel = &parent[(((size_t)face * parentSize + py) * parentSize + px) * 3];
+							for (int c = 0; c < 3; c++)
+							{
+								sum[c] += texel[c] * weight;
+							}
+							weightSum += weight;
+						}
+					}
+					float* texel = &cube.levels[level][(((size_t)face * levelSize + y) * levelSize + x) * 3];
+					for (int c = 0; c < 3; c++)
+					{
+						texel[c] = sum[c] / weightSum;
+					}
+				}
+			});
+		}
+	}
+
+	// Irradiance / pi of every texel from samples, whose weights sum to count / scale
+	inline void bakeIrradiance(const CubeMap& environment, int size, const std::vector<Sample>& samples, float scale, ThreadPool* pool, CubeMap& irradiance)
+	{
+		allocate(irradiance, size, 1);
+		// Frame of the shader: right = normalize(cross(+y, N)), up = cross(N, right)
+		auto frame = [](const float* n, float* right, float* up)
+		{
+			float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+			if (std::fabs(n[1]) >= 0.999f)
+			{
+				worldUp[1] = 0.0f;
+				worldUp[2] = 1.0f;
+			}
+			right[0] = worldUp[1] * n[2] - worldUp[2] * n[1];
+			right[1] = worldUp[2] * n[0] - worldUp[0] * n[2];
+			right[2] = worldUp[0] * n[1] - worldUp[1] * n[0];
+			float length = std::sqrt(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
+			for (int c = 0; c < 3; c++)
+			{
+				right[c] /= length;
+			}
+			up[0] = n[1] * right[2] - n[2] * right[1];
+			up[1] = n[2] * right[0] - n[0] * right[2];
+			up[2] = n[0] * right[1] - n[1] * right[0];
+		};
+		forEachRow(irradiance, 0, 1, pool, [&](int, int face, int y)
+		{
+			integrateRow(environment, samples, scale, face, y, size, frame, &irradiance.levels[0][((size_t)face * size + y) * size * 3]);
+		});
+	}
+
+	inline void bakeIrradiance(const CubeMap& environment, int size, uint32_t sampleCount, ThreadPool* pool, CubeMap& irradiance)
+	{
+		bakeIrradiance(environment, size, buildIrradianceSamples(sampleCount, environment.size), 1.0f / (float)sampleCount, pool, irradiance);
+	}
+
+	// RMS and largest difference of a map from a reference, relative to the reference's mean
+	inline void getRelativeError(const std::vector<float>& map, const std::vector<float>& reference, double& rms, double& largest)
+	{
+		double sumSquares = 0.0, sum = 0.0;
+		largest = 0.0;
+		for (size_t i = 0; i < reference.size(); i++)
+		{
+			double error = std::fabs((double)map[i] - reference[i]);
+			sumSquares += error * error;
+			largest = std::max(largest, error);
+			sum += reference[i];
+		}
+		double mean = std::max(sum / reference.size(), 1e-20);
+		rms = std::sqrt(sumSquares / reference.size()) / mean;
+		largest /= mean;
+	}
+
+	// Convergence test for the irradiance sample count: the smallest power of two from 16 whose map
+	// changes by less than tolerance (relative RMS) when the samples are doubled, at most maxCount
+	inline uint32_t findIrradianceSampleCount(const CubeMap& environment, int size, double tolerance, ThreadPool* pool, uint32_t maxCount = 4096)
+	{
+		CubeMap current, doubled;
+		uint32_t count = 16;
+		bakeIrradiance(environment, size, count, pool, current);
+		for (; count < maxCount; count *= 2)
+		{
+			bakeIrradiance(environment, size, count * 2, pool, doubled);
+			double rms, largest;
+			getRelativeError(current.levels[0], doubled.levels[0], rms, largest);
+			if (rms < tolerance)
+			{
+				return count;
+			}
+			std::swap(current, doubled);
+		}
+		return maxCount;
+	}
+
+	inline void bakePrefilter(const CubeMap& environment, int size, int levels, uint32_t sampleCount, ThreadPool* pool, CubeMap& prefilter)
+	{
+		allocate(prefilter, size, levels);
+		std::vector<std::vector<Sample>> samples(levels);
+		std::vector<float> scales(levels);
+		for (int level = 0; level < levels; level++)
+		{
+			samples[level] = buildPrefilterSamples(levels > 1 ? (float)level / (float)(levels - 1) : 0.0f, environment.size, sampleCount);
+			float totalWeight = 0.0f;
+			for (auto& i : samples[level])
+			{
+				totalWeight += i.weight;
+			}
+			scales[level] = 1.0f / totalWeight;
+		}
+		forEachRow(prefilter, 0, levels, pool, [&](int level, int face, int y)
+		{
+			int levelSize = prefilter.getLevelSize(level);
+			integrateRow(environment, samples[level], scales[level], face, y, levelSize, getGGXFrame, &prefilter.levels[level][((size_t)face * levelSize + y) * levelSize * 3]);
+		});
+	}
+
+	// Split sum scale and bias to F0 with GGX importance samples, N.V along x and roughness along y, Lanes::COUNT
+	// values of N.V at a time. Generates the table BRDFLUT ships
+	inline void bakeBRDF(int size, ThreadPool* pool, std::vector<float>& brdf, uint32_t sampleCount = 1024)
+	{
+		const int COUNT = Lanes::COUNT;
+		brdf.assign((size_t)size * size * 2, 0.0f);
+		auto run = [&](size_t begin, size_t end)
+		{
+			std::vector<float> hx(sampleCount), hz(sampleCount);
+			for (size_t y = begin; y < end; y++)
+			{
+				float roughness = (y + 0.5f) / size;
+				float k = roughness * roughness / 2.0f;
+				// Half vectors around N = +z, V lies in the xz plane so their y never matters
+				const float n[3] = { 0.0f, 0.0f, 1.0f };
+				float tangent[3], bitangent[3];
+				getGGXFrame(n, tangent, bitangent);
+				for (uint32_t i = 0; i < sampleCount; i++)
+				{
+					float h[3];
+					importanceSampleGGX(i, sampleCount, roughness, h);
+					hx[i] = tangent[0] * h[0] + bitangent[0] * h[1];
+					hz[i] = h[2];
+				}
+				for (int x0 = 0; x0 < size; x0 += COUNT)
+				{
+					float nDotVs[COUNT], vxs[COUNT];
+					for (int lane = 0; lane < COUNT; lane++)
+					{
+						nDotVs[lane] = (std::min(x0 + lane, size - 1) + 0.5f) / size;
+						vxs[lane] = std::sqrt(1.0f - nDotVs[lane] * nDotVs[lane]);
+					}
+					Lanes nDotV = Lanes::load(nDotVs), vx = Lanes::load(vxs);
+					Lanes one(1.0f), zero(0.0f), kLanes(k);
+					Lanes g1V = nDotV / (nDotV * (one - kLanes) + kLanes);
+					Lanes a(0.0f), b(0.0f);
+					for (uint32_t i = 0; i < sampleCount; i++)
+					{
+						Lanes h0(hx[i]), h2(hz[i]);
+						Lanes vDotH = vx * h0 + nDotV * h2;
+						// L = 2 (V.H) H - V is unit length already
+						Lanes lz = Lanes(2.0f) * vDotH * h2 - nDotV;
+						Lanes mask = positiveLanes(lz);
+						Lanes nDotL = maxLanes(lz, zero);
+						vDotH = maxLanes(vDotH, zero);
+						Lanes g = g1V * (nDotL / (nDotL * (one - kLanes) + kLanes));
+						Lanes gVis = g * vDotH / (Lanes(std::max(hz[i], 0.0f)) * nDotV);
+						Lanes f = one - vDotH;
+						Lanes f2 = f * f;
+						Lanes fc = f2 * f2 * f;
+						a = a + mask * (one - fc) * gVis;
+						b = b + mask * fc * gVis;
+					}
+					float as[COUNT], bs[COUNT];
+					(a / Lanes((float)sampleCount)).store(as);
+					(b / Lanes((float)sampleCount)).store(bs);
+					for (int lane = 0; lane < COUNT && x0 + lane < size; lane++)
+					{
+						brdf[(y * size + x0 + lane) * 2] = as[lane];
+						brdf[(y * size + x0 + lane) * 2 + 1] = bs[lane];
+					}
+				}
+			}
+		};
+		if (pool)
+		{
+			pool->parallelFor(size, 1, run);
+		}
+		else
+		{
+			run(0, size);
+		}
+	}
+
+	// Every map at the sizes of settings, on the pool or on the calling thread alone if it is null
+	inline Result bake(const Image& image, const IBLCache::Settings& settings, ThreadPool* pool)
+	{
+		Result result;
+		double start = getTimeMs();
+		bakeEnvironment(image, settings.environmentSize, pool, result.environment);
+		result.environmentMs = getTimeMs() - start;
+		start = getTimeMs();
+		bakeIrradiance(result.environment, settings.irradianceSize, (uint32_t)settings.irradianceSamples, pool, result.irradiance);
+		result.irradianceMs = getTimeMs() - start;
+		start = getTimeMs();
+		bakePrefilter(result.environment, settings.prefilterSize, settings.prefilterLevels, (uint32_t)settings.prefilterSamples, pool, result.prefilter);
+		result.prefilterMs = getTimeMs() - start;
+		return result;
+	}
+
+	// Write the maps as the IBL cache files of hdrFile, the engine then uploads them instead of baking
+	inline bool save(const Result& result, const std::string& hdrFile, const std::string& key, const IBLCache::Settings& settings)
+	{
+		const CubeMap* cubes[] = { &result.environment, &result.irradiance, &result.prefilter };
+		return IBLCache::save(hdrFile, key, settings, [&](size_t map, int level, unsigned char* out)
+		{
+			std::vector<uint16_t> halfs = getHalfs(*cubes[map], level);
+			std::memcpy(out, halfs.data(), halfs.size() * 2);
+		});
+	}
+
+	// --bake ibl: bake the maps of an HDR on the CPU at a quality tier and write its IBL cache
+	inline int bakeFile(const std::string& hdrFile = "Assets/environment.hdr", IBLCache::quality_enum quality = IBLCache::QUALITY_HIGH)
+	{
+		ThreadPool& pool = ThreadPool::get();
+		Image image;
+		if (!loadHDR(hdrFile, image, &pool))
+		{
+			return 1;
+		}
+		IBLCache::Settings settings = IBLCache::getSettings(quality);
+		Result result = bake(image, settings, &pool);
+		std::string key = IBLCache::getKey(hdrFile, settings, IBLCache::getShaderFiles());
+		if (!save(result, hdrFile, key, settings))
+		{
+			return 1;
+		}
+		std::cout << "IBL for " << hdrFile << " baked at " << IBLCache::getQualityName(quality) << " quality on " << pool.getThreadCount() + 1 << " threads with " << getKernelName() << " kernels in "
+			<< result.environmentMs + result.irradianceMs + result.prefilterMs << " ms (environment " << result.environmentMs
+			<< ", irradiance " << result.irradianceMs << ", prefilter " << result.prefilterMs << ")" << std::endl;
+		std::cout << "Written to " << IBLCache::getFileName(hdrFile, key, "*") << ", scaling: 3DEngine.exe --benchmark iblbake" << std::endl;
+		return 0;
+	}
+}
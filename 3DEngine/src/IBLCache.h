@@ -0,0 +1,478 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// OTHER
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "GLState.h"
+#include "MappedFile.h"
+#include "TextureFile.h"
+#include "ShaderBake.h"
+
+// Image based lighting maps saved to disk after they are first built, so later launches skip the
+// HDR decode and every convolution and just upload them. Each map is a half float KTX2 file next to
+// the HDR, named after a key in two parts: the source (the HDR's path, size and modification time
+// and the IBL shader sources) and the map sizes of the tier:
+// Assets/environment.<source>.<sizes>.irradiance.ktx2 etc. Changing any of them misses the cache and rebakes.
+namespace IBLCache
+{
+	// Bumped when the files change layout or the bake changes outside the shaders
+	static const uint32_t VERSION = 5;
+
+	// VkFormat values of the half float maps
+	enum vk_float_format_enum
+	{
+		VK_FORMAT_R16G16_SFLOAT = 83,
+		VK_FORMAT_R16G16B16_SFLOAT = 90
+	};
+
+	// Sizes the maps are built at, the cosine weighted samples per irradiance texel and the GGX samples
+	// per prefilter texel. Defaults are the high tier. The prefilter keeps 5 levels on every tier, as
+	// FragmentCorePBR maps roughness onto them with MAX_REFLECTION_LOD
+	struct Settings
+	{
+		int environmentSize = 512;
+		int irradianceSize = 32;
+		int irradianceSamples = 256;
+		int prefilterSize = 128;
+		int prefilterLevels = 5;
+		int prefilterSamples = 1024;
+	};
+
+	enum quality_enum { QUALITY_LOW = 0, QUALITY_MEDIUM, QUALITY_HIGH, QUALITY_ULTRA, QUALITY_COUNT };
+
+	inline const char* getQualityName(quality_enum quality)
+	{
+		static const char* const names[] = { "low", "medium", "high", "ultra" };
+		return names[quality];
+	}
+
+	// Tier by name, false if there is none
+	inline bool findQuality(const std::string& name, quality_enum& quality)
+	{
+		for (int i = 0; i < QUALITY_COUNT; i++)
+		{
+			if (name == getQualityName((quality_enum)i))
+			{
+				quality = (quality_enum)i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline Settings getSettings(quality_enum quality)
+	{
+		Settings settings;
+		switch (quality)
+		{
+		case QUALITY_LOW:
+			settings.environmentSize = 256;
+			settings.irradianceSize = 16;
+			settings.irradianceSamples = 64;
+			settings.prefilterSize = 64;
+			settings.prefilterSamples = 256;
+			break;
+		case QUALITY_MEDIUM:
+			settings.irradianceSamples = 128;
+			settings.prefilterSamples = 512;
+			break;
+		case QUALITY_ULTRA:
+			settings.environmentSize = 1024;
+			settings.irradianceSize = 64;
+			settings.irradianceSamples = 1024;
+			settings.prefilterSize = 256;
+			settings.prefilterSamples = 2048;
+			break;
+		default:
+			break;
+		}
+		return settings;
+	}
+
+	// Bytes of the maps on the GPU: the environment with its full mip chain, irradiance and prefilter
+	inline size_t getMemoryBytes(const Settings& settings)
+	{
+		auto levelBytes = [](int size) { return (size_t)size * size * 6 * 6; };
+		size_t bytes = levelBytes(settings.irradianceSize);
+		for (int i = 0; (settings.environmentSize >> i) > 0; i++)
+		{
+			bytes += levelBytes(settings.environmentSize >> i);
+		}
+		for (int i = 0; i < settings.prefilterLevels; i++)
+		{
+			bytes += levelBytes(std::max(1, settings.prefilterSize >> i));
+		}
+		return bytes;
+	}
+
+	// Textures initIBL creates, whether baked or loaded
+	struct Maps
+	{
+		GLuint environment = 0;
+		GLuint irradiance = 0;
+		GLuint prefilter = 0;
+	};
+
+	// One map file: cube maps are RGB16F with their six faces in each level, 2D maps are RG16F
+	struct MapFile
+	{
+		const char* name;
+		bool cube;
+		int size;
+		int levels;
+	};
+
+	inline std::vector<MapFile> getMapFiles(const Settings& settings)
+	{
+		// Only level 0 of the environment is stored, its mips only feed the prefilter convolution
+		return {
+			{ "environment", true, settings.environmentSize, 1 },
+			{ "irradiance", true, settings.irradianceSize, 1 },
+			{ "prefilter", true, settings.prefilterSize, settings.prefilterLevels }
+		};
+	}
+
+	// Sources of the Irradiance and Prefiltered Map programs
+	inline std::vector<std::string> getShaderFiles()
+	{
+		std::vector<std::string> files;
+		for (size_t i = 2; i <= 3; i++)
+		{
+			files.push_back(ShaderBake::getPrograms()[i].vertexFile);
+			files.push_back(ShaderBake::getPrograms()[i].fragmentFile);
+		}
+		return files;
+	}
+
+	inline uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// FNV-1a over a file's contents, read through a mapping. 0 if it can't be opened
+	inline uint64_t hashFile(uint64_t hash, const std::string& fileName)
+	{
+		MappedFile file(fileName);
+		if (!file.isOpen())
+		{
+			return 0;
+		}
+		return hashBytes(hash, file.getData(), file.getSize());
+	}
+
+	// Digits of the source part of a key, the part that tells whether cached maps are out of date
+	static const size_t SOURCE_DIGITS = 16;
+
+	// Key of the maps built from an HDR with settings by the shaders in shaderFiles, empty if the HDR is missing.
+	// The HDR is known by its path, size and modification time rather than its contents, which would
+	// mean reading the whole file on every launch. The shaders are small and hashed whole
+	inline std::string getKey(const std::string& hdrFile, const Settings& settings, const std::vector<std::string>& shaderFiles)
+	{
+		struct stat info;
+		if (stat(hdrFile.c_str(), &info) != 0)
+		{
+			return std::string();
+		}
+		uint64_t size = (uint64_t)info.st_size, lastWrite = (uint64_t)info.st_mtime;
+		uint64_t source = hashBytes(14695981039346656037ull, hdrFile.data(), hdrFile.size());
+		source = hashBytes(source, &size, sizeof(size));
+		source = hashBytes(source, &lastWrite, sizeof(lastWrite));
+		source = hashBytes(source, &VERSION, sizeof(VERSION));
+		for (auto& i : shaderFiles)
+		{
+			source = hashFile(source, i);
+		}
+		uint64_t sizes = hashBytes(14695981039346656037ull, &settings, sizeof(settings));
+		char key[SOURCE_DIGITS + 10];
+		std::snprintf(key, sizeof(key), "%016llx.%08x", (unsigned long long)source, (unsigned)(sizes ^ (sizes >> 32)));
+		return key;
+	}
+
+	// Assets/environment.hdr with key k and map "irradiance" -> Assets/environment.k.irradiance.ktx2
+	inline std::string getFileName(const std::string& hdrFile, const std::string& key, const char* map)
+	{
+		return hdrFile.substr(0, hdrFile.find_last_of('.')) + "." + key + "." + map + ".ktx2";
+	}
+
+	inline size_t getTexelBytes(const MapFile& map)
+	{
+		return map.cube ? 6 : 4;
+	}
+
+	inline size_t getLevelBytes(const MapFile& map, int level)
+	{
+		size_t size = (size_t)std::max(1, map.size >> level);
+		return size * size * getTexelBytes(map) * (map.cube ? 6 : 1);
+	}
+
+	// Basic data format descriptor of RGB16F or RG16F, linear signed floats in [-1, 1] as the spec asks
+	inline std::vector<unsigned char> buildDataFormatDescriptor(int channels)
+	{
+		uint32_t blockSize = 24 + 16 * (uint32_t)channels;
+		std::vector<unsigned char> out;
+		TextureFile::writeU32(out, 4 + blockSize);
+		TextureFile::writeU32(out, 0);
+		TextureFile::writeU32(out, 2 | (blockSize << 16));
+		TextureFile::writeU32(out, 1 | (1 << 8) | (1 << 16)); // RGBSDA, BT.709 primaries, linear transfer
+		TextureFile::writeU32(out, 0);
+		TextureFile::writeU32(out, 2 * channels);
+		TextureFile::writeU32(out, 0);
+		for (int i = 0; i < channels; i++)
+		{
+			TextureFile::writeU32(out, (uint32_t)(i * 16) | (15 << 16) | ((uint32_t)(i | 0x80 | 0x40) << 24)); // Float, signed
+			TextureFile::writeU32(out, 0);
+			TextureFile::writeU32(out, 0xBF800000); // -1.0f
+			TextureFile::writeU32(out, 0x3F800000); // 1.0f
+		}
+		return out;
+	}
+
+	// Fills out with the half float texels of a level of a map, cube faces one after the other
+	typedef std::function<void(size_t map, int level, unsigned char* out)> LevelWriter;
+
+	// Write a map as KTX2 with its levels from writer
+	inline bool writeMap(const std::string& fileName, size_t index, const MapFile& map, const LevelWriter& writer)
+	{
+		uint32_t levelCount = (uint32_t)map.levels;
+		std::vector<unsigned char> descriptor = buildDataFormatDescriptor(map.cube ? 3 : 2);
+		size_t descriptorOffset = 80 + (size_t)levelCount * 24;
+		// Levels aligned to lcm(texel size, 4), smallest level first
+		size_t alignment = map.cube ? 12 : 4;
+		std::vector<size_t> offsets(levelCount);
+		size_t end = descriptorOffset + descriptor.size();
+		for (size_t i = levelCount; i-- > 0;)
+		{
+			end = (end + alignment - 1) / alignment * alignment;
+			offsets[i] = end;
+			end += getLevelBytes(map, (int)i);
+		}
+
+		std::vector<unsigned char> out(TextureFile::KTX2_IDENTIFIER, TextureFile::KTX2_IDENTIFIER + 12);
+		TextureFile::writeU32(out, map.cube ? VK_FORMAT_R16G16B16_SFLOAT : VK_FORMAT_R16G16_SFLOAT);
+		TextureFile::writeU32(out, 2); // Type size
+		TextureFile::writeU32(out, (uint32_t)map.size);
+		TextureFile::writeU32(out, (uint32_t)map.size);
+		TextureFile::writeU32(out, 0); // Depth
+		TextureFile::writeU32(out, 0); // Layers
+		TextureFile::writeU32(out, map.cube ? 6 : 1);
+		TextureFile::writeU32(out, levelCount);
+		TextureFile::writeU32(out, 0); // Supercompression
+		TextureFile::writeU32(out, (uint32_t)descriptorOffset);
+		TextureFile::writeU32(out, (uint32_t)descriptor.size());
+		TextureFile::writeU32(out, 0); // Key/value data
+		TextureFile::writeU32(out, 0);
+		TextureFile::writeU64(out, 0); // Supercompression global data
+		TextureFile::writeU64(out, 0);
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			TextureFile::writeU64(out, offsets[i]);
+			TextureFile::writeU64(out, getLevelBytes(map, (int)i));
+			TextureFile::writeU64(out, getLevelBytes(map, (int)i));
+		}
+		out.insert(out.end(), descriptor.begin(), descriptor.end());
+		out.resize(end, 0);
+
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			writer(index, (int)i, out.data() + offsets[i]);
+		}
+
+		std::ofstream outFile(fileName, std::ios::binary);
+		outFile.write((const char*)out.data(), out.size());
+		return outFile.good();
+	}
+
+	// Check a mapped map file matches what is expected of it, offsets of each level in levelOffsets
+	inline bool readMap(const MappedFile& file, const MapFile& map, std::vector<size_t>& levelOffsets)
+	{
+		const unsigned char* data = file.getData();
+		size_t size = file.getSize();
+		if (!file.isOpen() || size < 80 + (size_t)map.levels * 24 || std::memcmp(data, TextureFile::KTX2_IDENTIFIER, 12) != 0)
+		{
+			return false;
+		}
+		uint32_t vkFormat = map.cube ? VK_FORMAT_R16G16B16_SFLOAT : VK_FORMAT_R16G16_SFLOAT;
+		if (TextureFile::readU32(data + 12) != vkFormat || TextureFile::readU32(data + 20) != (uint32_t)map.size
+			|| TextureFile::readU32(data + 24) != (uint32_t)map.size || TextureFile::readU32(data + 36) != (map.cube ? 6u : 1u)
+			|| TextureFile::readU32(data + 40) != (uint32_t)map.levels || TextureFile::readU32(data + 44) != 0)
+		{
+			return false;
+		}
+		levelOffsets.resize(map.levels);
+		for (int i = 0; i < map.levels; i++)
+		{
+			const unsigned char* entry = data + 80 + i * 24;
+			uint64_t offset = TextureFile::readU64(entry);
+			if (TextureFile::readU64(entry + 8) != getLevelBytes(map, i) || offset + getLevelBytes(map, i) > size)
+			{
+				return false;
+			}
+			levelOffsets[i] = (size_t)offset;
+		}
+		return true;
+	}
+
+	// Create a texture with the sampling state initIBL gives the map and upload its half float levels,
+	// each from getLevel
+	inline GLuint uploadMap(const MapFile& map, const std::function<const void*(int level)>& getLevel)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		GLenum target = map.cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+		GLState::get().bindTexture(0, target, texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int level = 0; level < map.levels; level++)
+		{
+			int size = std::max(1, map.size >> level);
+			const unsigned char* data = (const unsigned char*)getLevel(level);
+			if (map.cube)
+			{
+				size_t faceBytes = getLevelBytes(map, level) / 6;
+				for (unsigned int face = 0; face < 6; face++)
+				{
+					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB16F, size, size, 0, GL_RGB, GL_HALF_FLOAT, data + face * faceBytes);
+				}
+			}
+			else
+			{
+				glTexImage2D(GL_TEXTURE_2D, level, GL_RG16F, size, size, 0, GL_RG, GL_HALF_FLOAT, data);
+			}
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, map.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		if (map.cube)
+		{
+			glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		}
+		if (map.levels > 1)
+		{
+			glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, map.levels - 1);
+		}
+		return texture;
+	}
+
+	// Upload the levels of a mapped map file
+	inline GLuint uploadMap(const MappedFile& file, const MapFile& map, const std::vector<size_t>& levelOffsets)
+	{
+		return uploadMap(map, [&](int level) { return (const void*)(file.getData() + levelOffsets[level]); });
+	}
+
+	// Upload the maps cached under key. False if any is missing or doesn't match the settings,
+	// nothing is created then
+	inline bool load(const std::string& hdrFile, const std::string& key, const Settings& settings, Maps& maps)
+	{
+		if (key.empty())
+		{
+			return false;
+		}
+		std::vector<MapFile> mapFiles = getMapFiles(settings);
+		std::vector<MappedFile*> files;
+		std::vector<std::vector<size_t>> offsets(mapFiles.size());
+		bool found = true;
+		for (size_t i = 0; i < mapFiles.size(); i++)
+		{
+			files.push_back(new MappedFile(getFileName(hdrFile, key, mapFiles[i].name)));
+			found = found && readMap(*files[i], mapFiles[i], offsets[i]);
+		}
+		if (found)
+		{
+			GLuint* textures[] = { &maps.environment, &maps.irradiance, &maps.prefilter };
+			for (size_t i = 0; i < mapFiles.size(); i++)
+			{
+				*textures[i] = uploadMap(*files[i], mapFiles[i], offsets[i]);
+			}
+		}
+		for (auto* i : files)
+		{
+			delete i;
+		}
+		return found;
+	}
+
+	// Write the maps under key, in getMapFiles order, and delete those cached for the same HDR from
+	// other sources. Maps of the other tiers from the same source stay, switching tier loads them
+	inline bool save(const std::string& hdrFile, const std::string& key, const Settings& settings, const LevelWriter& writer)
+	{
+		if (key.empty())
+		{
+			return false;
+		}
+		std::vector<MapFile> mapFiles = getMapFiles(settings);
+		for (size_t i = 0; i < mapFiles.size(); i++)
+		{
+			std::string fileName = getFileName(hdrFile, key, mapFiles[i].name);
+			if (!writeMap(fileName, i, mapFiles[i], writer))
+			{
+				std::cout << "ERROR: Could not write IBL cache file " << fileName << std::endl;
+				std::remove(fileName.c_str());
+				return false;
+			}
+		}
+
+		size_t slash = hdrFile.find_last_of("/\\");
+		std::string directory = slash == std::string::npos ? "." : hdrFile.substr(0, slash);
+		std::string prefix = hdrFile.substr(slash == std::string::npos ? 0 : slash + 1);
+		prefix = prefix.substr(0, prefix.find_last_of('.')) + ".";
+		for (auto& i : TextureFile::listFiles(directory, ".ktx2"))
+		{
+			// <name>.<16 hex digits source>.<8 hex digits sizes>.<map>.ktx2, older versions had no sizes part
+			if (i.compare(0, prefix.size(), prefix) == 0 && i.size() > prefix.size() + SOURCE_DIGITS + 1 && i[prefix.size() + SOURCE_DIGITS] == '.'
+				&& i.compare(prefix.size(), SOURCE_DIGITS, key, 0, SOURCE_DIGITS) != 0)
+			{
+				std::remove((directory + "/" + i).c_str());
+			}
+		}
+		return true;
+	}
+
+	// Read the maps back from the GPU and save them
+	inline bool save(const std::string& hdrFile, const std::string& key, const Settings& settings, const Maps& maps)
+	{
+		std::vector<MapFile> mapFiles = getMapFiles(settings);
+		GLuint textures[] = { maps.environment, maps.irradiance, maps.prefilter };
+		// Rows are tightly packed in KTX2, 1x1 levels of 6 bytes would otherwise be padded
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		bool saved = save(hdrFile, key, settings, [&](size_t map, int level, unsigned char* out)
+		{
+			// Read through unit 0 as the context is GL 4.4. A cube map is read a face at a time, one after
+			// the other in the order KTX2 keeps them
+			if (mapFiles[map].cube)
+			{
+				GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, textures[map]);
+				size_t faceBytes = getLevelBytes(mapFiles[map], level) / 6;
+				for (int face = 0; face < 6; face++)
+				{
+					glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_HALF_FLOAT, out + face * faceBytes);
+				}
+			}
+			else
+			{
+				GLState::get().bindTexture(0, GL_TEXTURE_2D, textures[map]);
+				glGetTexImage(GL_TEXTURE_2D, level, GL_RG, GL_HALF_FLOAT, out);
+			}
+		});
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		return saved;
+	}
+}
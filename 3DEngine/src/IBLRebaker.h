@@ -0,0 +1,464 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// MTB
+#include <glm.hpp>
+#include <gtc\matrix_transform.hpp>
+
+// OTHER
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+#include "GLState.h"
+#include "Shader.h"
+#include "ThreadPool.h"
+#include "IBLCache.h"
+#include "IBLBaker.h"
+#include "SHIrradiance.h"
+
+// Changes the environment lighting while the engine runs without stalling a frame. start() decodes the
+// HDR on the thread pool, builds the environment cube map and its mips from it and projects that onto
+// SH9 there. update() then works through the rest as small jobs, as many each frame as fit its
+// millisecond budget: bands of the cube map's rows uploaded, irradiance faces, and scissored tiles of
+// every prefilter face and mip. The maps in use are
+// not touched, take() hands the new set over once its last job is done so they all change in one frame.
+// Draws are costed in texture samples at the rate timer queries measured, uploads in bytes at the rate
+// the render thread took. The first job of a frame always runs, so a tiny budget still gets there.
+class IBLRebaker
+{
+public:
+	struct Stats
+	{
+		unsigned jobsDone;
+		unsigned jobCount;
+		unsigned frames;		// Frames that ran jobs
+		double decodeMs;		// HDR decode, cube map build and SH projection on the pool
+		double lastFrameMs;		// Render thread time plus expected GPU time of the last frame's jobs
+		double longestFrameMs;
+		double totalMs;			// start() to the last job
+	};
+
+private:
+	// Environment cube map handed back from the pool, every level as half floats
+	struct Decoded
+	{
+		std::atomic<bool> done;
+		bool valid;
+		std::vector<std::vector<uint16_t>> environment;
+		SHIrradiance::Coefficients sh;
+		double decodeMs;
+	};
+
+	enum job_enum { JOB_UPLOAD = 0, JOB_DRAW, JOB_KIND_COUNT };
+
+	struct Job
+	{
+		int kind;
+		double cost;	// Bytes for uploads, texture samples for draws
+		std::function<void()> run;
+	};
+
+	// Largest job, faces needing more texture samples are drawn in tiles and cube map levels uploaded in bands
+	static const int JOB_SAMPLES = 1 << 20;
+	static const int JOB_BYTES = 4 << 20;
+	static const int QUERY_COUNT = 2;
+
+	Shader* irradiance;
+	Shader* prefilter;
+	IBLCache::Settings settings;
+	bool shIrradiance;
+	std::function<void()> renderCube;
+
+	std::string fileName;
+	std::shared_ptr<Decoded> decoded;
+	std::deque<Job> jobs;
+	bool busy;
+	bool ready;
+	double startMs;
+	// The maps being built
+	IBLCache::Maps maps;
+	GLuint framebuffer;
+	// Milliseconds per byte uploaded and per texture sample drawn
+	double msPerUnit[JOB_KIND_COUNT];
+	// Alternating timer queries over each frame's draws, read once available so they never stall
+	GLuint queries[QUERY_COUNT];
+	double querySamples[QUERY_COUNT];
+	bool queryPending[QUERY_COUNT];
+	int nextQuery;
+	Stats stats;
+
+	static double getTimeMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void updateRate(int kind, double ms, double cost)
+	{
+		if (cost > 0.0)
+		{
+			this->msPerUnit[kind] = 0.5 * (this->msPerUnit[kind] + ms / cost);
+		}
+	}
+
+	void readQueries()
+	{
+		for (int i = 0; i < QUERY_COUNT; i++)
+		{
+			if (!this->queryPending[i])
+			{
+				continue;
+			}
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(this->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+			{
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(this->queries[i], GL_QUERY_RESULT, &elapsed);
+				this->updateRate(JOB_DRAW, elapsed / 1000000.0, this->querySamples[i]);
+				this->queryPending[i] = false;
+			}
+		}
+	}
+
+	GLuint createCubeMap(int size, int levels)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, texture);
+		glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, GL_RGB16F, size, size);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return texture;
+	}
+
+	void deleteTexture(GLuint& texture)
+	{
+		if (texture)
+		{
+			GLState::get().forgetTexture(texture);
+			glDeleteTextures(1, &texture);
+			texture = 0;
+		}
+	}
+
+	// Jobs drawing every face of one level of a cube map through shader, tiled so no job takes more
+	// than JOB_SAMPLES texture samples. uniforms sets what the pass needs besides the face's view
+	void addDrawJobs(Shader* shader, GLenum sourceTarget, GLuint source, GLuint target, int level, int size, double samplesPerTexel, const std::function<void()>& uniforms)
+	{
+		int tile = size;
+		while (tile > 8 && (double)tile * tile * samplesPerTexel > JOB_SAMPLES)
+		{
+			tile /= 2;
+		}
+		for (int face = 0; face < 6; face++)
+		{
+			for (int y = 0; y < size; y += tile)
+			{
+				for (int x = 0; x < size; x += tile)
+				{
+					this->jobs.push_back({ JOB_DRAW, (double)tile * tile * samplesPerTexel, [=]()
+					{
+						uniforms();
+						shader->setMat4fv(getCaptureProjection(), "projection");
+						shader->setMat4fv(getCaptureView(face), "view");
+						shader->use();
+						GLState::get().bindTexture(0, sourceTarget, source);
+						glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, target, level);
+						GLState::get().setViewport(0, 0, size, size);
+						glScissor(x, y, tile, tile);
+						this->renderCube();
+					} });
+				}
+			}
+		}
+	}
+
+	// The whole bake as jobs, once the environment cube map is built
+	void createJobs()
+	{
+		const IBLCache::Settings& settings = this->settings;
+		int environmentLevels = IBLBaker::getLevelCount(settings.environmentSize);
+		this->maps.environment = this->createCubeMap(settings.environmentSize, environmentLevels);
+		this->maps.irradiance = this->createCubeMap(settings.irradianceSize, 1);
+		this->maps.prefilter = this->createCubeMap(settings.prefilterSize, settings.prefilterLevels);
+
+		// Upload the environment cube map and its mips in bands of rows. The faces of a level follow each
+		// other, so a band may run on into the next face
+		for (int level = 0; level < environmentLevels; level++)
+		{
+			int size = std::max(1, settings.environmentSize >> level);
+			size_t rowBytes = (size_t)size * 3 * sizeof(uint16_t);
+			int bandRows = (int)std::max<size_t>(1, JOB_BYTES / rowBytes);
+			for (int row = 0; row < size * 6; row += bandRows)
+			{
+				int rows = std::min(bandRows, size * 6 - row);
+				this->jobs.push_back({ JOB_UPLOAD, (double)rows * rowBytes, [this, level, size, row, rows]()
+				{
+					GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, this->maps.environment);
+					glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+					for (int i = row; i < row + rows;)
+					{
+						int face = i / size, y = i % size, count = std::min(row + rows - i, size - y);
+						glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, y, size, count, GL_RGB, GL_HALF_FLOAT, this->decoded->environment[level].data() + (size_t)i * size * 3);
+						i += count;
+					}
+					glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+				} });
+			}
+		}
+
+		Shader* irradiance = this->irradiance;
+		this->addDrawJobs(irradiance, GL_TEXTURE_CUBE_MAP, this->maps.environment, this->maps.irradiance, 0, settings.irradianceSize, settings.irradianceSamples, [irradiance, settings]()
+		{
+			irradiance->set1i(0, "environmentMap");
+			irradiance->set1i(settings.irradianceSamples, "sampleCount");
+			irradiance->set1f((float)settings.environmentSize, "environmentSize");
+		});
+
+		Shader* prefilter = this->prefilter;
+		for (int mip = 0; mip < settings.prefilterLevels; mip++)
+		{
+			float roughness = settings.prefilterLevels > 1 ? (float)mip / (float)(settings.prefilterLevels - 1) : 0.0f;
+			this->addDrawJobs(prefilter, GL_TEXTURE_CUBE_MAP, this->maps.environment, this->maps.prefilter, mip, std::max(1, settings.prefilterSize >> mip), settings.prefilterSamples, [prefilter, roughness, settings]()
+			{
+				prefilter->set1i(0, "environmentMap");
+				prefilter->set1i(settings.prefilterSamples, "sampleCount");
+				prefilter->set1f((float)settings.environmentSize, "environmentSize");
+				prefilter->set1f(roughness, "roughness");
+			});
+		}
+		this->stats.jobCount = (unsigned)this->jobs.size();
+	}
+
+	// Drop a rebake that hasn't been taken, a decode still running finishes into nothing
+	void release()
+	{
+		this->jobs.clear();
+		this->decoded.reset();
+		this->deleteTexture(this->maps.environment);
+		this->deleteTexture(this->maps.irradiance);
+		this->deleteTexture(this->maps.prefilter);
+		this->busy = false;
+		this->ready = false;
+	}
+
+public:
+	IBLRebaker(Shader* irradiance, Shader* prefilter, const IBLCache::Settings& settings, bool shIrradiance, std::function<void()> renderCube)
+		: irradiance(irradiance), prefilter(prefilter), settings(settings), renderCube(renderCube)
+	{
+		this->shIrradiance = shIrradiance;
+		this->busy = false;
+		this->ready = false;
+		this->startMs = 0.0;
+		this->framebuffer = 0;
+		// Until measured, 1 GB/s uploads and 1 G texture samples a second
+		this->msPerUnit[JOB_UPLOAD] = 1e-6;
+		this->msPerUnit[JOB_DRAW] = 1e-6;
+		this->queries[0] = 0;
+		this->queries[1] = 0;
+		this->querySamples[0] = 0.0;
+		this->querySamples[1] = 0.0;
+		this->queryPending[0] = false;
+		this->queryPending[1] = false;
+		this->nextQuery = 0;
+		std::memset(&this->stats, 0, sizeof(this->stats));
+	}
+
+	~IBLRebaker()
+	{
+		this->release();
+		if (this->framebuffer)
+		{
+			glDeleteFramebuffers(1, &this->framebuffer);
+		}
+		if (this->queries[0])
+		{
+			glDeleteQueries(QUERY_COUNT, this->queries);
+		}
+	}
+
+	IBLRebaker(const IBLRebaker&) = delete;
+	IBLRebaker& operator=(const IBLRebaker&) = delete;
+
+	// Projection and views of initIBL's cube map passes, face i looks down GL cube map face i
+	static glm::mat4 getCaptureProjection()
+	{
+		return glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+	}
+
+	static glm::mat4 getCaptureView(int face)
+	{
+		static const glm::vec3 directions[6] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+		static const glm::vec3 ups[6] = { glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+		return glm::lookAt(glm::vec3(0.0f), directions[face], ups[face]);
+	}
+
+	// Begin rebaking from fileName, replacing any rebake not yet taken
+	void start(const std::string& fileName)
+	{
+		this->release();
+		this->fileName = fileName;
+		this->busy = true;
+		this->startMs = getTimeMs();
+		std::memset(&this->stats, 0, sizeof(this->stats));
+		std::shared_ptr<Decoded> decoded = std::make_shared<Decoded>();
+		decoded->done = false;
+		decoded->valid = false;
+		decoded->sh = {};
+		decoded->decodeMs = 0.0;
+		this->decoded = decoded;
+		bool sh = this->shIrradiance;
+		int size = this->settings.environmentSize;
+		ThreadPool::get().enqueue([decoded, fileName, sh, size]()
+		{
+			double start = getTimeMs();
+			IBLBaker::Image image;
+			decoded->valid = IBLBaker::loadHDR(fileName, image, &ThreadPool::get(), true);
+			if (decoded->valid)
+			{
+				// Projected from the cube map like at startup
+				IBLBaker::CubeMap environment;
+				IBLBaker::bakeEnvironment(image, size, &ThreadPool::get(), environment);
+				if (sh)
+				{
+					decoded->sh = SHIrradiance::projectCube(environment.levels[0].data(), size, &ThreadPool::get());
+				}
+				for (int level = 0; level < (int)environment.levels.size(); level++)
+				{
+					decoded->environment.push_back(IBLBaker::getHalfs(environment, level));
+				}
+			}
+			decoded->decodeMs = getTimeMs() - start;
+			decoded->done = true;
+		});
+	}
+
+	// Run this frame's share of the jobs, called once per frame on the render thread. Returns true once
+	// the maps are complete and waiting for take(). Leaves the viewport at the last cube map face size
+	bool update(double budgetMs)
+	{
+		this->readQueries();
+		if (!this->busy || this->ready)
+		{
+			return this->ready;
+		}
+		if (this->stats.jobCount == 0)
+		{
+			if (!this->decoded->done)
+			{
+				return false;
+			}
+			this->stats.decodeMs = this->decoded->decodeMs;
+			if (!this->decoded->valid)
+			{
+				this->release();
+				return false;
+			}
+			this->createJobs();
+		}
+
+		if (!this->framebuffer)
+		{
+			glGenFramebuffers(1, &this->framebuffer);
+			glGenQueries(QUERY_COUNT, this->queries);
+		}
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+		glEnable(GL_SCISSOR_TEST);
+		int query = this->nextQuery;
+		bool timed = !this->queryPending[query];
+		if (timed)
+		{
+			glBeginQuery(GL_TIME_ELAPSED, this->queries[query]);
+		}
+		double spentMs = 0.0, samples = 0.0;
+		while (!this->jobs.empty())
+		{
+			const Job& job = this->jobs.front();
+			double expectedMs = job.cost * this->msPerUnit[job.kind];
+			if (spentMs > 0.0 && spentMs + expectedMs > budgetMs)
+			{
+				break;
+			}
+			double start = getTimeMs();
+			job.run();
+			double cpuMs = getTimeMs() - start;
+			if (job.kind == JOB_UPLOAD)
+			{
+				this->updateRate(JOB_UPLOAD, cpuMs, job.cost);
+				spentMs += cpuMs;
+			}
+			else
+			{
+				spentMs += cpuMs + expectedMs;
+				samples += job.cost;
+			}
+			this->jobs.pop_front();
+			this->stats.jobsDone++;
+		}
+		if (timed)
+		{
+			glEndQuery(GL_TIME_ELAPSED);
+			this->querySamples[query] = samples;
+			this->queryPending[query] = true;
+			this->nextQuery = (query + 1) % QUERY_COUNT;
+		}
+		glDisable(GL_SCISSOR_TEST);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+		this->stats.frames++;
+		this->stats.lastFrameMs = spentMs;
+		this->stats.longestFrameMs = std::max(this->stats.longestFrameMs, spentMs);
+
+		if (this->jobs.empty())
+		{
+			// Like initIBL the skybox samples level 0 of the environment only
+			GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, this->maps.environment);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			this->stats.totalMs = getTimeMs() - this->startMs;
+			this->ready = true;
+			std::cout << "IBL: " << this->fileName << " rebaked in " << this->stats.totalMs << " ms over " << this->stats.frames << " frames ("
+				<< this->stats.decodeMs << " ms decoding on the thread pool), longest frame " << this->stats.longestFrameMs << " ms" << std::endl;
+		}
+		return this->ready;
+	}
+
+	// Hand the finished environment, irradiance and prefilter maps over, the caller owns them from here.
+	// The BRDF LUT doesn't depend on the environment and is left as it is
+	void take(IBLCache::Maps& maps, SHIrradiance::Coefficients& sh)
+	{
+		maps.environment = this->maps.environment;
+		maps.irradiance = this->maps.irradiance;
+		maps.prefilter = this->maps.prefilter;
+		sh = this->decoded->sh;
+		this->maps = IBLCache::Maps();
+		this->release();
+	}
+
+	// Between start() and take()
+	bool isBusy() const
+	{
+		return this->busy;
+	}
+
+	const std::string& getFileName() const
+	{
+		return this->fileName;
+	}
+
+	const Stats& getStats() const
+	{
+		return this->stats;
+	}
+};
@@ -5,32 +5,51 @@ in vec3 position;
 
 // Cubemap
 uniform samplerCube environmentMap;
+// Cosine weighted samples per texel and the size of environmentMap level 0
+uniform int sampleCount;
+uniform float environmentSize;
 
 const float PI = 3.14159265359f;
 
+// Hammersley sequence random number generation helper function
+float radicalInverse_VdC(uint bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return float(bits) * 2.3283064365386963e-10; // / 0x100000000
+}
+
 void main()
 {
 	// Use position as vector for fragment. Essentially a normal of the tangent surface from the origin.
 	vec3 N = normalize(position);
 	vec3 irradiance = vec3(0.0);
-	// Caclulate tangent from origin
-	vec3 right = cross(vec3(0.0f, 1.0f, 0.0f), N);
+	// Caclulate tangent from origin, normalised so the hemisphere isn't squashed towards N near the poles
+	vec3 worldUp = abs(N.y) < 0.999f ? vec3(0.0f, 1.0f, 0.0f) : vec3(0.0f, 0.0f, 1.0f);
+	vec3 right = normalize(cross(worldUp, N));
 	// Calculate bitangent
 	vec3 up = cross(N, right);
 
-	float sampleDelta = 0.025f;
-	float nrSamples = 0.0f;
-	for (float phi = 0.0f; phi < 2.0f * PI; phi += sampleDelta) {
-		for (float theta = 0.0f; theta < 0.5f * PI; theta += sampleDelta)
-		{
-			// Spherical to cartesian.
-			vec3 tangentSample = vec3(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
-			vec3 sampleVec = tangentSample.x * right + tangentSample.y * up + tangentSample.z * N;
-			// Tangent space to world space
-			irradiance += texture(environmentMap, sampleVec).rgb * cos(theta) * sin(theta); // The further a sample is from the center of hemisphere the less influence it has
-			nrSamples++;
-		}
+	// Samples are spread with pdf cos(theta) / PI, so the cosine and the pdf cancel and every sample
+	// counts the same. Each reads the mip whose texels cover about the solid angle of its sample, so
+	// a few hundred samples see the whole environment instead of aliasing over its level 0 texels
+	float saTexel = 4.0f * PI / (6.0f * environmentSize * environmentSize);
+	for (int i = 0; i < sampleCount; i++)
+	{
+		float phi = 2.0f * PI * float(i) / float(sampleCount);
+		float xi = radicalInverse_VdC(uint(i));
+		float cosTheta = sqrt(1.0f - xi);
+		float sinTheta = sqrt(xi);
+		// Tangent space to world space
+		vec3 sampleVec = sinTheta * cos(phi) * right + sinTheta * sin(phi) * up + cosTheta * N;
+		float saSample = PI / (float(sampleCount) * cosTheta);
+		float mipLevel = 0.5f * log2(saSample / saTexel);
+		irradiance += textureLod(environmentMap, sampleVec, mipLevel).rgb;
 	}
-	irradiance *= PI / nrSamples;
+	// The map holds irradiance / PI, which is the mean of the samples
+	irradiance /= float(sampleCount);
 	FragColor = vec4(irradiance, 1.0f);
 }
@@ -0,0 +1,68 @@
+#pragma once
+
+// OTHER
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+// Multiple producer, single consumer queue. Producers push from any thread without locking,
+// the consumer takes everything pushed so far in one exchange, so there is no ABA problem.
+template<typename T>
+class LockFreeQueue
+{
+private:
+	struct Node
+	{
+		T value;
+		Node* next;
+	};
+
+	std::atomic<Node*> head;
+
+public:
+	LockFreeQueue()
+	{
+		this->head = nullptr;
+	}
+
+	~LockFreeQueue()
+	{
+		std::vector<T> remaining;
+		this->popAll(remaining);
+	}
+
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+	// Safe to call from any thread
+	void push(T value)
+	{
+		Node* node = new Node{ std::move(value), this->head.load(std::memory_order_relaxed) };
+		while (!this->head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	// Consumer thread only. Appends everything pushed so far in push order, returns how many were taken
+	size_t popAll(std::vector<T>& out)
+	{
+		Node* node = this->head.exchange(nullptr, std::memory_order_acquire);
+		size_t first = out.size();
+		while (node)
+		{
+			Node* next = node->next;
+			out.push_back(std::move(node->value));
+			delete node;
+			node = next;
+		}
+		// The list is newest first
+		std::reverse(out.begin() + first, out.end());
+		return out.size() - first;
+	}
+
+	bool empty() const
+	{
+		return this->head.load(std::memory_order_acquire) == nullptr;
+	}
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+// OTHER
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read only view of a whole file through the virtual memory system. Pages are only read from
+// disk when they are touched, and nothing is copied into a buffer of our own.
+class MappedFile
+{
+private:
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+
+public:
+	MappedFile(const std::string& fileName)
+	{
+		this->data = nullptr;
+		this->size = 0;
+#ifdef _WIN32
+		this->mapping = NULL;
+		this->file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (this->file == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(this->file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			return;
+		}
+		this->mapping = CreateFileMappingA(this->file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (this->mapping)
+		{
+			this->data = (const unsigned char*)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+			this->size = this->data ? (size_t)fileSize.QuadPart : 0;
+		}
+#else
+		int fd = open(fileName.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return;
+		}
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0)
+		{
+			void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (view != MAP_FAILED)
+			{
+				this->data = (const unsigned char*)view;
+				this->size = (size_t)info.st_size;
+			}
+		}
+		// The mapping keeps its own reference to the file
+		close(fd);
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (this->data)
+		{
+			UnmapViewOfFile(this->data);
+		}
+		if (this->mapping)
+		{
+			CloseHandle(this->mapping);
+		}
+		if (this->file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(this->file);
+		}
+#else
+		if (this->data)
+		{
+			munmap((void*)this->data, this->size);
+		}
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool isOpen() const
+	{
+		return this->data != nullptr;
+	}
+
+	const unsigned char* getData() const
+	{
+		return this->data;
+	}
+
+	size_t getSize() const
+	{
+		return this->size;
+	}
+};
@@ -17,6 +17,9 @@
 // Other
 #include "Shader.h"
 
+// PBR texture slots, in the order the material table stores them
+enum material_texture_enum { MATERIAL_ALBEDO = 0, MATERIAL_ORM, MATERIAL_METAL, MATERIAL_ROUGH, MATERIAL_NORMAL, MATERIAL_TEXTURE_COUNT };
+
 class Material
 {
 private:
@@ -30,12 +33,15 @@ private:
 	GLint metalTex;
 	GLint roughTex;
 	GLint normTex;
+	GLint ormTex;
+	bool packedORM; // Occlusion, roughness and metallic in one texture, for the ORM_TEXTURE permutation
 
 public:
 	// Blinn Phong constructor
 	Material(glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, GLint diffuseTex, GLint specularTex)
 	{
 		this->PBR = false;
+		this->packedORM = false;
 		this->ambient = ambient;
 		this->diffuse = diffuse;
 		this->specular = specular;
@@ -46,18 +52,52 @@ public:
 	Material(glm::vec3 ambient, GLint albedoTex, GLint metalTex, GLint roughTex, GLint normTex)
 	{
 		this->PBR = true;
+		this->packedORM = false;
 		this->ambient = ambient;
 		this->albedoTex = albedoTex;
 		this->metalTex = metalTex;
 		this->roughTex = roughTex;
 		this->normTex = normTex;
 	}
+	// PBR constructor with packed occlusion/roughness/metallic
+	Material(glm::vec3 ambient, GLint albedoTex, GLint ormTex, GLint normTex)
+	{
+		this->PBR = true;
+		this->packedORM = true;
+		this->ambient = ambient;
+		this->albedoTex = albedoTex;
+		this->ormTex = ormTex;
+		this->normTex = normTex;
+	}
 
 	~Material()
 	{
 
 	}
 
+	bool hasPackedORM() const
+	{
+		return this->packedORM;
+	}
+
+	// Unit the texture of a PBR slot is bound to, which is also its index in the model's textures. -1 if the material has none
+	GLint getTextureUnit(int slot) const
+	{
+		if (!this->PBR)
+		{
+			return -1;
+		}
+		switch (slot)
+		{
+		case MATERIAL_ALBEDO: return this->albedoTex;
+		case MATERIAL_ORM: return this->packedORM ? this->ormTex : -1;
+		case MATERIAL_METAL: return this->packedORM ? -1 : this->metalTex;
+		case MATERIAL_ROUGH: return this->packedORM ? -1 : this->roughTex;
+		case MATERIAL_NORMAL: return this->normTex;
+		default: return -1;
+		}
+	}
+
 	// Update material Uniforms
 	void sendToShader(Shader &program)
 	{
@@ -73,8 +113,15 @@ public:
 		{
 			program.setVec3f(this->ambient, "material.ambient");
 			program.set1i(this->albedoTex, "material.albedoTex");
-			program.set1i(this->metalTex, "material.metalTex");
-			program.set1i(this->roughTex, "material.roughTex");
+			if (this->packedORM)
+			{
+				program.set1i(this->ormTex, "material.ormTex");
+			}
+			else
+			{
+				program.set1i(this->metalTex, "material.metalTex");
+				program.set1i(this->roughTex, "material.roughTex");
+			}
 			program.set1i(this->normTex, "material.normTex");
 		}
 	}
@@ -0,0 +1,361 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// ImGUI
+#include "vendor/imgui/imgui.h"
+
+// OTHER
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+
+#include "Texture.h"
+#include "Material.h"
+#include "Shader.h"
+#include "GLState.h"
+#include "RenderQueue.h"
+
+// Textures of many materials in one shader storage buffer, so draws with different materials need
+// no binds in between and can go out in one multi draw (see MeshBatch). Shaders built with
+// MATERIAL_TABLE index the buffer with the material id of the draw.
+// - With GL_ARB_bindless_texture (BINDLESS_TEXTURES) each entry holds resident 64 bit texture handles
+// - Without it every slot is a texture array with each material's texture copied into a layer, and
+//   each entry holds the layers. All textures of a slot must then share their size and format
+// Handles freeze the state of their texture, so materials are only added once their textures are
+// fully loaded and are never streamed afterwards. When one of the table's textures is deleted the
+// table empties and materials are added again as they are drawn.
+class MaterialTable : public TextureListener
+{
+public:
+	// Shader storage binding of the table, matches FragmentCorePBR.glsl
+	static const GLuint MATERIAL_BINDING = 2;
+
+private:
+	struct BindlessEntry
+	{
+		GLuint64 handles[MATERIAL_TEXTURE_COUNT];
+	};
+
+	struct ArrayEntry
+	{
+		GLuint layers[MATERIAL_TEXTURE_COUNT];
+	};
+
+	// Texture array of one slot. Allocated with room to spare, only layers added since the last
+	// upload are copied in, and it is reallocated at twice the size when it fills up
+	struct TextureArray
+	{
+		GLuint id;
+		GLint internalFormat;
+		int width;
+		int height;
+		int levels;
+		size_t capacity;
+		size_t copied;
+		std::vector<const Texture*> layers;
+		std::unordered_map<const Texture*, int> layerIds;
+	};
+
+	// Id of a material and the textures it had in each slot when it was added
+	struct Record
+	{
+		int id;
+		const Texture* textures[MATERIAL_TEXTURE_COUNT];
+	};
+
+	bool bindless;
+	int materialCount;
+	std::unordered_map<const RenderMaterial*, Record> ids;
+	// Every texture in the table, and whether one of them has been deleted since
+	std::unordered_set<const Texture*> textures;
+	bool stale;
+	// Video memory of the layers copied into the arrays
+	size_t arrayBytes;
+	std::vector<BindlessEntry> bindlessEntries;
+	std::vector<ArrayEntry> arrayEntries;
+	TextureArray arrays[MATERIAL_TEXTURE_COUNT];
+	GLuint buffer;
+	bool dirty;
+
+	// Texture a material has in a slot, nullptr if none
+	static Texture* getSlotTexture(const RenderMaterial* material, int slot)
+	{
+		GLint index = material->material ? material->material->getTextureUnit(slot) : -1;
+		return index >= 0 && index < material->textureCount ? material->textures[index] : nullptr;
+	}
+
+	// Layer of texture in the array of slot, adding it if it isn't there. -1 if it does not match the array
+	int getLayer(int slot, const Texture* texture)
+	{
+		TextureArray& array = this->arrays[slot];
+		auto it = array.layerIds.find(texture);
+		if (it != array.layerIds.end())
+		{
+			return it->second;
+		}
+		// Queried through unit 0, the context is GL 4.4 without the DSA getters
+		GLint internalFormat = 0, maxLevel = 0;
+		GLState::get().bindTexture(0, GL_TEXTURE_2D, texture->getID());
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+		int levels = std::min(maxLevel + 1, (int)std::log2(std::max(texture->getWidth(), texture->getHeight())) + 1);
+		if (array.layers.empty())
+		{
+			array.internalFormat = internalFormat;
+			array.width = texture->getWidth();
+			array.height = texture->getHeight();
+			array.levels = levels;
+		}
+		else if (internalFormat != array.internalFormat || texture->getWidth() != array.width || texture->getHeight() != array.height || levels != array.levels)
+		{
+			return -1;
+		}
+		this->arrayBytes += texture->getMemoryBytes();
+		array.layerIds[texture] = (int)array.layers.size();
+		array.layers.push_back(texture);
+		return (int)array.layers.size() - 1;
+	}
+
+	// Copy layers added since the last call into the arrays, only the arrays are sampled afterwards
+	void updateArrays()
+	{
+		for (auto& array : this->arrays)
+		{
+			if (array.copied == array.layers.size())
+			{
+				continue;
+			}
+			if (array.layers.size() > array.capacity)
+			{
+				size_t capacity = std::max(array.layers.size(), array.capacity * 2);
+				GLuint id;
+				glGenTextures(1, &id);
+				GLState::get().bindTexture(0, GL_TEXTURE_2D_ARRAY, id);
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexStorage3D(GL_TEXTURE_2D_ARRAY, array.levels, array.internalFormat, array.width, array.height, (GLsizei)capacity);
+				// Layers already uploaded move over with one copy per level
+				if (array.id)
+				{
+					for (int level = 0; level < array.levels; level++)
+					{
+						GLsizei width = std::max(1, array.width >> level), height = std::max(1, array.height >> level);
+						glCopyImageSubData(array.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, (GLsizei)array.copied);
+					}
+					GLState::get().forgetTexture(array.id);
+					glDeleteTextures(1, &array.id);
+				}
+				array.id = id;
+				array.capacity = capacity;
+			}
+			for (size_t layer = array.copied; layer < array.layers.size(); layer++)
+			{
+				for (int level = 0; level < array.levels; level++)
+				{
+					GLsizei width = std::max(1, array.width >> level), height = std::max(1, array.height >> level);
+					glCopyImageSubData(array.layers[layer]->getID(), GL_TEXTURE_2D, level, 0, 0, 0, array.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, (GLint)layer, width, height, 1);
+				}
+			}
+			array.copied = array.layers.size();
+		}
+	}
+
+	void deleteArrays()
+	{
+		for (auto& i : this->arrays)
+		{
+			if (i.id)
+			{
+				GLState::get().forgetTexture(i.id);
+				glDeleteTextures(1, &i.id);
+			}
+			i = { 0, 0, 0, 0, 0, 0, 0, std::vector<const Texture*>(), std::unordered_map<const Texture*, int>() };
+		}
+	}
+
+	// Drop every material, they are added again the next time they are drawn
+	void clear()
+	{
+		this->materialCount = 0;
+		this->ids.clear();
+		this->textures.clear();
+		this->arrayBytes = 0;
+		this->bindlessEntries.clear();
+		this->arrayEntries.clear();
+		this->deleteArrays();
+		this->stale = false;
+		this->dirty = true;
+	}
+
+public:
+	// Uses bindless textures when the driver has them and allowBindless is set, texture arrays otherwise
+	MaterialTable(bool allowBindless = true)
+	{
+		this->bindless = allowBindless && GLEW_ARB_bindless_texture;
+		this->materialCount = 0;
+		this->stale = false;
+		this->arrayBytes = 0;
+		for (auto& i : this->arrays)
+		{
+			i = { 0, 0, 0, 0, 0, 0, 0, std::vector<const Texture*>(), std::unordered_map<const Texture*, int>() };
+		}
+		this->buffer = 0;
+		this->dirty = false;
+		Texture::addListener(this);
+	}
+
+	// Bindless handles belong to their textures and stay resident until the textures are deleted
+	~MaterialTable()
+	{
+		Texture::removeListener(this);
+		this->deleteArrays();
+		if (this->buffer)
+		{
+			glDeleteBuffers(1, &this->buffer);
+		}
+	}
+
+	MaterialTable(const MaterialTable&) = delete;
+	MaterialTable& operator=(const MaterialTable&) = delete;
+
+	bool isBindless() const
+	{
+		return this->bindless;
+	}
+
+	// Id of a PBR material, adding it on first use. -1 if its textures don't fit the texture arrays,
+	// such a material has to be drawn with its textures bound and is not tried again.
+	// Materials are known by address, so one found with other textures than it was added with is a
+	// new material in the old one's place and gets an entry of its own
+	int add(const RenderMaterial* material)
+	{
+		if (this->stale)
+		{
+			this->clear();
+		}
+		Record record;
+		for (int slot = 0; slot < MATERIAL_TEXTURE_COUNT; slot++)
+		{
+			record.textures[slot] = getSlotTexture(material, slot);
+		}
+		auto it = this->ids.find(material);
+		if (it != this->ids.end())
+		{
+			if (std::equal(record.textures, record.textures + MATERIAL_TEXTURE_COUNT, it->second.textures))
+			{
+				return it->second.id;
+			}
+		}
+		if (this->bindless)
+		{
+			BindlessEntry entry = {};
+			for (int slot = 0; slot < MATERIAL_TEXTURE_COUNT; slot++)
+			{
+				Texture* texture = getSlotTexture(material, slot);
+				entry.handles[slot] = texture ? texture->getBindlessHandle() : 0;
+			}
+			this->bindlessEntries.push_back(entry);
+		}
+		else
+		{
+			ArrayEntry entry = {};
+			for (int slot = 0; slot < MATERIAL_TEXTURE_COUNT; slot++)
+			{
+				const Texture* texture = record.textures[slot];
+				int layer = texture ? this->getLayer(slot, texture) : 0;
+				if (layer < 0)
+				{
+					std::cout << "ERROR: Material texture does not match the size and format of its texture array" << std::endl;
+					record.id = -1;
+					this->ids[material] = record;
+					return -1;
+				}
+				entry.layers[slot] = (GLuint)layer;
+			}
+			this->arrayEntries.push_back(entry);
+		}
+		record.id = this->materialCount++;
+		this->ids[material] = record;
+		this->textures.insert(record.textures, record.textures + MATERIAL_TEXTURE_COUNT);
+		this->dirty = true;
+		return record.id;
+	}
+
+	int getMaterialCount() const
+	{
+		return this->materialCount;
+	}
+
+	// Materials holding the texture lose it, the table is cleared before the next add
+	void onTextureDeleted(const Texture* texture) override
+	{
+		if (this->textures.count(texture))
+		{
+			this->stale = true;
+		}
+	}
+
+	// Upload materials added since the last call and bind the table. With texture arrays the arrays
+	// are bound to the units of their slots and the samplers of shader pointed at them
+	void bind(Shader& shader)
+	{
+		if (this->dirty)
+		{
+			if (!this->buffer)
+			{
+				glGenBuffers(1, &this->buffer);
+			}
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer);
+			if (this->bindless)
+			{
+				glBufferData(GL_SHADER_STORAGE_BUFFER, this->bindlessEntries.size() * sizeof(BindlessEntry), this->bindlessEntries.data(), GL_STATIC_DRAW);
+			}
+			else
+			{
+				glBufferData(GL_SHADER_STORAGE_BUFFER, this->arrayEntries.size() * sizeof(ArrayEntry), this->arrayEntries.data(), GL_STATIC_DRAW);
+				this->updateArrays();
+			}
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			this->dirty = false;
+		}
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, this->buffer);
+		if (!this->bindless)
+		{
+			const char* names[MATERIAL_TEXTURE_COUNT] = { "albedoTex", "ormTex", "metalTex", "roughTex", "normTex" };
+			for (int slot = 0; slot < MATERIAL_TEXTURE_COUNT; slot++)
+			{
+				if (this->arrays[slot].id)
+				{
+					GLState::get().bindTexture(slot, GL_TEXTURE_2D_ARRAY, this->arrays[slot].id);
+					shader.set1i(slot, names[slot]);
+				}
+			}
+		}
+	}
+
+	// Video memory of the texture arrays, bindless handles take none of their own
+	size_t getArrayBytes() const
+	{
+		return this->arrayBytes;
+	}
+
+	void renderGUI()
+	{
+		ImGui::Text("Material table: %d materials, %s", this->getMaterialCount(), this->bindless ? "bindless handles" : "texture arrays");
+		if (this->bindless)
+		{
+			ImGui::Text("%d resident texture handles", (int)Texture::getResidentHandleCount());
+		}
+		else
+		{
+			ImGui::Text("Texture arrays: %.1f MB copied", this->getArrayBytes() / (1024.0f * 1024.0f));
+		}
+	}
+};
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <vector>
+#include <cmath>
 
 #include "Vertex.h"
 #include "Shader.h"
@@ -27,13 +28,58 @@ private:
 
 	glm::mat4 ModelMatrix;
 
+	// Local space bounding sphere, used for culling and depth sorting
+	glm::vec3 boundsCentre;
+	float boundsRadius;
+	// Texture coordinate units per local space unit, used to pick the mip level a texture needs
+	float uvDensity;
+	// Reflection probes lighting the mesh and their weights, see ReflectionProbes::select
+	glm::vec4 probeBlend;
+
+	void initBounds()
+	{
+		if (this->nrOfVertices == 0)
+		{
+			this->boundsCentre = glm::vec3(0.0f);
+			this->boundsRadius = 0.0f;
+			return;
+		}
+		glm::vec3 minPos = this->vertexArray[0].position;
+		glm::vec3 maxPos = this->vertexArray[0].position;
+		for (size_t i = 1; i < this->nrOfVertices; i++)
+		{
+			minPos = glm::min(minPos, this->vertexArray[i].position);
+			maxPos = glm::max(maxPos, this->vertexArray[i].position);
+		}
+		this->boundsCentre = (minPos + maxPos) * 0.5f;
+		this->boundsRadius = glm::length(maxPos - minPos) * 0.5f;
+	}
+
+	// Square root of the summed texture coordinate area over the summed surface area of the triangles
+	void initUVDensity()
+	{
+		double surfaceArea = 0.0;
+		double uvArea = 0.0;
+		unsigned count = this->nrOfIndices > 0 ? this->nrOfIndices : this->nrOfVertices;
+		for (unsigned i = 0; i + 2 < count; i += 3)
+		{
+			const Vertex& a = this->vertexArray[this->nrOfIndices > 0 ? this->indexArray[i] : i];
+			const Vertex& b = this->vertexArray[this->nrOfIndices > 0 ? this->indexArray[i + 1] : i + 1];
+			const Vertex& c = this->vertexArray[this->nrOfIndices > 0 ? this->indexArray[i + 2] : i + 2];
+			surfaceArea += glm::length(glm::cross(b.position - a.position, c.position - a.position)) * 0.5;
+			glm::vec2 u = b.texcoord - a.texcoord, v = c.texcoord - a.texcoord;
+			uvArea += std::abs(u.x * v.y - u.y * v.x) * 0.5;
+		}
+		this->uvDensity = surfaceArea > 0.0 ? (float)std::sqrt(uvArea / surfaceArea) : 0.0f;
+	}
+
 	// BUFFERS
 	void initVAO()
 	{
 
 		// Create VAO
-		glCreateVertexArrays(1, &VAO);
-		glBindVertexArray(VAO);
+		glGenVertexArrays(1, &VAO);
+		GLState::get().bindVertexArray(VAO);
 
 		// VBO gen and bind
 		glGenBuffers(1, &VBO);
@@ -70,12 +116,17 @@ private:
 
 
 		// Bind VAO 0
-		glBindVertexArray(0);
+		GLState::get().bindVertexArray(0);
 	}
 	// Send updated model matrix uniform
 	void updateUniforms(Shader* shader)
 	{
 		shader->setMat4fv(ModelMatrix, "ModelMatrix");
+		// Only programs built with REFLECTION_PROBES read it
+		if (shader->getReflection().getLocation("probeBlend") != -1)
+		{
+			shader->setVec4f(this->probeBlend, "probeBlend");
+		}
 	}
 	// Update model matrix
 	void updateModelMatrix()
@@ -117,6 +168,9 @@ public:
 			this->indexArray[i] = indexArray[i];
 		}
 
+		this->probeBlend = glm::vec4(0.0f);
+		this->initBounds();
+		this->initUVDensity();
 		this->initVAO();
 		this->updateModelMatrix();
 	}
@@ -146,12 +200,16 @@ public:
 			this->indexArray[i] = primitive->getIndices()[i];
 		}
 
+		this->probeBlend = glm::vec4(0.0f);
+		this->initBounds();
+		this->initUVDensity();
 		this->initVAO();
 		this->updateModelMatrix();
 	}
 
 	~Mesh()
 	{
+		GLState::get().forgetVertexArray(VAO);
 		glDeleteVertexArrays(1, &VAO);
 		glDeleteBuffers(1, &VBO);
 		if (this->nrOfIndices > 0) // If drawing using indices
@@ -173,7 +231,7 @@ public:
 		this->updateUniforms(shader);
 		shader->use();
 		// Bind VAO
-		glBindVertexArray(this->VAO);
+		GLState::get().bindVertexArray(this->VAO);
 		// Render
 		if (this->nrOfIndices == 0)  // Draw using vertices
 		{
@@ -183,12 +241,62 @@ public:
 		{
 			glDrawElements(GL_TRIANGLES, nrOfIndices, GL_UNSIGNED_INT, 0);
 		}
-		glBindVertexArray(0);
-		glUseProgram(0);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		// State is left bound, the next draw only changes what it needs through GLState
 	}
+	// World space bounding sphere with the current transform
+	void getWorldBounds(glm::vec3& centre, float& radius)
+	{
+		this->updateModelMatrix();
+		centre = glm::vec3(this->ModelMatrix * glm::vec4(this->boundsCentre, 1.0f));
+		float maxScale = glm::max(glm::abs(this->scale.x), glm::max(glm::abs(this->scale.y), glm::abs(this->scale.z)));
+		radius = this->boundsRadius * maxScale;
+	}
+	// Model matrix with the current transform
+	const glm::mat4& getModelMatrix()
+	{
+		this->updateModelMatrix();
+		return this->ModelMatrix;
+	}
+
+	const Vertex* getVertices() const
+	{
+		return this->vertexArray;
+	}
+
+	unsigned getVertexCount() const
+	{
+		return this->nrOfVertices;
+	}
+
+	// Empty when the mesh is drawn without indices
+	const GLuint* getIndices() const
+	{
+		return this->indexArray;
+	}
+
+	unsigned getIndexCount() const
+	{
+		return this->nrOfIndices;
+	}
+
+	// Texture coordinate units per world unit with the current scale
+	float getUVDensity() const
+	{
+		float maxScale = glm::max(glm::abs(this->scale.x), glm::max(glm::abs(this->scale.y), glm::abs(this->scale.z)));
+		return maxScale > 0.0f ? this->uvDensity / maxScale : 0.0f;
+	}
+
+	const glm::vec4& getProbeBlend() const
+	{
+		return this->probeBlend;
+	}
+
 	// Setters
+	void setProbeBlend(const glm::vec4& probeBlend)
+	{
+		this->probeBlend = probeBlend;
+	}
+
 	void setOrigin(const glm::vec3 origin)
 	{
 		this->origin = origin;
@@ -0,0 +1,264 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// MTB
+#include <glm.hpp>
+#include <mat4x4.hpp>
+
+// OTHER
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <cstddef>
+
+#include "Vertex.h"
+#include "Mesh.h"
+#include "Shader.h"
+#include "GLState.h"
+
+// Meshes copied into one vertex and index buffer and drawn with a single glMultiDrawElementsIndirect.
+// Each draw's model matrix, material id and reflection probes go in a shader storage buffer. Shaders
+// built with MATERIAL_TABLE read it through an instanced attribute holding the draw index, which each
+// indirect command selects with its base instance (core since 4.2, unlike gl_DrawID).
+// Call begin(), add() every draw, then draw() once per frame. A mesh's geometry is copied the first
+// time it is added and reused afterwards.
+class MeshBatch
+{
+public:
+	// Shader storage binding of the draw table and location of the draw index, match VertexCorePBR.glsl
+	static const GLuint DRAW_BINDING = 1;
+	static const GLuint DRAW_INDEX_ATTRIBUTE = 6;
+
+	struct Stats
+	{
+		unsigned draws;
+		unsigned meshes;
+		double uploadMs;	// Render thread time writing the draw buffers in the last draw()
+	};
+
+private:
+	// Layout of DrawElementsIndirectCommand
+	struct IndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// std430 layout of DrawRecord in the shader
+	struct DrawRecord
+	{
+		glm::mat4 model;
+		GLuint material;
+		GLuint padding[3];
+		glm::vec4 probeBlend;
+	};
+
+	struct Range
+	{
+		GLuint firstIndex;
+		GLuint count;
+		GLint baseVertex;
+	};
+
+	std::unordered_map<const Mesh*, Range> ranges;
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	std::vector<Mesh*> meshes;
+	std::vector<IndirectCommand> commands;
+	std::vector<DrawRecord> records;
+	GLuint VAO;
+	GLuint VBO;
+	GLuint EBO;
+	GLuint drawIndexBuffer;
+	GLuint commandBuffer;
+	GLuint drawBuffer;
+	// Draw indices the instanced attribute can reach
+	size_t drawIndexCapacity;
+	bool geometryDirty;
+	Stats stats;
+
+	static double getTimeMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void initVAO()
+	{
+		glGenVertexArrays(1, &this->VAO);
+		GLState::get().bindVertexArray(this->VAO);
+		glGenBuffers(1, &this->VBO);
+		glGenBuffers(1, &this->EBO);
+		glGenBuffers(1, &this->drawIndexBuffer);
+		glGenBuffers(1, &this->commandBuffer);
+		glGenBuffers(1, &this->drawBuffer);
+
+		// Same input assembly as Mesh
+		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, position));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, color));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, texcoord));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, tangent));
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, bitangent));
+		glEnableVertexAttribArray(5);
+
+		// One value per instance, offset by the base instance of each command
+		glBindBuffer(GL_ARRAY_BUFFER, this->drawIndexBuffer);
+		glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)0);
+		glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE, 1);
+		glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE);
+
+		GLState::get().bindVertexArray(0);
+	}
+
+	// Copy a mesh's geometry in, meshes drawn without indices get a list of their own
+	const Range& addGeometry(const Mesh* mesh)
+	{
+		auto it = this->ranges.find(mesh);
+		if (it != this->ranges.end())
+		{
+			return it->second;
+		}
+		Range range = { (GLuint)this->indices.size(), 0, (GLint)this->vertices.size() };
+		this->vertices.insert(this->vertices.end(), mesh->getVertices(), mesh->getVertices() + mesh->getVertexCount());
+		if (mesh->getIndexCount() > 0)
+		{
+			this->indices.insert(this->indices.end(), mesh->getIndices(), mesh->getIndices() + mesh->getIndexCount());
+			range.count = mesh->getIndexCount();
+		}
+		else
+		{
+			for (GLuint i = 0; i < mesh->getVertexCount(); i++)
+			{
+				this->indices.push_back(i);
+			}
+			range.count = mesh->getVertexCount();
+		}
+		this->geometryDirty = true;
+		return this->ranges[mesh] = range;
+	}
+
+public:
+	MeshBatch()
+	{
+		this->VAO = 0;
+		this->VBO = 0;
+		this->EBO = 0;
+		this->drawIndexBuffer = 0;
+		this->commandBuffer = 0;
+		this->drawBuffer = 0;
+		this->drawIndexCapacity = 0;
+		this->geometryDirty = false;
+		this->stats = { 0, 0, 0.0 };
+	}
+
+	~MeshBatch()
+	{
+		if (this->VAO)
+		{
+			GLState::get().forgetVertexArray(this->VAO);
+			glDeleteVertexArrays(1, &this->VAO);
+			GLuint buffers[] = { this->VBO, this->EBO, this->drawIndexBuffer, this->commandBuffer, this->drawBuffer };
+			glDeleteBuffers(5, buffers);
+		}
+	}
+
+	MeshBatch(const MeshBatch&) = delete;
+	MeshBatch& operator=(const MeshBatch&) = delete;
+
+	// Start a new list of draws, geometry already copied is kept
+	void begin()
+	{
+		this->meshes.clear();
+		this->commands.clear();
+		this->records.clear();
+	}
+
+	// Draw mesh with the material of that id in the material table
+	void add(Mesh* mesh, int material)
+	{
+		const Range& range = this->addGeometry(mesh);
+		GLuint index = (GLuint)this->commands.size();
+		this->commands.push_back({ range.count, 1, range.firstIndex, range.baseVertex, index });
+		this->records.push_back({ glm::mat4(1.0f), (GLuint)material, { 0, 0, 0 }, glm::vec4(0.0f) });
+		this->meshes.push_back(mesh);
+	}
+
+	// Every draw added since begin() in one call. The program must be a MATERIAL_TABLE permutation
+	// and the material table bound
+	void draw(Shader* shader)
+	{
+		if (this->commands.empty())
+		{
+			return;
+		}
+		double start = getTimeMs();
+		if (!this->VAO)
+		{
+			this->initVAO();
+		}
+		if (this->geometryDirty)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+			glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), this->vertices.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			GLState::get().bindVertexArray(this->VAO);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), this->indices.data(), GL_STATIC_DRAW);
+			this->geometryDirty = false;
+		}
+		if (this->commands.size() > this->drawIndexCapacity)
+		{
+			std::vector<GLuint> drawIndices(this->commands.size());
+			for (size_t i = 0; i < drawIndices.size(); i++)
+			{
+				drawIndices[i] = (GLuint)i;
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, this->drawIndexBuffer);
+			glBufferData(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			this->drawIndexCapacity = drawIndices.size();
+		}
+
+		// Transforms and probes may change every frame, the buffers are orphaned and written again
+		for (size_t i = 0; i < this->meshes.size(); i++)
+		{
+			this->records[i].model = this->meshes[i]->getModelMatrix();
+			this->records[i].probeBlend = this->meshes[i]->getProbeBlend();
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->drawBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, this->records.size() * sizeof(DrawRecord), this->records.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BINDING, this->drawBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, this->commands.size() * sizeof(IndirectCommand), this->commands.data(), GL_STREAM_DRAW);
+		this->stats.uploadMs = getTimeMs() - start;
+
+		shader->use();
+		GLState::get().bindVertexArray(this->VAO);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)this->commands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		this->stats.draws = (unsigned)this->commands.size();
+		this->stats.meshes = (unsigned)this->ranges.size();
+	}
+
+	size_t getDrawCount() const
+	{
+		return this->commands.size();
+	}
+
+	const Stats& getStats() const
+	{
+		return this->stats;
+	}
+};
@@ -0,0 +1,383 @@
+#pragma once
+
+// OTHER
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "SIMD.h"
+#include "ThreadPool.h"
+
+// Filters a mip level can be built with
+enum mip_filter_enum { MIP_FILTER_BOX = 0, MIP_FILTER_KAISER, MIP_FILTER_LANCZOS };
+
+// What the texels hold, which decides the space they are filtered in
+enum mip_content_enum
+{
+	MIP_CONTENT_LINEAR = 0,	// Data like roughness, filtered as stored
+	MIP_CONTENT_SRGB,		// Colour with sRGB gamma, filtered in linear light and encoded back
+	MIP_CONTENT_NORMAL		// Tangent space normals, filtered as vectors and renormalised
+};
+
+// One RGBA8 mip level
+struct MipLevel
+{
+	int width;
+	int height;
+	std::vector<unsigned char> rgba;
+};
+
+// CPU mip chain generation with a windowed sinc (Kaiser or Lanczos 3) instead of the driver's box
+// filter. Each level is made from the one above it with a separable polyphase filter that wraps
+// around the edges like GL_REPEAT. Rows are split into bands over the thread pool, inside a band
+// the horizontal pass runs four channels per SSE register and the vertical pass 8 floats per AVX2
+// register (4 with SSE, scalar otherwise).
+namespace MipGenerator
+{
+	inline const char* getFilterName(int filter)
+	{
+		switch (filter)
+		{
+		case MIP_FILTER_KAISER: return "Kaiser";
+		case MIP_FILTER_LANCZOS: return "Lanczos3";
+		default: return "Box";
+		}
+	}
+
+	// Kernels, x in destination pixels
+
+	inline float sinc(float x)
+	{
+		if (std::fabs(x) < 1e-5f)
+		{
+			return 1.0f;
+		}
+		x *= 3.14159265f;
+		return std::sin(x) / x;
+	}
+
+	// Zeroth order modified Bessel function of the first kind
+	inline float besselI0(float x)
+	{
+		float sum = 1.0f, term = 1.0f;
+		for (int k = 1; k < 20; k++)
+		{
+			term *= (x * 0.5f / k) * (x * 0.5f / k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	inline float getRadius(int filter)
+	{
+		return filter == MIP_FILTER_BOX ? 0.5f : 3.0f;
+	}
+
+	inline float kernel(int filter, float x)
+	{
+		x = std::fabs(x);
+		switch (filter)
+		{
+		case MIP_FILTER_KAISER:
+		{
+			// Width 3, alpha 4
+			const float alpha = 4.0f;
+			if (x >= 3.0f)
+			{
+				return 0.0f;
+			}
+			float t = x / 3.0f;
+			return sinc(x) * besselI0(alpha * std::sqrt(1.0f - t * t)) / besselI0(alpha);
+		}
+		case MIP_FILTER_LANCZOS:
+			return x < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+		default:
+			return x <= 0.5f ? 1.0f : 0.0f;
+		}
+	}
+
+	// Source indices and normalised weights of every destination pixel along one axis
+	struct Taps
+	{
+		int count;
+		std::vector<int> index;
+		std::vector<float> weight;
+	};
+
+	inline Taps buildTaps(int filter, int source, int destination)
+	{
+		Taps taps;
+		float scale = (float)source / destination;
+		float support = getRadius(filter) * scale;
+		taps.count = (int)std::ceil(support * 2.0f) + 1;
+		taps.index.resize((size_t)destination * taps.count);
+		taps.weight.resize((size_t)destination * taps.count);
+		for (int i = 0; i < destination; i++)
+		{
+			float centre = (i + 0.5f) * scale;
+			int first = (int)std::floor(centre - support);
+			float total = 0.0f;
+			for (int t = 0; t < taps.count; t++)
+			{
+				int x = first + t;
+				float w = kernel(filter, (x + 0.5f - centre) / scale);
+				taps.index[(size_t)i * taps.count + t] = ((x % source) + source) % source;
+				taps.weight[(size_t)i * taps.count + t] = w;
+				total += w;
+			}
+			for (int t = 0; t < taps.count; t++)
+			{
+				taps.weight[(size_t)i * taps.count + t] /= total;
+			}
+		}
+		return taps;
+	}
+
+	// Conversions between bytes and the space the filter runs in
+
+	inline float srgbToLinear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	inline float linearToSrgb(float c)
+	{
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	struct Tables
+	{
+		float decode[3][256];		// Per content, colour channels
+		unsigned char encodeSrgb[65536];	// Linear value * 65535 to sRGB byte
+	};
+
+	inline const Tables& getTables()
+	{
+		static const Tables* tables = []()
+		{
+			Tables* t = new Tables();
+			for (int i = 0; i < 256; i++)
+			{
+				t->decode[MIP_CONTENT_LINEAR][i] = i / 255.0f;
+				t->decode[MIP_CONTENT_SRGB][i] = srgbToLinear(i / 255.0f);
+				t->decode[MIP_CONTENT_NORMAL][i] = i / 127.5f - 1.0f;
+			}
+			for (int i = 0; i < 65536; i++)
+			{
+				t->encodeSrgb[i] = (unsigned char)(linearToSrgb(i / 65535.0f) * 255.0f + 0.5f);
+			}
+			return t;
+		}();
+		return *tables;
+	}
+
+	inline unsigned char toByte(float v)
+	{
+		return (unsigned char)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	// Passes
+
+	// Filter one source row horizontally into destination width RGBA floats. The row is decoded
+	// into scratch (source width * 4 floats) first so every texel is converted once
+	inline void filterRow(const unsigned char* row, int sourceWidth, const float* decode, const Taps& taps, int width, float* scratch, float* out)
+	{
+		for (int i = 0; i < sourceWidth; i++)
+		{
+			const unsigned char* texel = row + (size_t)i * 4;
+			float* value = scratch + (size_t)i * 4;
+			value[0] = decode[texel[0]];
+			value[1] = decode[texel[1]];
+			value[2] = decode[texel[2]];
+			value[3] = texel[3] * (1.0f / 255.0f);
+		}
+		for (int i = 0; i < width; i++)
+		{
+			const int* index = &taps.index[(size_t)i * taps.count];
+			const float* weight = &taps.weight[(size_t)i * taps.count];
+#ifdef ENGINE_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (int t = 0; t < taps.count; t++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(scratch + (size_t)index[t] * 4), _mm_set1_ps(weight[t])));
+			}
+			_mm_storeu_ps(out + (size_t)i * 4, sum);
+#else
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int t = 0; t < taps.count; t++)
+			{
+				const float* value = scratch + (size_t)index[t] * 4;
+				for (int c = 0; c < 4; c++)
+				{
+					sum[c] += value[c] * weight[t];
+				}
+			}
+			std::copy(sum, sum + 4, out + (size_t)i * 4);
+#endif
+		}
+	}
+
+	// out = sum of weight[t] * rows[t], count floats per row
+	inline void filterColumn(const float* const* rows, const float* weight, int taps, size_t count, float* out)
+	{
+		size_t i = 0;
+#if defined(ENGINE_AVX2)
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 sum = _mm256_setzero_ps();
+			for (int t = 0; t < taps; t++)
+			{
+				sum = _mm256_fmadd_ps(_mm256_loadu_ps(rows[t] + i), _mm256_set1_ps(weight[t]), sum);
+			}
+			_mm256_storeu_ps(out + i, sum);
+		}
+#endif
+#ifdef ENGINE_SSE2
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int t = 0; t < taps; t++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[t] + i), _mm_set1_ps(weight[t])));
+			}
+			_mm_storeu_ps(out + i, sum);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			float sum = 0.0f;
+			for (int t = 0; t < taps; t++)
+			{
+				sum += rows[t][i] * weight[t];
+			}
+			out[i] = sum;
+		}
+	}
+
+	// Write a row of filtered RGBA floats back as bytes
+	inline void encodeRow(const float* in, int width, int content, unsigned char* out)
+	{
+		const Tables& tables = getTables();
+		for (int i = 0; i < width; i++)
+		{
+			const float* p = in + (size_t)i * 4;
+			unsigned char* texel = out + (size_t)i * 4;
+			if (content == MIP_CONTENT_SRGB)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					texel[c] = tables.encodeSrgb[(int)(std::min(std::max(p[c], 0.0f), 1.0f) * 65535.0f + 0.5f)];
+				}
+			}
+			else if (content == MIP_CONTENT_NORMAL)
+			{
+				// Averaged normals get shorter, scale them back onto the unit sphere
+				float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+				float scale = length > 1e-6f ? 1.0f / length : 0.0f;
+				float z = length > 1e-6f ? p[2] * scale : 1.0f;
+				texel[0] = toByte(p[0] * scale * 0.5f + 0.5f);
+				texel[1] = toByte(p[1] * scale * 0.5f + 0.5f);
+				texel[2] = toByte(z * 0.5f + 0.5f);
+			}
+			else
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					texel[c] = toByte(p[c]);
+				}
+			}
+			texel[3] = toByte(p[3]);
+		}
+	}
+
+	// Half size level (rounded down, at least 1) of an RGBA8 image
+	inline MipLevel downsample(const unsigned char* rgba, int width, int height, int content, int filter, ThreadPool* pool)
+	{
+		MipLevel level;
+		level.width = std::max(1, width / 2);
+		level.height = std::max(1, height / 2);
+		level.rgba.resize((size_t)level.width * level.height * 4);
+		Taps horizontal = buildTaps(filter, width, level.width);
+		Taps vertical = buildTaps(filter, height, level.height);
+		const float* decode = getTables().decode[content];
+		const int outWidth = level.width;
+		const size_t rowFloats = (size_t)outWidth * 4;
+
+		// Each band filters the source rows it needs horizontally once, then runs the vertical pass.
+		// Bands overlap by the filter support, which is the only work done twice
+		const size_t bandRows = 32;
+		size_t bands = (level.height + bandRows - 1) / bandRows;
+		auto filterBands = [&](size_t begin, size_t end)
+		{
+			std::vector<float> rows;
+			std::vector<float> out(rowFloats);
+			std::vector<float> scratch((size_t)width * 4);
+			std::vector<const float*> pointers(vertical.count);
+			std::vector<int> needed;
+			std::vector<int> rowSlot((size_t)height, -1);
+			for (size_t band = begin; band < end; band++)
+			{
+				int y0 = (int)(band * bandRows);
+				int y1 = std::min(level.height, y0 + (int)bandRows);
+				// Source rows the band touches
+				needed.clear();
+				for (int y = y0; y < y1; y++)
+				{
+					for (int t = 0; t < vertical.count; t++)
+					{
+						int source = vertical.index[(size_t)y * vertical.count + t];
+						if (rowSlot[source] < 0)
+						{
+							rowSlot[source] = (int)needed.size();
+							needed.push_back(source);
+						}
+					}
+				}
+				rows.resize(needed.size() * rowFloats);
+				for (size_t i = 0; i < needed.size(); i++)
+				{
+					filterRow(rgba + (size_t)needed[i] * width * 4, width, decode, horizontal, outWidth, scratch.data(), &rows[i * rowFloats]);
+				}
+				for (int y = y0; y < y1; y++)
+				{
+					for (int t = 0; t < vertical.count; t++)
+					{
+						pointers[t] = &rows[(size_t)rowSlot[vertical.index[(size_t)y * vertical.count + t]] * rowFloats];
+					}
+					filterColumn(pointers.data(), &vertical.weight[(size_t)y * vertical.count], vertical.count, rowFloats, out.data());
+					encodeRow(out.data(), outWidth, content, &level.rgba[(size_t)y * rowFloats]);
+				}
+				for (int i : needed)
+				{
+					rowSlot[i] = -1;
+				}
+			}
+		};
+		if (pool && bands > 1)
+		{
+			pool->parallelFor(bands, 1, filterBands);
+		}
+		else
+		{
+			filterBands(0, bands);
+		}
+		return level;
+	}
+
+	// Every level below the given image down to 1x1. Levels depend on the one above, so they are
+	// made in turn with the rows of each one spread over the pool (nullptr runs on this thread)
+	inline std::vector<MipLevel> generate(const unsigned char* rgba, int width, int height, int content, int filter = MIP_FILTER_KAISER, ThreadPool* pool = &ThreadPool::get())
+	{
+		std::vector<MipLevel> levels;
+		const unsigned char* source = rgba;
+		while (width > 1 || height > 1)
+		{
+			levels.push_back(downsample(source, width, height, content, filter, pool));
+			source = levels.back().rgba.data();
+			width = levels.back().width;
+			height = levels.back().height;
+		}
+		return levels;
+	}
+}
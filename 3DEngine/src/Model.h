@@ -5,20 +5,30 @@
 #include"Shader.h"
 #include"Material.h"
 #include"OBJParser.h"
+#include"RenderQueue.h"
+#include"TextureCache.h"
+#include"TextureStreamer.h"
+#include"MaterialTable.h"
+#include"MeshBatch.h"
+#include"ReflectionProbes.h"
 
 class Model
 {
 
 private:
 	Material* material;
-	Texture* overrideTextureDiffuse;
-	Texture* overrideTextureSpecular;
-	Texture* overrideTextureAlbedo;
-	Texture* overrideTextureMetal;
-	Texture* overrideTextureRough;
-	Texture* overrideTextureNormal;
+	// Handles keep the textures loaded for as long as the model exists
+	TextureHandle overrideTextureDiffuse;
+	TextureHandle overrideTextureSpecular;
+	TextureHandle overrideTextureAlbedo;
+	TextureHandle overrideTextureMetal;
+	TextureHandle overrideTextureRough;
+	TextureHandle overrideTextureNormal;
+	TextureHandle overrideTextureORM;
 	std::vector<Mesh*> meshes;
 	glm::vec3 position;
+	// Material and textures bound for every mesh of this model when drawn through a render queue
+	RenderMaterial renderMaterial;
 
 	void updateUniforms()
 	{
@@ -27,12 +37,13 @@ private:
 
 public:
 	// Deprecated constructor, Was usefull before the OBJ loader was implemented (With primitives etc..)
-	Model(glm::vec3 position, Material* material, Texture* texDif, Texture* texSpec, std::vector<Mesh*> meshes)
+	Model(glm::vec3 position, Material* material, TextureHandle texDif, TextureHandle texSpec, std::vector<Mesh*> meshes)
 	{
 		this->position = position;
 		this->material = material;
 		this->overrideTextureDiffuse = texDif;
 		this->overrideTextureSpecular = texSpec;
+		this->renderMaterial = { material, { texDif.get(), texSpec.get() }, 2 };
 
 		for (auto* i : meshes)
 		{
@@ -47,13 +58,14 @@ public:
 
 	}
 	// Create Blinn Phong model from OBJ file
-	Model(glm::vec3 position, Material* material, Texture* texDif, Texture* texSpec, const char* objFile)
+	Model(glm::vec3 position, Material* material, TextureHandle texDif, TextureHandle texSpec, const char* objFile)
 	{
 		// Get position, material and texture overrides
 		this->position = position;
 		this->material = material;
 		this->overrideTextureDiffuse = texDif;
 		this->overrideTextureSpecular = texSpec;
+		this->renderMaterial = { material, { texDif.get(), texSpec.get() }, 2 };
 		// Load all OBJ meshes
 		std::vector<Vertex> mesh = loadOBJ(objFile);
 		this->meshes.push_back(new Mesh(mesh.data(), mesh.size(), NULL, 0, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(.05f)));
@@ -66,7 +78,7 @@ public:
 
 	}
 	// Create PBR model from OBJ file
-	Model(glm::vec3 position, Material* material, Texture* texAlbedo, Texture* texMetal, Texture* texRough, Texture* texNormal, const char* objFile)
+	Model(glm::vec3 position, Material* material, TextureHandle texAlbedo, TextureHandle texMetal, TextureHandle texRough, TextureHandle texNormal, const char* objFile)
 	{
 		// Get position, material and texture overrides.
 		this->position = position;
@@ -75,6 +87,7 @@ public:
 		this->overrideTextureMetal = texMetal;
 		this->overrideTextureRough = texRough;
 		this->overrideTextureNormal = texNormal;
+		this->renderMaterial = { material, { texAlbedo.get(), texMetal.get(), texRough.get(), texNormal.get() }, 4 };
 		// Load all OBJ meshes
 		std::vector<Vertex> mesh = loadOBJ(objFile);
 		this->meshes.push_back(new Mesh(mesh.data(), mesh.size(), NULL, 0, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(.05f)));
@@ -86,6 +99,38 @@ public:
 		}
 
 	}
+	// Create PBR model from OBJ file with occlusion, roughness and metallic packed in one texture
+	Model(glm::vec3 position, Material* material, TextureHandle texAlbedo, TextureHandle texORM, TextureHandle texNormal, const char* objFile)
+	{
+		this->position = position;
+		this->material = material;
+		this->overrideTextureAlbedo = texAlbedo;
+		this->overrideTextureORM = texORM;
+		this->overrideTextureNormal = texNormal;
+		this->renderMaterial = { material, { texAlbedo.get(), texORM.get(), texNormal.get() }, 3 };
+		std::vector<Vertex> mesh = loadOBJ(objFile);
+		this->meshes.push_back(new Mesh(mesh.data(), mesh.size(), NULL, 0, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(.05f)));
+		for (auto& i : this->meshes)
+		{
+			i->move(this->position);
+			i->setOrigin(this->position);
+		}
+	}
+
+	// Create PBR model from OBJ file drawn with textures owned elsewhere, like the atlases of a virtual texture or streamed textures
+	Model(glm::vec3 position, Material* material, Texture* texAlbedo, Texture* texORM, Texture* texNormal, const char* objFile)
+	{
+		this->position = position;
+		this->material = material;
+		this->renderMaterial = { material, { texAlbedo, texORM, texNormal }, 3 };
+		std::vector<Vertex> mesh = loadOBJ(objFile);
+		this->meshes.push_back(new Mesh(mesh.data(), mesh.size(), NULL, 0, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(.05f)));
+		for (auto& i : this->meshes)
+		{
+			i->move(this->position);
+			i->setOrigin(this->position);
+		}
+	}
 
 	~Model()
 	{
@@ -118,45 +163,50 @@ public:
 		this->updateUniforms();
 	}
 
-	void render(Shader* shader)
+	// Queue every mesh of the model, the queue binds the material once per batch
+	void submit(RenderQueue& queue, Shader* shader, unsigned pass = PASS_OPAQUE)
 	{
-		// Update uniforms
-		this->updateUniforms();
-
-		// Update material uniform
-		this->material->sendToShader(*shader);
-		shader->use();
-
-		// Bind new textures
 		for (auto& i : this->meshes)
 		{
-			this->overrideTextureDiffuse->bind(0);
-			this->overrideTextureSpecular->bind(1);
-
-			i->render(shader);
+			queue.submit(pass, shader, &this->renderMaterial, i);
 		}
-		
 	}
 
-	void renderPBR(Shader* shader)
+	// Add every mesh to a multi draw with the model's material from the table. False if the
+	// material can't go in the table, the model is then queued as usual
+	bool submit(MeshBatch& batch, MaterialTable& table)
 	{
-		// Update uniforms
-		this->updateUniforms();
-
-		// Update material Uniform
-		this->material->sendToShader(*shader);
-		shader->use();
+		int material = table.add(&this->renderMaterial);
+		if (material < 0)
+		{
+			return false;
+		}
+		for (auto& i : this->meshes)
+		{
+			batch.add(i, material);
+		}
+		return true;
+	}
 
-		// Bind new textures
+	// Pick the reflection probes lighting each mesh from its bounds where it is now
+	void selectProbes(const ReflectionProbes& probes)
+	{
 		for (auto& i : this->meshes)
 		{
-			this->overrideTextureAlbedo->bind(0);
-			this->overrideTextureMetal->bind(1);
-			this->overrideTextureRough->bind(2);
-			this->overrideTextureNormal->bind(3);
-			i->render(shader);
+			glm::vec3 centre;
+			float radius;
+			i->getWorldBounds(centre, radius);
+			i->setProbeBlend(probes.select(centre, radius));
 		}
+	}
 
+	// Ask for the mip levels the model's textures need to cover each of its meshes
+	void stream(TextureStreamer& streamer)
+	{
+		for (auto& i : this->meshes)
+		{
+			streamer.request(this->renderMaterial, *i);
+		}
 	}
 
 };
\ No newline at end of file
@@ -0,0 +1,406 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// MTB
+#include <glm.hpp>
+#include <gtc\matrix_transform.hpp>
+
+// ImGUI
+#include "vendor/imgui/imgui.h"
+
+// OTHER
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+#include "GLState.h"
+#include "Shader.h"
+#include "IBLCache.h"
+#include "IBLRebaker.h"
+
+// Local specular lighting from cube maps captured at placed points in the scene, on top of the global
+// prefilter map. Each probe has a box: draws whose bounds overlap it are lit by it, and reflections
+// are box projected onto it (parallax correction) so they line up with the walls the box stands for.
+// Probes are prefiltered like the global map into one cube map array, with their boxes in a uniform
+// block, so FragmentCorePBR built with REFLECTION_PROBES picks any of them per draw.
+// Capture is spread over frames, one step each: the six faces of the scene are drawn one per frame
+// into a capture cube, then the six faces of the array layer are prefiltered from it one per frame.
+// A probe being recaptured keeps lighting draws meanwhile, so its faces change over those frames.
+class ReflectionProbes
+{
+public:
+	// Size of the array and uniform block, matches FragmentCorePBR.glsl
+	static const int MAX_PROBES = 8;
+	// Uniform buffer binding, matches FragmentCorePBR.glsl
+	static const GLuint UNIFORM_BINDING = 4;
+	// Frames to capture a probe, six faces drawn then six prefiltered
+	static const int CAPTURE_STEPS = 12;
+
+	struct Stats
+	{
+		unsigned stepsDone;
+		unsigned probesCaptured;
+		double lastStepMs;		// Render thread time of the last step
+	};
+
+	// Draws the scene without tonemapping into the bound framebuffer, seen from position
+	typedef std::function<void(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position)> SceneRenderer;
+
+private:
+	struct Probe
+	{
+		glm::vec3 position;
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+		// Every face has been prefiltered at least once
+		bool ready;
+	};
+
+	// std140 layout of one entry of the ReflectionProbes block
+	struct ProbeData
+	{
+		glm::vec4 position;
+		glm::vec4 boxMin;
+		glm::vec4 boxMax;
+	};
+
+	Shader* prefilter;
+	SceneRenderer renderScene;
+	std::function<void()> renderCube;
+	int size;
+	int levels;
+	int samples;
+	float nearPlane;
+	float farPlane;
+	GLint unit;
+
+	std::vector<Probe> probes;
+	// Probes waiting for a capture, the first is in progress at step
+	std::deque<int> pending;
+	int step;
+
+	GLuint probeArray;
+	GLuint captureCube;
+	GLuint captureDepth;
+	GLuint captureFramebuffer;
+	GLuint prefilterFramebuffer;
+	GLuint buffer;
+	Stats stats;
+
+	static double getTimeMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Textures and framebuffers, made with the first probe
+	void createTargets()
+	{
+		glGenTextures(1, &this->probeArray);
+		GLState::get().bindTexture(this->unit, GL_TEXTURE_CUBE_MAP_ARRAY, this->probeArray);
+		glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, this->levels, GL_RGB16F, this->size, this->size, MAX_PROBES * 6);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// The prefilter reads the capture through its mips like initIBL does the environment
+		int captureLevels = 1;
+		while ((this->size >> captureLevels) > 0)
+		{
+			captureLevels++;
+		}
+		glGenTextures(1, &this->captureCube);
+		GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, this->captureCube);
+		glTexStorage2D(GL_TEXTURE_CUBE_MAP, captureLevels, GL_RGB16F, this->size, this->size);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		glGenRenderbuffers(1, &this->captureDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, this->captureDepth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, this->size, this->size);
+		glGenFramebuffers(1, &this->captureFramebuffer);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, this->captureFramebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->captureDepth);
+		// Prefiltering draws without depth
+		glGenFramebuffers(1, &this->prefilterFramebuffer);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		glGenBuffers(1, &this->buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+		glBufferData(GL_UNIFORM_BUFFER, MAX_PROBES * sizeof(ProbeData), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BINDING, this->buffer);
+	}
+
+	void uploadProbe(int index)
+	{
+		const Probe& probe = this->probes[index];
+		ProbeData data = { glm::vec4(probe.position, 1.0f), glm::vec4(probe.boxMin, 1.0f), glm::vec4(probe.boxMax, 1.0f) };
+		glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, index * sizeof(ProbeData), sizeof(ProbeData), &data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	// Draw the scene into one face of the capture cube
+	void captureFace(const Probe& probe, int face)
+	{
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, this->captureFramebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, this->captureCube, 0);
+		GLState::get().setViewport(0, 0, this->size, this->size);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, this->nearPlane, this->farPlane);
+		glm::mat4 view = IBLRebaker::getCaptureView(face) * glm::translate(glm::mat4(1.0f), -probe.position);
+		this->renderScene(view, projection, probe.position);
+	}
+
+	// Prefilter every mip of one face of the probe's array layer from the capture cube
+	void prefilterFace(int index, int face)
+	{
+		GLState::get().bindTexture(0, GL_TEXTURE_CUBE_MAP, this->captureCube);
+		if (face == 0)
+		{
+			glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+		}
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, this->prefilterFramebuffer);
+		this->prefilter->set1i(0, "environmentMap");
+		// The capture cube is the source rather than the environment map
+		this->prefilter->set1i(this->samples, "sampleCount");
+		this->prefilter->set1f((float)this->size, "environmentSize");
+		this->prefilter->setMat4fv(IBLRebaker::getCaptureProjection(), "projection");
+		this->prefilter->setMat4fv(IBLRebaker::getCaptureView(face), "view");
+		this->prefilter->use();
+		for (int level = 0; level < this->levels; level++)
+		{
+			int levelSize = std::max(this->size >> level, 1);
+			this->prefilter->set1f((float)level / (float)std::max(this->levels - 1, 1), "roughness");
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, this->probeArray, level, index * 6 + face);
+			GLState::get().setViewport(0, 0, levelSize, levelSize);
+			this->renderCube();
+		}
+	}
+
+public:
+	// Probes are prefiltered with the global map's prefilter program and settings, so the shader reads
+	// both with the same roughness to mip mapping. Captures are the size of the prefilter map. The array
+	// is bound to unit
+	ReflectionProbes(Shader* prefilter, const IBLCache::Settings& settings, GLint unit, float nearPlane, float farPlane, SceneRenderer renderScene, std::function<void()> renderCube)
+	{
+		this->prefilter = prefilter;
+		this->renderScene = renderScene;
+		this->renderCube = renderCube;
+		this->size = settings.prefilterSize;
+		this->levels = settings.prefilterLevels;
+		this->samples = settings.prefilterSamples;
+		this->unit = unit;
+		this->nearPlane = nearPlane;
+		this->farPlane = farPlane;
+		this->step = 0;
+		this->probeArray = 0;
+		this->captureCube = 0;
+		this->captureDepth = 0;
+		this->captureFramebuffer = 0;
+		this->prefilterFramebuffer = 0;
+		this->buffer = 0;
+		std::memset(&this->stats, 0, sizeof(this->stats));
+	}
+
+	~ReflectionProbes()
+	{
+		if (this->probeArray)
+		{
+			GLState::get().forgetTexture(this->probeArray);
+			GLState::get().forgetTexture(this->captureCube);
+			GLuint textures[] = { this->probeArray, this->captureCube };
+			glDeleteTextures(2, textures);
+			glDeleteRenderbuffers(1, &this->captureDepth);
+			GLuint framebuffers[] = { this->captureFramebuffer, this->prefilterFramebuffer };
+			glDeleteFramebuffers(2, framebuffers);
+			glDeleteBuffers(1, &this->buffer);
+		}
+	}
+
+	ReflectionProbes(const ReflectionProbes&) = delete;
+	ReflectionProbes& operator=(const ReflectionProbes&) = delete;
+
+	// Place a probe capturing from position, lighting and parallax correcting within the box. The
+	// position must lie in the box. Returns its index, -1 when all MAX_PROBES are placed
+	int add(const glm::vec3& position, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		if ((int)this->probes.size() >= MAX_PROBES)
+		{
+			std::cout << "ERROR: Reflection probes: all " << MAX_PROBES << " probes are placed" << std::endl;
+			return -1;
+		}
+		if (!this->probeArray)
+		{
+			this->createTargets();
+		}
+		this->probes.push_back({ position, boxMin, boxMax, false });
+		int index = (int)this->probes.size() - 1;
+		this->uploadProbe(index);
+		this->recapture(index);
+		return index;
+	}
+
+	// Move a probe or its box, it is captured again from the new position
+	void set(int index, const glm::vec3& position, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		Probe& probe = this->probes[index];
+		probe.position = position;
+		probe.boxMin = boxMin;
+		probe.boxMax = boxMax;
+		this->uploadProbe(index);
+		// A capture in progress would mix faces from both positions, start it over
+		if (!this->pending.empty() && this->pending.front() == index)
+		{
+			this->step = 0;
+		}
+		this->recapture(index);
+	}
+
+	// Queue a probe for capture, after any already waiting
+	void recapture(int index)
+	{
+		if (std::find(this->pending.begin(), this->pending.end(), index) == this->pending.end())
+		{
+			this->pending.push_back(index);
+		}
+	}
+
+	// Queue every probe, e.g. after the environment or the scene changed
+	void recaptureAll()
+	{
+		for (int i = 0; i < (int)this->probes.size(); i++)
+		{
+			this->recapture(i);
+		}
+	}
+
+	// Run one capture step, called once per frame on the render thread. Leaves the default framebuffer
+	// bound and the viewport at the size of the last face drawn
+	void update()
+	{
+		if (this->pending.empty())
+		{
+			return;
+		}
+		double start = getTimeMs();
+		int index = this->pending.front();
+		if (this->step < 6)
+		{
+			this->captureFace(this->probes[index], this->step);
+		}
+		else
+		{
+			this->prefilterFace(index, this->step - 6);
+		}
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+		this->step++;
+		this->stats.stepsDone++;
+		if (this->step == CAPTURE_STEPS)
+		{
+			this->probes[index].ready = true;
+			this->pending.pop_front();
+			this->step = 0;
+			this->stats.probesCaptured++;
+		}
+		this->stats.lastStepMs = getTimeMs() - start;
+	}
+
+	// Probes lighting a draw with these world bounds: the two whose boxes hold the largest share of
+	// the bounding box, in x and y, with those shares in z and w. The global prefilter map lights the
+	// rest. Shares past 1 in total, where boxes overlap, are scaled down to 1
+	glm::vec4 select(const glm::vec3& centre, float radius) const
+	{
+		int best[2] = { 0, 0 };
+		float weights[2] = { 0.0f, 0.0f };
+		glm::vec3 boundsMin = centre - glm::vec3(radius);
+		glm::vec3 boundsMax = centre + glm::vec3(radius);
+		float volume = 8.0f * radius * radius * radius;
+		for (int i = 0; i < (int)this->probes.size(); i++)
+		{
+			const Probe& probe = this->probes[i];
+			if (!probe.ready)
+			{
+				continue;
+			}
+			float weight;
+			if (volume > 0.0f)
+			{
+				glm::vec3 overlap = glm::max(glm::min(boundsMax, probe.boxMax) - glm::max(boundsMin, probe.boxMin), glm::vec3(0.0f));
+				weight = overlap.x * overlap.y * overlap.z / volume;
+			}
+			else
+			{
+				weight = glm::all(glm::greaterThanEqual(centre, probe.boxMin)) && glm::all(glm::lessThanEqual(centre, probe.boxMax)) ? 1.0f : 0.0f;
+			}
+			if (weight > weights[0])
+			{
+				best[1] = best[0];
+				weights[1] = weights[0];
+				best[0] = i;
+				weights[0] = weight;
+			}
+			else if (weight > weights[1])
+			{
+				best[1] = i;
+				weights[1] = weight;
+			}
+		}
+		float total = weights[0] + weights[1];
+		if (total > 1.0f)
+		{
+			weights[0] /= total;
+			weights[1] /= total;
+		}
+		return glm::vec4((float)best[0], (float)best[1], weights[0], weights[1]);
+	}
+
+	int getCount() const
+	{
+		return (int)this->probes.size();
+	}
+
+	bool isCapturing() const
+	{
+		return !this->pending.empty();
+	}
+
+	const Stats& getStats() const
+	{
+		return this->stats;
+	}
+
+	void renderGUI()
+	{
+		ImGui::Begin("Reflection Probes");
+		ImGui::Text("%d/%d probes, %dx%d prefiltered texels per face", this->getCount(), MAX_PROBES, this->size, this->size);
+		for (int i = 0; i < (int)this->probes.size(); i++)
+		{
+			const Probe& probe = this->probes[i];
+			bool capturing = !this->pending.empty() && this->pending.front() == i;
+			ImGui::Text("%d: (%.1f, %.1f, %.1f), box %.1f x %.1f x %.1f, %s", i, probe.position.x, probe.position.y, probe.position.z,
+				probe.boxMax.x - probe.boxMin.x, probe.boxMax.y - probe.boxMin.y, probe.boxMax.z - probe.boxMin.z,
+				capturing ? "capturing" : (probe.ready ? "ready" : "waiting"));
+		}
+		if (this->isCapturing())
+		{
+			ImGui::Text("Capturing probe %d: step %d/%d, %.3f ms last step", this->pending.front(), this->step, CAPTURE_STEPS, this->stats.lastStepMs);
+		}
+		if (ImGui::Button("Recapture all"))
+		{
+			this->recaptureAll();
+		}
+		ImGui::End();
+	}
+};
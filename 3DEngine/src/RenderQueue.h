@@ -0,0 +1,428 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// MTB
+#include <glm.hpp>
+#include <mat4x4.hpp>
+
+// OTHER
+#include <vector>
+#include <map>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "Material.h"
+#include "ThreadPool.h"
+
+// Render passes, executed in this order
+enum render_pass_enum { PASS_OPAQUE = 0, PASS_TRANSPARENT };
+
+// Everything a draw needs bound besides the program, shared by all meshes of a model
+struct RenderMaterial
+{
+	static const int MAX_TEXTURES = 4;
+
+	Material* material;
+	Texture* textures[MAX_TEXTURES];
+	int textureCount;
+
+	// Sort id cached by the render queue, valid while sortGeneration matches the queue's, which is never 0
+	mutable unsigned sortId = 0;
+	mutable unsigned sortGeneration = 0;
+};
+
+// Sort key layout, most significant first:
+// | pass 4 | program 12 | material 16 | depth 24 | unused 8 |
+// Sorting the keys groups draws by pass, then program, then material and orders each group front to back.
+// Program ids come from the shader, material ids from a table shared by every queue.
+class RenderQueue
+{
+public:
+	struct DrawCommand
+	{
+		Shader* shader;
+		const RenderMaterial* material;
+		Mesh* mesh;
+	};
+
+	struct Stats
+	{
+		unsigned submitted;
+		unsigned culled;
+		unsigned drawn;
+		unsigned programChanges;
+		unsigned materialChanges;
+		double sortMs;
+		double executeMs;
+	};
+
+	static const unsigned DEPTH_BITS = 24;
+
+private:
+	struct SortItem
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	std::vector<SortItem> items;
+	std::vector<SortItem> scratch;
+	std::vector<DrawCommand> commands;
+
+	// Compact material ids, shared by all queues. Materials with the same material and textures share an id
+	struct MaterialIds
+	{
+		std::map<std::array<const void*, RenderMaterial::MAX_TEXTURES + 1>, unsigned> ids;
+		unsigned generation;
+		unsigned textureDeletes;
+	};
+
+	// Camera for culling and depth
+	glm::vec4 frustumPlanes[6];
+	glm::vec3 cameraPosition;
+	float farPlane;
+
+	// Counts below this are sorted on the calling thread
+	size_t parallelThreshold;
+
+	Stats stats;
+
+	static double getTimeMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static MaterialIds& getMaterialIds()
+	{
+		static MaterialIds materialIds = { {}, 1, 0 };
+		return materialIds;
+	}
+
+	// Looked up once per material, then read from the material until the table is reset. The table
+	// starts over when a texture is deleted, its address may come back as another texture, or when
+	// the ids run out. Draws already queued keep their old ids, which only costs some grouping
+	static unsigned getMaterialId(const RenderMaterial* material)
+	{
+		MaterialIds& materialIds = getMaterialIds();
+		if (materialIds.textureDeletes != Texture::getDeleteCount() || materialIds.ids.size() > 0xFFFF)
+		{
+			materialIds.ids.clear();
+			materialIds.generation++;
+			materialIds.textureDeletes = Texture::getDeleteCount();
+		}
+		if (material->sortGeneration == materialIds.generation)
+		{
+			return material->sortId;
+		}
+
+		std::array<const void*, RenderMaterial::MAX_TEXTURES + 1> key;
+		key.fill(nullptr);
+		key[0] = material->material;
+		for (int i = 0; i < material->textureCount; i++)
+		{
+			key[i + 1] = material->textures[i];
+		}
+		auto it = materialIds.ids.insert({ key, (unsigned)materialIds.ids.size() }).first;
+		material->sortId = it->second;
+		material->sortGeneration = materialIds.generation;
+		return it->second;
+	}
+
+	// Sphere against the six frustum planes
+	bool isVisible(const glm::vec3& centre, float radius) const
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			if (glm::dot(glm::vec3(this->frustumPlanes[i]), centre) + this->frustumPlanes[i].w < -radius)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// One LSD pass over byte 'shift' on the calling thread. Returns false if the pass was skipped
+	static bool radixPass(const SortItem* src, SortItem* dst, size_t count, unsigned shift)
+	{
+		size_t histogram[256] = { 0 };
+		for (size_t i = 0; i < count; i++)
+		{
+			histogram[(src[i].key >> shift) & 0xFF]++;
+		}
+		// Every key has the same byte, the order would not change
+		if (histogram[(src[0].key >> shift) & 0xFF] == count)
+		{
+			return false;
+		}
+		size_t offset = 0;
+		for (int b = 0; b < 256; b++)
+		{
+			size_t c = histogram[b];
+			histogram[b] = offset;
+			offset += c;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+		}
+		return true;
+	}
+
+	// Same pass split over the thread pool. Each chunk builds its own histogram, the offsets are
+	// laid out chunk by chunk within each bucket so the scatter stays stable.
+	static bool radixPassParallel(const SortItem* src, SortItem* dst, size_t count, unsigned shift, ThreadPool& pool)
+	{
+		size_t chunkCount = pool.getThreadCount() + 1;
+		size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+		std::vector<std::array<size_t, 256>> histograms(chunkCount);
+
+		pool.parallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t c = begin; c < end; c++)
+			{
+				std::array<size_t, 256>& histogram = histograms[c];
+				histogram.fill(0);
+				size_t last = std::min(count, (c + 1) * chunkSize);
+				for (size_t i = c * chunkSize; i < last; i++)
+				{
+					histogram[(src[i].key >> shift) & 0xFF]++;
+				}
+			}
+		});
+
+		size_t firstBucket = (src[0].key >> shift) & 0xFF;
+		size_t firstTotal = 0;
+		for (size_t c = 0; c < chunkCount; c++)
+		{
+			firstTotal += histograms[c][firstBucket];
+		}
+		if (firstTotal == count)
+		{
+			return false;
+		}
+
+		size_t offset = 0;
+		for (int b = 0; b < 256; b++)
+		{
+			for (size_t c = 0; c < chunkCount; c++)
+			{
+				size_t n = histograms[c][b];
+				histograms[c][b] = offset;
+				offset += n;
+			}
+		}
+
+		pool.parallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t c = begin; c < end; c++)
+			{
+				std::array<size_t, 256>& histogram = histograms[c];
+				size_t last = std::min(count, (c + 1) * chunkSize);
+				for (size_t i = c * chunkSize; i < last; i++)
+				{
+					dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+				}
+			}
+		});
+		return true;
+	}
+
+public:
+	RenderQueue()
+	{
+		this->parallelThreshold = 1 << 16;
+		this->cameraPosition = glm::vec3(0.0f);
+		this->farPlane = 1000.0f;
+		for (int i = 0; i < 6; i++)
+		{
+			this->frustumPlanes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+		std::memset(&this->stats, 0, sizeof(this->stats));
+	}
+
+	~RenderQueue()
+	{
+
+	}
+
+	static uint64_t makeKey(unsigned pass, unsigned program, unsigned material, unsigned depth)
+	{
+		return ((uint64_t)(pass & 0xF) << 60) | ((uint64_t)(program & 0xFFF) << 48) | ((uint64_t)(material & 0xFFFF) << 32) | ((uint64_t)(depth & 0xFFFFFF) << 8);
+	}
+
+	static unsigned getKeyProgram(uint64_t key) { return (unsigned)(key >> 48) & 0xFFF; }
+	static unsigned getKeyMaterial(uint64_t key) { return (unsigned)(key >> 32) & 0xFFFF; }
+
+	void setParallelThreshold(size_t threshold)
+	{
+		this->parallelThreshold = threshold;
+	}
+
+	// Start a new frame with the camera the draws are culled and sorted against
+	void begin(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, const glm::vec3& cameraPosition, float farPlane)
+	{
+		this->items.clear();
+		this->commands.clear();
+		this->cameraPosition = cameraPosition;
+		this->farPlane = farPlane;
+
+		// Gribb / Hartmann plane extraction, glm is column major so rows are read across columns
+		glm::mat4 m = projectionMatrix * viewMatrix;
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec4 row(m[0][i], m[1][i], m[2][i], m[3][i]);
+			glm::vec4 w(m[0][3], m[1][3], m[2][3], m[3][3]);
+			this->frustumPlanes[i * 2] = w + row;
+			this->frustumPlanes[i * 2 + 1] = w - row;
+		}
+		for (int i = 0; i < 6; i++)
+		{
+			this->frustumPlanes[i] /= glm::length(glm::vec3(this->frustumPlanes[i]));
+		}
+
+		std::memset(&this->stats, 0, sizeof(this->stats));
+	}
+
+	// Add a mesh, culled against the frustum. Opaque draws sort front to back, transparent back to front
+	void submit(unsigned pass, Shader* shader, const RenderMaterial* material, Mesh* mesh)
+	{
+		this->stats.submitted++;
+		glm::vec3 centre;
+		float radius;
+		mesh->getWorldBounds(centre, radius);
+		if (!this->isVisible(centre, radius))
+		{
+			this->stats.culled++;
+			return;
+		}
+		float depth = glm::clamp((glm::length(centre - this->cameraPosition) - radius) / this->farPlane, 0.0f, 1.0f);
+		unsigned depthBucket = (unsigned)(depth * ((1 << DEPTH_BITS) - 1));
+		if (pass == PASS_TRANSPARENT)
+		{
+			depthBucket = ((1 << DEPTH_BITS) - 1) - depthBucket;
+		}
+		unsigned materialId = material ? this->getMaterialId(material) : 0;
+		this->submitKey(makeKey(pass, shader->getSortId(), materialId, depthBucket), { shader, material, mesh });
+	}
+
+	// Add a draw with a precomputed key
+	void submitKey(uint64_t key, const DrawCommand& command)
+	{
+		this->items.push_back({ key, (uint32_t)this->commands.size() });
+		this->commands.push_back(command);
+	}
+
+	// LSD radix sort of the keys, 8 bits per pass. Passes where every key shares the byte are skipped
+	void sort(ThreadPool& pool = ThreadPool::get())
+	{
+		double start = getTimeMs();
+		size_t count = this->items.size();
+		if (count > 1)
+		{
+			this->scratch.resize(count);
+			SortItem* src = this->items.data();
+			SortItem* dst = this->scratch.data();
+			bool parallel = count >= this->parallelThreshold && pool.getThreadCount() > 0;
+			for (unsigned shift = 0; shift < 64; shift += 8)
+			{
+				bool moved = parallel ? radixPassParallel(src, dst, count, shift, pool) : radixPass(src, dst, count, shift);
+				if (moved)
+				{
+					std::swap(src, dst);
+				}
+			}
+			if (src != this->items.data())
+			{
+				std::memcpy(this->items.data(), src, count * sizeof(SortItem));
+			}
+		}
+		this->stats.sortMs = getTimeMs() - start;
+	}
+
+	// Issue the sorted draws, only switching program and material when the key changes
+	void execute()
+	{
+		double start = getTimeMs();
+		Shader* currentShader = nullptr;
+		const RenderMaterial* currentMaterial = nullptr;
+		for (auto& i : this->items)
+		{
+			const DrawCommand& command = this->commands[i.index];
+			bool programChanged = command.shader != currentShader;
+			if (programChanged)
+			{
+				currentShader = command.shader;
+				currentShader->use();
+				this->stats.programChanges++;
+			}
+			// Material uniforms live in the program, so a new program needs them again
+			if (command.material && (command.material != currentMaterial || programChanged))
+			{
+				currentMaterial = command.material;
+				currentMaterial->material->sendToShader(*currentShader);
+				for (int t = 0; t < currentMaterial->textureCount; t++)
+				{
+					currentMaterial->textures[t]->bind(t);
+				}
+				this->stats.materialChanges++;
+			}
+			command.mesh->render(currentShader);
+			this->stats.drawn++;
+		}
+		this->stats.executeMs = getTimeMs() - start;
+	}
+
+	// Program and material switches needed to draw the queue in its current order
+	void countStateChanges(unsigned& programChanges, unsigned& materialChanges) const
+	{
+		programChanges = 0;
+		materialChanges = 0;
+		uint64_t lastProgram = ~0ull;
+		uint64_t lastMaterial = ~0ull;
+		for (auto& i : this->items)
+		{
+			unsigned program = getKeyProgram(i.key);
+			unsigned material = getKeyMaterial(i.key);
+			if (program != lastProgram)
+			{
+				programChanges++;
+				lastMaterial = ~0ull;
+			}
+			if (material != lastMaterial)
+			{
+				materialChanges++;
+			}
+			lastProgram = program;
+			lastMaterial = material;
+		}
+	}
+
+	bool isSorted() const
+	{
+		for (size_t i = 1; i < this->items.size(); i++)
+		{
+			if (this->items[i - 1].key > this->items[i].key)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t size() const
+	{
+		return this->items.size();
+	}
+
+	const Stats& getStats() const
+	{
+		return this->stats;
+	}
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// OTHER
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+#include "ThreadPool.h"
+#include "IBLBaker.h"
+
+// Diffuse irradiance as 9 spherical harmonics (L2) coefficients per colour channel instead of an
+// irradiance cube map. The environment is projected onto the basis on the CPU, every texel weighted
+// by its solid angle, and the cosine lobe convolution is then a scale per band (Ramamoorthi and
+// Hanrahan, "An Efficient Representation for Irradiance Environment Maps"). The coefficients are
+// stored with the basis constants folded in, so FragmentCorePBR built with SH_IRRADIANCE evaluates
+// irradiance with a handful of multiply adds on the normal.
+// L2 keeps 99% of the energy of the cosine lobe, but a small very bright light rings, which shows as
+// a darker band on the side facing away from it. Results are clamped to 0 where it would go negative.
+namespace SHIrradiance
+{
+	// Uniform buffer binding, matches FragmentCorePBR.glsl
+	static const GLuint UNIFORM_BINDING = 3;
+
+	// std140 layout of the SHIrradiance block, one vec4 per coefficient with RGB in xyz
+	struct Coefficients
+	{
+		float c[9][4];
+	};
+
+	// The 9 basis functions of a unit direction, without their constants: 1, y, z, x, xy, yz, 3z^2 - 1, xz, x^2 - y^2
+	inline void getBasis(const float* d, float* basis)
+	{
+		basis[0] = 1.0f;
+		basis[1] = d[1];
+		basis[2] = d[2];
+		basis[3] = d[0];
+		basis[4] = d[0] * d[1];
+		basis[5] = d[1] * d[2];
+		basis[6] = 3.0f * d[2] * d[2] - 1.0f;
+		basis[7] = d[0] * d[2];
+		basis[8] = d[0] * d[0] - d[1] * d[1];
+	}
+
+	// Constants of the real spherical harmonics, in getBasis order
+	inline const float* getBasisConstants()
+	{
+		static const float constants[9] = { 0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+		return constants;
+	}
+
+	// Sum rows into per row partial sums on the pool, then add those up in row order so the result
+	// does not depend on the thread count
+	inline void projectRows(size_t rowCount, ThreadPool* pool, const std::function<void(size_t row, double* sums)>& row, double* result)
+	{
+		std::vector<double> sums(rowCount * 27, 0.0);
+		auto run = [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				row(i, &sums[i * 27]);
+			}
+		};
+		if (pool)
+		{
+			pool->parallelFor(rowCount, 1, run);
+		}
+		else
+		{
+			run(0, rowCount);
+		}
+		std::fill(result, result + 27, 0.0);
+		for (size_t i = 0; i < rowCount; i++)
+		{
+			for (int j = 0; j < 27; j++)
+			{
+				result[j] += sums[i * 27 + j];
+			}
+		}
+	}
+
+	// Shader coefficients from the radiance projection. Convolving with the cosine lobe scales the bands
+	// by pi, 2 pi / 3 and pi / 4, divided by pi here as the irradiance map held irradiance / pi: the
+	// shader multiplies it by albedo without dividing by pi
+	inline Coefficients toIrradiance(const double* radiance)
+	{
+		static const float bands[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+		const float* constants = getBasisConstants();
+		Coefficients out = {};
+		for (int i = 0; i < 9; i++)
+		{
+			// Projecting multiplies by the constant once and evaluating once more
+			float scale = bands[i] * constants[i] * constants[i];
+			for (int c = 0; c < 3; c++)
+			{
+				out.c[i][c] = (float)radiance[i * 3 + c] * scale;
+			}
+		}
+		return out;
+	}
+
+	// Irradiance of an RGB float cube map with its faces in GL order, size texels wide
+	inline Coefficients projectCube(const float* faces, int size, ThreadPool* pool)
+	{
+		double radiance[27];
+		projectRows((size_t)size * 6, pool, [&](size_t row, double* sums)
+		{
+			int face = (int)(row / size), y = (int)(row % size);
+			for (int x = 0; x < size; x++)
+			{
+				float d[3], basis[9];
+				IBLBaker::getTexelDirection(face, x, y, size, d);
+				getBasis(d, basis);
+				float weight = IBLBaker::getTexelSolidAngle(x, y, size);
+				const float* texel = faces + (row * size + x) * 3;
+				for (int i = 0; i < 9; i++)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						sums[i * 3 + c] += texel[c] * basis[i] * weight;
+					}
+				}
+			}
+		}, radiance);
+		return toIrradiance(radiance);
+	}
+
+	// Irradiance of a float equirectangular image, straight from the HDR without a cube map. Texels get
+	// the solid angle of their band of latitude
+	inline Coefficients projectEquirect(const IBLBaker::Image& image, ThreadPool* pool)
+	{
+		double radiance[27];
+		projectRows((size_t)image.height, pool, [&](size_t row, double* sums)
+		{
+			// Inverse of the IBLBaker::sampleEquirect mapping
+			float latitude = ((row + 0.5f) / image.height - 0.5f) * IBLBaker::PI;
+			float weight = 2.0f * IBLBaker::PI / image.width * (std::sin(latitude + 0.5f * IBLBaker::PI / image.height) - std::sin(latitude - 0.5f * IBLBaker::PI / image.height));
+			for (int x = 0; x < image.width; x++)
+			{
+				float longitude = ((x + 0.5f) / image.width - 0.5f) * 2.0f * IBLBaker::PI;
+				float d[3] = { std::cos(latitude) * std::cos(longitude), std::sin(latitude), std::cos(latitude) * std::sin(longitude) }, basis[9];
+				getBasis(d, basis);
+				const float* texel = &image.rgb[(row * image.width + x) * 3];
+				for (int i = 0; i < 9; i++)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						sums[i * 3 + c] += texel[c] * basis[i] * weight;
+					}
+				}
+			}
+		}, radiance);
+		return toIrradiance(radiance);
+	}
+
+	// What the shader computes for a unit normal
+	inline void evaluate(const Coefficients& coefficients, const float* n, float* out)
+	{
+		float basis[9];
+		getBasis(n, basis);
+		for (int c = 0; c < 3; c++)
+		{
+			float sum = 0.0f;
+			for (int i = 0; i < 9; i++)
+			{
+				sum += coefficients.c[i][c] * basis[i];
+			}
+			out[c] = std::max(sum, 0.0f);
+		}
+	}
+
+	// Uniform buffer holding the coefficients, bound to UNIFORM_BINDING
+	inline GLuint createBuffer(const Coefficients& coefficients)
+	{
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Coefficients), &coefficients, GL_STATIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BINDING, buffer);
+		return buffer;
+	}
+}
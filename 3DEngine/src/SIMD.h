@@ -0,0 +1,20 @@
+#pragma once
+
+// Instruction sets the CPU side code may use, picked from the compiler flags.
+// SSE2 is always there on x64 and on x86 with /arch:SSE2 (the default), AVX2 needs /arch:AVX2.
+// Every SIMD path has a scalar fallback for other targets.
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define ENGINE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define ENGINE_AVX2 1
+#include <immintrin.h>
+#endif
+
+// Half float conversion, on every AVX2 CPU. MSVC has no flag of its own for it and allows it with /arch:AVX2
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define ENGINE_F16C 1
+#include <immintrin.h>
+#endif
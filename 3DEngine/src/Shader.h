@@ -17,16 +17,82 @@
 // OTHER
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "ShaderReflection.h"
+#include "GLState.h"
+
+// State of a background shader reload
+enum shader_reload_enum { RELOAD_IDLE = 0, RELOAD_PENDING, RELOAD_SUCCEEDED, RELOAD_FAILED };
 
 class Shader
 {
 private:
 
 	GLuint id;
+	// Small id for render queue sort keys, unlike GL names these stay dense
+	unsigned sortId;
+
+	// Source files, kept so the program can be rebuilt when they change on disk
+	std::string vertexFile;
+	std::string fragmentFile;
+	std::string geometryFile;
+	// Space separated macros defined at the top of every stage, selects a permutation of the source
+	std::string defines;
+
+	// Program being compiled in the background, swapped with id once it links
+	GLuint pendingId;
+	int reloadStatus;
+	std::string reloadLog;
+
+	// Last value written to each uniform, replayed onto a reloaded program. Ints are kept as ints
+	struct UniformValue
+	{
+		GLenum type;
+		union
+		{
+			GLfloat floats[16];
+			GLint ints[16];
+		};
+	};
+	// Per entry of the reflected uniforms, and by name for writes to names the program does not have
+	std::vector<UniformValue> uniformValues;
+	std::unordered_map<std::string, UniformValue> unusedValues;
+
+	// Active interface of the current program
+	ShaderReflection reflection;
+
+	// Was the current program built from baked SPIR-V, and how long it took to build at startup
+	bool spirv;
+	double compileMs;
+
+	// SPIR-V loading can be switched off globally, e.g. to compare against the GLSL path
+	static bool& spirvAllowed()
+	{
+		static bool allowed = true;
+		return allowed;
+	}
+
+	static time_t getLastWrite(const std::string& path)
+	{
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+		{
+			return 0;
+		}
+		return info.st_mtime;
+	}
 
 	// Read shader source
-	std::string loadShaderSource(char* fileName)
+	std::string loadShaderSource(const char* fileName)
 	{
 		std::string temp = "";
 		std::string src = "";
@@ -42,170 +108,515 @@ private:
 		std::cout << "ERROR: Could not open shader: " << fileName << std::endl;
 		}
 		inFile.close();
+		// Permutation macros go after the #version line, #line keeps compile errors on the right lines
+		if (!this->defines.empty())
+		{
+			size_t lineEnd = src.find('\n');
+			std::istringstream names(this->defines);
+			std::string name, block;
+			while (names >> name)
+			{
+				block += "#define " + name + "\n";
+			}
+			src.insert(lineEnd == std::string::npos ? src.size() : lineEnd + 1, block + "#line 2\n");
+		}
 		return src;
 	}
 
-	// Load and compile shader
-	GLuint loadShader(GLenum type, char* fileName)
+	// Load and start compiling shader, the compile status is checked once the program is linked
+	GLuint loadShader(GLenum type, const char* fileName)
 	{
-		char infoLog[512];
-		GLint success;
-
 		GLuint shader = glCreateShader(type);
 		std::string str_src = this->loadShaderSource(fileName);
 		const GLchar* src = str_src.c_str();
 		glShaderSource(shader, 1, &src, NULL);
 		glCompileShader(shader);
 
+		return shader;
+	}
+
+	// Load a baked SPIR-V module for a GLSL file. Returns 0 if there is none, it is older than
+	// the GLSL source or the driver rejects it, the caller then compiles the GLSL instead
+	GLuint loadSpirvShader(GLenum type, const std::string& fileName)
+	{
+		std::string spirvFile = getSpirvFile(fileName, this->defines);
+		time_t spirvTime = getLastWrite(spirvFile);
+		if (spirvTime == 0 || spirvTime < getLastWrite(fileName))
+		{
+			return 0;
+		}
+		std::ifstream inFile(spirvFile, std::ios::binary | std::ios::ate);
+		std::streamoff size = inFile.tellg();
+		if (size < 20 || size % 4 != 0)
+		{
+			return 0;
+		}
+		std::vector<char> binary((size_t)size);
+		inFile.seekg(0);
+		inFile.read(binary.data(), size);
+		if (*(const uint32_t*)binary.data() != 0x07230203)
+		{
+			std::cout << "ERROR: Not a SPIR-V module: " << spirvFile << std::endl;
+			return 0;
+		}
+
+		GLuint shader = glCreateShader(type);
+		glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, binary.data(), (GLsizei)size);
+		glSpecializeShaderARB(shader, "main", 0, NULL, NULL);
+		GLint success;
 		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 		if (!success)
 		{
-			glGetShaderInfoLog(shader, 512, NULL, infoLog);
-			std::cout << "ERROR: Could not compile shader: " << fileName << std::endl;
-			std::cout << infoLog << std::endl;
+			std::cout << this->getCompileLog(shader, spirvFile);
+			glDeleteShader(shader);
+			return 0;
 		}
-
 		return shader;
 	}
 
-	// Link shader
-	void linkProgram(GLuint vertexShader, GLuint geometryShader, GLuint fragmentShader)
+	// Get the compile log of a shader, empty if it compiled
+	std::string getCompileLog(GLuint shader, const std::string& fileName)
 	{
 		char infoLog[512];
 		GLint success;
 
-		this->id = glCreateProgram();
-
-		glAttachShader(this->id, vertexShader);
-
-		if (geometryShader)
-		{
-			glAttachShader(this->id, geometryShader);
-		}
-
-		glAttachShader(this->id, fragmentShader);
-
-		glLinkProgram(this->id);
-
-		glGetProgramiv(this->id, GL_LINK_STATUS, &success);
-		if (!success)
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (success)
 		{
-			glGetProgramInfoLog(this->id, 512, NULL, infoLog);
-			std::cout << "ERROR: could not link program" << std::endl;
-			std::cout << infoLog << std::endl;
+			return "";
 		}
-		glUseProgram(0);
+		glGetShaderInfoLog(shader, 512, NULL, infoLog);
+		return "ERROR: Could not compile shader: " + fileName + "\n" + infoLog + "\n";
 	}
-public:
 
-	Shader(const char* vertexFile, const char* fragmentFile, const char* geometryFile = "")
+	// Compile all stages and start linking them into a new program. With useSpirv the baked
+	// modules are tried first, GL does not allow mixing SPIR-V and GLSL so it is all stages or none
+	GLuint createProgram(bool useSpirv, bool& isSpirv)
 	{
 		GLuint vertexShader = 0;
 		GLuint geometryShader = 0;
 		GLuint fragmentShader = 0;
 
+		isSpirv = false;
+		if (useSpirv && spirvAllowed() && GLEW_ARB_gl_spirv)
+		{
+			vertexShader = this->loadSpirvShader(GL_VERTEX_SHADER, this->vertexFile);
+			if (!this->geometryFile.empty())
+			{
+				geometryShader = this->loadSpirvShader(GL_GEOMETRY_SHADER, this->geometryFile);
+			}
+			fragmentShader = this->loadSpirvShader(GL_FRAGMENT_SHADER, this->fragmentFile);
+			isSpirv = vertexShader && fragmentShader && (geometryShader || this->geometryFile.empty());
+			if (!isSpirv)
+			{
+				glDeleteShader(vertexShader);
+				glDeleteShader(geometryShader);
+				glDeleteShader(fragmentShader);
+				geometryShader = 0;
+			}
+		}
+
 		//Load and Compile
-		vertexShader = loadShader(GL_VERTEX_SHADER, (char*)vertexFile);
-		if (geometryFile != "")
+		if (!isSpirv)
 		{
-			geometryShader = loadShader(GL_GEOMETRY_SHADER, (char*)geometryFile);
+			vertexShader = loadShader(GL_VERTEX_SHADER, this->vertexFile.c_str());
+			if (!this->geometryFile.empty())
+			{
+				geometryShader = loadShader(GL_GEOMETRY_SHADER, this->geometryFile.c_str());
+			}
+			fragmentShader = loadShader(GL_FRAGMENT_SHADER, this->fragmentFile.c_str());
 		}
-		fragmentShader = loadShader(GL_FRAGMENT_SHADER, (char*)fragmentFile);
 
 		//Link
-		this->linkProgram(vertexShader, geometryShader, fragmentShader);
+		GLuint program = glCreateProgram();
+		glAttachShader(program, vertexShader);
+		if (geometryShader)
+		{
+			glAttachShader(program, geometryShader);
+		}
+		glAttachShader(program, fragmentShader);
+		glLinkProgram(program);
 
-		//End
+		// Shaders are only flagged for deletion here, they live until the program is deleted
 		glDeleteShader(vertexShader);
 		glDeleteShader(geometryShader);
 		glDeleteShader(fragmentShader);
+
+		return program;
 	}
-	~Shader()
+
+	// Check link status of a program (blocks until linking has finished), empty log if it linked
+	std::string getLinkLog(GLuint program)
 	{
-		glDeleteProgram(this->id);
+		char infoLog[512];
+		GLint success;
+		std::string log = "";
+
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (success)
+		{
+			return log;
+		}
+		// Report which stage failed
+		GLuint attached[3];
+		GLsizei count = 0;
+		glGetAttachedShaders(program, 3, &count, attached);
+		for (GLsizei i = 0; i < count; i++)
+		{
+			GLint type;
+			glGetShaderiv(attached[i], GL_SHADER_TYPE, &type);
+			const std::string& file = type == GL_VERTEX_SHADER ? this->vertexFile : type == GL_GEOMETRY_SHADER ? this->geometryFile : this->fragmentFile;
+			log += this->getCompileLog(attached[i], file);
+		}
+		glGetProgramInfoLog(program, 512, NULL, infoLog);
+		log += "ERROR: could not link program\n";
+		log += infoLog;
+		return log;
 	}
 
-	//Set uniform functions
-	void use()
+	// Write a recorded value to the current program
+	void replayUniform(GLint location, const UniformValue& v)
 	{
-		glUseProgram(this->id);
+		GLuint program = this->id;
+		switch (v.type)
+		{
+		case GL_INT: glProgramUniform1i(program, location, v.ints[0]); break;
+		case GL_FLOAT: glProgramUniform1f(program, location, v.floats[0]); break;
+		case GL_FLOAT_VEC2: glProgramUniform2fv(program, location, 1, v.floats); break;
+		case GL_FLOAT_VEC3: glProgramUniform3fv(program, location, 1, v.floats); break;
+		case GL_FLOAT_VEC4: glProgramUniform4fv(program, location, 1, v.floats); break;
+		case GL_FLOAT_MAT3: glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, v.floats); break;
+		case GL_FLOAT_MAT4: glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, v.floats); break;
+		default: break;
+		}
 	}
 
-	void unuse()
+	// Reflect the current program. Recorded values follow their names onto its interface, and with
+	// replay are written at the reflected locations so a reloaded program starts where the old one was
+	void reflectProgram(bool replay)
 	{
-		glUseProgram(0);
+		std::unordered_map<std::string, UniformValue> previous = this->unusedValues;
+		for (size_t i = 0; i < this->uniformValues.size(); i++)
+		{
+			if (this->uniformValues[i].type)
+			{
+				previous[this->reflection.getUniforms()[i].name] = this->uniformValues[i];
+			}
+		}
+		this->reflection.reflect(this->id);
+		this->uniformValues.assign(this->reflection.getUniforms().size(), UniformValue());
+		this->unusedValues.clear();
+		for (auto& i : previous)
+		{
+			int index = this->reflection.getIndex(i.first.c_str());
+			if (index == -1)
+			{
+				this->unusedValues.insert(i);
+				continue;
+			}
+			this->uniformValues[index] = i.second;
+			if (replay)
+			{
+				this->replayUniform(this->reflection.getUniforms()[index].location, i.second);
+			}
+		}
 	}
 
-	void set1i(GLint value, const GLchar* name)
+	// GL_ARB_gl_spirv does not promise that uniforms can be found by name. When a baked program
+	// lacks a name the engine writes, build the GLSL program and switch to it if it has the name.
+	// False if the name is inactive in the GLSL as well, then the baked program is kept
+	bool fallBackToGlsl(const GLchar* name)
 	{
-		this->use();
+		bool isSpirv;
+		GLuint program = this->createProgram(false, isSpirv);
+		if (!this->getLinkLog(program).empty() || glGetUniformLocation(program, name) == -1)
+		{
+			glDeleteProgram(program);
+			return false;
+		}
+		std::cout << "WARNING: Baked SPIR-V for " << this->fragmentFile << " has no uniform " << name << ", compiling GLSL" << std::endl;
+		GLint current = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+		bool bound = (GLuint)current == this->id;
+		GLState::get().forgetProgram(this->id);
+		glDeleteProgram(this->id);
+		this->id = program;
+		this->spirv = false;
+		this->reflectProgram(true);
+		// Draws that already bound the baked program carry on with the new one
+		if (bound)
+		{
+			this->use();
+		}
+		return true;
+	}
 
-		glUniform1i(glGetUniformLocation(this->id, name), value);
+	// Remember a uniform value so it survives a reload, returns the location to write it to. Active
+	// uniforms are found with one lookup of the reflected names, without building a string
+	GLint writeUniform(const GLchar* name, GLenum type, const void* data, size_t bytes, GLint intValue = 0)
+	{
+		int index = this->reflection.getIndex(name);
+		// Only checked on the first write of each name, later ones find it in unusedValues
+		if (index == -1 && this->spirv && !this->unusedValues.count(name) && this->fallBackToGlsl(name))
+		{
+			index = this->reflection.getIndex(name);
+		}
+		UniformValue& v = index == -1 ? this->unusedValues[name] : this->uniformValues[index];
+		bool redundant = v.type == type && std::memcmp(v.floats, data, bytes) == 0;
+		v.type = type;
+		std::memcpy(v.floats, data, bytes);
+		this->reflection.recordWrite(index, name, type, redundant, intValue);
+		return index == -1 ? -1 : this->reflection.getUniforms()[index].location;
+	}
 
-		this->unuse();
+	// Ids of deleted shaders, handed out again before new ones so the ids stay small
+	static std::vector<unsigned>& getFreeSortIds()
+	{
+		static std::vector<unsigned> freeIds;
+		return freeIds;
 	}
-	// Using unsigned int rather than GLint (Fix for data loss when parsing between the two)
-	void set1iUI(unsigned int value, const GLchar* name)
+
+	static unsigned allocateSortId()
 	{
-		this->use();
+		static unsigned next = 0;
+		std::vector<unsigned>& freeIds = getFreeSortIds();
+		if (freeIds.empty())
+		{
+			return next++;
+		}
+		unsigned id = freeIds.back();
+		freeIds.pop_back();
+		return id;
+	}
+public:
 
-		glUniform1i(glGetUniformLocation(this->id, name), value);
+	Shader(const char* vertexFile, const char* fragmentFile, const char* geometryFile = "", const char* defines = "")
+	{
+		this->vertexFile = vertexFile;
+		this->fragmentFile = fragmentFile;
+		this->geometryFile = geometryFile;
+		this->defines = defines;
+		this->pendingId = 0;
+		this->reloadStatus = RELOAD_IDLE;
+		this->sortId = allocateSortId();
+
+		auto start = std::chrono::steady_clock::now();
+		this->id = this->createProgram(true, this->spirv);
+		std::string log = this->getLinkLog(this->id);
+		if (this->spirv)
+		{
+			this->reflection.reflect(this->id);
+			// The setters find uniforms by name, a driver that drops SPIR-V names can't be used
+			if (!log.empty() || !this->reflection.hasNames())
+			{
+				std::cout << "WARNING: Baked SPIR-V for " << this->fragmentFile << " not usable, compiling GLSL" << std::endl;
+				glDeleteProgram(this->id);
+				this->id = this->createProgram(false, this->spirv);
+				log = this->getLinkLog(this->id);
+			}
+		}
+		if (!log.empty())
+		{
+			std::cout << log << std::endl;
+		}
+		this->reflectProgram(false);
+		this->compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	~Shader()
+	{
+		getFreeSortIds().push_back(this->sortId);
+		GLState::get().forgetProgram(this->id);
+		glDeleteProgram(this->id);
+		if (this->pendingId)
+		{
+			glDeleteProgram(this->pendingId);
+		}
+	}
 
-		this->unuse();
+	// Baked module next to the GLSL file, written by the shader bake step. Each permutation has
+	// its own, e.g. FragmentCorePBR.glsl.ORM_TEXTURE.spv
+	static std::string getSpirvFile(const std::string& glslFile, const std::string& defines = "")
+	{
+		std::string suffix;
+		std::istringstream names(defines);
+		std::string name;
+		while (names >> name)
+		{
+			suffix += "." + name;
+		}
+		return glslFile + suffix + ".spv";
 	}
 
-	void set1f(GLfloat value, const GLchar* name)
+	static void setSpirvEnabled(bool enabled)
 	{
-		this->use();
+		spirvAllowed() = enabled;
+	}
 
-		glUniform1f(glGetUniformLocation(this->id, name), value);
+	bool isSpirv() const
+	{
+		return this->spirv;
+	}
 
-		this->unuse();
+	// Time to compile and link the program at startup
+	double getCompileMs() const
+	{
+		return this->compileMs;
 	}
 
-	void setVec2f(glm::fvec2 value, const GLchar* name)
+	// Source file getters, used by the shader watcher
+	const std::string& getVertexFile() const { return this->vertexFile; }
+	const std::string& getFragmentFile() const { return this->fragmentFile; }
+	const std::string& getGeometryFile() const { return this->geometryFile; }
+	const std::string& getDefines() const { return this->defines; }
+
+	// Does this program use the given source file
+	bool usesFile(const std::string& fileName) const
 	{
-		this->use();
+		return fileName == this->vertexFile || fileName == this->fragmentFile || fileName == this->geometryFile;
+	}
 
-		glUniform2fv(glGetUniformLocation(this->id, name), 1, glm::value_ptr(value));
+	// Start recompiling from disk. The current program stays in use until the new one links.
+	// The GLSL was just edited so any baked SPIR-V is out of date, always compile the source
+	void beginReload()
+	{
+		if (this->pendingId)
+		{
+			glDeleteProgram(this->pendingId);
+		}
+		bool pendingSpirv;
+		this->pendingId = this->createProgram(false, pendingSpirv);
+		this->reloadStatus = RELOAD_PENDING;
+	}
 
-		this->unuse();
+	// Check on a background reload, called once per frame. Swaps the program id when linking succeeds
+	void pollReload()
+	{
+		if (this->reloadStatus != RELOAD_PENDING)
+		{
+			return;
+		}
+		// With parallel shader compile the driver links on its own threads, don't stall the frame waiting on it
+		if (GLEW_ARB_parallel_shader_compile)
+		{
+			GLint complete = GL_FALSE;
+			glGetProgramiv(this->pendingId, GL_COMPLETION_STATUS_ARB, &complete);
+			if (!complete)
+			{
+				return;
+			}
+		}
+		this->reloadLog = this->getLinkLog(this->pendingId);
+		if (this->reloadLog.empty())
+		{
+			GLState::get().forgetProgram(this->id);
+			glDeleteProgram(this->id);
+			this->id = this->pendingId;
+			this->spirv = false;
+			this->reflectProgram(true);
+			this->reloadStatus = RELOAD_SUCCEEDED;
+		}
+		else
+		{
+			// Keep the old program
+			glDeleteProgram(this->pendingId);
+			this->reloadStatus = RELOAD_FAILED;
+		}
+		this->pendingId = 0;
 	}
 
-	void setVec3f(glm::fvec3 value, const GLchar* name)
+	int getReloadStatus() const
 	{
-		this->use();
+		return this->reloadStatus;
+	}
 
-		glUniform3fv(glGetUniformLocation(this->id, name), 1, glm::value_ptr(value));
+	const std::string& getReloadLog() const
+	{
+		return this->reloadLog;
+	}
 
-		this->unuse();
+	ShaderReflection& getReflection()
+	{
+		return this->reflection;
 	}
 
-	void setVec4f(glm::fvec4 value, const GLchar* name)
+	GLuint getID() const
 	{
-		this->use();
+		return this->id;
+	}
 
-		glUniform4fv(glGetUniformLocation(this->id, name), 1, glm::value_ptr(value));
+	unsigned getSortId() const
+	{
+		return this->sortId;
+	}
 
-		this->unuse();
+	//Set uniform functions
+	void use()
+	{
+		GLState::get().useProgram(this->id);
 	}
 
-	void setMat3fv(glm::mat3 value, GLchar* name, GLboolean transpose = GL_FALSE)
+	void unuse()
 	{
-		this->use();
+		GLState::get().useProgram(0);
+	}
 
-		glUniformMatrix3fv(glGetUniformLocation(this->id, name), 1, transpose, glm::value_ptr(value));
+	// Uniforms are written with glProgramUniform so setting them never changes the bound program.
+	// The location is found first, the lookup may replace a baked program with the GLSL one
+	void set1i(GLint value, const GLchar* name)
+	{
+		GLint location = this->writeUniform(name, GL_INT, &value, sizeof(value), value);
+		glProgramUniform1i(this->id, location, value);
+	}
+	// Using unsigned int rather than GLint (Fix for data loss when parsing between the two)
+	void set1iUI(unsigned int value, const GLchar* name)
+	{
+		GLint data = (GLint)value;
+		GLint location = this->writeUniform(name, GL_INT, &data, sizeof(data), data);
+		glProgramUniform1i(this->id, location, data);
+	}
 
-		this->unuse();
+	void set1f(GLfloat value, const GLchar* name)
+	{
+		GLint location = this->writeUniform(name, GL_FLOAT, &value, sizeof(value));
+		glProgramUniform1f(this->id, location, value);
 	}
 
-	void setMat4fv(glm::mat4 value, const GLchar* name, GLboolean transpose = GL_FALSE)
+	void setVec2f(glm::fvec2 value, const GLchar* name)
+	{
+		GLint location = this->writeUniform(name, GL_FLOAT_VEC2, glm::value_ptr(value), sizeof(value));
+		glProgramUniform2fv(this->id, location, 1, glm::value_ptr(value));
+	}
+
+	void setVec3f(glm::fvec3 value, const GLchar* name)
+	{
+		GLint location = this->writeUniform(name, GL_FLOAT_VEC3, glm::value_ptr(value), sizeof(value));
+		glProgramUniform3fv(this->id, location, 1, glm::value_ptr(value));
+	}
+
+	void setVec4f(glm::fvec4 value, const GLchar* name)
 	{
-		this->use();
+		GLint location = this->writeUniform(name, GL_FLOAT_VEC4, glm::value_ptr(value), sizeof(value));
+		glProgramUniform4fv(this->id, location, 1, glm::value_ptr(value));
+	}
 
-		glUniformMatrix4fv(glGetUniformLocation(this->id, name), 1, transpose, glm::value_ptr(value));
+	void setMat3fv(glm::mat3 value, const GLchar* name, GLboolean transpose = GL_FALSE)
+	{
+		if (transpose)
+		{
+			value = glm::transpose(value);
+		}
+		GLint location = this->writeUniform(name, GL_FLOAT_MAT3, glm::value_ptr(value), sizeof(value));
+		glProgramUniformMatrix3fv(this->id, location, 1, GL_FALSE, glm::value_ptr(value));
+	}
 
-		this->unuse();
+	void setMat4fv(glm::mat4 value, const GLchar* name, GLboolean transpose = GL_FALSE)
+	{
+		if (transpose)
+		{
+			value = glm::transpose(value);
+		}
+		GLint location = this->writeUniform(name, GL_FLOAT_MAT4, glm::value_ptr(value), sizeof(value));
+		glProgramUniformMatrix4fv(this->id, location, 1, GL_FALSE, glm::value_ptr(value));
 	}
 
-};
\ No newline at end of file
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+// OTHER
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#include "Shader.h"
+
+// Offline shader bake: compiles the engine GLSL to SPIR-V with glslang, optimises it with
+// spirv-opt (dead code elimination, constant folding of MAX_REFLECTION_LOD etc.)
+// and writes <file>.glsl.spv next to the source. Shader picks the modules up through GL_ARB_gl_spirv.
+// Run with: 3DEngine.exe --bake shaders (glslangValidator and spirv-opt from the Vulkan SDK or PATH)
+namespace ShaderBake
+{
+	struct ProgramFiles
+	{
+		const char* vertexFile;
+		const char* fragmentFile;
+		// Permutation macros, see Shader
+		const char* defines = "";
+	};
+
+	// Every program the engine builds, in shader_enum order
+	inline const std::vector<ProgramFiles>& getPrograms()
+	{
+		static const std::vector<ProgramFiles> programs =
+		{
+			{ "src/VertexCorePBR.glsl", "src/FragmentCorePBR.glsl" }, // PBR
+			{ "src/VertexCore.glsl", "src/FragmentCore.glsl" }, // BlinnPhong
+			{ "src/CubeMapVS.glsl", "src/IrradianceConvolutionFS.glsl" }, // Irradiance (IBL stuff)
+			{ "src/CubeMapVS.glsl", "src/CubeMapPrefilterFS.glsl" }, // Prefiltered Map (IBL stuff)
+			{ "src/skyboxVS.glsl", "src/skyboxFS.glsl" } // Skybox (optional)
+		};
+		return programs;
+	}
+
+	// Permutations the engine may pick at startup instead of a program above, and programs it only
+	// builds for some assets (the virtual texture feedback pass), baked as well
+	enum permutation_enum { PERMUTATION_PBR_ORM = 0, PERMUTATION_PBR_VIRTUAL, PERMUTATION_VIRTUAL_FEEDBACK, PERMUTATION_PBR_TABLE, PERMUTATION_PBR_SH,
+		PERMUTATION_PBR_PROBES, PERMUTATION_PBR_CAPTURE, PERMUTATION_SKYBOX_CAPTURE, PERMUTATION_PBR_BRDF_APPROX };
+
+	inline const std::vector<ProgramFiles>& getPermutations()
+	{
+		static const std::vector<ProgramFiles> permutations =
+		{
+			{ "src/VertexCorePBR.glsl", "src/FragmentCorePBR.glsl", "ORM_TEXTURE" }, // PBR with packed occlusion/roughness/metallic
+			{ "src/VertexCorePBR.glsl", "src/FragmentCorePBR.glsl", "ORM_TEXTURE VIRTUAL_TEXTURE" }, // PBR sampling a virtual texture
+			{ "src/VertexCorePBR.glsl", "src/VirtualFeedbackFS.glsl" }, // Virtual texture feedback pass
+			{ "src/VertexCorePBR.glsl", "src/FragmentCorePBR.glsl", "ORM_TEXTURE MATERIAL_TABLE" }, // PBR reading a material table with texture arrays, BINDLESS_TEXTURES is GLSL only
+			{ "src/VertexCorePBR.glsl", "src/FragmentCorePBR.glsl", "ORM_TEXTURE SH_IRRADIANCE" }, // PBR with spherical harmonics irradiance
+			{ "src/VertexCorePBR.glsl", "src/FragmentCorePBR.glsl", "ORM_TEXTURE SH_IRRADIANCE REFLECTION_PROBES" }, // Same with local reflection probes, the default
+			{ "src/VertexCorePBR.glsl", "src/FragmentCorePBR.glsl", "ORM_TEXTURE SH_IRRADIANCE PROBE_CAPTURE" }, // Reflection probe capture, HDR out
+			{ "src/skyboxVS.glsl", "src/skyboxFS.glsl", "PROBE_CAPTURE" }, // Skybox in reflection probe captures
+			{ "src/VertexCorePBR.glsl", "src/FragmentCorePBR.glsl", "ORM_TEXTURE SH_IRRADIANCE REFLECTION_PROBES BRDF_APPROX" } // Analytic BRDF instead of the LUT
+		};
+		return permutations;
+	}
+
+	// Path of a bake tool, taken from the Vulkan SDK when it is installed
+	inline std::string getToolPath(const char* tool)
+	{
+		const char* sdk = std::getenv("VULKAN_SDK");
+		if (sdk)
+		{
+			return std::string("\"") + sdk + "/Bin/" + tool + "\"";
+		}
+		return tool;
+	}
+
+	// Number of instructions in a SPIR-V module, 0 if it can't be read
+	inline unsigned countInstructions(const std::string& fileName)
+	{
+		std::ifstream inFile(fileName, std::ios::binary);
+		std::vector<uint32_t> words;
+		uint32_t word;
+		while (inFile.read((char*)&word, sizeof(word)))
+		{
+			words.push_back(word);
+		}
+		// Five word header, then each instruction stores its length in the high half of its first word
+		if (words.size() < 5 || words[0] != 0x07230203)
+		{
+			return 0;
+		}
+		unsigned count = 0;
+		for (size_t i = 5; i < words.size(); count++)
+		{
+			uint32_t length = words[i] >> 16;
+			if (length == 0)
+			{
+				return 0;
+			}
+			i += length;
+		}
+		return count;
+	}
+
+	// Run a command, returns its time in milliseconds or a negative value if it failed
+	inline double runTool(const std::string& command)
+	{
+		auto start = std::chrono::steady_clock::now();
+		// cmd.exe strips the outer quotes of the whole line
+#ifdef _WIN32
+		int result = std::system(("\"" + command + "\"").c_str());
+#else
+		int result = std::system(command.c_str());
+#endif
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return result == 0 ? ms : -1.0;
+	}
+
+	struct StageResult
+	{
+		unsigned instructions;
+		unsigned optimisedInstructions;
+		double compileMs;
+		double optimiseMs;
+	};
+
+	// Compile and optimise one stage, false if either tool failed
+	inline bool bakeStage(const std::string& fileName, const std::string& defines, const char* stage, StageResult& result)
+	{
+		std::string spirvFile = Shader::getSpirvFile(fileName, defines);
+		std::string unoptimisedFile = spirvFile + ".unopt";
+		std::string macros;
+		std::istringstream names(defines);
+		std::string name;
+		while (names >> name)
+		{
+			macros += " -D" + name;
+		}
+
+		// -G targets OpenGL, loose uniforms and samplers get locations and bindings assigned
+		result.compileMs = runTool(getToolPath("glslangValidator") + " -G --auto-map-locations --auto-map-bindings" + macros + " -S " + stage
+			+ " -o \"" + unoptimisedFile + "\" \"" + fileName + "\"");
+		if (result.compileMs < 0.0)
+		{
+			std::cout << "ERROR: glslang failed on " << fileName << std::endl;
+			return false;
+		}
+		// Performance passes only, debug names are kept as the engine sets uniforms by name.
+		// spirv-opt has no 4.4 environment, 4.3 is the newest that doesn't assume more than the 4.4 context has
+		result.optimiseMs = runTool(getToolPath("spirv-opt") + " -O --target-env=opengl4.3 -o \"" + spirvFile + "\" \"" + unoptimisedFile + "\"");
+		result.instructions = countInstructions(unoptimisedFile);
+		std::remove(unoptimisedFile.c_str());
+		if (result.optimiseMs < 0.0)
+		{
+			std::cout << "ERROR: spirv-opt failed on " << fileName << std::endl;
+			std::remove(spirvFile.c_str());
+			return false;
+		}
+		result.optimisedInstructions = countInstructions(spirvFile);
+		return true;
+	}
+
+	// Bake every stage used by the engine programs and print instruction counts per program.
+	// Returns the process exit code
+	inline int bake()
+	{
+		std::vector<ProgramFiles> programs = getPrograms();
+		programs.insert(programs.end(), getPermutations().begin(), getPermutations().end());
+		std::map<std::string, StageResult> stages;
+		int failed = 0;
+		for (auto& i : programs)
+		{
+			const char* files[2] = { i.vertexFile, i.fragmentFile };
+			const char* stageNames[2] = { "vert", "frag" };
+			for (int s = 0; s < 2; s++)
+			{
+				// Stages shared between programs (CubeMapVS) are only baked once
+				std::string stage = Shader::getSpirvFile(files[s], i.defines);
+				if (stages.count(stage))
+				{
+					continue;
+				}
+				StageResult result = { 0, 0, 0.0, 0.0 };
+				if (!bakeStage(files[s], i.defines, stageNames[s], result))
+				{
+					failed = 1;
+				}
+				stages[stage] = result;
+			}
+		}
+
+		std::cout << std::left << std::setw(46) << "program (fragment)" << std::right << std::setw(14) << "instructions"
+			<< std::setw(12) << "optimised" << std::setw(10) << "change" << std::setw(14) << "bake ms" << std::endl;
+		for (auto& i : programs)
+		{
+			const StageResult& vs = stages[Shader::getSpirvFile(i.vertexFile, i.defines)];
+			const StageResult& fs = stages[Shader::getSpirvFile(i.fragmentFile, i.defines)];
+			unsigned before = vs.instructions + fs.instructions;
+			unsigned after = vs.optimisedInstructions + fs.optimisedInstructions;
+			double change = before ? 100.0 * ((double)after - before) / before : 0.0;
+			std::string name = i.fragmentFile + std::string(*i.defines ? " " : "") + i.defines;
+			std::cout << std::left << std::setw(46) << name << std::right << std::setw(14) << before << std::setw(12) << after
+				<< std::setw(9) << std::fixed << std::setprecision(1) << change << "%" << std::setw(14) << std::setprecision(1)
+				<< vs.compileMs + vs.optimiseMs + fs.compileMs + fs.optimiseMs << std::endl;
+		}
+		std::cout << "Runtime compile times: 3DEngine.exe --benchmark shadercompile" << std::endl;
+		return failed;
+	}
+}
@@ -0,0 +1,355 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// OTHER
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <cstring>
+
+// Active interface of a linked program, queried after link, and a record of what the
+// engine writes to it. Used to validate that everything a shader samples is bound and that
+// every uniform write lands somewhere.
+class ShaderReflection
+{
+public:
+	struct Variable
+	{
+		std::string name;
+		GLenum type;
+		GLint location;
+		GLint arraySize;
+		GLint blockIndex;
+	};
+
+	struct Block
+	{
+		std::string name;
+		GLint binding;
+		GLint dataSize;
+	};
+
+	// Writes made through the Shader setters since the last frame boundary
+	struct WriteStats
+	{
+		bool written;
+		GLenum type;
+		unsigned writes;
+		unsigned redundant;
+		unsigned lastFrameWrites;
+		unsigned lastFrameRedundant;
+		GLint samplerUnit;
+	};
+
+private:
+	std::vector<Variable> uniforms;
+	std::vector<Variable> attributes;
+	std::vector<Block> blocks;
+	// Keyed by the names held in uniforms, so a lookup from a setter hashes the characters without
+	// building a std::string
+	struct NameHash
+	{
+		size_t operator()(const char* name) const
+		{
+			size_t hash = 2166136261u;
+			for (; *name; name++)
+			{
+				hash = (hash ^ (unsigned char)*name) * 16777619u;
+			}
+			return hash;
+		}
+	};
+	struct NameEqual
+	{
+		bool operator()(const char* a, const char* b) const
+		{
+			return std::strcmp(a, b) == 0;
+		}
+	};
+	std::unordered_map<const char*, size_t, NameHash, NameEqual> uniformIndex;
+	// Per entry of uniforms, and for names the program does not have
+	std::vector<WriteStats> writeStats;
+	std::map<std::string, WriteStats> unusedWrites;
+
+	static std::string getResourceName(GLuint program, GLenum interfaceType, GLuint index)
+	{
+		char name[256];
+		GLsizei length = 0;
+		glGetProgramResourceName(program, interfaceType, index, sizeof(name), &length, name);
+		std::string str(name, length);
+		// Arrays are reported as "name[0]", the setters use the plain name
+		size_t bracket = str.find("[0]");
+		if (bracket != std::string::npos && bracket + 3 == str.size())
+		{
+			str = str.substr(0, bracket);
+		}
+		return str;
+	}
+
+public:
+	ShaderReflection()
+	{
+
+	}
+
+	// Enumerate the active uniforms, uniform blocks and vertex attributes of a linked program
+	void reflect(GLuint program)
+	{
+		// Write stats follow the names onto the new program
+		std::map<std::string, WriteStats> previous = this->unusedWrites;
+		for (size_t i = 0; i < this->uniforms.size(); i++)
+		{
+			if (this->writeStats[i].written)
+			{
+				previous[this->uniforms[i].name] = this->writeStats[i];
+			}
+		}
+		this->unusedWrites.clear();
+		this->writeStats.clear();
+		this->uniforms.clear();
+		this->attributes.clear();
+		this->blocks.clear();
+		this->uniformIndex.clear();
+
+		GLint count = 0;
+		const GLenum uniformProps[] = { GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX };
+		glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLint values[4];
+			glGetProgramResourceiv(program, GL_UNIFORM, i, 4, uniformProps, 4, NULL, values);
+			this->uniforms.push_back({ getResourceName(program, GL_UNIFORM, i), (GLenum)values[0], values[1], values[2], values[3] });
+		}
+		// Indexed once the vector has stopped growing, the keys point into it
+		this->writeStats.resize(this->uniforms.size(), WriteStats());
+		for (size_t i = 0; i < this->uniforms.size(); i++)
+		{
+			this->uniformIndex[this->uniforms[i].name.c_str()] = i;
+			auto it = previous.find(this->uniforms[i].name);
+			if (it != previous.end())
+			{
+				this->writeStats[i] = it->second;
+				previous.erase(it);
+			}
+		}
+		this->unusedWrites = previous;
+
+		const GLenum attributeProps[] = { GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE };
+		glGetProgramInterfaceiv(program, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLint values[3];
+			glGetProgramResourceiv(program, GL_PROGRAM_INPUT, i, 3, attributeProps, 3, NULL, values);
+			this->attributes.push_back({ getResourceName(program, GL_PROGRAM_INPUT, i), (GLenum)values[0], values[1], values[2], -1 });
+		}
+
+		const GLenum blockProps[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+		glGetProgramInterfaceiv(program, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLint values[2];
+			glGetProgramResourceiv(program, GL_UNIFORM_BLOCK, i, 2, blockProps, 2, NULL, values);
+			this->blocks.push_back({ getResourceName(program, GL_UNIFORM_BLOCK, i), values[0], values[1] });
+		}
+	}
+
+	// Entry of an active uniform in getUniforms, -1 if the program does not use it
+	int getIndex(const GLchar* name) const
+	{
+		auto it = this->uniformIndex.find(name);
+		return it == this->uniformIndex.end() ? -1 : (int)it->second;
+	}
+
+	// Location of an active uniform, -1 if the program does not use it
+	GLint getLocation(const GLchar* name) const
+	{
+		int index = this->getIndex(name);
+		return index == -1 ? -1 : this->uniforms[index].location;
+	}
+
+	// Record a write made through one of the Shader setters to the uniform at index, or by name when
+	// the program does not have it
+	void recordWrite(int index, const GLchar* name, GLenum type, bool redundant, GLint value = 0)
+	{
+		WriteStats& stats = index == -1 ? this->unusedWrites[name] : this->writeStats[index];
+		stats.written = true;
+		stats.type = type;
+		stats.writes++;
+		if (redundant)
+		{
+			stats.redundant++;
+		}
+		if (type == GL_INT)
+		{
+			stats.samplerUnit = value;
+		}
+	}
+
+	// Frame boundary, keeps the counts of the frame that just finished for the report
+	void newFrame()
+	{
+		for (auto& i : this->writeStats)
+		{
+			i.lastFrameWrites = i.writes;
+			i.lastFrameRedundant = i.redundant;
+			i.writes = 0;
+			i.redundant = 0;
+		}
+		for (auto& i : this->unusedWrites)
+		{
+			i.second.lastFrameWrites = i.second.writes;
+			i.second.writes = 0;
+		}
+	}
+
+	// SPIR-V programs only report names if the driver kept the debug names of the module
+	bool hasNames() const
+	{
+		for (auto& i : this->uniforms)
+		{
+			if (i.name.empty())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	const std::vector<Variable>& getUniforms() const { return this->uniforms; }
+	const std::vector<Variable>& getAttributes() const { return this->attributes; }
+	const std::vector<Block>& getBlocks() const { return this->blocks; }
+
+	static bool isSampler(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_SAMPLER_2D_MULTISAMPLE: case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Texture target a sampler type reads from, used to detect two targets sharing one unit
+	static GLenum getSamplerTarget(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_SAMPLER_1D: return GL_TEXTURE_1D;
+		case GL_SAMPLER_3D: return GL_TEXTURE_3D;
+		case GL_SAMPLER_CUBE: return GL_TEXTURE_CUBE_MAP;
+		case GL_SAMPLER_2D_ARRAY: return GL_TEXTURE_2D_ARRAY;
+		case GL_SAMPLER_CUBE_MAP_ARRAY: return GL_TEXTURE_CUBE_MAP_ARRAY;
+		case GL_SAMPLER_2D_MULTISAMPLE: return GL_TEXTURE_2D_MULTISAMPLE;
+		default: return GL_TEXTURE_2D;
+		}
+	}
+
+	// Can a value written by a setter of type writeType be stored in a uniform of type uniformType
+	static bool isCompatible(GLenum writeType, GLenum uniformType)
+	{
+		if (writeType == GL_INT)
+		{
+			return uniformType == GL_INT || uniformType == GL_BOOL || isSampler(uniformType);
+		}
+		return writeType == uniformType;
+	}
+
+	static const char* getTypeName(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_INT: return "int";
+		case GL_BOOL: return "bool";
+		case GL_FLOAT: return "float";
+		case GL_FLOAT_VEC2: return "vec2";
+		case GL_FLOAT_VEC3: return "vec3";
+		case GL_FLOAT_VEC4: return "vec4";
+		case GL_FLOAT_MAT3: return "mat3";
+		case GL_FLOAT_MAT4: return "mat4";
+		case GL_SAMPLER_2D: return "sampler2D";
+		case GL_SAMPLER_CUBE: return "samplerCube";
+		case GL_SAMPLER_2D_ARRAY: return "sampler2DArray";
+		case GL_SAMPLER_CUBE_MAP_ARRAY: return "samplerCubeArray";
+		default: return "other";
+		}
+	}
+
+	// Compare the program interface with the writes recorded so far. reservedUnits lists texture
+	// units owned by someone else (e.g. the IBL maps) that material samplers must not land on.
+	std::string validate(const std::map<GLint, std::string>& reservedUnits = std::map<GLint, std::string>()) const
+	{
+		std::stringstream report;
+		std::map<GLint, std::vector<const Variable*>> units;
+
+		for (size_t index = 0; index < this->uniforms.size(); index++)
+		{
+			const Variable& i = this->uniforms[index];
+			const WriteStats& stats = this->writeStats[index];
+			// Members of uniform blocks are written through buffers, not setters
+			if (i.blockIndex != -1)
+			{
+				continue;
+			}
+			if (!stats.written)
+			{
+				if (isSampler(i.type))
+				{
+					report << "UNBOUND SAMPLER: " << i.name << " (" << getTypeName(i.type) << ") is never assigned a unit and reads unit 0\n";
+					units[0].push_back(&i);
+				}
+				else
+				{
+					report << "UNSET UNIFORM: " << i.name << " (" << getTypeName(i.type) << ") is never written\n";
+				}
+				continue;
+			}
+			if (!isCompatible(stats.type, i.type))
+			{
+				report << "TYPE MISMATCH: " << i.name << " is " << getTypeName(i.type) << " but is written as " << getTypeName(stats.type) << "\n";
+			}
+			if (isSampler(i.type))
+			{
+				units[stats.samplerUnit].push_back(&i);
+			}
+			if (stats.lastFrameRedundant > 0)
+			{
+				report << "REDUNDANT WRITE: " << i.name << " written " << stats.lastFrameWrites << " times last frame, " << stats.lastFrameRedundant << " with an unchanged value\n";
+			}
+		}
+
+		for (auto& i : this->unusedWrites)
+		{
+			report << "UNUSED WRITE: " << i.first << " is not an active uniform (" << i.second.lastFrameWrites << " writes last frame)\n";
+		}
+
+		for (auto& unit : units)
+		{
+			auto reserved = reservedUnits.find(unit.first);
+			for (auto* sampler : unit.second)
+			{
+				if (reserved != reservedUnits.end() && reserved->second != sampler->name)
+				{
+					report << "UNIT ALIASING: " << sampler->name << " reads unit " << unit.first << " which is reserved for " << reserved->second << "\n";
+				}
+			}
+			for (size_t a = 0; a < unit.second.size(); a++)
+			{
+				for (size_t b = a + 1; b < unit.second.size(); b++)
+				{
+					bool sameTarget = getSamplerTarget(unit.second[a]->type) == getSamplerTarget(unit.second[b]->type);
+					report << (sameTarget ? "UNIT SHARED: " : "UNIT CONFLICT: ") << unit.second[a]->name << " and " << unit.second[b]->name << " both read unit " << unit.first;
+					report << (sameTarget ? "\n" : " with different texture targets (invalid draw)\n");
+				}
+			}
+		}
+		return report.str();
+	}
+};
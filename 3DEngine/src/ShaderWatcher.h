@@ -0,0 +1,288 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// ImGUI
+#include "vendor/imgui/imgui.h"
+
+// OTHER
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "Shader.h"
+
+// Watches the GLSL sources of a set of shaders on a background thread and rebuilds the
+// programs whose files change. Compilation is handed to the driver (in parallel when
+// GL_ARB_parallel_shader_compile is available) and the program id is only swapped once
+// the new program links, so a broken edit never replaces a working shader.
+class ShaderWatcher
+{
+private:
+	struct WatchedFile
+	{
+		std::string path;
+		time_t lastWrite;
+	};
+
+	std::vector<Shader*> shaders;
+	std::vector<WatchedFile> files;
+
+	// Files reported as changed by the watcher thread, consumed on the render thread
+	std::mutex changedMutex;
+	std::set<std::string> changedFiles;
+
+	std::thread watchThread;
+	std::atomic<bool> running;
+
+	// Reload history shown in the GUI
+	std::map<Shader*, double> reloadTimes;
+
+	static time_t getLastWrite(const std::string& path)
+	{
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+		{
+			return 0;
+		}
+		return info.st_mtime;
+	}
+
+	// Shader paths are written with windows separators, normalise for comparison
+	static std::string normalisePath(std::string path)
+	{
+		for (auto& c : path)
+		{
+			if (c == '\\')
+			{
+				c = '/';
+			}
+		}
+		return path;
+	}
+
+	void addFile(const std::string& path)
+	{
+		if (path.empty())
+		{
+			return;
+		}
+		for (auto& i : this->files)
+		{
+			if (i.path == path)
+			{
+				return;
+			}
+		}
+		this->files.push_back({ path, getLastWrite(path) });
+	}
+
+	void markChanged(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(this->changedMutex);
+		this->changedFiles.insert(path);
+	}
+
+#ifdef __linux__
+	// inotify watch on each source directory, woken by the kernel when a file is written or replaced
+	void watchLoop()
+	{
+		int fd = inotify_init1(IN_NONBLOCK);
+		if (fd < 0)
+		{
+			std::cout << "ERROR: inotify_init1 failed, falling back to polling" << std::endl;
+			this->pollLoop();
+			return;
+		}
+		std::map<int, std::string> directories;
+		for (auto& i : this->files)
+		{
+			std::string path = normalisePath(i.path);
+			size_t slash = path.find_last_of('/');
+			std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+			int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (wd >= 0)
+			{
+				directories[wd] = dir;
+			}
+		}
+
+		char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+		pollfd pfd = { fd, POLLIN, 0 };
+		while (this->running)
+		{
+			// Wake up regularly to check if the engine is shutting down
+			if (poll(&pfd, 1, 200) <= 0)
+			{
+				continue;
+			}
+			ssize_t length = read(fd, buffer, sizeof(buffer));
+			for (char* ptr = buffer; length > 0 && ptr < buffer + length; )
+			{
+				const inotify_event* event = (const inotify_event*)ptr;
+				if (event->len > 0)
+				{
+					std::string changed = directories[event->wd] + "/" + event->name;
+					for (auto& i : this->files)
+					{
+						if (normalisePath(i.path) == changed)
+						{
+							this->markChanged(i.path);
+						}
+					}
+				}
+				ptr += sizeof(inotify_event) + event->len;
+			}
+		}
+		close(fd);
+	}
+#else
+	void watchLoop()
+	{
+		this->pollLoop();
+	}
+#endif
+
+	// Portable fallback, compare modification times a few times a second
+	void pollLoop()
+	{
+		while (this->running)
+		{
+			for (auto& i : this->files)
+			{
+				time_t lastWrite = getLastWrite(i.path);
+				if (lastWrite != 0 && lastWrite != i.lastWrite)
+				{
+					i.lastWrite = lastWrite;
+					this->markChanged(i.path);
+				}
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		}
+	}
+
+public:
+	ShaderWatcher()
+	{
+		this->running = false;
+	}
+
+	~ShaderWatcher()
+	{
+		this->stop();
+	}
+
+	// Register shaders before calling start
+	void watch(Shader* shader)
+	{
+		this->shaders.push_back(shader);
+		this->addFile(shader->getVertexFile());
+		this->addFile(shader->getGeometryFile());
+		this->addFile(shader->getFragmentFile());
+	}
+
+	void start()
+	{
+		if (this->running)
+		{
+			return;
+		}
+		// Let the driver compile with as many threads as it wants
+		if (GLEW_ARB_parallel_shader_compile)
+		{
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		}
+		this->running = true;
+		this->watchThread = std::thread(&ShaderWatcher::watchLoop, this);
+	}
+
+	void stop()
+	{
+		this->running = false;
+		if (this->watchThread.joinable())
+		{
+			this->watchThread.join();
+		}
+	}
+
+	// Called once per frame on the render thread. Starts reloads for changed files and swaps finished programs
+	void update()
+	{
+		std::set<std::string> changed;
+		{
+			std::lock_guard<std::mutex> lock(this->changedMutex);
+			changed.swap(this->changedFiles);
+		}
+		for (auto& file : changed)
+		{
+			for (auto* i : this->shaders)
+			{
+				if (i->usesFile(file))
+				{
+					std::cout << "Reloading shader: " << file << std::endl;
+					i->beginReload();
+				}
+			}
+		}
+		for (auto* i : this->shaders)
+		{
+			int status = i->getReloadStatus();
+			i->pollReload();
+			if (status == RELOAD_PENDING && i->getReloadStatus() != RELOAD_PENDING)
+			{
+				this->reloadTimes[i] = ImGui::GetTime();
+				if (i->getReloadStatus() == RELOAD_FAILED)
+				{
+					std::cout << i->getReloadLog() << std::endl;
+				}
+			}
+		}
+	}
+
+	// Status of every watched program and the info log of failed reloads
+	void renderGUI()
+	{
+		ImGui::Begin("Shader Reload");
+		ImGui::Text("Watching %d files (%s)", (int)this->files.size(), GLEW_ARB_parallel_shader_compile ? "parallel compile" : "blocking compile");
+		for (auto* i : this->shaders)
+		{
+			const char* status = "Loaded";
+			ImVec4 colour = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
+			switch (i->getReloadStatus())
+			{
+			case RELOAD_PENDING: status = "Compiling"; colour = ImVec4(1.0f, 1.0f, 0.0f, 1.0f); break;
+			case RELOAD_SUCCEEDED: status = "Reloaded"; colour = ImVec4(0.0f, 1.0f, 0.0f, 1.0f); break;
+			case RELOAD_FAILED: status = "Failed, using previous program"; colour = ImVec4(1.0f, 0.3f, 0.3f, 1.0f); break;
+			default: break;
+			}
+			ImGui::TextColored(colour, "%s: %s", i->getFragmentFile().c_str(), status);
+			ImGui::SameLine();
+			ImGui::TextDisabled("[%s, %.1f ms]", i->isSpirv() ? "SPIR-V" : "GLSL", i->getCompileMs());
+			if (this->reloadTimes.count(i))
+			{
+				ImGui::SameLine();
+				ImGui::TextDisabled("(%.0fs ago)", ImGui::GetTime() - this->reloadTimes[i]);
+			}
+			if (i->getReloadStatus() == RELOAD_FAILED)
+			{
+				ImGui::TextWrapped("%s", i->getReloadLog().c_str());
+			}
+		}
+		ImGui::End();
+	}
+};
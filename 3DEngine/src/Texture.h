@@ -8,11 +8,25 @@
 
 // SOIL2
 #include <SOIL2.h>
-#include <stb_image.h>
 
 // OTHER
 #include <iostream>
 #include <string>
+#include <vector>
+#include <algorithm>
+
+#include "GLState.h"
+#include "TextureCompressor.h"
+
+class Texture;
+
+// Told about every texture just before it is deleted, for classes that keep texture pointers
+class TextureListener
+{
+public:
+	virtual ~TextureListener() {}
+	virtual void onTextureDeleted(const Texture* texture) = 0;
+};
 
 class Texture
 {
@@ -20,12 +34,22 @@ private:
 	GLuint id;
 	int width;
 	int height;
-    unsigned int cubeVAO = 0;
-    unsigned int cubeVBO = 0;
+	size_t memoryBytes = 0;
+	// Format of the levels defined with uploadLevel
+	int format = FORMAT_RGBA8;
+	// Resident bindless handle, 0 until one is asked for
+	GLuint64 bindlessHandle = 0;
+
+	static std::vector<TextureListener*>& getListeners()
+	{
+		static std::vector<TextureListener*> listeners;
+		return listeners;
+	}
 
 public:
 
-	Texture(const char* fileName)
+    // Colour textures pass srgb so the sampler decodes them to linear before filtering
+	Texture(const char* fileName, bool srgb = false)
 	{
         // If already exists then delete
         if (this->id)
@@ -35,7 +59,7 @@ public:
         unsigned char* image = SOIL_load_image(fileName, &this->width, &this->height, NULL, SOIL_LOAD_RGBA);
 
         glGenTextures(1, &this->id);
-        glBindTexture(GL_TEXTURE_2D, this->id);
+        GLState::get().bindTexture(0, GL_TEXTURE_2D, this->id);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -44,8 +68,9 @@ public:
 
         if (image)
         {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, this->width, this->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+            glTexImage2D(GL_TEXTURE_2D, 0, srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, this->width, this->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
             glGenerateMipmap(GL_TEXTURE_2D);
+            this->memoryBytes = (size_t)this->width * this->height * 4 * 4 / 3;
         }
         else
         {
@@ -54,218 +79,232 @@ public:
         SOIL_free_image_data(image);
 	}
 
-    Texture(const char* fileName, Shader* equirectangularToCubemapShader, Shader* irradianceShader, unsigned int envCubeMap)
+    // 1x1 texture of a single colour, used as a placeholder until the real image has been decoded
+    Texture(unsigned char r, unsigned char g, unsigned char b, unsigned char a = 255)
     {
-        // Load HDR image from file
-        int nrComponents;
-        float* image = stbi_loadf(fileName, &this->width, &this->height, &nrComponents, 0);
-        unsigned int hdrTexture = 5; // index 5
-        if (image)
-        {
-            glGenTextures(1, &hdrTexture);
-            glBindTexture(GL_TEXTURE_2D, hdrTexture);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, this->width, this->height, 0, GL_RGB, GL_FLOAT, image);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            stbi_image_free(image);
-        }
-        else
+        const unsigned char colour[4] = { r, g, b, a };
+        this->width = 1;
+        this->height = 1;
+
+        glGenTextures(1, &this->id);
+        GLState::get().bindTexture(0, GL_TEXTURE_2D, this->id);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, colour);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        this->memoryBytes = 4;
+    }
+
+    // Empty texture of a single level in format, filled a region at a time with uploadRegion.
+    // Used for atlases, so it is filtered without mips and clamped to its edges
+    Texture(int width, int height, int format)
+    {
+        this->width = width;
+        this->height = height;
+
+        glGenTextures(1, &this->id);
+        GLState::get().bindTexture(0, GL_TEXTURE_2D, this->id);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glTexStorage2D(GL_TEXTURE_2D, 1, TextureCompressor::getGLFormat(format), width, height);
+        this->memoryBytes = TextureCompressor::getLevelBytes(format, width, height);
+    }
+
+    // Texture with levelCount mip levels of format and nothing in them yet. Levels are defined one
+    // at a time with uploadLevel and only those in the range set by setLevelRange are sampled,
+    // so a streamer can keep just the coarse end of the chain on the GPU
+    Texture(int width, int height, int format, int levelCount)
+    {
+        this->width = width;
+        this->height = height;
+        this->format = format;
+
+        glGenTextures(1, &this->id);
+        GLState::get().bindTexture(0, GL_TEXTURE_2D, this->id);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    }
+
+	~Texture()
+	{
+		for (auto* i : getListeners())
+		{
+			i->onTextureDeleted(this);
+		}
+		// A handle must stop being resident before its texture goes
+		if (this->bindlessHandle)
+		{
+			glMakeTextureHandleNonResidentARB(this->bindlessHandle);
+			getResidentHandleCount()--;
+		}
+		getDeleteCount()++;
+		GLState::get().forgetTexture(this->id);
+		glDeleteTextures(1, &this->id);
+	}
+
+	static void addListener(TextureListener* listener)
+	{
+		getListeners().push_back(listener);
+	}
+
+	static void removeListener(TextureListener* listener)
+	{
+		std::vector<TextureListener*>& listeners = getListeners();
+		listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+	}
+
+	// Bindless handle of the texture, made resident on first use and kept resident until the
+	// texture is deleted. The handle freezes the texture's sampling state
+	GLuint64 getBindlessHandle()
+	{
+		if (!this->bindlessHandle)
+		{
+			this->bindlessHandle = glGetTextureHandleARB(this->id);
+			glMakeTextureHandleResidentARB(this->bindlessHandle);
+			getResidentHandleCount()++;
+		}
+		return this->bindlessHandle;
+	}
+
+	static unsigned& getResidentHandleCount()
+	{
+		static unsigned count = 0;
+		return count;
+	}
+
+	// Textures deleted so far. Anything keyed on texture pointers rebuilds when it changes,
+	// since a new texture can be allocated at a freed one's address
+	static unsigned& getDeleteCount()
+	{
+		static unsigned count = 0;
+		return count;
+	}
+
+    GLuint getID() const
+    {
+        return this->id;
+    }
+
+    int getWidth() const
+    {
+        return this->width;
+    }
+
+    int getHeight() const
+    {
+        return this->height;
+    }
+
+    // Video memory taken by the texture including its mip chain
+    size_t getMemoryBytes() const
+    {
+        return this->memoryBytes;
+    }
+
+    // Replace the image with a prebuilt mip chain (block compressed or RGBA8) already written to a
+    // pixel unpack buffer, level offsets are into the buffer. Each level is uploaded as it is.
+    // The GL name does not change, so materials and bindings holding this texture pick up the new image
+    void uploadLevelsFromPixelBuffer(GLuint pixelBuffer, int format, const std::vector<CompressedLevel>& levels)
+    {
+        GLenum glFormat = TextureCompressor::getGLFormat(format);
+        this->width = levels[0].width;
+        this->height = levels[0].height;
+        this->memoryBytes = 0;
+        GLState::get().bindTexture(0, GL_TEXTURE_2D, this->id);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        for (size_t i = 0; i < levels.size(); i++)
         {
-            std::cout << "ERROR: Failed to load texture" << fileName << std::endl;
+            const CompressedLevel& level = levels[i];
+            if (TextureCompressor::getBaseFormat(format) == FORMAT_RGBA8)
+            {
+                glTexImage2D(GL_TEXTURE_2D, (GLint)i, glFormat, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)level.offset);
+            }
+            else
+            {
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, glFormat, level.width, level.height, 0, (GLsizei)level.size, (void*)level.offset);
+            }
+            this->memoryBytes += level.size;
         }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+    }
 
-        // Set up Frame buffer
-        unsigned int cubeFBO;
-        glGenFramebuffers(1, &cubeFBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
-        // Create Cubemap texture
-        glGenTextures(1, &envCubeMap);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, envCubeMap);
-        for (unsigned int i = 0; i < 6; ++i)
+    // Define one mip level from level.size bytes of data in the format the texture was created with
+    void uploadLevel(int index, const CompressedLevel& level, const void* data)
+    {
+        GLState::get().bindTexture(0, GL_TEXTURE_2D, this->id);
+        GLenum glFormat = TextureCompressor::getGLFormat(this->format);
+        if (TextureCompressor::getBaseFormat(this->format) == FORMAT_RGBA8)
         {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
+            glTexImage2D(GL_TEXTURE_2D, index, glFormat, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
         }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // Projection and view matrix for cubemap faces
-        glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-        glm::mat4 captureViews[] =
-        {
-           glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-           glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-           glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-           glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-           glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-           glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
-        };
-        
-        // Render HDR to Cubemap
-        equirectangularToCubemapShader->set1i(5, "equirectangularMap");
-        equirectangularToCubemapShader->setMat4fv(captureProjection, "projection");
-        equirectangularToCubemapShader->use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, hdrTexture);
-        glViewport(0, 0, 512, 512);
-        glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
-        for (unsigned int i = 0; i < 6; ++i)
+        else
         {
-            equirectangularToCubemapShader->setMat4fv(captureViews[i], "view");
-            equirectangularToCubemapShader->use();
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubeMap, 0);
-            glClear(GL_COLOR_BUFFER_BIT);
-            // DEBUGGING CODE
-            //GLenum type = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-            //switch (type)
-            //{
-            //case GL_FRAMEBUFFER_UNDEFINED: std::cout << "GL_FRAMEBUFFER_UNDEFINED"; break;
-            //case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT: std::cout << "GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT"; break;
-            //case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT: std::cout << "GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT"; break;
-            //case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER: std::cout << "GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER"; break;
-            //case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER: std::cout << "GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER"; break;
-            //case GL_FRAMEBUFFER_UNSUPPORTED: std::cout << "GL_FRAMEBUFFER_UNSUPPORTED"; break;
-            //case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE: std::cout << "GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE"; break;
-            //case GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS: std::cout << "GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS"; break;
-            //case GL_FRAMEBUFFER_COMPLETE: std::cout << "GL_FRAMEBUFFER_COMPLETE"; break;
-            //}
-            renderCube(); // renders a 1x1 cube
+            glCompressedTexImage2D(GL_TEXTURE_2D, index, glFormat, level.width, level.height, 0, (GLsizei)level.size, data);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        this->memoryBytes += level.size;
+    }
 
-        // Create texture for convoluted map
-        unsigned int irradianceMap = 7;
-        glGenTextures(1, &irradianceMap);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-        for (unsigned int i = 0; i < 6; ++i)
+    // Give a level defined with uploadLevel back to the driver by making it empty, it must be
+    // outside the sampled range by now
+    void releaseLevel(int index, const CompressedLevel& level)
+    {
+        GLState::get().bindTexture(0, GL_TEXTURE_2D, this->id);
+        GLenum glFormat = TextureCompressor::getGLFormat(this->format);
+        if (TextureCompressor::getBaseFormat(this->format) == FORMAT_RGBA8)
         {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
+            glTexImage2D(GL_TEXTURE_2D, index, glFormat, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
         }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
-
-        // Convolute to create irradiance cubemap
-        irradianceShader->use();
-        irradianceShader->set1i(6, "environmentMap");
-        irradianceShader->setMat4fv(captureProjection, "projection");
-        irradianceShader->use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, envCubeMap);
-        glViewport(0, 0, 32, 32);
-        glBindFramebuffer(GL_FRAMEBUFFER, cubeFBO);
-        for (unsigned int i = 0; i < 6; ++i)
+        else
         {
-            irradianceShader->setMat4fv(captureViews[i], "view");
-            irradianceShader->use();
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
-            glClear(GL_COLOR_BUFFER_BIT);
-            renderCube();
+            glCompressedTexImage2D(GL_TEXTURE_2D, index, glFormat, 0, 0, 0, 0, nullptr);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        this->memoryBytes -= level.size;
     }
-    
-
-	~Texture()
-	{
-		glDeleteTextures(1, &this->id);
-	}
 
-    GLuint getID() const
+    // Sample only levels base to max, every level in between must be defined
+    void setLevelRange(int base, int max)
     {
-        return this->id;
+        GLState::get().bindTexture(0, GL_TEXTURE_2D, this->id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, max);
     }
 
-    void bind(const GLint texture_unit)
+    // Overwrite part of the first level with an image of size bytes in format, block compressed
+    // regions must start and end on a block boundary
+    void uploadRegion(int x, int y, int width, int height, int format, const void* data, size_t size)
     {
-        glActiveTexture(GL_TEXTURE0 + texture_unit);
-        glBindTexture(GL_TEXTURE_2D, this->id);
+        GLState::get().bindTexture(0, GL_TEXTURE_2D, this->id);
+        if (TextureCompressor::getBaseFormat(format) == FORMAT_RGBA8)
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        }
+        else
+        {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, TextureCompressor::getGLFormat(format), (GLsizei)size, data);
+        }
     }
 
-    void unbind()
+    void bind(const GLint texture_unit)
     {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::get().bindTexture(texture_unit, GL_TEXTURE_2D, this->id);
     }
 
-private:
-    // IBL helper function for rendering to cubemap
-    void renderCube()
+    void unbind(const GLint texture_unit = 0)
     {
-        if (cubeVAO == 0)
-        {
-            float vertices[] = {
-                // back face
-                -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-                 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-                 1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
-                 1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-                -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-                -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
-                // front face
-                -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-                 1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
-                 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-                 1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-                -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
-                -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-                // left face
-                -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-                -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
-                -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-                -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-                -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-                -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-                // right face
-                 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-                 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-                 1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
-                 1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-                 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-                 1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
-                // bottom face
-                -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-                 1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
-                 1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-                 1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-                -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-                -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-                // top face
-                -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-                 1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-                 1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
-                 1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-                -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-                -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
-            };
-            glGenVertexArrays(1, &cubeVAO);
-            glGenBuffers(1, &cubeVBO);
-            // fill buffer
-            glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-            // link vertex attributes
-            glBindVertexArray(cubeVAO);
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-            glEnableVertexAttribArray(1);
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-            glEnableVertexAttribArray(2);
-            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-            glBindVertexArray(0);
-        }
-        // render Cube
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
+        GLState::get().bindTexture(texture_unit, GL_TEXTURE_2D, 0);
     }
 
 };
\ No newline at end of file
@@ -0,0 +1,315 @@
+#pragma once
+
+// SOIL2
+#include <SOIL2.h>
+
+// OTHER
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cctype>
+#include <algorithm>
+
+#include "TextureCompressor.h"
+#include "TextureFile.h"
+#include "VirtualTexture.h"
+
+// Offline texture bake: decodes every Assets/*.png, builds its mip chain, block compresses it
+// and writes Assets/<name>.ktx2 (or .dds). TextureLoader uses the baked file while it is newer
+// than the image, so startup skips PNG decoding and compression entirely.
+// Run with: 3DEngine.exe --bake textures [ktx2|dds]
+// --bake virtual writes tiled .vtex files for the virtual texture instead, see bakeVirtual.
+namespace TextureBake
+{
+	// GPU format for a material texture, picked from its name like Engine::initTextures does
+	inline int guessFormat(const std::string& fileName)
+	{
+		std::string name = fileName;
+		std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+		if (name.find("normal") != std::string::npos)
+		{
+			return FORMAT_BC5;
+		}
+		for (const char* i : { "rough", "metal", "_ao", "occlusion", "height" })
+		{
+			if (name.find(i) != std::string::npos)
+			{
+				return FORMAT_BC4;
+			}
+		}
+		// Everything else is colour, stored sRGB so the sampler linearises it
+		return FORMAT_BC7 | FORMAT_SRGB;
+	}
+
+	// ORM packing: occlusion, roughness and metallic maps share one BC7 texture (r, g, b), so the
+	// PBR shader's ORM_TEXTURE permutation reads them with one sampler and one fetch
+
+	// Channel of the packed texture a map goes to, -1 if it isn't one of the three
+	inline int getORMChannel(const std::string& fileName)
+	{
+		std::string name = fileName;
+		std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+		if (name.find("occlusion") != std::string::npos || name.find("_ao") != std::string::npos || name.compare(0, 3, "ao.") == 0)
+		{
+			return 0;
+		}
+		if (name.find("rough") != std::string::npos)
+		{
+			return 1;
+		}
+		if (name.find("metal") != std::string::npos)
+		{
+			return 2;
+		}
+		return -1;
+	}
+
+	// Source map per channel in a directory, empty where there is none
+	inline std::vector<std::string> findORMSources(const std::string& directory)
+	{
+		std::vector<std::string> sources(3);
+		for (auto& i : TextureFile::listFiles(directory, ".png"))
+		{
+			int channel = getORMChannel(i);
+			if (channel >= 0 && sources[channel].empty())
+			{
+				sources[channel] = directory + "/" + i;
+			}
+		}
+		return sources;
+	}
+
+	// Packed texture baked from the maps in a directory, empty if there is none newer than all of them
+	inline std::string findBakedORM(const std::string& directory)
+	{
+		std::vector<std::string> sources = findORMSources(directory);
+		for (const char* extension : { ".ktx2", ".dds" })
+		{
+			std::string packed = directory + "/orm" + extension;
+			time_t packedTime = TextureFile::getLastWrite(packed);
+			bool current = packedTime != 0;
+			for (auto& i : sources)
+			{
+				current = current && (i.empty() || TextureFile::getLastWrite(i) <= packedTime);
+			}
+			if (current)
+			{
+				return packed;
+			}
+		}
+		return std::string();
+	}
+
+	// RGBA8 image with occlusion, roughness and metallic in r, g, b. A missing occlusion map is
+	// white, a missing metallic map black. Returns false without roughness or metallic, or if the
+	// maps differ in size
+	inline bool packORM(const std::vector<std::string>& sources, std::vector<unsigned char>& rgba, int& width, int& height)
+	{
+		if (sources[1].empty() && sources[2].empty())
+		{
+			return false;
+		}
+		const unsigned char defaults[3] = { 255, 128, 0 };
+		width = 0;
+		height = 0;
+		for (int channel = 0; channel < 3; channel++)
+		{
+			if (sources[channel].empty())
+			{
+				continue;
+			}
+			int w, h;
+			unsigned char* map = SOIL_load_image(sources[channel].c_str(), &w, &h, NULL, SOIL_LOAD_RGBA);
+			if (!map || (width && (w != width || h != height)))
+			{
+				std::cout << "ERROR: Can't pack " << sources[channel] << ", it is missing or a different size" << std::endl;
+				SOIL_free_image_data(map);
+				return false;
+			}
+			if (!width)
+			{
+				width = w;
+				height = h;
+				rgba.assign((size_t)w * h * 4, 255);
+				for (size_t i = 0; i < (size_t)w * h; i++)
+				{
+					std::copy(defaults, defaults + 3, &rgba[i * 4]);
+				}
+			}
+			for (size_t i = 0; i < (size_t)w * h; i++)
+			{
+				rgba[i * 4 + channel] = map[i * 4];
+			}
+			SOIL_free_image_data(map);
+		}
+		return true;
+	}
+
+	inline int bake(const std::string& container = "ktx2", const std::string& directory = "Assets")
+	{
+		if (container != "ktx2" && container != "dds")
+		{
+			std::cout << "ERROR: Unknown texture container: " << container << " (ktx2 or dds)" << std::endl;
+			return 1;
+		}
+		std::vector<std::string> files = TextureFile::listFiles(directory, ".png");
+		if (files.empty())
+		{
+			std::cout << "ERROR: No .png files in " << directory << std::endl;
+			return 1;
+		}
+		std::cout << std::left << std::setw(24) << "texture" << std::right << std::setw(8) << "format" << std::setw(12) << "size"
+			<< std::setw(12) << "PNG MB" << std::setw(12) << "baked MB" << std::setw(12) << "bake ms" << std::endl;
+		int failed = 0;
+		for (auto& i : files)
+		{
+			std::string source = directory + "/" + i;
+			std::string target = directory + "/" + i.substr(0, i.size() - 4) + "." + container;
+			auto start = std::chrono::steady_clock::now();
+			int width, height;
+			unsigned char* rgba = SOIL_load_image(source.c_str(), &width, &height, NULL, SOIL_LOAD_RGBA);
+			if (!rgba)
+			{
+				std::cout << "ERROR: Failed to load texture" << source << std::endl;
+				failed = 1;
+				continue;
+			}
+			int format = guessFormat(i);
+			CompressedImage image = TextureCompressor::compress(rgba, width, height, format);
+			SOIL_free_image_data(rgba);
+			bool written = container == "dds" ? TextureFile::writeDDS(target, image) : TextureFile::writeKTX2(target, image);
+			if (!written)
+			{
+				std::cout << "ERROR: Could not write " << target << std::endl;
+				failed = 1;
+				continue;
+			}
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			const double mb = 1.0 / (1024.0 * 1024.0);
+			MappedFile sourceFile(source), targetFile(target);
+			std::cout << std::left << std::setw(24) << i << std::right << std::setw(8) << TextureCompressor::getFormatName(format)
+				<< std::setw(12) << (std::to_string(width) + "x" + std::to_string(height)) << std::fixed << std::setprecision(1)
+				<< std::setw(12) << sourceFile.getSize() * mb << std::setw(12) << targetFile.getSize() * mb << std::setw(12) << ms << std::endl;
+		}
+
+		// Packed occlusion/roughness/metallic, filtered as data rather than colour
+		std::vector<std::string> sources = findORMSources(directory);
+		std::vector<unsigned char> orm;
+		int width, height;
+		if (packORM(sources, orm, width, height))
+		{
+			std::string target = directory + "/orm." + container;
+			CompressedImage image = TextureCompressor::compress(orm.data(), width, height, FORMAT_BC7, &ThreadPool::get(), MIP_CONTENT_LINEAR);
+			bool written = container == "dds" ? TextureFile::writeDDS(target, image) : TextureFile::writeKTX2(target, image);
+			if (!written)
+			{
+				std::cout << "ERROR: Could not write " << target << std::endl;
+				failed = 1;
+			}
+			else
+			{
+				// Separate maps are BC4 at half a byte per texel each, the packed one is BC7 at one byte
+				int maps = 0;
+				for (auto& i : sources)
+				{
+					maps += i.empty() ? 0 : 1;
+				}
+				std::cout << "orm." << container << " packs " << maps << " maps: " << maps << " samplers and fetches become 1, "
+					<< maps * 0.5 << " bytes per texel become 1" << std::endl;
+			}
+		}
+		std::cout << "Load times: 3DEngine.exe --benchmark textureload" << std::endl;
+		return failed;
+	}
+
+	// Virtual texture layers in the order the engine binds them: albedo, packed ORM and normal map
+	inline std::vector<std::string> getVirtualLayers(const std::string& directory)
+	{
+		return { directory + "/albedo.vtex", directory + "/orm.vtex", directory + "/normal.vtex" };
+	}
+
+	// Tiled layers baked from a directory, empty unless all of them are there and newer than their sources
+	inline std::vector<std::string> findBakedVirtual(const std::string& directory)
+	{
+		std::vector<std::string> layers = getVirtualLayers(directory);
+		std::vector<std::string> sources = findORMSources(directory);
+		sources.push_back(directory + "/albedo.png");
+		sources.push_back(directory + "/normal.png");
+		time_t oldest = 0;
+		for (auto& i : layers)
+		{
+			time_t layerTime = TextureFile::getLastWrite(i);
+			if (layerTime == 0)
+			{
+				return std::vector<std::string>();
+			}
+			oldest = oldest ? std::min(oldest, layerTime) : layerTime;
+		}
+		for (auto& i : sources)
+		{
+			if (!i.empty() && TextureFile::getLastWrite(i) > oldest)
+			{
+				return std::vector<std::string>();
+			}
+		}
+		return layers;
+	}
+
+	// Writes albedo.vtex (BC7 sRGB), orm.vtex (BC7, packed like bake does) and normal.vtex (BC5).
+	// The engine then draws the model through the virtual texture, streaming only the pages it sees
+	inline int bakeVirtual(const std::string& directory = "Assets")
+	{
+		std::vector<std::string> layers = getVirtualLayers(directory);
+		std::cout << std::left << std::setw(24) << "layer" << std::right << std::setw(10) << "format" << std::setw(12) << "size"
+			<< std::setw(10) << "pages" << std::setw(12) << "file MB" << std::setw(12) << "bake ms" << std::endl;
+		int failed = 0;
+		for (size_t layer = 0; layer < layers.size(); layer++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			std::vector<unsigned char> rgba;
+			int width = 0, height = 0;
+			int format = FORMAT_BC7;
+			int mipContent = -1;
+			if (layer == 1)
+			{
+				if (!packORM(findORMSources(directory), rgba, width, height))
+				{
+					std::cout << "ERROR: No roughness or metalness map to pack in " << directory << std::endl;
+					failed = 1;
+					continue;
+				}
+				mipContent = MIP_CONTENT_LINEAR;
+			}
+			else
+			{
+				std::string source = directory + (layer == 0 ? "/albedo.png" : "/normal.png");
+				unsigned char* image = SOIL_load_image(source.c_str(), &width, &height, NULL, SOIL_LOAD_RGBA);
+				if (!image)
+				{
+					std::cout << "ERROR: Failed to load texture" << source << std::endl;
+					failed = 1;
+					continue;
+				}
+				rgba.assign(image, image + (size_t)width * height * 4);
+				SOIL_free_image_data(image);
+				format = guessFormat(source);
+			}
+			if (!TiledTextureFile::write(layers[layer], rgba.data(), width, height, format, &ThreadPool::get(), mipContent))
+			{
+				std::cout << "ERROR: Could not write " << layers[layer] << std::endl;
+				failed = 1;
+				continue;
+			}
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			MappedFile file(layers[layer]);
+			TiledTextureFile::TiledImage image;
+			TiledTextureFile::read(file, image);
+			std::cout << std::left << std::setw(24) << layers[layer] << std::right << std::setw(10) << TextureCompressor::getFormatName(format)
+				<< std::setw(12) << (std::to_string(width) + "x" + std::to_string(height)) << std::setw(10) << image.offsets.size()
+				<< std::fixed << std::setprecision(1) << std::setw(12) << file.getSize() / (1024.0 * 1024.0) << std::setw(12) << ms << std::endl;
+		}
+		std::cout << "Streaming behaviour: 3DEngine.exe --benchmark virtualtexture" << std::endl;
+		return failed;
+	}
+}
@@ -0,0 +1,384 @@
+#pragma once
+
+// ImGUI
+#include "vendor/imgui/imgui.h"
+
+// OTHER
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include <cctype>
+#include <algorithm>
+
+#include "Texture.h"
+#include "TextureLoader.h"
+
+class TextureCache;
+
+// One texture owned by the cache
+struct TextureCacheEntry
+{
+	TextureCache* cache;
+	Texture* texture;
+	std::string path;
+	int format;
+	uint64_t fileSize;
+	// 0 until another file of the same size and format is requested
+	uint64_t contentHash;
+	int refCount;
+	// Position in the cache's least recently used list while nothing references the texture
+	std::list<TextureCacheEntry*>::iterator lruPosition;
+};
+
+// Shared reference to a cached texture. The texture stays loaded while any handle to it exists,
+// once the last handle is gone the cache may evict it. Handles must not outlive their cache.
+class TextureHandle
+{
+private:
+	TextureCacheEntry* entry;
+
+public:
+	TextureHandle() : entry(nullptr) {}
+	explicit TextureHandle(TextureCacheEntry* entry);
+	TextureHandle(const TextureHandle& other);
+	TextureHandle(TextureHandle&& other) : entry(other.entry) { other.entry = nullptr; }
+	TextureHandle& operator=(TextureHandle other)
+	{
+		std::swap(this->entry, other.entry);
+		return *this;
+	}
+	~TextureHandle();
+
+	Texture* get() const { return this->entry ? this->entry->texture : nullptr; }
+	Texture* operator->() const { return this->get(); }
+	explicit operator bool() const { return this->entry != nullptr; }
+};
+
+// Loads each texture once per format. Requests are matched by canonical path first and by a hash of
+// the file contents second, so the same image under two names or copied to two files shares one GL
+// texture. Only files whose size matches a cached file of the same format are hashed, so a new image
+// doesn't cost a read on the render thread. Textures nothing references are kept for reuse and
+// evicted least recently used first once the cache is over its video memory budget.
+class TextureCache
+{
+public:
+	struct Stats
+	{
+		unsigned pathHits;
+		unsigned contentHits;
+		unsigned misses;
+		unsigned evictions;
+	};
+
+private:
+	TextureLoader& loader;
+	// Keyed by getPathKey
+	std::unordered_map<std::string, TextureCacheEntry*> byPath;
+	// Keyed by getSizeKey, the candidates for a content hit
+	std::unordered_multimap<uint64_t, TextureCacheEntry*> bySize;
+	std::vector<TextureCacheEntry*> entries;
+	// Unreferenced entries, most recently released at the front
+	std::list<TextureCacheEntry*> lru;
+	size_t budget;
+	Stats stats;
+
+	// Absolute path with one separator style, case folded on Windows where the file system ignores case
+	static std::string canonicalise(const std::string& path)
+	{
+		std::string result = path;
+#ifdef _WIN32
+		char full[_MAX_PATH];
+		if (_fullpath(full, path.c_str(), _MAX_PATH))
+		{
+			result = full;
+		}
+		std::replace(result.begin(), result.end(), '/', '\\');
+		std::transform(result.begin(), result.end(), result.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+#else
+		char full[PATH_MAX];
+		std::replace(result.begin(), result.end(), '\\', '/');
+		if (realpath(result.c_str(), full))
+		{
+			result = full;
+		}
+#endif
+		return result;
+	}
+
+	static std::string getPathKey(const std::string& path, int format)
+	{
+		return path + "|" + std::to_string(format);
+	}
+
+	static uint64_t getSizeKey(uint64_t fileSize, int format)
+	{
+		return (fileSize << 12) | (uint64_t)(format & 0xFFF);
+	}
+
+	// 0 if the file can't be read
+	static uint64_t getFileSize(const std::string& path)
+	{
+		std::ifstream inFile(path, std::ios::binary | std::ios::ate);
+		return inFile.is_open() ? (uint64_t)inFile.tellg() : 0;
+	}
+
+	// FNV-1a over the file, 0 if it can't be read
+	static uint64_t hashFile(const std::string& path)
+	{
+		std::ifstream inFile(path, std::ios::binary);
+		if (!inFile.is_open())
+		{
+			return 0;
+		}
+		uint64_t hash = 14695981039346656037ull;
+		char buffer[64 * 1024];
+		while (inFile.read(buffer, sizeof(buffer)) || inFile.gcount() > 0)
+		{
+			std::streamsize count = inFile.gcount();
+			for (std::streamsize i = 0; i < count; i++)
+			{
+				hash = (hash ^ (unsigned char)buffer[i]) * 1099511628211ull;
+			}
+		}
+		return hash;
+	}
+
+	void destroy(TextureCacheEntry* entry)
+	{
+		// Other paths may point at the same entry through a content hit
+		for (auto it = this->byPath.begin(); it != this->byPath.end();)
+		{
+			it = it->second == entry ? this->byPath.erase(it) : std::next(it);
+		}
+		auto candidates = this->bySize.equal_range(getSizeKey(entry->fileSize, entry->format));
+		for (auto it = candidates.first; it != candidates.second; ++it)
+		{
+			if (it->second == entry)
+			{
+				this->bySize.erase(it);
+				break;
+			}
+		}
+		this->entries.erase(std::find(this->entries.begin(), this->entries.end(), entry));
+		delete entry->texture;
+		delete entry;
+	}
+
+	TextureHandle insert(TextureCacheEntry* entry, const std::string& pathKey)
+	{
+		this->byPath[pathKey] = entry;
+		return TextureHandle(entry);
+	}
+
+	// A cached texture of the same format whose file has the same contents, hashing the files only now
+	TextureCacheEntry* findContent(const std::string& path, int format, uint64_t fileSize, uint64_t& hash)
+	{
+		auto candidates = this->bySize.equal_range(getSizeKey(fileSize, format));
+		for (auto it = candidates.first; it != candidates.second; ++it)
+		{
+			TextureCacheEntry* candidate = it->second;
+			if (candidate->format != format)
+			{
+				continue;
+			}
+			if (!hash)
+			{
+				hash = hashFile(path);
+			}
+			if (!candidate->contentHash)
+			{
+				candidate->contentHash = hashFile(candidate->path);
+			}
+			if (hash && candidate->contentHash == hash)
+			{
+				return candidate;
+			}
+		}
+		return nullptr;
+	}
+
+public:
+	TextureCache(TextureLoader& loader, size_t budget = 256 * 1024 * 1024) : loader(loader)
+	{
+		this->budget = budget;
+		this->stats = { 0, 0, 0, 0 };
+	}
+
+	~TextureCache()
+	{
+		this->clear();
+	}
+
+	// Get a texture, loading it only if neither its path nor its contents are cached yet
+	TextureHandle get(const char* fileName, int format = FORMAT_RGBA8, unsigned char r = 128, unsigned char g = 128, unsigned char b = 128)
+	{
+		std::string path = canonicalise(fileName);
+		std::string pathKey = getPathKey(path, format);
+		auto byPath = this->byPath.find(pathKey);
+		if (byPath != this->byPath.end())
+		{
+			this->stats.pathHits++;
+			return TextureHandle(byPath->second);
+		}
+
+		uint64_t fileSize = getFileSize(path);
+		uint64_t hash = 0;
+		TextureCacheEntry* byContent = fileSize ? this->findContent(path, format, fileSize, hash) : nullptr;
+		if (byContent)
+		{
+			this->stats.contentHits++;
+			return this->insert(byContent, pathKey);
+		}
+
+		this->stats.misses++;
+		TextureCacheEntry* entry = new TextureCacheEntry{ this, this->loader.load(fileName, format, r, g, b), path, format, fileSize, hash, 0, this->lru.end() };
+		this->entries.push_back(entry);
+		if (fileSize)
+		{
+			this->bySize.emplace(getSizeKey(fileSize, format), entry);
+		}
+		return this->insert(entry, pathKey);
+	}
+
+	// Called by TextureHandle
+	void acquire(TextureCacheEntry* entry)
+	{
+		if (entry->refCount++ == 0 && entry->lruPosition != this->lru.end())
+		{
+			this->lru.erase(entry->lruPosition);
+			entry->lruPosition = this->lru.end();
+		}
+	}
+
+	// Called by TextureHandle
+	void release(TextureCacheEntry* entry)
+	{
+		if (--entry->refCount == 0)
+		{
+			this->lru.push_front(entry);
+			entry->lruPosition = this->lru.begin();
+			this->evict();
+		}
+	}
+
+	// Delete unreferenced textures, oldest first, until the cache fits its budget
+	void evict()
+	{
+		size_t resident = this->getResidentBytes();
+		auto it = this->lru.end();
+		while (resident > this->budget && it != this->lru.begin())
+		{
+			TextureCacheEntry* entry = *--it;
+			// A texture still waiting on its decode is referenced by the loader
+			if (this->loader.isLoading(entry->texture))
+			{
+				continue;
+			}
+			resident -= entry->texture->getMemoryBytes();
+			it = this->lru.erase(it);
+			this->destroy(entry);
+			this->stats.evictions++;
+		}
+	}
+
+	void setBudget(size_t bytes)
+	{
+		this->budget = bytes;
+		this->evict();
+	}
+
+	size_t getBudget() const
+	{
+		return this->budget;
+	}
+
+	size_t getResidentBytes() const
+	{
+		size_t bytes = 0;
+		for (auto* i : this->entries)
+		{
+			bytes += i->texture->getMemoryBytes();
+		}
+		return bytes;
+	}
+
+	size_t getUnreferencedBytes() const
+	{
+		size_t bytes = 0;
+		for (auto* i : this->lru)
+		{
+			bytes += i->texture->getMemoryBytes();
+		}
+		return bytes;
+	}
+
+	const Stats& getStats() const
+	{
+		return this->stats;
+	}
+
+	// Delete every texture, handles still held become dangling
+	void clear()
+	{
+		for (auto* i : this->entries)
+		{
+			delete i->texture;
+			delete i;
+		}
+		this->entries.clear();
+		this->byPath.clear();
+		this->bySize.clear();
+		this->lru.clear();
+	}
+
+	void renderGUI()
+	{
+		const float mb = 1.0f / (1024.0f * 1024.0f);
+		unsigned requests = this->stats.pathHits + this->stats.contentHits + this->stats.misses;
+		ImGui::Begin("Texture Cache");
+		ImGui::Text("Requests: %u (%u path hits, %u content hits, %u misses)", requests, this->stats.pathHits, this->stats.contentHits, this->stats.misses);
+		ImGui::Text("Hit rate: %.1f%%", requests ? 100.0f * (requests - this->stats.misses) / requests : 0.0f);
+		ImGui::Text("Textures: %d (%d unreferenced), %u evicted", (int)this->entries.size(), (int)this->lru.size(), this->stats.evictions);
+		ImGui::Text("Memory: %.1f MB resident, %.1f MB unreferenced", this->getResidentBytes() * mb, this->getUnreferencedBytes() * mb);
+		int budgetMb = (int)(this->budget / (1024 * 1024));
+		if (ImGui::SliderInt("Budget (MB)", &budgetMb, 16, 2048))
+		{
+			this->setBudget((size_t)budgetMb * 1024 * 1024);
+		}
+		for (auto* i : this->entries)
+		{
+			ImGui::Text("%5.1f MB  refs %d  %s", i->texture->getMemoryBytes() * mb, i->refCount, i->path.c_str());
+		}
+		ImGui::End();
+	}
+};
+
+inline TextureHandle::TextureHandle(TextureCacheEntry* entry) : entry(entry)
+{
+	if (this->entry)
+	{
+		this->entry->cache->acquire(this->entry);
+	}
+}
+
+inline TextureHandle::TextureHandle(const TextureHandle& other) : entry(other.entry)
+{
+	if (this->entry)
+	{
+		this->entry->cache->acquire(this->entry);
+	}
+}
+
+inline TextureHandle::~TextureHandle()
+{
+	if (this->entry)
+	{
+		this->entry->cache->release(this->entry);
+	}
+}
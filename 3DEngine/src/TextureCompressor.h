@@ -0,0 +1,668 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// OTHER
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "SIMD.h"
+#include "ThreadPool.h"
+#include "MipGenerator.h"
+
+// Formats a texture can be stored in on the GPU
+enum texture_format_enum { FORMAT_RGBA8 = 0, FORMAT_BC7, FORMAT_BC5, FORMAT_BC4 };
+// Added to FORMAT_RGBA8 or FORMAT_BC7 for colour stored with sRGB gamma (FORMAT_BC7 | FORMAT_SRGB).
+// The texture unit then converts texels to linear before filtering, so shaders read linear colour
+enum texture_colour_space_enum { FORMAT_SRGB = 0x100 };
+
+// One mip level inside CompressedImage::data
+struct CompressedLevel
+{
+	int width;
+	int height;
+	size_t offset;
+	size_t size;
+};
+
+// Block compressed image with its full mip chain
+struct CompressedImage
+{
+	int format;
+	std::vector<unsigned char> data;
+	std::vector<CompressedLevel> levels;
+};
+
+// CPU block compression:
+// BC7 (mode 6, one RGBA line with 16 steps) for colour, BC5 (two BC4 channels) for normal maps
+// and BC4 (one channel, 8 steps) for greyscale maps like roughness and metalness.
+// Blocks of every mip level are encoded in parallel on the thread pool.
+namespace TextureCompressor
+{
+	// Format without the colour space
+	inline int getBaseFormat(int format)
+	{
+		return format & ~FORMAT_SRGB;
+	}
+
+	inline bool isSRGB(int format)
+	{
+		return (format & FORMAT_SRGB) != 0;
+	}
+
+	inline GLenum getGLFormat(int format)
+	{
+		bool srgb = isSRGB(format);
+		switch (getBaseFormat(format))
+		{
+		case FORMAT_BC7: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		case FORMAT_BC5: return GL_COMPRESSED_RG_RGTC2;
+		case FORMAT_BC4: return GL_COMPRESSED_RED_RGTC1;
+		default: return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		}
+	}
+
+	inline size_t getBlockBytes(int format)
+	{
+		return getBaseFormat(format) == FORMAT_BC4 ? 8 : 16;
+	}
+
+	// Bytes of one level, RGBA8 levels are stored as plain rows of pixels
+	inline size_t getLevelBytes(int format, int width, int height)
+	{
+		if (getBaseFormat(format) == FORMAT_RGBA8)
+		{
+			return (size_t)width * height * 4;
+		}
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes(format);
+	}
+
+	// Space the mip chain is filtered in: BC5 holds normal maps, sRGB formats colour and the rest
+	// data that is filtered as stored
+	inline int getMipContent(int format)
+	{
+		if (getBaseFormat(format) == FORMAT_BC5)
+		{
+			return MIP_CONTENT_NORMAL;
+		}
+		return isSRGB(format) ? MIP_CONTENT_SRGB : MIP_CONTENT_LINEAR;
+	}
+
+	inline const char* getFormatName(int format)
+	{
+		bool srgb = isSRGB(format);
+		switch (getBaseFormat(format))
+		{
+		case FORMAT_BC7: return srgb ? "BC7 sRGB" : "BC7";
+		case FORMAT_BC5: return "BC5";
+		case FORMAT_BC4: return "BC4";
+		default: return srgb ? "RGBA8 sRGB" : "RGBA8";
+		}
+	}
+
+	// For each of 16 pixels (channels stored as separate rows of 16) find the closest palette
+	// entry. Returns the summed squared error
+	inline float findNearest(const float pixels[][16], int channels, const float palette[][4], int paletteSize, uint8_t indices[16])
+	{
+		float total = 0.0f;
+#ifdef ENGINE_SSE2
+		// Four pixels at a time against every entry, keeping the best index per lane
+		for (int p = 0; p < 16; p += 4)
+		{
+			__m128 best = _mm_set1_ps(1e30f);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (int k = 0; k < paletteSize; k++)
+			{
+				__m128 error = _mm_setzero_ps();
+				for (int c = 0; c < channels; c++)
+				{
+					__m128 d = _mm_sub_ps(_mm_loadu_ps(&pixels[c][p]), _mm_set1_ps(palette[k][c]));
+					error = _mm_add_ps(error, _mm_mul_ps(d, d));
+				}
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(error, best));
+				best = _mm_min_ps(error, best);
+				bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestIndex));
+			}
+			alignas(16) int32_t lanes[4];
+			alignas(16) float errors[4];
+			_mm_store_si128((__m128i*)lanes, bestIndex);
+			_mm_store_ps(errors, best);
+			for (int i = 0; i < 4; i++)
+			{
+				indices[p + i] = (uint8_t)lanes[i];
+				total += errors[i];
+			}
+		}
+#else
+		for (int p = 0; p < 16; p++)
+		{
+			float best = 1e30f;
+			for (int k = 0; k < paletteSize; k++)
+			{
+				float error = 0.0f;
+				for (int c = 0; c < channels; c++)
+				{
+					float d = pixels[c][p] - palette[k][c];
+					error += d * d;
+				}
+				if (error < best)
+				{
+					best = error;
+					indices[p] = (uint8_t)k;
+				}
+			}
+			total += best;
+		}
+#endif
+		return total;
+	}
+
+	// Least squares endpoints for fixed palette weights (0 = first endpoint, 1 = second)
+	inline void fitEndpoints(const float pixels[][16], int channels, const uint8_t indices[16], const float* weights, float endpoints[2][4])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = { 0.0f }, bx[4] = { 0.0f };
+		for (int p = 0; p < 16; p++)
+		{
+			float w = weights[indices[p]];
+			aa += (1.0f - w) * (1.0f - w);
+			ab += (1.0f - w) * w;
+			bb += w * w;
+			for (int c = 0; c < channels; c++)
+			{
+				ax[c] += (1.0f - w) * pixels[c][p];
+				bx[c] += w * pixels[c][p];
+			}
+		}
+		float det = aa * bb - ab * ab;
+		if (std::fabs(det) < 1e-6f)
+		{
+			return;
+		}
+		for (int c = 0; c < channels; c++)
+		{
+			endpoints[0][c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / det));
+			endpoints[1][c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / det));
+		}
+	}
+
+	// Little endian bit packing into a block
+	struct BitWriter
+	{
+		uint8_t* out;
+		unsigned position;
+
+		void write(unsigned value, unsigned bits)
+		{
+			for (unsigned i = 0; i < bits; i++, this->position++)
+			{
+				if (value & (1u << i))
+				{
+					this->out[this->position >> 3] |= (uint8_t)(1u << (this->position & 7));
+				}
+			}
+		}
+	};
+
+	struct BitReader
+	{
+		const uint8_t* in;
+		unsigned position;
+
+		unsigned read(unsigned bits)
+		{
+			unsigned value = 0;
+			for (unsigned i = 0; i < bits; i++, this->position++)
+			{
+				value |= ((this->in[this->position >> 3] >> (this->position & 7)) & 1u) << i;
+			}
+			return value;
+		}
+	};
+
+	// BC4
+
+	inline void getBC4Palette(uint8_t r0, uint8_t r1, float palette[8][4])
+	{
+		palette[0][0] = r0;
+		palette[1][0] = r1;
+		if (r0 > r1)
+		{
+			for (int i = 1; i < 7; i++)
+			{
+				palette[i + 1][0] = (float)(((7 - i) * r0 + i * r1) / 7);
+			}
+		}
+		else
+		{
+			for (int i = 1; i < 5; i++)
+			{
+				palette[i + 1][0] = (float)(((5 - i) * r0 + i * r1) / 5);
+			}
+			palette[6][0] = 0.0f;
+			palette[7][0] = 255.0f;
+		}
+	}
+
+	inline float tryBC4(const float pixels[][16], uint8_t r0, uint8_t r1, uint8_t out[8], uint8_t indices[16])
+	{
+		float palette[8][4];
+		getBC4Palette(r0, r1, palette);
+		float error = findNearest(pixels, 1, palette, 8, indices);
+		std::memset(out, 0, 8);
+		BitWriter writer = { out, 0 };
+		writer.write(r0, 8);
+		writer.write(r1, 8);
+		for (int p = 0; p < 16; p++)
+		{
+			writer.write(indices[p], 3);
+		}
+		return error;
+	}
+
+	// One channel block, pixels[0] holds the 16 values
+	inline void encodeBC4Block(const float pixels[][16], uint8_t out[8])
+	{
+		float lo = 255.0f, hi = 0.0f;
+		for (int p = 0; p < 16; p++)
+		{
+			lo = std::min(lo, pixels[0][p]);
+			hi = std::max(hi, pixels[0][p]);
+		}
+		uint8_t indices[16];
+		uint8_t r0 = (uint8_t)(hi + 0.5f);
+		uint8_t r1 = (uint8_t)(lo + 0.5f);
+		float error = tryBC4(pixels, r0, r1, out, indices);
+		if (error == 0.0f || r0 <= r1)
+		{
+			return;
+		}
+		// Refit the endpoints to the chosen steps, kept if it lowers the error
+		static const float weights[8] = { 0.0f, 1.0f, 1.0f / 7, 2.0f / 7, 3.0f / 7, 4.0f / 7, 5.0f / 7, 6.0f / 7 };
+		float endpoints[2][4] = { { hi }, { lo } };
+		fitEndpoints(pixels, 1, indices, weights, endpoints);
+		uint8_t f0 = (uint8_t)(endpoints[0][0] + 0.5f);
+		uint8_t f1 = (uint8_t)(endpoints[1][0] + 0.5f);
+		if (f0 > f1)
+		{
+			uint8_t refit[8];
+			if (tryBC4(pixels, f0, f1, refit, indices) < error)
+			{
+				std::memcpy(out, refit, 8);
+			}
+		}
+	}
+
+	inline void decodeBC4Block(const uint8_t in[8], uint8_t* values, int stride)
+	{
+		float palette[8][4];
+		getBC4Palette(in[0], in[1], palette);
+		BitReader reader = { in, 16 };
+		for (int p = 0; p < 16; p++)
+		{
+			values[p * stride] = (uint8_t)palette[reader.read(3)][0];
+		}
+	}
+
+	// BC7 mode 6
+
+	static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	inline void getBC7Palette(const int endpoints[2][4], float palette[16][4])
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				palette[i][c] = (float)(((64 - BC7_WEIGHTS[i]) * endpoints[0][c] + BC7_WEIGHTS[i] * endpoints[1][c] + 32) >> 6);
+			}
+		}
+	}
+
+	// Quantise to 7 bits plus a shared low bit per endpoint, choosing the low bit that fits best
+	inline void quantiseBC7(const float endpoints[2][4], int quantised[2][4], int pbits[2])
+	{
+		for (int e = 0; e < 2; e++)
+		{
+			float bestError = 1e30f;
+			for (int p = 0; p < 2; p++)
+			{
+				int q[4];
+				float error = 0.0f;
+				for (int c = 0; c < 4; c++)
+				{
+					q[c] = std::min(127, std::max(0, (int)std::floor((endpoints[e][c] - p) * 0.5f + 0.5f)));
+					float d = (float)((q[c] << 1) | p) - endpoints[e][c];
+					error += d * d;
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					pbits[e] = p;
+					for (int c = 0; c < 4; c++)
+					{
+						quantised[e][c] = q[c];
+					}
+				}
+			}
+		}
+	}
+
+	inline float tryBC7(const float pixels[][16], const float endpoints[2][4], uint8_t out[16], uint8_t indices[16])
+	{
+		int quantised[2][4];
+		int pbits[2];
+		quantiseBC7(endpoints, quantised, pbits);
+		int expanded[2][4];
+		for (int e = 0; e < 2; e++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				expanded[e][c] = (quantised[e][c] << 1) | pbits[e];
+			}
+		}
+		float palette[16][4];
+		getBC7Palette(expanded, palette);
+		float error = findNearest(pixels, 4, palette, 16, indices);
+
+		// The first index is stored with 3 bits, swap the endpoints so its top bit is 0
+		if (indices[0] & 8)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				std::swap(quantised[0][c], quantised[1][c]);
+			}
+			std::swap(pbits[0], pbits[1]);
+			for (int p = 0; p < 16; p++)
+			{
+				indices[p] = 15 - indices[p];
+			}
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter writer = { out, 0 };
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.write(quantised[0][c], 7);
+			writer.write(quantised[1][c], 7);
+		}
+		writer.write(pbits[0], 1);
+		writer.write(pbits[1], 1);
+		writer.write(indices[0], 3);
+		for (int p = 1; p < 16; p++)
+		{
+			writer.write(indices[p], 4);
+		}
+		return error;
+	}
+
+	inline void encodeBC7Block(const float pixels[][16], uint8_t out[16])
+	{
+		// Principal axis of the block colours by power iteration on the covariance
+		float mean[4] = { 0.0f };
+		for (int c = 0; c < 4; c++)
+		{
+			for (int p = 0; p < 16; p++)
+			{
+				mean[c] += pixels[c][p];
+			}
+			mean[c] /= 16.0f;
+		}
+		float covariance[4][4] = { { 0.0f } };
+		for (int p = 0; p < 16; p++)
+		{
+			float d[4];
+			for (int c = 0; c < 4; c++)
+			{
+				d[c] = pixels[c][p] - mean[c];
+			}
+			for (int a = 0; a < 4; a++)
+			{
+				for (int b = 0; b < 4; b++)
+				{
+					covariance[a][b] += d[a] * d[b];
+				}
+			}
+		}
+		float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = { 0.0f };
+			float length = 0.0f;
+			for (int a = 0; a < 4; a++)
+			{
+				for (int b = 0; b < 4; b++)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length += next[a] * next[a];
+			}
+			if (length < 1e-12f)
+			{
+				break;
+			}
+			length = 1.0f / std::sqrt(length);
+			for (int a = 0; a < 4; a++)
+			{
+				axis[a] = next[a] * length;
+			}
+		}
+
+		// Endpoints at the extremes of the projection onto the axis
+		float lo = 1e30f, hi = -1e30f;
+		for (int p = 0; p < 16; p++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				t += (pixels[c][p] - mean[c]) * axis[c];
+			}
+			lo = std::min(lo, t);
+			hi = std::max(hi, t);
+		}
+		float endpoints[2][4];
+		for (int c = 0; c < 4; c++)
+		{
+			endpoints[0][c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * lo));
+			endpoints[1][c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * hi));
+		}
+
+		uint8_t indices[16];
+		float error = tryBC7(pixels, endpoints, out, indices);
+
+		// Refit to the chosen weights, the swap in tryBC7 may have reversed the index order
+		float weights[16];
+		for (int i = 0; i < 16; i++)
+		{
+			weights[i] = BC7_WEIGHTS[i] / 64.0f;
+		}
+		for (int iteration = 0; iteration < 2 && error > 0.0f; iteration++)
+		{
+			fitEndpoints(pixels, 4, indices, weights, endpoints);
+			uint8_t refit[16];
+			uint8_t refitIndices[16];
+			float refitError = tryBC7(pixels, endpoints, refit, refitIndices);
+			if (refitError >= error)
+			{
+				break;
+			}
+			error = refitError;
+			std::memcpy(out, refit, 16);
+			std::memcpy(indices, refitIndices, 16);
+		}
+	}
+
+	// Decodes mode 6 blocks only, which is all encodeBC7Block writes. Returns false for other modes
+	inline bool decodeBC7Block(const uint8_t in[16], uint8_t rgba[64])
+	{
+		if ((in[0] & 0x7F) != (1 << 6))
+		{
+			return false;
+		}
+		BitReader reader = { in, 7 };
+		int endpoints[2][4];
+		for (int c = 0; c < 4; c++)
+		{
+			endpoints[0][c] = reader.read(7) << 1;
+			endpoints[1][c] = reader.read(7) << 1;
+		}
+		int p0 = reader.read(1);
+		int p1 = reader.read(1);
+		for (int c = 0; c < 4; c++)
+		{
+			endpoints[0][c] |= p0;
+			endpoints[1][c] |= p1;
+		}
+		float palette[16][4];
+		getBC7Palette(endpoints, palette);
+		for (int p = 0; p < 16; p++)
+		{
+			unsigned index = reader.read(p == 0 ? 3 : 4);
+			for (int c = 0; c < 4; c++)
+			{
+				rgba[p * 4 + c] = (uint8_t)palette[index][c];
+			}
+		}
+		return true;
+	}
+
+	// Images
+
+	// Encode the 4x4 block at (bx, by) of an RGBA8 image, edge blocks repeat the last pixels
+	inline void encodeBlock(const unsigned char* rgba, int width, int height, int bx, int by, int format, uint8_t* out)
+	{
+		float pixels[4][16];
+		for (int p = 0; p < 16; p++)
+		{
+			int x = std::min(bx * 4 + (p & 3), width - 1);
+			int y = std::min(by * 4 + (p >> 2), height - 1);
+			const unsigned char* texel = rgba + ((size_t)y * width + x) * 4;
+			for (int c = 0; c < 4; c++)
+			{
+				pixels[c][p] = texel[c];
+			}
+		}
+		switch (getBaseFormat(format))
+		{
+		case FORMAT_BC7:
+			encodeBC7Block(pixels, out);
+			break;
+		case FORMAT_BC5:
+			encodeBC4Block(pixels, out);
+			encodeBC4Block(pixels + 1, out + 8);
+			break;
+		case FORMAT_BC4:
+			encodeBC4Block(pixels, out);
+			break;
+		}
+	}
+
+	// Compress an RGBA8 image and every mip level below it. Pass a pool to spread the mip filtering
+	// and the blocks of all levels over its threads, or nullptr to encode on the calling thread.
+	// The mip chain is filtered with MipGenerator in the space getMipContent picks for the format,
+	// or in mipContent if it is given. FORMAT_RGBA8 only builds the uncompressed mip chain
+	inline CompressedImage compress(const unsigned char* rgba, int width, int height, int format, ThreadPool* pool = &ThreadPool::get(), int mipContent = -1)
+	{
+		CompressedImage image;
+		image.format = format;
+
+		// Mip chain
+		std::vector<MipLevel> mips = MipGenerator::generate(rgba, width, height, mipContent < 0 ? getMipContent(format) : mipContent, MIP_FILTER_KAISER, pool);
+		int w = width, h = height;
+		size_t blockBytes = getBlockBytes(format);
+		size_t offset = 0;
+		std::vector<size_t> firstBlock;
+		size_t blockCount = 0;
+		while (true)
+		{
+			size_t blocksX = (w + 3) / 4, blocksY = (h + 3) / 4;
+			image.levels.push_back({ w, h, offset, getLevelBytes(format, w, h) });
+			firstBlock.push_back(blockCount);
+			offset += image.levels.back().size;
+			blockCount += blocksX * blocksY;
+			if (w == 1 && h == 1)
+			{
+				break;
+			}
+			w = std::max(1, w / 2);
+			h = std::max(1, h / 2);
+		}
+		image.data.resize(offset);
+
+		if (getBaseFormat(format) == FORMAT_RGBA8)
+		{
+			for (size_t level = 0; level < image.levels.size(); level++)
+			{
+				std::memcpy(image.data.data() + image.levels[level].offset, level == 0 ? rgba : mips[level - 1].rgba.data(), image.levels[level].size);
+			}
+			return image;
+		}
+
+		// Blocks of all levels form one range, so the small levels don't leave threads idle
+		auto encodeRange = [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				size_t level = std::upper_bound(firstBlock.begin(), firstBlock.end(), i) - firstBlock.begin() - 1;
+				const CompressedLevel& l = image.levels[level];
+				const unsigned char* pixels = level == 0 ? rgba : mips[level - 1].rgba.data();
+				size_t block = i - firstBlock[level];
+				int blocksX = (l.width + 3) / 4;
+				encodeBlock(pixels, l.width, l.height, (int)(block % blocksX), (int)(block / blocksX), format, image.data.data() + l.offset + block * blockBytes);
+			}
+		};
+		if (pool)
+		{
+			pool->parallelFor(blockCount, 256, encodeRange);
+		}
+		else
+		{
+			encodeRange(0, blockCount);
+		}
+		return image;
+	}
+
+	// Decode the first level back to RGBA8, used to measure the quality of the encoder
+	inline std::vector<unsigned char> decompress(const CompressedImage& image)
+	{
+		const CompressedLevel& level = image.levels[0];
+		std::vector<unsigned char> rgba((size_t)level.width * level.height * 4, 0);
+		size_t blockBytes = getBlockBytes(image.format);
+		int blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+		for (int by = 0; by < blocksY; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				const uint8_t* block = image.data.data() + level.offset + ((size_t)by * blocksX + bx) * blockBytes;
+				uint8_t decoded[64] = { 0 };
+				switch (getBaseFormat(image.format))
+				{
+				case FORMAT_BC7:
+					decodeBC7Block(block, decoded);
+					break;
+				case FORMAT_BC5:
+					decodeBC4Block(block, decoded, 4);
+					decodeBC4Block(block + 8, decoded + 1, 4);
+					break;
+				case FORMAT_BC4:
+					decodeBC4Block(block, decoded, 4);
+					break;
+				}
+				for (int p = 0; p < 16; p++)
+				{
+					int x = bx * 4 + (p & 3), y = by * 4 + (p >> 2);
+					if (x < level.width && y < level.height)
+					{
+						std::memcpy(&rgba[((size_t)y * level.width + x) * 4], &decoded[p * 4], 4);
+					}
+				}
+			}
+		}
+		return rgba;
+	}
+}
@@ -0,0 +1,477 @@
+#pragma once
+
+// OTHER
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "TextureCompressor.h"
+#include "MappedFile.h"
+
+// KTX2 and DDS containers holding a prebuilt mip chain, block compressed or RGBA8, with its colour space.
+// Readers only parse the headers and return where each level lives in the file, so a memory
+// mapped file can be copied straight to the GPU with no decode step.
+// Both formats are little endian, like every target the engine builds for.
+namespace TextureFile
+{
+	static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	// VkFormat values used by KTX2
+	enum vk_format_enum
+	{
+		VK_FORMAT_R8G8B8A8_UNORM = 37,
+		VK_FORMAT_R8G8B8A8_SRGB = 43,
+		VK_FORMAT_BC4_UNORM_BLOCK = 139,
+		VK_FORMAT_BC5_UNORM_BLOCK = 141,
+		VK_FORMAT_BC7_UNORM_BLOCK = 145,
+		VK_FORMAT_BC7_SRGB_BLOCK = 146
+	};
+
+	// DXGI_FORMAT values used by the DDS DX10 header
+	enum dxgi_format_enum
+	{
+		DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+		DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+		DXGI_FORMAT_BC4_UNORM = 80,
+		DXGI_FORMAT_BC5_UNORM = 83,
+		DXGI_FORMAT_BC7_UNORM = 98,
+		DXGI_FORMAT_BC7_UNORM_SRGB = 99
+	};
+
+	inline uint32_t readU32(const unsigned char* data)
+	{
+		uint32_t value;
+		std::memcpy(&value, data, 4);
+		return value;
+	}
+
+	inline uint64_t readU64(const unsigned char* data)
+	{
+		uint64_t value;
+		std::memcpy(&value, data, 8);
+		return value;
+	}
+
+	inline void writeU32(std::vector<unsigned char>& out, uint32_t value)
+	{
+		const unsigned char* bytes = (const unsigned char*)&value;
+		out.insert(out.end(), bytes, bytes + 4);
+	}
+
+	inline void writeU64(std::vector<unsigned char>& out, uint64_t value)
+	{
+		const unsigned char* bytes = (const unsigned char*)&value;
+		out.insert(out.end(), bytes, bytes + 8);
+	}
+
+	inline uint32_t fourCC(const char* code)
+	{
+		return (uint32_t)(unsigned char)code[0] | ((uint32_t)(unsigned char)code[1] << 8)
+			| ((uint32_t)(unsigned char)code[2] << 16) | ((uint32_t)(unsigned char)code[3] << 24);
+	}
+
+	// Fill in the dimensions of each level, the offsets are set by the caller
+	inline bool setLevelSizes(int format, int width, int height, std::vector<CompressedLevel>& levels)
+	{
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			levels[i].width = std::max(1, width >> i);
+			levels[i].height = std::max(1, height >> i);
+			levels[i].size = TextureCompressor::getLevelBytes(format, levels[i].width, levels[i].height);
+		}
+		return !levels.empty() && width > 0 && height > 0;
+	}
+
+	// KTX2
+
+	inline int formatFromVk(uint32_t vkFormat)
+	{
+		switch (vkFormat)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM: return FORMAT_RGBA8;
+		case VK_FORMAT_BC4_UNORM_BLOCK: return FORMAT_BC4;
+		case VK_FORMAT_BC5_UNORM_BLOCK: return FORMAT_BC5;
+		case VK_FORMAT_BC7_UNORM_BLOCK: return FORMAT_BC7;
+		case VK_FORMAT_R8G8B8A8_SRGB: return FORMAT_RGBA8 | FORMAT_SRGB;
+		case VK_FORMAT_BC7_SRGB_BLOCK: return FORMAT_BC7 | FORMAT_SRGB;
+		default: return -1;
+		}
+	}
+
+	inline uint32_t formatToVk(int format)
+	{
+		bool srgb = TextureCompressor::isSRGB(format);
+		switch (TextureCompressor::getBaseFormat(format))
+		{
+		case FORMAT_BC4: return VK_FORMAT_BC4_UNORM_BLOCK;
+		case FORMAT_BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case FORMAT_BC7: return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		default: return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+
+	// Basic data format descriptor the KTX2 spec requires for each vkFormat
+	inline std::vector<unsigned char> buildDataFormatDescriptor(int format)
+	{
+		struct Sample
+		{
+			uint32_t bitOffset;
+			uint32_t bitLength;
+			uint32_t channel;
+			uint32_t upper;
+		};
+		std::vector<Sample> samples;
+		uint32_t colourModel;
+		uint32_t blockDimensions;
+		int base = TextureCompressor::getBaseFormat(format);
+		switch (base)
+		{
+		case FORMAT_BC7:
+			colourModel = 134; // KHR_DF_MODEL_BC7
+			samples.push_back({ 0, 128, 0, 0xFFFFFFFF });
+			break;
+		case FORMAT_BC5:
+			colourModel = 132; // KHR_DF_MODEL_BC5
+			samples.push_back({ 0, 64, 0, 0xFFFFFFFF });
+			samples.push_back({ 64, 64, 1, 0xFFFFFFFF });
+			break;
+		case FORMAT_BC4:
+			colourModel = 131; // KHR_DF_MODEL_BC4
+			samples.push_back({ 0, 64, 0, 0xFFFFFFFF });
+			break;
+		default:
+			colourModel = 1; // KHR_DF_MODEL_RGBSDA
+			samples.push_back({ 0, 8, 0, 255 });
+			samples.push_back({ 8, 8, 1, 255 });
+			samples.push_back({ 16, 8, 2, 255 });
+			samples.push_back({ 24, 8, 15, 255 });
+			break;
+		}
+		// Block dimensions are stored minus one, 4x4 for the block formats
+		blockDimensions = base == FORMAT_RGBA8 ? 0 : 0x0303;
+		uint32_t bytesPerBlock = base == FORMAT_RGBA8 ? 4 : (uint32_t)TextureCompressor::getBlockBytes(format);
+		uint32_t transfer = TextureCompressor::isSRGB(format) ? 2 : 1;
+
+		uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+		std::vector<unsigned char> out;
+		writeU32(out, 4 + blockSize);
+		writeU32(out, 0); // Khronos vendor, basic descriptor type
+		writeU32(out, 2 | (blockSize << 16)); // Version 1.3
+		writeU32(out, colourModel | (1 << 8) | (transfer << 16)); // BT.709 primaries, linear or sRGB transfer, straight alpha
+		writeU32(out, blockDimensions);
+		writeU32(out, bytesPerBlock);
+		writeU32(out, 0);
+		for (auto& i : samples)
+		{
+			writeU32(out, i.bitOffset | ((i.bitLength - 1) << 16) | (i.channel << 24));
+			writeU32(out, 0);
+			writeU32(out, 0);
+			writeU32(out, i.upper);
+		}
+		return out;
+	}
+
+	// Parse a KTX2 file, level offsets are from the start of data
+	inline bool readKTX2(const unsigned char* data, size_t size, int& format, std::vector<CompressedLevel>& levels)
+	{
+		if (size < 80 || std::memcmp(data, KTX2_IDENTIFIER, 12) != 0)
+		{
+			return false;
+		}
+		format = formatFromVk(readU32(data + 12));
+		uint32_t width = readU32(data + 20);
+		uint32_t height = readU32(data + 24);
+		uint32_t depth = readU32(data + 28);
+		uint32_t layers = readU32(data + 32);
+		uint32_t faces = readU32(data + 36);
+		uint32_t levelCount = std::max(1u, readU32(data + 40));
+		uint32_t supercompression = readU32(data + 44);
+		if (format < 0 || depth > 1 || layers > 1 || faces != 1 || supercompression != 0 || size < 80 + (size_t)levelCount * 24)
+		{
+			std::cout << "ERROR: Unsupported KTX2 texture (only 2D, uncompressed RGBA8/BC4/BC5/BC7 without supercompression)" << std::endl;
+			return false;
+		}
+		levels.resize(levelCount);
+		if (!setLevelSizes(format, (int)width, (int)height, levels))
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			const unsigned char* entry = data + 80 + i * 24;
+			uint64_t offset = readU64(entry);
+			uint64_t length = readU64(entry + 8);
+			if (length < levels[i].size || offset + length > size)
+			{
+				std::cout << "ERROR: KTX2 level " << i << " is truncated" << std::endl;
+				return false;
+			}
+			levels[i].offset = (size_t)offset;
+		}
+		return true;
+	}
+
+	inline bool writeKTX2(const std::string& fileName, const CompressedImage& image)
+	{
+		uint32_t levelCount = (uint32_t)image.levels.size();
+		std::vector<unsigned char> descriptor = buildDataFormatDescriptor(image.format);
+		size_t descriptorOffset = 80 + (size_t)levelCount * 24;
+		// Level data is aligned to the block size, smallest level first as the spec asks
+		size_t alignment = TextureCompressor::getBaseFormat(image.format) == FORMAT_RGBA8 ? 4 : TextureCompressor::getBlockBytes(image.format);
+		std::vector<size_t> offsets(levelCount);
+		size_t end = descriptorOffset + descriptor.size();
+		for (size_t i = levelCount; i-- > 0;)
+		{
+			end = (end + alignment - 1) / alignment * alignment;
+			offsets[i] = end;
+			end += image.levels[i].size;
+		}
+
+		std::vector<unsigned char> out(KTX2_IDENTIFIER, KTX2_IDENTIFIER + 12);
+		writeU32(out, formatToVk(image.format));
+		writeU32(out, 1); // Type size
+		writeU32(out, (uint32_t)image.levels[0].width);
+		writeU32(out, (uint32_t)image.levels[0].height);
+		writeU32(out, 0); // Depth
+		writeU32(out, 0); // Layers
+		writeU32(out, 1); // Faces
+		writeU32(out, levelCount);
+		writeU32(out, 0); // Supercompression
+		writeU32(out, (uint32_t)descriptorOffset);
+		writeU32(out, (uint32_t)descriptor.size());
+		writeU32(out, 0); // Key/value data
+		writeU32(out, 0);
+		writeU64(out, 0); // Supercompression global data
+		writeU64(out, 0);
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			writeU64(out, offsets[i]);
+			writeU64(out, image.levels[i].size);
+			writeU64(out, image.levels[i].size);
+		}
+		out.insert(out.end(), descriptor.begin(), descriptor.end());
+		out.resize(end, 0);
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			std::memcpy(out.data() + offsets[i], image.data.data() + image.levels[i].offset, image.levels[i].size);
+		}
+
+		std::ofstream outFile(fileName, std::ios::binary);
+		outFile.write((const char*)out.data(), out.size());
+		return outFile.good();
+	}
+
+	// DDS
+
+	// Parse a DDS file with a DX10 header, or the legacy ATI1/ATI2 four character codes and 32 bit RGBA
+	inline bool readDDS(const unsigned char* data, size_t size, int& format, std::vector<CompressedLevel>& levels)
+	{
+		if (size < 128 || readU32(data) != fourCC("DDS ") || readU32(data + 4) != 124)
+		{
+			return false;
+		}
+		uint32_t height = readU32(data + 12);
+		uint32_t width = readU32(data + 16);
+		uint32_t levelCount = std::max(1u, readU32(data + 28));
+		const unsigned char* pixelFormat = data + 76;
+		uint32_t pixelFlags = readU32(pixelFormat + 4);
+		uint32_t code = readU32(pixelFormat + 8);
+		uint32_t caps2 = readU32(data + 112);
+		size_t offset = 128;
+		format = -1;
+		if (pixelFlags & 0x4) // DDPF_FOURCC
+		{
+			if (code == fourCC("DX10"))
+			{
+				if (size < 148 || readU32(data + 132) != 3 || readU32(data + 140) > 1) // Texture2D, one element
+				{
+					std::cout << "ERROR: Only single 2D DDS textures are supported" << std::endl;
+					return false;
+				}
+				switch (readU32(data + 128))
+				{
+				case DXGI_FORMAT_R8G8B8A8_UNORM: format = FORMAT_RGBA8; break;
+				case DXGI_FORMAT_BC4_UNORM: format = FORMAT_BC4; break;
+				case DXGI_FORMAT_BC5_UNORM: format = FORMAT_BC5; break;
+				case DXGI_FORMAT_BC7_UNORM: format = FORMAT_BC7; break;
+				case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: format = FORMAT_RGBA8 | FORMAT_SRGB; break;
+				case DXGI_FORMAT_BC7_UNORM_SRGB: format = FORMAT_BC7 | FORMAT_SRGB; break;
+				}
+				offset = 148;
+			}
+			else if (code == fourCC("ATI1") || code == fourCC("BC4U"))
+			{
+				format = FORMAT_BC4;
+			}
+			else if (code == fourCC("ATI2") || code == fourCC("BC5U"))
+			{
+				format = FORMAT_BC5;
+			}
+		}
+		else if ((pixelFlags & 0x40) && readU32(pixelFormat + 12) == 32 && readU32(pixelFormat + 16) == 0xFF
+			&& readU32(pixelFormat + 20) == 0xFF00 && readU32(pixelFormat + 24) == 0xFF0000) // DDPF_RGB in RGBA order
+		{
+			format = FORMAT_RGBA8;
+		}
+		if (format < 0 || (caps2 & 0x200) != 0) // Cube maps are not supported
+		{
+			std::cout << "ERROR: Unsupported DDS texture (only 2D RGBA8/BC4/BC5/BC7)" << std::endl;
+			return false;
+		}
+
+		// Levels follow each other, largest first
+		levels.resize(levelCount);
+		if (!setLevelSizes(format, (int)width, (int)height, levels))
+		{
+			return false;
+		}
+		for (auto& i : levels)
+		{
+			i.offset = offset;
+			offset += i.size;
+		}
+		if (offset > size)
+		{
+			std::cout << "ERROR: DDS texture is truncated" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	inline bool writeDDS(const std::string& fileName, const CompressedImage& image)
+	{
+		const CompressedLevel& top = image.levels[0];
+		bool compressed = TextureCompressor::getBaseFormat(image.format) != FORMAT_RGBA8;
+		bool srgb = TextureCompressor::isSRGB(image.format);
+		std::vector<unsigned char> out;
+		writeU32(out, fourCC("DDS "));
+		writeU32(out, 124);
+		// Caps, height, width, pixel format, mip count, plus pitch or linear size
+		writeU32(out, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | (compressed ? 0x80000 : 0x8));
+		writeU32(out, (uint32_t)top.height);
+		writeU32(out, (uint32_t)top.width);
+		writeU32(out, compressed ? (uint32_t)top.size : (uint32_t)top.width * 4);
+		writeU32(out, 0); // Depth
+		writeU32(out, (uint32_t)image.levels.size());
+		out.resize(out.size() + 11 * 4, 0);
+		// Pixel format, always the DX10 extension
+		writeU32(out, 32);
+		writeU32(out, 0x4);
+		writeU32(out, fourCC("DX10"));
+		out.resize(out.size() + 5 * 4, 0);
+		writeU32(out, 0x1000 | 0x400000 | 0x8); // Texture, mipmap, complex
+		out.resize(out.size() + 4 * 4, 0);
+		// DX10 header
+		switch (TextureCompressor::getBaseFormat(image.format))
+		{
+		case FORMAT_BC4: writeU32(out, DXGI_FORMAT_BC4_UNORM); break;
+		case FORMAT_BC5: writeU32(out, DXGI_FORMAT_BC5_UNORM); break;
+		case FORMAT_BC7: writeU32(out, srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM); break;
+		default: writeU32(out, srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM); break;
+		}
+		writeU32(out, 3); // Texture2D
+		writeU32(out, 0);
+		writeU32(out, 1); // Array size
+		writeU32(out, 0);
+		for (auto& i : image.levels)
+		{
+			out.insert(out.end(), image.data.begin() + i.offset, image.data.begin() + i.offset + i.size);
+		}
+
+		std::ofstream outFile(fileName, std::ios::binary);
+		outFile.write((const char*)out.data(), out.size());
+		return outFile.good();
+	}
+
+	// Files
+
+	// Parse a mapped KTX2 or DDS file, picked by its magic number
+	inline bool read(const MappedFile& file, int& format, std::vector<CompressedLevel>& levels)
+	{
+		if (!file.isOpen())
+		{
+			return false;
+		}
+		return readKTX2(file.getData(), file.getSize(), format, levels) || readDDS(file.getData(), file.getSize(), format, levels);
+	}
+
+	inline bool isContainer(const std::string& fileName)
+	{
+		std::string extension = fileName.substr(std::min(fileName.size(), fileName.find_last_of('.')));
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+		return extension == ".ktx2" || extension == ".dds";
+	}
+
+	inline time_t getLastWrite(const std::string& path)
+	{
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 ? info.st_mtime : 0;
+	}
+
+	// <name>.ktx2 or <name>.dds baked from an image, empty if there is none at least as new as the image
+	inline std::string findBaked(const std::string& fileName)
+	{
+		if (isContainer(fileName))
+		{
+			return fileName;
+		}
+		size_t dot = fileName.find_last_of('.');
+		std::string base = fileName.substr(0, dot == std::string::npos || dot < fileName.find_last_of("/\\") + 1 ? fileName.size() : dot);
+		time_t sourceTime = getLastWrite(fileName);
+		for (const char* extension : { ".ktx2", ".dds" })
+		{
+			time_t bakedTime = getLastWrite(base + extension);
+			if (bakedTime != 0 && bakedTime >= sourceTime)
+			{
+				return base + extension;
+			}
+		}
+		return std::string();
+	}
+
+	// Names of the files in a directory ending with extension
+	inline std::vector<std::string> listFiles(const std::string& directory, const std::string& extension)
+	{
+		std::vector<std::string> files;
+#ifdef _WIN32
+		_finddata_t found;
+		intptr_t search = _findfirst((directory + "\\*" + extension).c_str(), &found);
+		if (search != -1)
+		{
+			do
+			{
+				files.push_back(found.name);
+			} while (_findnext(search, &found) == 0);
+			_findclose(search);
+		}
+#else
+		DIR* dir = opendir(directory.c_str());
+		if (dir)
+		{
+			while (dirent* entry = readdir(dir))
+			{
+				std::string name = entry->d_name;
+				if (name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0)
+				{
+					files.push_back(name);
+				}
+			}
+			closedir(dir);
+		}
+#endif
+		std::sort(files.begin(), files.end());
+		return files;
+	}
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// SOIL2
+#include <SOIL2.h>
+
+// OTHER
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstring>
+
+#include "Texture.h"
+#include "TextureFile.h"
+#include "ThreadPool.h"
+#include "LockFreeQueue.h"
+
+// Loads textures without blocking the render thread. load() returns a placeholder texture straight
+// away and decodes the image on the thread pool, update() uploads finished images through pixel
+// buffers and swaps them into the placeholder once they are ready.
+// An image with a baked <name>.ktx2 or <name>.dds next to it is read from that instead: the file is
+// memory mapped and its mip levels are copied to the GPU as they are, with no decode or compression.
+class TextureLoader
+{
+public:
+	struct Stats
+	{
+		unsigned requested;
+		unsigned uploaded;
+		unsigned failed;
+		double decodeMs;	// Summed over the worker threads
+		double uploadMs;	// Render thread time spent copying and issuing uploads
+	};
+
+private:
+	// Decoded image handed back from a worker
+	struct Decoded
+	{
+		Texture* texture;
+		std::string fileName;
+		unsigned char* pixels;
+		int width;
+		int height;
+		int format;
+		// Mip chain made from pixels, block compressed unless the format is RGBA8
+		CompressedImage compressed;
+		// Set instead when the levels come from a baked file, compressed.levels then point into it
+		std::shared_ptr<MappedFile> file;
+		double decodeMs;
+	};
+
+	// Shared with the decode jobs, which may still be running when the loader is stopped
+	struct Shared
+	{
+		LockFreeQueue<Decoded> decoded;
+		std::atomic<int> inFlight;
+		std::atomic<bool> stopping;
+	};
+
+	static const int PIXEL_BUFFER_COUNT = 2;
+
+	std::shared_ptr<Shared> shared;
+	std::deque<Decoded> ready;
+	std::set<const Texture*> loading;
+	std::vector<Decoded> popped;
+	GLuint pixelBuffers[PIXEL_BUFFER_COUNT];
+	int nextPixelBuffer;
+	bool async;
+	unsigned pending;
+	// Bytes uploaded per frame before the rest waits for the next frame, at least one image is always uploaded
+	size_t uploadBudget;
+	Stats stats;
+
+	static double getTimeMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Runs on a worker, or on the render thread when loading synchronously
+	static void decode(Decoded& image, const std::string& bakedFile)
+	{
+		double start = getTimeMs();
+		if (!bakedFile.empty())
+		{
+			image.file = std::make_shared<MappedFile>(bakedFile);
+			if (TextureFile::read(*image.file, image.compressed.format, image.compressed.levels))
+			{
+				// Touch every page here so the copy on the render thread does not wait on the disk
+				const unsigned char* data = image.file->getData();
+				volatile unsigned char sum = 0;
+				for (size_t i = 0; i < image.file->getSize(); i += 4096)
+				{
+					sum += data[i];
+				}
+			}
+			else
+			{
+				// Fall back to the source image
+				std::cout << "ERROR: Failed to read baked texture " << bakedFile << std::endl;
+				image.file.reset();
+				image.compressed.levels.clear();
+			}
+		}
+		if (!image.file)
+		{
+			image.pixels = SOIL_load_image(image.fileName.c_str(), &image.width, &image.height, NULL, SOIL_LOAD_RGBA);
+			// Mip levels are filtered here too, RGBA8 just skips the block compression
+			if (image.pixels)
+			{
+				image.compressed = TextureCompressor::compress(image.pixels, image.width, image.height, image.format);
+				SOIL_free_image_data(image.pixels);
+				image.pixels = nullptr;
+			}
+		}
+		image.decodeMs = getTimeMs() - start;
+	}
+
+	void upload(const Decoded& image)
+	{
+		if (image.compressed.levels.empty())
+		{
+			std::cout << "ERROR: Failed to load texture" << image.fileName << std::endl;
+			this->stats.failed++;
+			return;
+		}
+		if (this->pixelBuffers[0] == 0)
+		{
+			glGenBuffers(PIXEL_BUFFER_COUNT, this->pixelBuffers);
+		}
+		// Alternate buffers so a copy still in flight from the last upload is not waited on
+		GLuint buffer = this->pixelBuffers[this->nextPixelBuffer];
+		this->nextPixelBuffer = (this->nextPixelBuffer + 1) % PIXEL_BUFFER_COUNT;
+
+		// Mip levels are packed one after another in the buffer
+		std::vector<CompressedLevel> packed = image.compressed.levels;
+		size_t size = 0;
+		for (auto& i : packed)
+		{
+			i.offset = size;
+			size += i.size;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (mapped)
+		{
+			const unsigned char* source = image.file ? image.file->getData() : image.compressed.data.data();
+			for (size_t i = 0; i < packed.size(); i++)
+			{
+				std::memcpy((unsigned char*)mapped + packed[i].offset, source + image.compressed.levels[i].offset, packed[i].size);
+			}
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (mapped)
+		{
+			image.texture->uploadLevelsFromPixelBuffer(buffer, image.compressed.format, packed);
+			this->stats.uploaded++;
+		}
+		else
+		{
+			std::cout << "ERROR: Could not map pixel buffer for " << image.fileName << std::endl;
+			this->stats.failed++;
+		}
+	}
+
+public:
+	TextureLoader()
+	{
+		this->shared = std::make_shared<Shared>();
+		this->shared->inFlight = 0;
+		this->shared->stopping = false;
+		this->pixelBuffers[0] = 0;
+		this->pixelBuffers[1] = 0;
+		this->nextPixelBuffer = 0;
+		this->async = true;
+		this->pending = 0;
+		this->uploadBudget = 32 * 1024 * 1024;
+		std::memset(&this->stats, 0, sizeof(this->stats));
+	}
+
+	~TextureLoader()
+	{
+		this->stop();
+	}
+
+	// With async off load() decodes and uploads on the calling thread like Texture(fileName)
+	void setAsync(bool async)
+	{
+		this->async = async;
+	}
+
+	void setUploadBudget(size_t bytesPerFrame)
+	{
+		this->uploadBudget = bytesPerFrame;
+	}
+
+	// Returns a texture that can be bound immediately. It shows the placeholder colour until
+	// the image has been decoded, mip mapped, block compressed to format if requested, and uploaded by update().
+	// A baked file keeps the format it was baked with
+	Texture* load(const char* fileName, int format = FORMAT_RGBA8, unsigned char r = 128, unsigned char g = 128, unsigned char b = 128)
+	{
+		this->stats.requested++;
+		std::string bakedFile = TextureFile::findBaked(fileName);
+		if (!this->async && bakedFile.empty())
+		{
+			this->stats.uploaded++;
+			return new Texture(fileName, TextureCompressor::isSRGB(format));
+		}
+		Texture* texture = new Texture(r, g, b);
+		if (!this->async)
+		{
+			Decoded image = { texture, fileName, nullptr, 0, 0, format, CompressedImage(), nullptr, 0.0 };
+			decode(image, bakedFile);
+			this->stats.decodeMs += image.decodeMs;
+			this->upload(image);
+			return texture;
+		}
+		this->loading.insert(texture);
+		this->pending++;
+		this->shared->inFlight++;
+		std::shared_ptr<Shared> shared = this->shared;
+		std::string file = fileName;
+		ThreadPool::get().enqueue([shared, texture, file, bakedFile, format]()
+		{
+			if (!shared->stopping)
+			{
+				Decoded image = { texture, file, nullptr, 0, 0, format, CompressedImage(), nullptr, 0.0 };
+				decode(image, bakedFile);
+				shared->decoded.push(std::move(image));
+			}
+			shared->inFlight--;
+		});
+		return texture;
+	}
+
+	// Upload images that finished decoding, called once per frame on the render thread
+	void update()
+	{
+		if (this->pending == 0)
+		{
+			return;
+		}
+		double start = getTimeMs();
+		this->popped.clear();
+		this->shared->decoded.popAll(this->popped);
+		for (auto& i : this->popped)
+		{
+			this->stats.decodeMs += i.decodeMs;
+			this->ready.push_back(std::move(i));
+		}
+
+		size_t uploaded = 0;
+		while (!this->ready.empty() && (uploaded == 0 || uploaded < this->uploadBudget))
+		{
+			Decoded& image = this->ready.front();
+			this->upload(image);
+			uploaded += image.texture->getMemoryBytes() + 1;
+			SOIL_free_image_data(image.pixels);
+			this->loading.erase(image.texture);
+			this->ready.pop_front();
+			this->pending--;
+		}
+		this->stats.uploadMs += getTimeMs() - start;
+	}
+
+	// Have all requested textures been uploaded
+	bool isIdle() const
+	{
+		return this->pending == 0;
+	}
+
+	// Is the texture still waiting for its image, it must not be deleted until it is uploaded
+	bool isLoading(const Texture* texture) const
+	{
+		return this->loading.count(texture) != 0;
+	}
+
+	unsigned getPendingCount() const
+	{
+		return this->pending;
+	}
+
+	const Stats& getStats() const
+	{
+		return this->stats;
+	}
+
+	// Wait for running decodes and release everything, must be called while the GL context is current
+	void stop()
+	{
+		this->shared->stopping = true;
+		while (this->shared->inFlight > 0)
+		{
+			std::this_thread::yield();
+		}
+		this->shared->decoded.popAll(this->popped);
+		for (auto& i : this->popped)
+		{
+			this->ready.push_back(std::move(i));
+		}
+		this->popped.clear();
+		for (auto& i : this->ready)
+		{
+			SOIL_free_image_data(i.pixels);
+		}
+		this->ready.clear();
+		this->loading.clear();
+		this->pending = 0;
+		if (this->pixelBuffers[0])
+		{
+			glDeleteBuffers(PIXEL_BUFFER_COUNT, this->pixelBuffers);
+			this->pixelBuffers[0] = 0;
+			this->pixelBuffers[1] = 0;
+		}
+	}
+};
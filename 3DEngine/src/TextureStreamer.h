@@ -0,0 +1,502 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// MTB
+#include <glm.hpp>
+
+// ImGUI
+#include "vendor/imgui/imgui.h"
+
+// OTHER
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#include "Texture.h"
+#include "TextureFile.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+#include "LockFreeQueue.h"
+
+// Mip streaming for whole textures. load() maps a baked KTX2 or DDS file and uploads only the tail
+// of its mip chain, the levels no larger than TAIL_SIZE. Every frame each material asks for the
+// level its textures need, from the UV density of the mesh and its distance to the camera, and
+// update() moves the sampled range one level at a time through GL_TEXTURE_BASE_LEVEL:
+// - finer levels are read out of the mapped file on the thread pool and uploaded when they arrive
+// - levels finer than needed for demoteDelay frames are dropped again
+// - everything resident stays under the budget, levels nothing asks for are dropped first to make room
+// KTX2 stores the smallest level first, so the tail is a few kilobytes at the start of the file.
+class TextureStreamer
+{
+public:
+	struct Stats
+	{
+		unsigned promoted;		// Levels made resident since the start
+		unsigned demoted;		// Levels dropped since the start
+		unsigned deferred;		// Levels the last update had no room for under the budget
+		double uploadMs;		// Render thread time since the start
+		double loadMs;			// Summed over the worker threads
+	};
+
+	// Levels no larger than this on their longest side are loaded with the texture and always kept
+	static const int TAIL_SIZE = 64;
+
+private:
+	// Level read out of the file by a worker
+	struct Loaded
+	{
+		size_t entry;
+		int level;
+		std::vector<unsigned char> data;
+		double loadMs;
+	};
+
+	// Shared with the load jobs, which may still be running when the streamer is stopped
+	struct Shared
+	{
+		LockFreeQueue<Loaded> loaded;
+		std::atomic<int> inFlight;
+		std::atomic<bool> stopping;
+	};
+
+	struct Entry
+	{
+		Texture* texture;
+		std::string fileName;
+		std::shared_ptr<MappedFile> file;
+		int format;
+		std::vector<CompressedLevel> levels;
+		int tailLevel;			// Finest level of the tail
+		int residentLevel;		// Finest level on the GPU and the base level sampled from
+		int wantedLevel;		// Finest level asked for this frame
+		int loadingLevel;		// Level a worker is reading, -1 if none
+		unsigned surplusFrames;	// Frames in a row with finer levels resident than wanted
+	};
+
+	static const int MAX_LOADS = 8;
+
+	std::shared_ptr<Shared> shared;
+	std::vector<Entry> entries;
+	std::unordered_map<const Texture*, size_t> byTexture;
+	std::deque<Loaded> ready;
+	std::vector<Loaded> popped;
+	size_t budget;
+	// Bytes uploaded per frame before the rest waits for the next frame, at least one level is always uploaded
+	size_t uploadBudget;
+	unsigned demoteDelay;
+	size_t residentBytes;
+	// Promotions in flight hold their bytes here so the budget is not handed out twice
+	size_t reservedBytes;
+	int loadCount;
+	glm::vec3 cameraPosition;
+	// Screen pixels covered by one world unit at a distance of one
+	float pixelsPerUnit;
+	Stats stats;
+
+	static double getTimeMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	int getLevelCount(const Entry& entry) const
+	{
+		return (int)entry.levels.size();
+	}
+
+	// Sample one level coarser and give the finest back
+	void demote(Entry& entry)
+	{
+		int level = entry.residentLevel;
+		entry.texture->setLevelRange(level + 1, this->getLevelCount(entry) - 1);
+		entry.texture->releaseLevel(level, entry.levels[level]);
+		this->residentBytes -= entry.levels[level].size;
+		entry.residentLevel++;
+		this->stats.demoted++;
+	}
+
+	// Drop a level from the texture with the most levels nothing asks for, false if there is none
+	bool demoteSurplus()
+	{
+		Entry* best = nullptr;
+		for (auto& i : this->entries)
+		{
+			if (i.loadingLevel < 0 && i.residentLevel < i.wantedLevel && (!best || i.wantedLevel - i.residentLevel > best->wantedLevel - best->residentLevel))
+			{
+				best = &i;
+			}
+		}
+		if (best)
+		{
+			this->demote(*best);
+		}
+		return best != nullptr;
+	}
+
+	void requestLevel(size_t index)
+	{
+		Entry& entry = this->entries[index];
+		int level = entry.residentLevel - 1;
+		entry.loadingLevel = level;
+		this->reservedBytes += entry.levels[level].size;
+		this->loadCount++;
+		this->shared->inFlight++;
+		std::shared_ptr<Shared> shared = this->shared;
+		std::shared_ptr<MappedFile> file = entry.file;
+		CompressedLevel source = entry.levels[level];
+		ThreadPool::get().enqueue([shared, file, index, level, source]()
+		{
+			if (!shared->stopping)
+			{
+				// The copy out of the mapping is where the level is read from disk
+				double start = getTimeMs();
+				const unsigned char* data = file->getData() + source.offset;
+				Loaded loaded = { index, level, std::vector<unsigned char>(data, data + source.size), 0.0 };
+				loaded.loadMs = getTimeMs() - start;
+				shared->loaded.push(std::move(loaded));
+			}
+			shared->inFlight--;
+		});
+	}
+
+public:
+	TextureStreamer(size_t budgetBytes = 256 * 1024 * 1024)
+	{
+		this->shared = std::make_shared<Shared>();
+		this->shared->inFlight = 0;
+		this->shared->stopping = false;
+		this->budget = budgetBytes;
+		this->uploadBudget = 32 * 1024 * 1024;
+		this->demoteDelay = 120;
+		this->residentBytes = 0;
+		this->reservedBytes = 0;
+		this->loadCount = 0;
+		this->cameraPosition = glm::vec3(0.0f);
+		this->pixelsPerUnit = 1.0f;
+		this->stats = { 0, 0, 0, 0.0, 0.0 };
+	}
+
+	~TextureStreamer()
+	{
+		this->stop();
+		for (auto& i : this->entries)
+		{
+			delete i.texture;
+		}
+	}
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// Texture streamed from the baked mip chain of fileName (an image with a baked file next to it,
+	// or the KTX2 or DDS file itself). Only the tail is uploaded here, nullptr if there is no baked file.
+	// The streamer owns the texture
+	Texture* load(const std::string& fileName)
+	{
+		std::string bakedFile = TextureFile::findBaked(fileName);
+		if (bakedFile.empty())
+		{
+			std::cout << "ERROR: No baked mip chain to stream for " << fileName << std::endl;
+			return nullptr;
+		}
+		Entry entry;
+		entry.fileName = bakedFile;
+		entry.file = std::make_shared<MappedFile>(bakedFile);
+		if (!TextureFile::read(*entry.file, entry.format, entry.levels))
+		{
+			std::cout << "ERROR: Failed to read baked texture " << bakedFile << std::endl;
+			return nullptr;
+		}
+		int levelCount = this->getLevelCount(entry);
+		entry.tailLevel = levelCount - 1;
+		while (entry.tailLevel > 0 && std::max(entry.levels[entry.tailLevel - 1].width, entry.levels[entry.tailLevel - 1].height) <= TAIL_SIZE)
+		{
+			entry.tailLevel--;
+		}
+		entry.texture = new Texture(entry.levels[0].width, entry.levels[0].height, entry.format, levelCount);
+		for (int i = levelCount - 1; i >= entry.tailLevel; i--)
+		{
+			entry.texture->uploadLevel(i, entry.levels[i], entry.file->getData() + entry.levels[i].offset);
+			this->residentBytes += entry.levels[i].size;
+		}
+		entry.texture->setLevelRange(entry.tailLevel, levelCount - 1);
+		entry.residentLevel = entry.tailLevel;
+		entry.wantedLevel = entry.tailLevel;
+		entry.loadingLevel = -1;
+		entry.surplusFrames = 0;
+		this->byTexture[entry.texture] = this->entries.size();
+		this->entries.push_back(entry);
+		return entry.texture;
+	}
+
+	// Start a frame seen from cameraPosition with a vertical field of view of fov degrees over
+	// viewportHeight pixels. Every texture wants only its tail until a material asks for more
+	void beginFrame(const glm::vec3& cameraPosition, float fov, int viewportHeight)
+	{
+		this->cameraPosition = cameraPosition;
+		this->pixelsPerUnit = viewportHeight / (2.0f * std::tan(glm::radians(fov) * 0.5f));
+		for (auto& i : this->entries)
+		{
+			i.wantedLevel = i.tailLevel;
+		}
+	}
+
+	// Ask for the levels the streamed textures of material need to cover mesh this frame. The
+	// nearest point of its bounds decides, so it is sharp wherever the mesh is on screen
+	void request(const RenderMaterial& material, Mesh& mesh)
+	{
+		glm::vec3 centre;
+		float radius;
+		mesh.getWorldBounds(centre, radius);
+		float density = mesh.getUVDensity();
+		float distance = std::max(glm::length(centre - this->cameraPosition) - radius, 0.01f);
+		for (int i = 0; i < material.textureCount; i++)
+		{
+			auto it = this->byTexture.find(material.textures[i]);
+			if (it == this->byTexture.end())
+			{
+				continue;
+			}
+			Entry& entry = this->entries[it->second];
+			// Texels per screen pixel, its log2 is the level the sampler would pick
+			int level = 0;
+			if (density > 0.0f)
+			{
+				float texelsPerPixel = std::max(entry.levels[0].width, entry.levels[0].height) * density * distance / this->pixelsPerUnit;
+				level = (int)std::floor(std::log2(std::max(texelsPerPixel, 1.0f)));
+			}
+			entry.wantedLevel = std::min(entry.wantedLevel, std::min(level, entry.tailLevel));
+		}
+	}
+
+	// Upload levels that finished loading, drop levels no longer needed and request the next ones,
+	// called once per frame on the render thread after the requests
+	void update()
+	{
+		double start = getTimeMs();
+		this->popped.clear();
+		this->shared->loaded.popAll(this->popped);
+		for (auto& i : this->popped)
+		{
+			this->stats.loadMs += i.loadMs;
+			this->ready.push_back(std::move(i));
+		}
+
+		// Each level is the next finer one below the base, so the range stays complete
+		size_t uploaded = 0;
+		while (!this->ready.empty() && (uploaded == 0 || uploaded < this->uploadBudget))
+		{
+			Loaded& loaded = this->ready.front();
+			Entry& entry = this->entries[loaded.entry];
+			const CompressedLevel& level = entry.levels[loaded.level];
+			entry.texture->uploadLevel(loaded.level, level, loaded.data.data());
+			entry.texture->setLevelRange(loaded.level, this->getLevelCount(entry) - 1);
+			entry.residentLevel = loaded.level;
+			entry.loadingLevel = -1;
+			this->reservedBytes -= level.size;
+			this->residentBytes += level.size;
+			this->loadCount--;
+			this->stats.promoted++;
+			uploaded += level.size + 1;
+			this->ready.pop_front();
+		}
+
+		// Levels finer than wanted are kept for a while in case the camera comes back
+		for (auto& i : this->entries)
+		{
+			if (i.residentLevel < i.wantedLevel && i.loadingLevel < 0)
+			{
+				if (++i.surplusFrames >= this->demoteDelay)
+				{
+					this->demote(i);
+				}
+			}
+			else
+			{
+				i.surplusFrames = 0;
+			}
+		}
+
+		// Textures furthest from the level they want first, smaller levels first between equals
+		std::vector<size_t> candidates;
+		for (size_t i = 0; i < this->entries.size(); i++)
+		{
+			if (this->entries[i].loadingLevel < 0 && this->entries[i].residentLevel > this->entries[i].wantedLevel)
+			{
+				candidates.push_back(i);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b)
+		{
+			const Entry& x = this->entries[a];
+			const Entry& y = this->entries[b];
+			int deficitX = x.residentLevel - x.wantedLevel, deficitY = y.residentLevel - y.wantedLevel;
+			if (deficitX != deficitY)
+			{
+				return deficitX > deficitY;
+			}
+			return x.levels[x.residentLevel - 1].size < y.levels[y.residentLevel - 1].size;
+		});
+		this->stats.deferred = 0;
+		for (size_t i : candidates)
+		{
+			if (this->loadCount >= MAX_LOADS)
+			{
+				break;
+			}
+			const Entry& entry = this->entries[i];
+			size_t bytes = entry.levels[entry.residentLevel - 1].size;
+			while (this->residentBytes + this->reservedBytes + bytes > this->budget && this->demoteSurplus())
+			{
+			}
+			if (this->residentBytes + this->reservedBytes + bytes > this->budget)
+			{
+				this->stats.deferred++;
+				continue;
+			}
+			this->requestLevel(i);
+		}
+		this->stats.uploadMs += getTimeMs() - start;
+	}
+
+	// Wait for running loads and drop their levels, must be called while the GL context is current
+	void stop()
+	{
+		this->shared->stopping = true;
+		while (this->shared->inFlight > 0)
+		{
+			std::this_thread::yield();
+		}
+		this->shared->loaded.popAll(this->popped);
+		this->popped.clear();
+		this->ready.clear();
+		for (auto& i : this->entries)
+		{
+			i.loadingLevel = -1;
+		}
+		this->reservedBytes = 0;
+		this->loadCount = 0;
+	}
+
+	void setBudget(size_t bytes)
+	{
+		this->budget = bytes;
+		while (this->residentBytes > this->budget && this->demoteSurplus())
+		{
+		}
+	}
+
+	size_t getBudget() const
+	{
+		return this->budget;
+	}
+
+	void setUploadBudget(size_t bytesPerFrame)
+	{
+		this->uploadBudget = bytesPerFrame;
+	}
+
+	void setDemoteDelay(unsigned frames)
+	{
+		this->demoteDelay = frames;
+	}
+
+	int getTextureCount() const
+	{
+		return (int)this->entries.size();
+	}
+
+	// Video memory of the levels on the GPU
+	size_t getResidentBytes() const
+	{
+		return this->residentBytes;
+	}
+
+	// Video memory with every level of every texture on the GPU, what loading mip 0 would take
+	size_t getFullResidencyBytes() const
+	{
+		size_t bytes = 0;
+		for (auto& i : this->entries)
+		{
+			for (auto& l : i.levels)
+			{
+				bytes += l.size;
+			}
+		}
+		return bytes;
+	}
+
+	// Video memory with every texture at exactly the level it wants this frame
+	size_t getWantedBytes() const
+	{
+		size_t bytes = 0;
+		for (auto& i : this->entries)
+		{
+			for (int l = i.wantedLevel; l < this->getLevelCount(i); l++)
+			{
+				bytes += i.levels[l].size;
+			}
+		}
+		return bytes;
+	}
+
+	// Textures drawn from a coarser level than they want this frame
+	int getMissingCount() const
+	{
+		int count = 0;
+		for (auto& i : this->entries)
+		{
+			count += i.residentLevel > i.wantedLevel ? 1 : 0;
+		}
+		return count;
+	}
+
+	// Finest resident and wanted level of a streamed texture, -1 for any other texture
+	int getResidentLevel(const Texture* texture) const
+	{
+		auto it = this->byTexture.find(texture);
+		return it == this->byTexture.end() ? -1 : this->entries[it->second].residentLevel;
+	}
+
+	int getWantedLevel(const Texture* texture) const
+	{
+		auto it = this->byTexture.find(texture);
+		return it == this->byTexture.end() ? -1 : this->entries[it->second].wantedLevel;
+	}
+
+	const Stats& getStats() const
+	{
+		return this->stats;
+	}
+
+	void renderGUI()
+	{
+		const float mb = 1.0f / (1024.0f * 1024.0f);
+		ImGui::Begin("Texture Streaming");
+		ImGui::Text("%d textures, %d loading, %d below the level they want", this->getTextureCount(), this->loadCount, this->getMissingCount());
+		ImGui::Text("Memory: %.1f MB resident, %.1f MB wanted, %.1f MB fully resident", this->getResidentBytes() * mb, this->getWantedBytes() * mb, this->getFullResidencyBytes() * mb);
+		ImGui::Text("Levels: %u promoted, %u demoted, %u deferred by the budget", this->stats.promoted, this->stats.demoted, this->stats.deferred);
+		ImGui::Text("Upload %.1f ms, load %.1f ms total", this->stats.uploadMs, this->stats.loadMs);
+		int budgetMb = (int)(this->budget / (1024 * 1024));
+		if (ImGui::SliderInt("Budget (MB)", &budgetMb, 16, 2048))
+		{
+			this->setBudget((size_t)budgetMb * 1024 * 1024);
+		}
+		for (auto& i : this->entries)
+		{
+			ImGui::Text("%5.1f MB  level %d (wants %d, tail %d)  %s", i.texture->getMemoryBytes() * mb, i.residentLevel, i.wantedLevel, i.tailLevel, i.fileName.c_str());
+		}
+		ImGui::End();
+	}
+};
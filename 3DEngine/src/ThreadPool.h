@@ -0,0 +1,153 @@
+#pragma once
+
+// OTHER
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+
+// Fixed set of worker threads for CPU side work (sorting, decoding, baking).
+// Tasks can be queued and forgotten, or a range can be split across the workers with parallelFor.
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex taskMutex;
+	std::condition_variable taskCondition;
+	bool stopping;
+
+	void workerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(this->taskMutex);
+				this->taskCondition.wait(lock, [this] { return this->stopping || !this->tasks.empty(); });
+				if (this->stopping && this->tasks.empty())
+				{
+					return;
+				}
+				task = std::move(this->tasks.front());
+				this->tasks.pop();
+			}
+			task();
+		}
+	}
+
+public:
+	// Default to one worker per hardware thread, leaving one for the render thread
+	ThreadPool(unsigned threadCount = 0)
+	{
+		this->stopping = false;
+		if (threadCount == 0)
+		{
+			unsigned hardware = std::thread::hardware_concurrency();
+			threadCount = hardware > 1 ? hardware - 1 : 1;
+		}
+		for (unsigned i = 0; i < threadCount; i++)
+		{
+			this->workers.emplace_back(&ThreadPool::workerLoop, this);
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->taskMutex);
+			this->stopping = true;
+		}
+		this->taskCondition.notify_all();
+		for (auto& i : this->workers)
+		{
+			i.join();
+		}
+	}
+
+	// Shared pool used by the engine subsystems
+	static ThreadPool& get()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+	unsigned getThreadCount() const
+	{
+		return (unsigned)this->workers.size();
+	}
+
+	// Queue a task to run on a worker, returns immediately
+	void enqueue(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->taskMutex);
+			this->tasks.push(std::move(task));
+		}
+		this->taskCondition.notify_one();
+	}
+
+	// Split [0, count) into chunks of at least grainSize and run func(begin, end) on each.
+	// The calling thread works on chunks too and the call returns once every chunk is done.
+	void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& func)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		size_t maxChunks = (size_t)this->getThreadCount() + 1;
+		size_t chunkCount = std::min(maxChunks, (count + grainSize - 1) / std::max<size_t>(grainSize, 1));
+		if (chunkCount <= 1)
+		{
+			func(0, count);
+			return;
+		}
+		size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+		// Shared with the queued helpers, a helper that only starts after the work is done still touches it
+		struct ForState
+		{
+			std::atomic<size_t> nextChunk;
+			std::atomic<size_t> doneChunks;
+			std::mutex doneMutex;
+			std::condition_variable doneCondition;
+		};
+		std::shared_ptr<ForState> state = std::make_shared<ForState>();
+		state->nextChunk = 0;
+		state->doneChunks = 0;
+		const std::function<void(size_t, size_t)>* work = &func;
+
+		// Each helper pulls chunks until none are left, so a busy pool never deadlocks the caller
+		auto runChunks = [state, work, chunkCount, chunkSize, count]()
+		{
+			size_t chunk;
+			while ((chunk = state->nextChunk++) < chunkCount)
+			{
+				size_t begin = chunk * chunkSize;
+				size_t end = std::min(count, begin + chunkSize);
+				if (begin < end)
+				{
+					(*work)(begin, end);
+				}
+				if (++state->doneChunks == chunkCount)
+				{
+					std::lock_guard<std::mutex> lock(state->doneMutex);
+					state->doneCondition.notify_all();
+				}
+			}
+		};
+		for (size_t i = 1; i < chunkCount; i++)
+		{
+			this->enqueue(runChunks);
+		}
+		runChunks();
+
+		std::unique_lock<std::mutex> lock(state->doneMutex);
+		state->doneCondition.wait(lock, [&] { return state->doneChunks == chunkCount; });
+	}
+};
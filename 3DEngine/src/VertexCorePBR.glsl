@@ -12,12 +12,35 @@ out vec2 vs_texcoord;
 out vec3 vs_normal;
 out vec3 vs_tangent;
 
+#ifdef MATERIAL_TABLE
+// Many draws in one multi draw call: the model matrix, material and reflection probes of each come
+// from a table indexed by an instanced attribute holding the draw index, see MeshBatch.h
+struct DrawRecord
+{
+	mat4 model;
+	uint material;
+	vec4 probeBlend;
+};
+layout(std430, binding = 1) readonly buffer DrawTable
+{
+	DrawRecord draws[];
+};
+layout(location = 6) in uint vertex_drawIndex;
+flat out uint vs_materialID;
+flat out vec4 vs_probeBlend;
+#else
 uniform mat4 ModelMatrix;
+#endif
 uniform mat4 ViewMatrix;
 uniform mat4 ProjectionMatrix;
 
 void main()
 {
+#ifdef MATERIAL_TABLE
+	mat4 ModelMatrix = draws[vertex_drawIndex].model;
+	vs_materialID = draws[vertex_drawIndex].material;
+	vs_probeBlend = draws[vertex_drawIndex].probeBlend;
+#endif
 	vs_position = vec4(ModelMatrix * vec4(vertex_position, 1.0f)).xyz;
 	vs_color = vertex_color;
 	vs_texcoord = vec2(vertex_texcoord.x, vertex_texcoord.y * -1.0f);
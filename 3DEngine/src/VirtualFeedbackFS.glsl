@@ -0,0 +1,29 @@
+#version 440
+// VIRTUAL TEXTURE FEEDBACK SHADER
+// Writes the page each pixel samples, read back by VirtualTexture to stream the missing ones in.
+// The level is picked like virtualAddress in FragmentCorePBR.glsl and VirtualTexture::getPage
+layout(location = 0) out uint fs_page;
+
+in vec3 vs_position;
+in vec3 vs_color;
+in vec2 vs_texcoord;
+in vec3 vs_normal;
+in vec3 vs_tangent;
+
+uniform float vtPages; // Pages per side of level 0
+uniform float vtMaxLevel;
+uniform float vtLevelBias; // log2 of how much smaller than the screen this pass is drawn
+
+const float VT_PAGE_SIZE = 128.0f;
+
+void main()
+{
+	vec2 texels = vs_texcoord * vtPages * VT_PAGE_SIZE;
+	vec2 dx = dFdx(texels);
+	vec2 dy = dFdy(texels);
+	int level = int(clamp(0.5f * log2(max(dot(dx, dx), dot(dy, dy))) - vtLevelBias, 0.0f, vtMaxLevel));
+	int pages = max(int(vtPages) >> level, 1);
+	uvec2 page = uvec2(min(ivec2(fract(vs_texcoord) * float(pages)), ivec2(pages - 1)));
+	// Level in the top 4 bits, then 14 bits each for y and x
+	fs_page = (uint(level) << 28) | (page.y << 14) | page.x;
+}
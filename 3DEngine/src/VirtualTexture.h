@@ -0,0 +1,910 @@
+#pragma once
+
+// GLEW
+#include <glew.h>
+
+// MTB
+#include <glm.hpp>
+
+// ImGUI
+#include "vendor/imgui/imgui.h"
+
+// OTHER
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "Texture.h"
+#include "Shader.h"
+#include "TextureCompressor.h"
+#include "TextureFile.h"
+#include "MipGenerator.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "LockFreeQueue.h"
+
+// Tiled texture file (.vtex): every mip level cut into pages of PAGE_SIZE texels, each stored as a
+// tile with a PAGE_BORDER texel border taken from its neighbours, so bilinear filtering inside a
+// page never reads the page next to it in the atlas. Tiles are block compressed in the format the
+// GPU samples, a page is streamed in by copying its tile straight into the atlas.
+// Layout: 32 byte header (magic, version, format, size, page size, border, level count, tile bytes),
+// a 64 bit file offset per page, level by level in rows, then the tiles.
+namespace TiledTextureFile
+{
+	static const int PAGE_SIZE = 128;
+	static const int PAGE_BORDER = 4;
+	static const int TILE_SIZE = PAGE_SIZE + 2 * PAGE_BORDER;
+	static const uint32_t VERSION = 1;
+	// Page ids keep 4 bits for the level
+	static const int MAX_LEVELS = 16;
+
+	struct TiledImage
+	{
+		int format;
+		// Width and height of level 0
+		int size;
+		int levelCount;
+		size_t tileBytes;
+		// Index of the first page of each level in offsets
+		std::vector<size_t> firstPage;
+		std::vector<uint64_t> offsets;
+
+		// Pages per side of a level
+		int getPages(int level) const
+		{
+			return std::max(1, (this->size >> level) / PAGE_SIZE);
+		}
+
+		uint64_t getOffset(int level, int x, int y) const
+		{
+			return this->offsets[this->firstPage[level] + (size_t)y * this->getPages(level) + x];
+		}
+	};
+
+	// Levels down to the first one that fits in a single page
+	inline int getLevelCount(int size)
+	{
+		int levels = 1;
+		while ((size >> levels) >= PAGE_SIZE)
+		{
+			levels++;
+		}
+		return levels;
+	}
+
+	// Square, a power of two and at least one page
+	inline bool isValidSize(int width, int height)
+	{
+		return width == height && width >= PAGE_SIZE && (width & (width - 1)) == 0 && getLevelCount(width) <= MAX_LEVELS;
+	}
+
+	// Fill in levelCount, firstPage and the number of pages, offsets are left to the caller
+	inline size_t setLayout(TiledImage& image)
+	{
+		image.levelCount = getLevelCount(image.size);
+		image.tileBytes = TextureCompressor::getLevelBytes(image.format, TILE_SIZE, TILE_SIZE);
+		image.firstPage.clear();
+		size_t pageCount = 0;
+		for (int level = 0; level < image.levelCount; level++)
+		{
+			image.firstPage.push_back(pageCount);
+			pageCount += (size_t)image.getPages(level) * image.getPages(level);
+		}
+		return pageCount;
+	}
+
+	// Build the mip chain of an RGBA8 image and write it as tiles in format. Pages are cut and
+	// compressed in parallel on pool, or on the calling thread if it is nullptr
+	inline bool write(const std::string& fileName, const unsigned char* rgba, int width, int height, int format, ThreadPool* pool = &ThreadPool::get(), int mipContent = -1)
+	{
+		if (!isValidSize(width, height))
+		{
+			std::cout << "ERROR: " << fileName << " needs a square, power of two image of at least " << PAGE_SIZE << " texels, not " << width << "x" << height << std::endl;
+			return false;
+		}
+		std::vector<MipLevel> mips = MipGenerator::generate(rgba, width, height, mipContent < 0 ? TextureCompressor::getMipContent(format) : mipContent, MIP_FILTER_KAISER, pool);
+		TiledImage image;
+		image.format = format;
+		image.size = width;
+		size_t pageCount = setLayout(image);
+		size_t headerBytes = 32 + pageCount * 8;
+		std::vector<unsigned char> tiles(pageCount * image.tileBytes);
+
+		// Each tile is cut from its level with wrap addressing, so the border of an edge page
+		// comes from the opposite edge like a repeating texture
+		auto encodeRange = [&](size_t begin, size_t end)
+		{
+			std::vector<unsigned char> tile((size_t)TILE_SIZE * TILE_SIZE * 4);
+			for (size_t i = begin; i < end; i++)
+			{
+				int level = (int)(std::upper_bound(image.firstPage.begin(), image.firstPage.end(), i) - image.firstPage.begin() - 1);
+				int pages = image.getPages(level);
+				int page = (int)(i - image.firstPage[level]);
+				int levelSize = width >> level;
+				const unsigned char* pixels = level == 0 ? rgba : mips[level - 1].rgba.data();
+				for (int y = 0; y < TILE_SIZE; y++)
+				{
+					int sourceY = ((page / pages) * PAGE_SIZE - PAGE_BORDER + y) & (levelSize - 1);
+					for (int x = 0; x < TILE_SIZE; x++)
+					{
+						int sourceX = ((page % pages) * PAGE_SIZE - PAGE_BORDER + x) & (levelSize - 1);
+						std::memcpy(&tile[((size_t)y * TILE_SIZE + x) * 4], pixels + ((size_t)sourceY * levelSize + sourceX) * 4, 4);
+					}
+				}
+				unsigned char* out = tiles.data() + i * image.tileBytes;
+				if (TextureCompressor::getBaseFormat(format) == FORMAT_RGBA8)
+				{
+					std::memcpy(out, tile.data(), image.tileBytes);
+					continue;
+				}
+				const int blocks = TILE_SIZE / 4;
+				size_t blockBytes = TextureCompressor::getBlockBytes(format);
+				for (int b = 0; b < blocks * blocks; b++)
+				{
+					TextureCompressor::encodeBlock(tile.data(), TILE_SIZE, TILE_SIZE, b % blocks, b / blocks, format, out + b * blockBytes);
+				}
+			}
+		};
+		if (pool)
+		{
+			pool->parallelFor(pageCount, 4, encodeRange);
+		}
+		else
+		{
+			encodeRange(0, pageCount);
+		}
+
+		std::vector<unsigned char> header;
+		TextureFile::writeU32(header, TextureFile::fourCC("VTEX"));
+		TextureFile::writeU32(header, VERSION);
+		TextureFile::writeU32(header, (uint32_t)format);
+		TextureFile::writeU32(header, (uint32_t)width);
+		TextureFile::writeU32(header, PAGE_SIZE);
+		TextureFile::writeU32(header, PAGE_BORDER);
+		TextureFile::writeU32(header, (uint32_t)image.levelCount);
+		TextureFile::writeU32(header, (uint32_t)image.tileBytes);
+		for (size_t i = 0; i < pageCount; i++)
+		{
+			TextureFile::writeU64(header, headerBytes + i * image.tileBytes);
+		}
+		std::ofstream outFile(fileName, std::ios::binary);
+		outFile.write((const char*)header.data(), header.size());
+		outFile.write((const char*)tiles.data(), tiles.size());
+		return outFile.good();
+	}
+
+	// Parse the header and page offsets of a mapped .vtex file
+	inline bool read(const MappedFile& file, TiledImage& image)
+	{
+		const unsigned char* data = file.getData();
+		size_t size = file.getSize();
+		if (size < 32 || TextureFile::readU32(data) != TextureFile::fourCC("VTEX") || TextureFile::readU32(data + 4) != VERSION)
+		{
+			return false;
+		}
+		image.format = (int)TextureFile::readU32(data + 8);
+		image.size = (int)TextureFile::readU32(data + 12);
+		int base = TextureCompressor::getBaseFormat(image.format);
+		if (base < FORMAT_RGBA8 || base > FORMAT_BC4 || !isValidSize(image.size, image.size)
+			|| TextureFile::readU32(data + 16) != PAGE_SIZE || TextureFile::readU32(data + 20) != PAGE_BORDER)
+		{
+			std::cout << "ERROR: Unsupported tiled texture (format " << image.format << ", size " << image.size << ")" << std::endl;
+			return false;
+		}
+		size_t pageCount = setLayout(image);
+		if ((int)TextureFile::readU32(data + 24) != image.levelCount || TextureFile::readU32(data + 28) != image.tileBytes || size < 32 + pageCount * 8)
+		{
+			std::cout << "ERROR: Tiled texture header does not match its size and format" << std::endl;
+			return false;
+		}
+		image.offsets.resize(pageCount);
+		for (size_t i = 0; i < pageCount; i++)
+		{
+			image.offsets[i] = TextureFile::readU64(data + 32 + i * 8);
+			if (image.offsets[i] + image.tileBytes > size)
+			{
+				std::cout << "ERROR: Tiled texture page " << i << " is truncated" << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+// Sparse virtual texture over one or more tiled files of the same size (albedo, ORM, normal...),
+// which share one page table. Only the pages the camera needs are in video memory:
+// - a feedback pass draws the scene at low resolution writing the page each pixel samples, read
+//   back a frame later through a pixel pack buffer (or handed in by processFeedback directly)
+// - missing pages, and their missing parents, are requested coarsest and most visible first
+// - a streaming thread copies their tiles out of the memory mapped files
+// - update() places each loaded page in a slot of the physical atlases, evicting the least
+//   recently used page, and rewrites the page table the shaders look pages up in
+// The coarsest level is loaded up front and never evicted, so every lookup finds some page.
+// Created with gpu false nothing touches GL, so the whole system runs headless.
+class VirtualTexture
+{
+public:
+	struct Stats
+	{
+		unsigned requested;		// Distinct pages in the last feedback
+		unsigned missing;		// Of those, not resident at the level asked for
+		unsigned streamed;		// Pages placed in the atlas since the start
+		unsigned evicted;
+		unsigned dropped;		// Loaded with no slot free, asked for again later
+		double feedbackMs;		// Render thread time for the last feedback
+		double streamMs;		// Streaming thread time since the start
+	};
+
+	// Feedback texels and page ids: level in the top 4 bits, then 14 bits each for y and x
+	static const uint32_t NO_PAGE = 0xFFFFFFFF;
+	// The feedback pass is this many times smaller than the screen on each side
+	static const int FEEDBACK_DIVISOR = 8;
+
+	static uint32_t makePage(int level, int x, int y)
+	{
+		return ((uint32_t)level << 28) | ((uint32_t)y << 14) | (uint32_t)x;
+	}
+
+	static int getPageLevel(uint32_t page)
+	{
+		return (int)(page >> 28);
+	}
+
+	static int getPageX(uint32_t page)
+	{
+		return (int)(page & 0x3FFF);
+	}
+
+	static int getPageY(uint32_t page)
+	{
+		return (int)((page >> 14) & 0x3FFF);
+	}
+
+private:
+	// Loaded tiles of one page, one per layer one after another
+	struct LoadedPage
+	{
+		uint32_t page;
+		std::vector<unsigned char> tiles;
+	};
+
+	// Shared with the streaming thread
+	struct Streamer
+	{
+		std::vector<std::unique_ptr<MappedFile>> files;
+		std::vector<TiledTextureFile::TiledImage> images;
+		std::mutex mutex;
+		std::condition_variable wake;
+		// Most important last
+		std::vector<uint32_t> requests;
+		// Taken by the thread and not yet picked up by update()
+		std::unordered_set<uint32_t> loading;
+		LockFreeQueue<LoadedPage> loaded;
+		bool stopping = false;
+		std::atomic<uint64_t> streamMicroseconds;
+	};
+
+	// Page in a slot of the atlases, NO_PAGE if the slot is free
+	struct Slot
+	{
+		uint32_t page;
+		unsigned lastUsed;
+	};
+
+	static const unsigned PINNED = 0xFFFFFFFF;
+
+	std::vector<std::string> fileNames;
+	std::shared_ptr<Streamer> streamer;
+	std::thread thread;
+	bool valid;
+	bool gpu;
+	int size;
+	int levelCount;
+	size_t slotBytes;
+	int slotsPerSide;
+	std::vector<Slot> slots;
+	std::unordered_map<uint32_t, int> resident;
+	std::deque<LoadedPage> ready;
+	// Per level, the slot and level of the page each entry is drawn from, as RGBA8UI texels
+	std::vector<std::vector<uint32_t>> pageTable;
+	bool pageTableDirty;
+	unsigned frame;
+	unsigned uploadsPerFrame;
+	Stats stats;
+
+	// GL objects, only with gpu
+	std::vector<Texture*> atlases;
+	GLuint pageTableTexture;
+	GLuint feedbackFramebuffer;
+	GLuint feedbackTexture;
+	GLuint feedbackDepth;
+	GLuint feedbackBuffers[2];
+	int feedbackWidth;
+	int feedbackHeight;
+	unsigned feedbackFrame;
+
+	static void stream(std::shared_ptr<Streamer> streamer)
+	{
+		while (true)
+		{
+			uint32_t page;
+			{
+				std::unique_lock<std::mutex> lock(streamer->mutex);
+				streamer->wake.wait(lock, [&streamer] { return streamer->stopping || !streamer->requests.empty(); });
+				if (streamer->stopping)
+				{
+					return;
+				}
+				page = streamer->requests.back();
+				streamer->requests.pop_back();
+				streamer->loading.insert(page);
+			}
+			auto start = std::chrono::steady_clock::now();
+			LoadedPage loaded = { page, std::vector<unsigned char>() };
+			for (size_t i = 0; i < streamer->files.size(); i++)
+			{
+				// Copying out of the mapping is where the tile is read from disk
+				const TiledTextureFile::TiledImage& image = streamer->images[i];
+				const unsigned char* tile = streamer->files[i]->getData() + image.getOffset(getPageLevel(page), getPageX(page), getPageY(page));
+				loaded.tiles.insert(loaded.tiles.end(), tile, tile + image.tileBytes);
+			}
+			streamer->streamMicroseconds += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			streamer->loaded.push(std::move(loaded));
+		}
+	}
+
+	int getPages(int level) const
+	{
+		return std::max(1, (this->size >> level) / TiledTextureFile::PAGE_SIZE);
+	}
+
+	bool isValidPage(uint32_t page) const
+	{
+		int level = getPageLevel(page);
+		return level < this->levelCount && getPageX(page) < this->getPages(level) && getPageY(page) < this->getPages(level);
+	}
+
+	// A free slot, or the least recently used one not needed this frame, -1 if every slot is in use
+	int findSlot()
+	{
+		int best = -1;
+		for (int i = 0; i < (int)this->slots.size(); i++)
+		{
+			const Slot& slot = this->slots[i];
+			if (slot.page == NO_PAGE)
+			{
+				return i;
+			}
+			if (slot.lastUsed < this->frame && (best < 0 || slot.lastUsed < this->slots[best].lastUsed))
+			{
+				best = i;
+			}
+		}
+		return best;
+	}
+
+	void place(const LoadedPage& loaded, int slot, unsigned lastUsed)
+	{
+		Slot& target = this->slots[slot];
+		if (target.page != NO_PAGE)
+		{
+			this->resident.erase(target.page);
+			this->stats.evicted++;
+		}
+		target.page = loaded.page;
+		target.lastUsed = lastUsed;
+		this->resident[loaded.page] = slot;
+		this->pageTableDirty = true;
+		this->stats.streamed++;
+		if (!this->gpu)
+		{
+			return;
+		}
+		size_t offset = 0;
+		for (size_t i = 0; i < this->atlases.size(); i++)
+		{
+			const TiledTextureFile::TiledImage& image = this->streamer->images[i];
+			this->atlases[i]->uploadRegion((slot % this->slotsPerSide) * TiledTextureFile::TILE_SIZE, (slot / this->slotsPerSide) * TiledTextureFile::TILE_SIZE,
+				TiledTextureFile::TILE_SIZE, TiledTextureFile::TILE_SIZE, image.format, loaded.tiles.data() + offset, image.tileBytes);
+			offset += image.tileBytes;
+		}
+	}
+
+	// Point every entry at its own page when it is resident, otherwise at the entry of its parent
+	void rebuildPageTable()
+	{
+		for (int level = this->levelCount - 1; level >= 0; level--)
+		{
+			int pages = this->getPages(level);
+			std::vector<uint32_t>& entries = this->pageTable[level];
+			for (int y = 0; y < pages; y++)
+			{
+				for (int x = 0; x < pages; x++)
+				{
+					auto it = this->resident.find(makePage(level, x, y));
+					if (it != this->resident.end())
+					{
+						entries[(size_t)y * pages + x] = (uint32_t)(it->second % this->slotsPerSide) | ((uint32_t)(it->second / this->slotsPerSide) << 8) | ((uint32_t)level << 16) | (255u << 24);
+					}
+					else
+					{
+						entries[(size_t)y * pages + x] = this->pageTable[level + 1][(size_t)(y / 2) * this->getPages(level + 1) + x / 2];
+					}
+				}
+			}
+			if (this->gpu)
+			{
+				GLState::get().bindTexture(0, GL_TEXTURE_2D, this->pageTableTexture);
+				glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, pages, pages, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries.data());
+			}
+		}
+		this->pageTableDirty = false;
+	}
+
+	void destroyFeedback()
+	{
+		if (this->feedbackFramebuffer)
+		{
+			GLState::get().forgetTexture(this->feedbackTexture);
+			glDeleteFramebuffers(1, &this->feedbackFramebuffer);
+			glDeleteTextures(1, &this->feedbackTexture);
+			glDeleteRenderbuffers(1, &this->feedbackDepth);
+			glDeleteBuffers(2, this->feedbackBuffers);
+			this->feedbackFramebuffer = 0;
+		}
+	}
+
+	void createFeedback(int width, int height)
+	{
+		this->destroyFeedback();
+		this->feedbackWidth = width;
+		this->feedbackHeight = height;
+		this->feedbackFrame = 0;
+		glGenTextures(1, &this->feedbackTexture);
+		GLState::get().bindTexture(0, GL_TEXTURE_2D, this->feedbackTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, width, height);
+		glGenRenderbuffers(1, &this->feedbackDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, this->feedbackDepth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glGenFramebuffers(1, &this->feedbackFramebuffer);
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, this->feedbackFramebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->feedbackTexture, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->feedbackDepth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "ERROR: Virtual texture feedback framebuffer is incomplete" << std::endl;
+		}
+		glGenBuffers(2, this->feedbackBuffers);
+		for (GLuint i : this->feedbackBuffers)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, i);
+			glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, nullptr, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+public:
+	// Open tiled files of the same size as the layers, each gets an atlas of budgetBytes / layers
+	VirtualTexture(const std::vector<std::string>& fileNames, size_t budgetBytes = 32 * 1024 * 1024, bool gpu = true)
+	{
+		this->fileNames = fileNames;
+		this->streamer = std::make_shared<Streamer>();
+		this->streamer->streamMicroseconds = 0;
+		this->valid = !fileNames.empty();
+		this->gpu = gpu;
+		this->size = 0;
+		this->levelCount = 0;
+		this->slotBytes = 0;
+		this->slotsPerSide = 0;
+		this->pageTableDirty = true;
+		this->frame = 0;
+		this->uploadsPerFrame = 32;
+		std::memset(&this->stats, 0, sizeof(this->stats));
+		this->pageTableTexture = 0;
+		this->feedbackFramebuffer = 0;
+		this->feedbackWidth = 0;
+		this->feedbackHeight = 0;
+		this->feedbackFrame = 0;
+
+		for (auto& i : fileNames)
+		{
+			this->streamer->files.emplace_back(new MappedFile(i));
+			this->streamer->images.emplace_back();
+			TiledTextureFile::TiledImage& image = this->streamer->images.back();
+			if (!this->streamer->files.back()->isOpen() || !TiledTextureFile::read(*this->streamer->files.back(), image))
+			{
+				std::cout << "ERROR: Failed to open tiled texture " << i << std::endl;
+				this->valid = false;
+				return;
+			}
+			if (this->size && image.size != this->size)
+			{
+				std::cout << "ERROR: Tiled texture " << i << " is " << image.size << " texels, the others are " << this->size << std::endl;
+				this->valid = false;
+				return;
+			}
+			this->size = image.size;
+			this->levelCount = image.levelCount;
+			this->slotBytes += image.tileBytes;
+		}
+		if (!this->valid)
+		{
+			return;
+		}
+
+		// Square atlases, as many slots as fit in the budget. Slot coordinates are stored in a byte
+		GLint maxSize = 16384;
+		if (gpu)
+		{
+			glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+		}
+		this->slotsPerSide = (int)std::sqrt((double)budgetBytes / this->slotBytes);
+		this->slotsPerSide = std::max(2, std::min({ this->slotsPerSide, 255, (int)maxSize / TiledTextureFile::TILE_SIZE }));
+		this->slots.assign((size_t)this->slotsPerSide * this->slotsPerSide, { NO_PAGE, 0 });
+		this->pageTable.resize(this->levelCount);
+		for (int level = 0; level < this->levelCount; level++)
+		{
+			this->pageTable[level].assign((size_t)this->getPages(level) * this->getPages(level), 0);
+		}
+		if (gpu)
+		{
+			int atlasSize = this->slotsPerSide * TiledTextureFile::TILE_SIZE;
+			for (auto& i : this->streamer->images)
+			{
+				this->atlases.push_back(new Texture(atlasSize, atlasSize, i.format));
+			}
+			glGenTextures(1, &this->pageTableTexture);
+			GLState::get().bindTexture(0, GL_TEXTURE_2D, this->pageTableTexture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexStorage2D(GL_TEXTURE_2D, this->levelCount, GL_RGBA8UI, this->getPages(0), this->getPages(0));
+		}
+
+		// The coarsest level is the fallback for everything, read before the first frame and kept
+		int coarsest = this->levelCount - 1;
+		for (int y = 0; y < this->getPages(coarsest); y++)
+		{
+			for (int x = 0; x < this->getPages(coarsest); x++)
+			{
+				LoadedPage loaded = { makePage(coarsest, x, y), std::vector<unsigned char>() };
+				for (size_t i = 0; i < this->streamer->files.size(); i++)
+				{
+					const TiledTextureFile::TiledImage& image = this->streamer->images[i];
+					const unsigned char* tile = this->streamer->files[i]->getData() + image.getOffset(coarsest, x, y);
+					loaded.tiles.insert(loaded.tiles.end(), tile, tile + image.tileBytes);
+				}
+				this->place(loaded, this->findSlot(), PINNED);
+			}
+		}
+		this->rebuildPageTable();
+		this->thread = std::thread(&VirtualTexture::stream, this->streamer);
+	}
+
+	~VirtualTexture()
+	{
+		if (this->thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(this->streamer->mutex);
+				this->streamer->stopping = true;
+			}
+			this->streamer->wake.notify_all();
+			this->thread.join();
+		}
+		for (auto* i : this->atlases)
+		{
+			delete i;
+		}
+		if (this->pageTableTexture)
+		{
+			GLState::get().forgetTexture(this->pageTableTexture);
+			glDeleteTextures(1, &this->pageTableTexture);
+		}
+		this->destroyFeedback();
+	}
+
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+	bool isValid() const
+	{
+		return this->valid;
+	}
+
+	// Physical atlas of a layer, in the order the files were given
+	Texture* getAtlas(size_t layer) const
+	{
+		return this->atlases[layer];
+	}
+
+	int getSize() const
+	{
+		return this->size;
+	}
+
+	int getLevelCount() const
+	{
+		return this->levelCount;
+	}
+
+	int getSlotCount() const
+	{
+		return (int)this->slots.size();
+	}
+
+	int getResidentCount() const
+	{
+		return (int)this->resident.size();
+	}
+
+	const Stats& getStats() const
+	{
+		return this->stats;
+	}
+
+	void setUploadsPerFrame(unsigned pages)
+	{
+		this->uploadsPerFrame = std::max(1u, pages);
+	}
+
+	// Video memory of the atlases and page table
+	size_t getResidentBytes() const
+	{
+		size_t pageTableBytes = 0;
+		for (auto& i : this->pageTable)
+		{
+			pageTableBytes += i.size() * 4;
+		}
+		return this->slots.size() * this->slotBytes + pageTableBytes;
+	}
+
+	// Video memory the layers would take as ordinary textures with full mip chains
+	size_t getFullResidencyBytes() const
+	{
+		size_t bytes = 0;
+		for (auto& i : this->streamer->images)
+		{
+			for (int size = this->size; size > 0; size /= 2)
+			{
+				bytes += TextureCompressor::getLevelBytes(i.format, size, size);
+			}
+		}
+		return bytes;
+	}
+
+	// Page a sample at uv needs, given how far uv moves to the next pixel right (dx) and down (dy)
+	// at full resolution. The same sums as virtualLevel and VirtualFeedbackFS.glsl
+	uint32_t getPage(glm::vec2 uv, glm::vec2 dx, glm::vec2 dy) const
+	{
+		dx *= (float)this->size;
+		dy *= (float)this->size;
+		float level = 0.5f * std::log2(std::max(glm::dot(dx, dx), glm::dot(dy, dy)));
+		int l = (int)std::min(std::max(level, 0.0f), (float)(this->levelCount - 1));
+		int pages = this->getPages(l);
+		glm::vec2 wrapped = uv - glm::floor(uv);
+		return makePage(l, std::min((int)(wrapped.x * pages), pages - 1), std::min((int)(wrapped.y * pages), pages - 1));
+	}
+
+	// Level of the page the shaders sample for page, its own if it is resident, else that of a parent
+	int getServedLevel(uint32_t page) const
+	{
+		int level = getPageLevel(page);
+		return (int)((this->pageTable[level][(size_t)getPageY(page) * this->getPages(level) + getPageX(page)] >> 16) & 0xFF);
+	}
+
+	// Take one frame of feedback texels, NO_PAGE where nothing virtual textured was drawn.
+	// Marks the pages in use and replaces the streaming requests with what is missing now
+	void processFeedback(const uint32_t* texels, size_t count)
+	{
+		auto start = std::chrono::steady_clock::now();
+		this->frame++;
+		// Neighbouring texels mostly want the same page, skip the repeats before sorting
+		std::vector<uint32_t> pages;
+		uint32_t last = NO_PAGE;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (texels[i] != last && texels[i] != NO_PAGE)
+			{
+				last = texels[i];
+				pages.push_back(last);
+			}
+		}
+		std::sort(pages.begin(), pages.end());
+
+		// Weight of each missing page, the texels that want it or one of its children
+		std::unordered_map<uint32_t, unsigned> missing;
+		this->stats.requested = 0;
+		this->stats.missing = 0;
+		for (size_t i = 0; i < pages.size();)
+		{
+			size_t end = i;
+			while (end < pages.size() && pages[end] == pages[i])
+			{
+				end++;
+			}
+			uint32_t page = pages[i];
+			unsigned weight = (unsigned)(end - i);
+			i = end;
+			if (!this->isValidPage(page))
+			{
+				continue;
+			}
+			this->stats.requested++;
+			// Walk up to the first resident parent, it is drawn in the meantime so it is in use too
+			int x = getPageX(page), y = getPageY(page);
+			for (int level = getPageLevel(page); level < this->levelCount; level++, x /= 2, y /= 2)
+			{
+				uint32_t id = makePage(level, x, y);
+				auto it = this->resident.find(id);
+				if (it != this->resident.end())
+				{
+					Slot& slot = this->slots[it->second];
+					slot.lastUsed = slot.lastUsed == PINNED ? PINNED : this->frame;
+					break;
+				}
+				if (id == page)
+				{
+					this->stats.missing++;
+				}
+				missing[id] += weight;
+			}
+		}
+
+		// Coarse pages first since they cover the most screen, then the most wanted
+		std::vector<std::pair<uint64_t, uint32_t>> order;
+		for (auto& i : missing)
+		{
+			order.push_back({ ((uint64_t)getPageLevel(i.first) << 32) | i.second, i.first });
+		}
+		std::sort(order.begin(), order.end());
+		// Pages loaded but still waiting for their upload are not asked for again
+		std::unordered_set<uint32_t> waiting;
+		for (auto& i : this->ready)
+		{
+			waiting.insert(i.page);
+		}
+		{
+			std::lock_guard<std::mutex> lock(this->streamer->mutex);
+			this->streamer->requests.clear();
+			for (auto& i : order)
+			{
+				if (!this->streamer->loading.count(i.second) && !waiting.count(i.second))
+				{
+					this->streamer->requests.push_back(i.second);
+				}
+			}
+		}
+		this->streamer->wake.notify_one();
+		this->stats.feedbackMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Place pages the streaming thread has loaded, up to the per frame limit, and update the page table
+	void update()
+	{
+		std::vector<LoadedPage> loaded;
+		if (this->streamer->loaded.popAll(loaded))
+		{
+			std::lock_guard<std::mutex> lock(this->streamer->mutex);
+			for (auto& i : loaded)
+			{
+				this->streamer->loading.erase(i.page);
+			}
+		}
+		for (auto& i : loaded)
+		{
+			this->ready.push_back(std::move(i));
+		}
+		for (unsigned uploads = 0; !this->ready.empty() && uploads < this->uploadsPerFrame; uploads++)
+		{
+			const LoadedPage& page = this->ready.front();
+			if (!this->resident.count(page.page))
+			{
+				int slot = this->findSlot();
+				if (slot < 0)
+				{
+					this->stats.dropped++;
+				}
+				else
+				{
+					this->place(page, slot, this->frame);
+				}
+			}
+			this->ready.pop_front();
+		}
+		if (this->pageTableDirty)
+		{
+			this->rebuildPageTable();
+		}
+		this->stats.streamMs = this->streamer->streamMicroseconds / 1000.0;
+	}
+
+	// Uniforms of the VIRTUAL_TEXTURE permutation and the feedback shader
+	void setUniforms(Shader& shader, GLint pageTableUnit) const
+	{
+		shader.set1i(pageTableUnit, "vtPageTable");
+		shader.set1f((float)this->getPages(0), "vtPages");
+		shader.set1f((float)(this->levelCount - 1), "vtMaxLevel");
+		shader.set1f((float)this->slotsPerSide, "vtAtlasSlots");
+	}
+
+	void bindPageTable(GLint unit)
+	{
+		GLState::get().bindTexture(unit, GL_TEXTURE_2D, this->pageTableTexture);
+	}
+
+	// log2 of how much smaller the feedback pass is, subtracted from its level of detail
+	static float getFeedbackLevelBias()
+	{
+		return std::log2((float)FEEDBACK_DIVISOR);
+	}
+
+	// Bind and clear the feedback framebuffer, the scene is then drawn with the feedback shader
+	void beginFeedback(int screenWidth, int screenHeight)
+	{
+		int width = std::max(1, screenWidth / FEEDBACK_DIVISOR);
+		int height = std::max(1, screenHeight / FEEDBACK_DIVISOR);
+		if (width != this->feedbackWidth || height != this->feedbackHeight)
+		{
+			this->createFeedback(width, height);
+		}
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, this->feedbackFramebuffer);
+		GLState::get().setViewport(0, 0, width, height);
+		const GLuint clearPage[4] = { NO_PAGE, 0, 0, 0 };
+		const GLfloat clearDepth = 1.0f;
+		glClearBufferuiv(GL_COLOR, 0, clearPage);
+		glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+	}
+
+	// Start reading this frame's feedback back and process last frame's, which has arrived by now.
+	// Restores the default framebuffer
+	void endFeedback(int screenWidth, int screenHeight)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, this->feedbackBuffers[this->feedbackFrame & 1]);
+		glReadPixels(0, 0, this->feedbackWidth, this->feedbackHeight, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		if (this->feedbackFrame > 0)
+		{
+			size_t count = (size_t)this->feedbackWidth * this->feedbackHeight;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, this->feedbackBuffers[(this->feedbackFrame + 1) & 1]);
+			const uint32_t* texels = (const uint32_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * 4, GL_MAP_READ_BIT);
+			if (texels)
+			{
+				this->processFeedback(texels, count);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		this->feedbackFrame++;
+		GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::get().setViewport(0, 0, screenWidth, screenHeight);
+	}
+
+	void renderGUI()
+	{
+		const float mb = 1.0f / (1024.0f * 1024.0f);
+		ImGui::Begin("Virtual Texture");
+		ImGui::Text("%d layers, %dx%d texels, %d levels, %d texel pages", (int)this->fileNames.size(), this->size, this->size, this->levelCount, TiledTextureFile::PAGE_SIZE);
+		ImGui::Text("Pages: %d/%d slots resident, %u requested, %u missing", this->getResidentCount(), this->getSlotCount(), this->stats.requested, this->stats.missing);
+		ImGui::Text("Streamed %u, evicted %u, dropped %u", this->stats.streamed, this->stats.evicted, this->stats.dropped);
+		ImGui::Text("Memory: %.1f MB resident, %.1f MB fully resident", this->getResidentBytes() * mb, this->getFullResidencyBytes() * mb);
+		ImGui::Text("Feedback %.3f ms, streaming %.1f ms total", this->stats.feedbackMs, this->stats.streamMs);
+		for (auto& i : this->fileNames)
+		{
+			ImGui::Text("%s", i.c_str());
+		}
+		ImGui::End();
+	}
+};
@@ -28,8 +28,24 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <chrono>
 
 #include "Primitives.h"
 #include "Mesh.h"
 #include "Model.h"
 #include "Light.h"
+#include "ShaderWatcher.h"
+#include "TextureLoader.h"
+#include "VirtualTexture.h"
+#include "TextureStreamer.h"
+#include "MaterialTable.h"
+#include "MeshBatch.h"
+#include "HDRFile.h"
+#include "IBLCache.h"
+#include "IBLBaker.h"
+#include "BRDFLUT.h"
+#include "SHIrradiance.h"
+#include "IBLRebaker.h"
+#include "ReflectionProbes.h"
+#include "ShaderBake.h"
+#include "TextureBake.h"
@@ -1,11 +1,66 @@
 #include "Engine.h"
+#include "Benchmark.h"
 
-int main(void)
+int main(int argc, char** argv)
 {
+    // Run a standalone benchmark instead of the engine: 3DEngine.exe --benchmark <name>
+    if (argc > 2 && std::string(argv[1]) == "--benchmark")
+    {
+        return Benchmark::run(argv[2]);
+    }
+    // Offline asset bake: 3DEngine.exe --bake shaders, 3DEngine.exe --bake textures [ktx2|dds], 3DEngine.exe --bake virtual,
+    // 3DEngine.exe --bake ibl [file.hdr] [low|medium|high|ultra], 3DEngine.exe --bake brdf
+    if (argc > 2 && std::string(argv[1]) == "--bake")
+    {
+        if (std::string(argv[2]) == "shaders")
+        {
+            return ShaderBake::bake();
+        }
+        if (std::string(argv[2]) == "textures")
+        {
+            return TextureBake::bake(argc > 3 ? argv[3] : "ktx2");
+        }
+        if (std::string(argv[2]) == "virtual")
+        {
+            return TextureBake::bakeVirtual();
+        }
+        if (std::string(argv[2]) == "ibl")
+        {
+            IBLCache::quality_enum quality = IBLCache::QUALITY_HIGH;
+            if (argc > 4 && !IBLCache::findQuality(argv[4], quality))
+            {
+                std::cout << "ERROR: Unknown IBL quality: " << argv[4] << std::endl;
+                return 1;
+            }
+            return argc > 3 ? IBLBaker::bakeFile(argv[3], quality) : IBLBaker::bakeFile();
+        }
+        if (std::string(argv[2]) == "brdf")
+        {
+            return BRDFLUT::bake();
+        }
+        std::cout << "ERROR: Unknown bake step: " << argv[2] << std::endl;
+        return 1;
+    }
     try 
     {
+        // For comparison: --sync-textures loads textures on the render thread before the first frame,
+        // --irradiance-map lights diffuse IBL from the irradiance cube map instead of spherical harmonics,
+        // --brdf-approx uses an analytic fit of the split sum BRDF instead of the LUT,
+        // --ibl-quality low|medium|high|ultra sets the IBL map sizes and sample counts (high by default)
+        bool asyncTextures = true, shIrradiance = true, brdfApprox = false;
+        IBLCache::quality_enum iblQuality = IBLCache::QUALITY_HIGH;
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::string(argv[i]) == "--ibl-quality" && i + 1 < argc && !IBLCache::findQuality(argv[i + 1], iblQuality))
+            {
+                std::cout << "ERROR: Unknown IBL quality: " << argv[i + 1] << std::endl;
+            }
+            asyncTextures = asyncTextures && std::string(argv[i]) != "--sync-textures";
+            shIrradiance = shIrradiance && std::string(argv[i]) != "--irradiance-map";
+            brdfApprox = brdfApprox || std::string(argv[i]) == "--brdf-approx";
+        }
         // Create engine with name, resolution and boolean value for window resize mode
-        Engine engine("3D Graphics Engine", 1280, 720, true);
+        Engine engine("3D Graphics Engine", 1280, 720, true, asyncTextures, shIrradiance, brdfApprox, iblQuality);
         // Main render loop
         while (!engine.getWindowShouldClose())
         {
@@ -8,9 +8,14 @@ void main()
 {
     vec3 envColor = texture(environmentMap, position).rgb;
 
-    // HDR tonemapping and gamma correction
+#ifndef PROBE_CAPTURE
+    // HDR tonemapping, reflection probes capture the radiance before it
     envColor = envColor / (envColor + vec3(1.0));
+#endif
+#ifdef LINEAR_FRAMEBUFFER
+    // Gamma correction, otherwise the sRGB framebuffer encodes on write
     envColor = pow(envColor, vec3(1.0 / 2.2));
+#endif
 
     FragColor = vec4(envColor, 1.0);
 }
\ No newline at end of file